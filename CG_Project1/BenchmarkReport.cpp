@@ -0,0 +1,71 @@
+#include "BenchmarkReport.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+namespace {
+	double percentile(const std::vector<double>& sorted, double p) {
+		if (sorted.empty()) return 0.0;
+		// Nearest-rank percentile
+		size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(rank, sorted.size() - 1)];
+	}
+
+	std::string escapeJson(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+}
+
+BenchmarkReport::BenchmarkReport() : cpuFrames(), gpuFrames() {}
+
+BenchmarkReport::Summary BenchmarkReport::summarize(std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	Summary summary;
+	summary.count = samples.size();
+	summary.mean = samples.empty() ? 0.0 : std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	summary.p50 = percentile(samples, 50.0);
+	summary.p95 = percentile(samples, 95.0);
+	summary.p99 = percentile(samples, 99.0);
+	summary.max = samples.empty() ? 0.0 : samples.back();
+	return summary;
+}
+
+void BenchmarkReport::print() const {
+	Summary cpu = summarize(cpuFrames);
+	Summary gpu = summarize(gpuFrames);
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Benchmark: " << cpu.count << " frames\n"
+		<< "  CPU ms  mean " << cpu.mean << "  p50 " << cpu.p50 << "  p95 " << cpu.p95 << "  p99 " << cpu.p99 << "  max " << cpu.max << "\n"
+		<< "  GPU ms  mean " << gpu.mean << "  p50 " << gpu.p50 << "  p95 " << gpu.p95 << "  p99 " << gpu.p99 << "  max " << gpu.max
+		<< std::endl;
+	std::cout.unsetf(std::ios::fixed);
+}
+
+bool BenchmarkReport::writeJson(const std::string& path, const std::string& pathName, const std::string& glRenderer) const {
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		std::cerr << "Failed to open benchmark output: " << path << std::endl;
+		return false;
+	}
+
+	auto writeSummary = [&out](const char* name, const Summary& s, bool last) {
+		out << "  \"" << name << "\": { \"frames\": " << s.count << ", \"mean\": " << s.mean << ", \"p50\": " << s.p50
+			<< ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << " }" << (last ? "\n" : ",\n");
+	};
+
+	out << std::fixed << std::setprecision(4);
+	out << "{\n";
+	out << "  \"path\": \"" << escapeJson(pathName) << "\",\n";
+	out << "  \"renderer\": \"" << escapeJson(glRenderer) << "\",\n";
+	writeSummary("cpu_ms", summarize(cpuFrames), false);
+	writeSummary("gpu_ms", summarize(gpuFrames), true);
+	out << "}\n";
+	return true;
+}
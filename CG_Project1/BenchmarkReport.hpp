@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Collects per-frame CPU and GPU times of a benchmark run and summarizes them
+// as mean/percentiles, both on stdout and as JSON that can be diffed between builds.
+class BenchmarkReport {
+public:
+	BenchmarkReport();
+
+	void addCpuFrame(double ms) { cpuFrames.push_back(ms); }
+	void addGpuFrame(double ms) { gpuFrames.push_back(ms); }
+
+	void print() const;
+	bool writeJson(const std::string& path, const std::string& pathName, const std::string& glRenderer) const;
+
+private:
+	struct Summary {
+		size_t count;
+		double mean;
+		double p50;
+		double p95;
+		double p99;
+		double max;
+	};
+
+	std::vector<double> cpuFrames;
+	std::vector<double> gpuFrames;
+
+	static Summary summarize(std::vector<double> samples);
+};
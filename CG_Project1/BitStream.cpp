@@ -0,0 +1,59 @@
+#include "BitStream.hpp"
+
+BitWriter::BitWriter() : bytes(), scratch(0), scratchBits(0) {}
+
+void BitWriter::clear() {
+	bytes.clear();
+	scratch = 0;
+	scratchBits = 0;
+}
+
+void BitWriter::write(uint32_t value, int bits) {
+	uint64_t mask = bits >= 32 ? 0xFFFFFFFFull : (1ull << bits) - 1;
+	scratch |= (static_cast<uint64_t>(value) & mask) << scratchBits;
+	scratchBits += bits;
+	while (scratchBits >= 8) {
+		bytes.push_back(static_cast<uint8_t>(scratch));
+		scratch >>= 8;
+		scratchBits -= 8;
+	}
+}
+
+const std::vector<uint8_t>& BitWriter::finish() {
+	if (scratchBits > 0) {
+		bytes.push_back(static_cast<uint8_t>(scratch));
+		scratch = 0;
+		scratchBits = 0;
+	}
+	return bytes;
+}
+
+BitReader::BitReader(const uint8_t* data, size_t size) : data(data), size(size), bitPosition(0), overflowed(false) {}
+
+uint32_t BitReader::read(int bits) {
+	if (bitPosition + bits > size * 8) {
+		overflowed = true;
+		bitPosition = size * 8;
+		return 0;
+	}
+
+	uint32_t value = 0;
+	int written = 0;
+	while (written < bits) {
+		size_t byte = bitPosition / 8;
+		int offset = static_cast<int>(bitPosition % 8);
+		int take = 8 - offset < bits - written ? 8 - offset : bits - written;
+		uint32_t chunk = (data[byte] >> offset) & ((1u << take) - 1);
+		value |= chunk << written;
+		written += take;
+		bitPosition += take;
+	}
+	return value;
+}
+
+int32_t BitReader::readSigned(int bits) {
+	uint32_t value = read(bits);
+	// Sign-extend from the top bit of the field
+	if (bits < 32 && (value & (1u << (bits - 1)))) value |= ~((1u << bits) - 1);
+	return static_cast<int32_t>(value);
+}
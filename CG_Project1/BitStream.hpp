@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packs values of any bit width back to back, least significant bit first, for network
+// messages where every field is only as wide as its range needs.
+class BitWriter {
+public:
+	BitWriter();
+
+	void clear();
+
+	// The low bits of value; bits is 1 to 32
+	void write(uint32_t value, int bits);
+	void writeBool(bool value) { write(value ? 1u : 0u, 1); }
+	// Two's complement in bits bits; the value must fit
+	void writeSigned(int32_t value, int bits) { write(static_cast<uint32_t>(value), bits); }
+
+	// Pads the last byte with zeros and returns the message; clear() before writing another
+	const std::vector<uint8_t>& finish();
+
+	size_t getBitCount() const { return bytes.size() * 8 + scratchBits; }
+
+private:
+	std::vector<uint8_t> bytes;
+	uint64_t scratch;
+	int scratchBits;
+};
+
+// Reads what a BitWriter wrote. Reading past the end yields zeros and marks the reader as
+// overflowed, so decoders check once at the end instead of after every field.
+class BitReader {
+public:
+	BitReader(const uint8_t* data, size_t size);
+
+	uint32_t read(int bits);
+	bool readBool() { return read(1) != 0; }
+	int32_t readSigned(int bits);
+
+	bool isOverflowed() const { return overflowed; }
+
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t bitPosition;
+	bool overflowed;
+};
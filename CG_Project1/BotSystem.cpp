@@ -0,0 +1,285 @@
+#include "BotSystem.hpp"
+#include "NavMesh.hpp"
+#include "LineOfSight.hpp"
+#include "SpatialGrid.hpp"
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+	const float MAX_HEALTH = 100.0f;
+	const float RETREAT_HEALTH = 30.0f;    // Falls back home below this
+	const float RECOVERED_HEALTH = 90.0f;  // and patrols again once healed to this
+	const float REGEN_PER_SECOND = 15.0f;  // While retreating
+	const float DAMAGE_PER_SECOND = 20.0f; // From each enemy engaging a bot it can see
+
+	const float ENGAGE_RANGE = 25.0f;
+	const float WALK_SPEED = 4.0f;
+
+	// Default think budget per tick, and the first guess of a think's cost before any is measured
+	const double DEFAULT_THINK_BUDGET_US = 250.0;
+	const double INITIAL_THINK_COST_NS = 2000.0;
+
+	// Fewest bots handed to one think slice, and bots per job in both passes
+	const size_t MIN_THINK_SLICE = 8;
+	const size_t THINK_GRAIN = 16;
+	const size_t ACT_GRAIN = 128;
+
+	const int PATROL_GOAL_ATTEMPTS = 16;
+
+	// Character models face -x, so yaw 90 looks down +z
+	float yawTowards(const glm::vec3& direction) {
+		return std::atan2(direction.z, -direction.x) * (180.0f / 3.14159265f);
+	}
+
+	// Cheap integer hash, so bots can roll dice in parallel without sharing a generator
+	uint32_t mix(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+}
+
+BotSystem::BotSystem(const NavMesh& navMesh, PathService& paths)
+	: navMesh(navMesh), paths(paths), current(0), handles(), homes(), homeRegions(), goals(), waypoints(), wantsPath()
+	, storeIndices(), botOfCharacter(), routes(), thinkCursor(0), thinkBudgetNs(static_cast<long long>(DEFAULT_THINK_BUDGET_US * 1000.0))
+	, thinkCostNs(INITIAL_THINK_COST_NS), lastThinkCount(0), lastThinkNs(0), tick(0) {}
+
+BotSystem::~BotSystem() {
+	clear();
+}
+
+void BotSystem::add(EntityHandle character, const glm::vec3& home) {
+	BotState state = { home, 0.0f, MAX_HEALTH, Mode::PATROL, EntityHandle() };
+	states[0].push_back(state);
+	states[1].push_back(state);
+	handles.push_back(character);
+	homes.push_back(home);
+	uint32_t polygon = navMesh.findPolygon(home);
+	homeRegions.push_back(polygon != NavMesh::NONE ? navMesh.getPolygon(polygon).region : NavMesh::NONE);
+	goals.push_back(home);
+	waypoints.push_back(0);
+	wantsPath.push_back(0);
+	storeIndices.push_back(-1);
+	routes.emplace_back();
+}
+
+void BotSystem::clear() {
+	for (PathResult& route : routes) {
+		paths.cancel(route);
+	}
+	states[0].clear();
+	states[1].clear();
+	handles.clear();
+	homes.clear();
+	homeRegions.clear();
+	goals.clear();
+	waypoints.clear();
+	wantsPath.clear();
+	storeIndices.clear();
+	routes.clear();
+	thinkCursor = 0;
+}
+
+glm::vec3 BotSystem::pickPatrolGoal(size_t bot) const {
+	if (navMesh.isEmpty() || homeRegions[bot] == NavMesh::NONE) return homes[bot];
+
+	uint32_t seed = mix(static_cast<uint32_t>(bot) * 0x9e3779b9u ^ tick);
+	for (int attempt = 0; attempt < PATROL_GOAL_ATTEMPTS; attempt++) {
+		seed = mix(seed + 1);
+		const NavMesh::Polygon& polygon = navMesh.getPolygon(seed % static_cast<uint32_t>(navMesh.getPolygonCount()));
+		if (polygon.region == homeRegions[bot]) return polygon.center;
+	}
+	return homes[bot];
+}
+
+void BotSystem::think(size_t bot, const CharacterStore& characters, const LineOfSight& sight, const SpatialGrid& grid) {
+	int self = storeIndices[bot];
+	if (self < 0) return;
+	const BotState& now = states[current][bot];
+	BotState& next = states[1 - current][bot];
+	CharacterStore::Team team = characters.getTeams()[self];
+
+	// Closest enemy in range that this bot can see
+	thread_local std::vector<EntityHandle> nearby;
+	nearby.clear();
+	grid.queryRadius(now.position, ENGAGE_RANGE, nearby);
+	EntityHandle target;
+	float closest = FLT_MAX;
+	for (EntityHandle handle : nearby) {
+		int other = characters.indexOf(handle);
+		if (other < 0 || characters.getTeams()[other] == team) continue;
+		if (static_cast<size_t>(std::max(self, other)) >= sight.size() || !sight.canSee(self, other)) continue;
+		glm::vec3 offset = characters.getPositions()[other] - now.position;
+		float distance = glm::dot(offset, offset);
+		if (distance < closest) {
+			closest = distance;
+			target = handle;
+		}
+	}
+
+	const PathResult& route = routes[bot];
+	bool hurt = now.health < (now.mode == Mode::RETREAT ? RECOVERED_HEALTH : RETREAT_HEALTH);
+	if (hurt) {
+		if (now.mode != Mode::RETREAT) {
+			goals[bot] = homes[bot];
+			wantsPath[bot] = 1;
+		}
+		next.mode = Mode::RETREAT;
+		next.target = EntityHandle();
+	}
+	else if (!target.isNull()) {
+		next.mode = Mode::ENGAGE;
+		next.target = target;
+	}
+	else {
+		// A new patrol goal when coming out of another mode or when the last one is done with
+		bool arrived = route.status == PathResult::Status::FOUND && waypoints[bot] >= route.points.size();
+		bool noRoute = route.status == PathResult::Status::NONE || route.status == PathResult::Status::NOT_FOUND;
+		if (now.mode != Mode::PATROL || arrived || noRoute) {
+			goals[bot] = pickPatrolGoal(bot);
+			wantsPath[bot] = 1;
+		}
+		next.mode = Mode::PATROL;
+		next.target = EntityHandle();
+	}
+}
+
+void BotSystem::act(size_t bot, const CharacterStore& characters, float dt) {
+	if (storeIndices[bot] < 0) return;
+	BotState& next = states[1 - current][bot];
+
+	if (next.mode == Mode::RETREAT) {
+		next.health = std::min(next.health + REGEN_PER_SECOND * dt, MAX_HEALTH);
+	}
+
+	// Engaged bots stand and face their target
+	if (next.mode == Mode::ENGAGE) {
+		int target = characters.indexOf(next.target);
+		if (target >= 0) next.yaw = yawTowards(characters.getPositions()[target] - next.position);
+		return;
+	}
+
+	const PathResult& route = routes[bot];
+	if (route.status != PathResult::Status::FOUND) return;
+	float step = WALK_SPEED * dt;
+	uint32_t& waypoint = waypoints[bot];
+	while (step > 0.0f && waypoint < route.points.size()) {
+		glm::vec3 offset = route.points[waypoint] - next.position;
+		float distance = glm::length(offset);
+		if (distance > 1e-4f) next.yaw = yawTowards(offset);
+		if (distance <= step) {
+			next.position = route.points[waypoint];
+			step -= distance;
+			waypoint++;
+		}
+		else {
+			next.position += offset * (step / distance);
+			step = 0.0f;
+		}
+	}
+}
+
+void BotSystem::update(CharacterStore& characters, const LineOfSight& sight, const SpatialGrid& grid, float dt, JobSystem* jobs) {
+	PROFILE_SCOPE("BotSystem::update");
+	size_t count = handles.size();
+	if (count == 0) return;
+
+	// Start the next state from this one; anything else moving a character wins over the AI
+	std::vector<BotState>& now = states[current];
+	std::vector<BotState>& next = states[1 - current];
+	const glm::vec3* positions = characters.getPositions();
+	const float* yaws = characters.getYaws();
+	for (size_t bot = 0; bot < count; bot++) {
+		storeIndices[bot] = characters.indexOf(handles[bot]);
+		if (storeIndices[bot] >= 0) {
+			now[bot].position = positions[storeIndices[bot]];
+			now[bot].yaw = yaws[storeIndices[bot]];
+		}
+	}
+	next = now;
+
+	// Think in slices sized to fit what is left of the budget, so every bot thinks at most
+	// once a tick and a big population simply takes more ticks to get round
+	{
+		PROFILE_SCOPE("BotSystem::think");
+		long long thinkStart = CpuProfiler::now();
+		size_t thought = 0;
+		while (thought < count) {
+			long long elapsed = CpuProfiler::now() - thinkStart;
+			if (thought > 0 && elapsed >= thinkBudgetNs) break;
+
+			double remaining = static_cast<double>(std::max(thinkBudgetNs - elapsed, 0ll));
+			size_t slice = static_cast<size_t>(remaining / std::max(thinkCostNs, 1.0));
+			slice = std::min(std::max(slice, MIN_THINK_SLICE), count - thought);
+
+			size_t first = thinkCursor;
+			auto thinkRange = [&](size_t begin, size_t end) {
+				for (size_t k = begin; k < end; k++) think((first + k) % count, characters, sight, grid);
+			};
+			long long sliceStart = CpuProfiler::now();
+			if (jobs) jobs->parallelFor(slice, THINK_GRAIN, thinkRange);
+			else thinkRange(0, slice);
+
+			double perBot = static_cast<double>(CpuProfiler::now() - sliceStart) / slice;
+			thinkCostNs = thinkCostNs * 0.75 + perBot * 0.25;
+			thinkCursor = (first + slice) % count;
+			thought += slice;
+		}
+		lastThinkCount = thought;
+		lastThinkNs = CpuProfiler::now() - thinkStart;
+	}
+
+	{
+		PROFILE_SCOPE("BotSystem::act");
+		auto actRange = [&](size_t begin, size_t end) {
+			for (size_t bot = begin; bot < end; bot++) act(bot, characters, dt);
+		};
+		if (jobs) jobs->parallelFor(count, ACT_GRAIN, actRange);
+		else actRange(0, count);
+	}
+
+	// Damage lands on other bots, so it is gathered here rather than in the passes
+	botOfCharacter.assign(characters.size(), -1);
+	for (size_t bot = 0; bot < count; bot++) {
+		if (storeIndices[bot] >= 0) botOfCharacter[storeIndices[bot]] = static_cast<int>(bot);
+	}
+	for (size_t bot = 0; bot < count; bot++) {
+		if (next[bot].mode != Mode::ENGAGE || storeIndices[bot] < 0) continue;
+		int target = characters.indexOf(next[bot].target);
+		if (target < 0 || botOfCharacter[target] < 0) continue;
+		if (static_cast<size_t>(std::max(storeIndices[bot], target)) >= sight.size() || !sight.canSee(storeIndices[bot], target)) continue;
+		BotState& victim = next[botOfCharacter[target]];
+		victim.health = std::max(victim.health - DAMAGE_PER_SECOND * dt, 0.0f);
+	}
+
+	// Write back to the store and queue the paths think asked for
+	for (size_t bot = 0; bot < count; bot++) {
+		int index = storeIndices[bot];
+		if (index < 0) continue;
+		if (next[bot].position != now[bot].position) characters.setPosition(index, next[bot].position);
+		if (next[bot].yaw != now[bot].yaw) characters.setYaw(index, next[bot].yaw);
+		if (wantsPath[bot]) {
+			paths.request(next[bot].position, goals[bot], routes[bot]);
+			waypoints[bot] = 1;  // The first point is where the bot stands
+			wantsPath[bot] = 0;
+		}
+	}
+
+	current = 1 - current;
+	tick++;
+}
+
+size_t BotSystem::getMemoryUsage() const {
+	size_t bytes = vectorBytes(states[0]) + vectorBytes(states[1]) + vectorBytes(handles) + vectorBytes(homes) + vectorBytes(homeRegions)
+		+ vectorBytes(goals) + vectorBytes(waypoints) + vectorBytes(wantsPath) + vectorBytes(storeIndices) + vectorBytes(botOfCharacter);
+	bytes += routes.size() * sizeof(PathResult);
+	for (const PathResult& route : routes) bytes += vectorBytes(route.points);
+	return bytes;
+}
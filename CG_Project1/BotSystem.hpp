@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CharacterStore.hpp"
+#include "PathService.hpp"
+
+class NavMesh;
+class LineOfSight;
+class SpatialGrid;
+class JobSystem;
+
+// Bots driving characters with a patrol / engage / retreat state machine. Every tick has two
+// parallel passes: a think pass that picks targets and goals, time sliced round robin so it
+// stays within a budget however many bots there are, and a cheap act pass that moves and
+// turns every bot. Both read the shared state of the previous tick and write each bot's own
+// next state into a second buffer, so neither needs locks; damage and path requests, which
+// touch other bots or shared services, are applied in a short serial pass afterwards.
+class BotSystem {
+public:
+	enum class Mode : uint8_t { PATROL, ENGAGE, RETREAT };
+
+	BotSystem(const NavMesh& navMesh, PathService& paths);
+	~BotSystem();
+
+	// The bot retreats to home when hurt
+	void add(EntityHandle character, const glm::vec3& home);
+	void clear();
+
+	// Thinks for as many bots as the budget allows, then moves all of them and writes their
+	// positions and yaws back to the store. Sight and grid may lag a tick behind.
+	void update(CharacterStore& characters, const LineOfSight& sight, const SpatialGrid& grid, float dt, JobSystem* jobs = nullptr);
+
+	void setThinkBudget(double microseconds) { thinkBudgetNs = static_cast<long long>(microseconds * 1000.0); }
+
+	size_t size() const { return handles.size(); }
+	size_t getMemoryUsage() const;  // Heap bytes held, routes included
+	EntityHandle getCharacter(size_t bot) const { return handles[bot]; }
+	EntityHandle getTarget(size_t bot) const { return states[current][bot].target; }
+	Mode getMode(size_t bot) const { return states[current][bot].mode; }
+	float getHealth(size_t bot) const { return states[current][bot].health; }
+
+	size_t getLastThinkCount() const { return lastThinkCount; }
+	double getLastThinkMicroseconds() const { return lastThinkNs / 1000.0; }
+
+private:
+	// What other bots may read during a tick; each bot writes only its own entry of the next buffer
+	struct BotState {
+		glm::vec3 position;
+		float yaw;
+		float health;
+		Mode mode;
+		EntityHandle target;
+	};
+
+	const NavMesh& navMesh;
+	PathService& paths;
+
+	std::vector<BotState> states[2];
+	int current;
+
+	// Private to each bot
+	std::vector<EntityHandle> handles;
+	std::vector<glm::vec3> homes;
+	std::vector<uint32_t> homeRegions;
+	std::vector<glm::vec3> goals;
+	std::vector<uint32_t> waypoints;  // Next point of the path being followed
+	std::vector<uint8_t> wantsPath;   // Set by think, requested after the passes
+	std::vector<int> storeIndices;    // Dense store index this tick, -1 if the character is gone
+	std::vector<int> botOfCharacter;  // The other way round, -1 for characters without a bot
+	std::deque<PathResult> routes;    // A deque so results keep their address as bots are added
+
+	// Round robin over bots for the think pass, sized by the measured cost per bot
+	size_t thinkCursor;
+	long long thinkBudgetNs;
+	double thinkCostNs;
+	size_t lastThinkCount;
+	long long lastThinkNs;
+	uint32_t tick;
+
+	void think(size_t bot, const CharacterStore& characters, const LineOfSight& sight, const SpatialGrid& grid);
+	void act(size_t bot, const CharacterStore& characters, float dt);
+	glm::vec3 pickPatrolGoal(size_t bot) const;
+};
@@ -3,6 +3,7 @@
 #include "WindowManager.hpp"
 #include "Renderer.hpp"
 #include "ShaderProgram.hpp"
+#include "ShaderPermutationCache.hpp"
 #include "Camera.hpp"
 #include "OBJLoader.hpp"
 #include <glm/glm.hpp>
@@ -10,26 +11,500 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "Skybox.hpp"
 #include "Crosshair.hpp"
-#include "Character.hpp"
+#include "CharacterStore.hpp"
+#include "JobSystem.hpp"
+#include "TransformHierarchy.hpp"
+#include "ClusteredLighting.hpp"
+#include "SceneFramebuffer.hpp"
+#include "PerformanceGovernor.hpp"
+#include "GpuProfiler.hpp"
+#include "CpuProfiler.hpp"
+#include "FlythroughPath.hpp"
+#include "BenchmarkReport.hpp"
+#include "SimulationClock.hpp"
+#include "InputLatch.hpp"
+#include "FramePacer.hpp"
+#include "RenderSnapshot.hpp"
+#include "TripleBuffer.hpp"
+#include "Microbenchmarks.hpp"
+#include "MapBVH.hpp"
+#include "CharacterController.hpp"
+#include "PlayerMovement.hpp"
+#include "SceneQuery.hpp"
+#include "LineOfSight.hpp"
+#include "SpatialGrid.hpp"
+#include "NavMesh.hpp"
+#include "PathService.hpp"
+#include "BotSystem.hpp"
+#include "DedicatedServer.hpp"
+#include "Replication.hpp"
+#include "PlayerPrediction.hpp"
+#include "SnapshotInterpolator.hpp"
 #include <vector>
 #include <random>
 #include <ctime>
-
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 // Weapon ENUM for weapon swaping
 Renderer::WeaponType currentWeapon = Renderer::WeaponType::KNIFE;
 
-// Camera movement speeds
-const float RIFLE_SPEED = 7.0f;    // Slowest
-const float PISTOL_SPEED = 8.0f;   // Medium
-const float KNIFE_SPEED = 10.0f;    // Fastest
+// Simulation tick rate in Hz, independent of the render rate
+const int DEFAULT_TICK_RATE = 64;
+
+// Window size; the 3D scene may render below it and get upscaled
+const int WINDOW_WIDTH = 1366;
+const int WINDOW_HEIGHT = 768;
+
+// GPU time budget the governor keeps the scene under
+const float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+
+// Projection clip planes, shared with the light clustering
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+// Benchmark mode: fixed seed and timestep so runs are comparable between builds
+const unsigned int BENCHMARK_SEED = 1337;
+const float BENCHMARK_TIMESTEP = 1.0f / 60.0f;
+const int BENCHMARK_WARMUP_FRAMES = 30;  // Held at the first pose and left out of the stats
+
+// Muzzle flash light
+const float MUZZLE_FLASH_DURATION = 0.05f;
+const float HITSCAN_RANGE = 200.0f;
+const float KNIFE_RANGE = 1.5f;        // From the eye, so it reaches a standing character's feet
+const float PROXIMITY_CELL_SIZE = 2.0f;
+const float MUZZLE_FLASH_RADIUS = 8.0f;
+
+// Networked play: how far behind the newest snapshot remote characters are drawn
+const float CLIENT_INTERPOLATION_DELAY = 0.1f;
+
+// Where each viewmodel sits relative to the camera, indexed by Renderer::WeaponType
+struct ViewmodelPlacement {
+	glm::vec3 position;
+	glm::vec3 rotationDegrees;
+	float scale;
+};
+
+const ViewmodelPlacement VIEWMODEL_PLACEMENTS[] = {
+	{ glm::vec3(0.4f, -0.3f, -0.6f), glm::vec3(0.0f, 180.0f, 0.0f), 0.005f },   // RIFLE
+	{ glm::vec3(0.18f, -0.2f, -0.6f), glm::vec3(0.0f, -90.0f, 0.0f), 0.03f },   // PISTOL
+	{ glm::vec3(0.1f, -0.2f, -0.5f), glm::vec3(0.0f, 180.0f, 15.0f), 0.1f }     // KNIFE
+};
+
+// Camera-relative offset of a viewmodel; constant per weapon
+static glm::mat4 viewmodelOffset(const ViewmodelPlacement& placement) {
+	glm::mat4 offset = glm::translate(glm::mat4(1.0f), placement.position);
+	offset = glm::rotate(offset, glm::radians(placement.rotationDegrees.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	offset = glm::rotate(offset, glm::radians(placement.rotationDegrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	offset = glm::rotate(offset, glm::radians(placement.rotationDegrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	return offset;
+}
+
+// Mesh transform under the offset: bobbing, model scale and a slight tilt for a better viewing angle
+static glm::mat4 viewmodelMesh(const ViewmodelPlacement& placement, float bobbingOffset) {
+	glm::mat4 mesh = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, bobbingOffset, 0.0f));
+	mesh = glm::scale(mesh, glm::vec3(placement.scale));
+	mesh = glm::rotate(mesh, glm::radians(-10.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	return mesh;
+}
+
+// GL-side state for drawing a frame. Only the thread that currently holds the GL context
+// may touch it: the render thread when rendering is threaded, otherwise the main thread.
+struct RenderContext {
+	WindowManager& window;
+	Renderer& renderer;
+	const OBJLoader& mapLoader;
+	const ShaderProgram& shader;
+	const ShaderProgram& characterShader;
+	const ShaderProgram& weaponShader;
+	const ShaderProgram& hudShader;
+	ShaderProgram& skyboxShader;
+	Skybox& skybox;
+	Crosshair& crosshair;
+	ClusteredLighting& lighting;
+	std::vector<PointLight>& lights;
+	SceneFramebuffer& sceneTarget;
+	PerformanceGovernor& governor;
+	GpuProfiler& gpuProfiler;
+	FramePacer& framePacer;
+	InputLatch& inputLatch;
+	std::atomic<unsigned long long>& presentedFrames;  // Read by the main thread for the trace window
+
+	// Currently applied settings, compared against each snapshot's request
+	int swapInterval;
+	int framesInFlight;
+
+	bool pacingReport;
+	long long lastPacingReportNs;
+
+	// Character transforms currently in the instance buffers
+	unsigned long long uploadedCharacterVersion;
+};
+
+// Applies hotkey changes that need the GL context
+static void applyRenderSettings(RenderContext& ctx, const RenderSnapshot& snapshot) {
+	if (snapshot.framesInFlight != ctx.framesInFlight) {
+		ctx.framePacer.setMaxFramesInFlight(snapshot.framesInFlight);
+		ctx.framesInFlight = snapshot.framesInFlight;
+		std::cout << "Frames in flight: " << ctx.framePacer.getMaxFramesInFlight() << std::endl;
+	}
+	if (snapshot.swapInterval != ctx.swapInterval) {
+		ctx.swapInterval = snapshot.swapInterval;
+		std::cout << "Swap interval: " << ctx.window.setSwapInterval(snapshot.swapInterval) << std::endl;
+	}
+}
+
+// Draws one snapshot into the back buffer
+static void renderFrame(RenderContext& ctx, const RenderSnapshot& snapshot) {
+	PROFILE_SCOPE("RenderFrame");
+
+	// Render the scene offscreen at the resolution the governor picked
+	ctx.gpuProfiler.beginFrame();
+	ctx.governor.beginFrame();
+	ctx.sceneTarget.bind(ctx.governor.getResolutionScale());
+
+	// Clear the screen and depth buffer
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Set up view and projection matrices
+	glm::mat4 projection = glm::perspective(glm::radians(snapshot.cameraZoom), static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
+	glm::mat4 view = glm::lookAt(snapshot.cameraPosition, snapshot.cameraPosition + snapshot.cameraFront, snapshot.cameraUp);
+
+	// Gather this frame's dynamic lights and bin them into clusters
+	ctx.lights.clear();
+	if (snapshot.muzzleFlash) {
+		ctx.lights.emplace_back(snapshot.cameraPosition + snapshot.cameraFront * 0.8f, MUZZLE_FLASH_RADIUS, glm::vec3(1.0f, 0.8f, 0.5f), 2.0f);
+	}
+	{
+		PROFILE_SCOPE("ClusteredLighting::update");
+		ctx.lighting.update(ctx.lights, view, projection, NEAR_PLANE, FAR_PLANE);
+	}
+
+	// Map model matrix
+	glm::mat4 mapModel = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f));
+
+	// Only apply pitch rotation (vertical movement)
+	float pitch = snapshot.cameraPitch * 0.1f;
+	glm::mat4 weaponRotation = glm::mat4(1.0f);
+	weaponRotation = glm::rotate(weaponRotation, glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+
+	// Final transformation
+	glm::mat4 weaponTransform = projection * snapshot.weaponModel;
+
+	// Draw skybox first
+	ctx.gpuProfiler.beginScope("Skybox");
+	glDepthFunc(GL_LEQUAL);  // Change depth function so depth test passes when values are equal to depth buffer's content
+	glm::mat4 skyboxView = glm::mat4(glm::mat3(view)); // Remove translation from the view matrix
+	ctx.skyboxShader.use();
+	ctx.skyboxShader.setUniform("view", skyboxView);
+	ctx.skyboxShader.setUniform("projection", projection);
+	ctx.skybox.render(ctx.skyboxShader);
+	glDepthFunc(GL_LESS); // Set depth function back to default
+	ctx.gpuProfiler.endScope();
+
+	// Render the map
+	ctx.gpuProfiler.beginScope("Map");
+	ctx.shader.use();
+	ctx.shader.setUniform("model", mapModel);
+	ctx.shader.setUniform("view", view);
+	ctx.shader.setUniform("projection", projection);
+	ctx.shader.setUniform("ambient", glm::vec3(1.0f));
+	ctx.shader.setUniform("lodBias", ctx.governor.getLodBias());
+	ctx.lighting.bind(ctx.shader, 1, static_cast<float>(ctx.sceneTarget.getScaledWidth()), static_cast<float>(ctx.sceneTarget.getScaledHeight()));
+	ctx.renderer.render(ctx.shader, ctx.mapLoader);
+	ctx.gpuProfiler.endScope();
+
+	// Render characters, one instanced batch per team
+	ctx.gpuProfiler.beginScope("Characters");
+	ctx.characterShader.use();
+	ctx.characterShader.setUniform("view", view);
+	ctx.characterShader.setUniform("projection", projection);
+	ctx.characterShader.setUniform("ambient", glm::vec3(1.0f));
+	ctx.characterShader.setUniform("lodBias", ctx.governor.getLodBias());
+	ctx.lighting.bind(ctx.characterShader, 1, static_cast<float>(ctx.sceneTarget.getScaledWidth()), static_cast<float>(ctx.sceneTarget.getScaledHeight()));
+	if (snapshot.characterVersion != ctx.uploadedCharacterVersion) {
+		// Only re-upload when something moved; static characters stay in the buffers. A lost
+		// upload keeps the old version so the next frame retries it.
+		size_t characterCount = snapshot.characterPositions.size();
+		TransformBatch ctBatch = { snapshot.characterPositions.data(), snapshot.characterYaws.data(), nullptr, CharacterStore::MODEL_SCALE, snapshot.ctCount };
+		TransformBatch tBatch = { ctBatch.positions + snapshot.ctCount, ctBatch.yawsDegrees + snapshot.ctCount, nullptr, CharacterStore::MODEL_SCALE, characterCount - snapshot.ctCount };
+		bool uploaded = ctx.renderer.uploadCharacterInstances(CharacterStore::Team::CT, ctBatch);
+		uploaded = ctx.renderer.uploadCharacterInstances(CharacterStore::Team::T, tBatch) && uploaded;
+		if (uploaded) ctx.uploadedCharacterVersion = snapshot.characterVersion;
+	}
+	ctx.renderer.renderCharacters(ctx.characterShader, CharacterStore::Team::CT);
+	ctx.renderer.renderCharacters(ctx.characterShader, CharacterStore::Team::T);
+	ctx.gpuProfiler.endScope();
+
+	// Render the weapon (unlit, its view space is not the camera's)
+	ctx.gpuProfiler.beginScope("Weapon");
+	ctx.weaponShader.use();
+	ctx.weaponShader.setUniform("model", weaponTransform);
+	ctx.weaponShader.setUniform("view", weaponRotation);
+	ctx.weaponShader.setUniform("projection", glm::mat4(1.0f));
+	ctx.weaponShader.setUniform("lodBias", ctx.governor.getLodBias());
+	ctx.renderer.renderWeapon(ctx.weaponShader, snapshot.weapon);
+	ctx.gpuProfiler.endScope();
+
+	// Upscale to the window; the HUD is drawn afterwards at native resolution
+	ctx.gpuProfiler.beginScope("Upscale");
+	ctx.sceneTarget.blitToScreen();
+	ctx.gpuProfiler.endScope();
+	ctx.governor.endFrame();
+
+	// render the crosshair
+	ctx.gpuProfiler.beginScope("Crosshair");
+	ctx.crosshair.render(ctx.hudShader);
+	ctx.gpuProfiler.endScope();
+	ctx.gpuProfiler.endFrame();
+}
+
+// Swaps and closes the frame's pacing and latency measurements
+static void presentFrame(RenderContext& ctx, const RenderSnapshot& snapshot) {
+	ctx.window.swapBuffers();
+	ctx.framePacer.afterSwap();
+	ctx.inputLatch.markPresented(snapshot.inputSampleNs);
+	ctx.presentedFrames.fetch_add(1, std::memory_order_relaxed);
+
+	if (ctx.pacingReport && CpuProfiler::now() - ctx.lastPacingReportNs > 2000000000LL) {
+		std::cout << "Pacing [swap interval " << ctx.swapInterval << "] "
+			<< ctx.framePacer.takeReport(ctx.inputLatch.getAverageLatencyMs()) << std::endl;
+		ctx.lastPacingReportNs = CpuProfiler::now();
+	}
+}
+
+// Samples this tick's input from the WASD state and the camera
+static PlayerInput sampleInput(const Camera& camera, const Uint8* state) {
+	PlayerInput input = {};
+	if (state[SDL_SCANCODE_W]) input.buttons |= PlayerInput::FORWARD;
+	if (state[SDL_SCANCODE_S]) input.buttons |= PlayerInput::BACK;
+	if (state[SDL_SCANCODE_A]) input.buttons |= PlayerInput::LEFT;
+	if (state[SDL_SCANCODE_D]) input.buttons |= PlayerInput::RIGHT;
+	input.weapon = static_cast<uint8_t>(currentWeapon);
+	input.walking = camera.isYLocked;
+	input.yaw = camera.Yaw;
+	input.pitch = camera.Pitch;
+	return input;
+}
+
+// One tick of networked play: predicts and sends this tick's input, then reads the server.
+// A queued shot goes out with this input, tagged with the server tick the remote characters
+// are drawn at so the server can rewind them to what the player saw.
+static void updateNetworkedPlayer(Camera& camera, ReplicationClient& client, PlayerPrediction& prediction,
+	SnapshotInterpolator& interpolator, const Uint8* state, bool& fireQueued, float deltaTime) {
+	// Nothing is predicted until the server has placed the player
+	if (prediction.isStarted()) {
+		PlayerInput input = sampleInput(camera, state);
+		if (fireQueued) {
+			input.buttons |= PlayerInput::FIRE;
+			input.viewTick = interpolator.getRenderTick();
+			fireQueued = false;
+		}
+		prediction.predict(input, deltaTime);
+		client.sendInput(input);
+	}
+
+	if (client.update(CpuProfiler::now())) {
+		interpolator.push(client.getSnapshot());
+		if (client.hasPlayer()) {
+			if (!prediction.isStarted()) prediction.reset(client.getCorrection().state);
+			else prediction.reconcile(client.getCorrection());
+		}
+	}
+	if (prediction.isStarted()) camera.Position = prediction.getSmoothedEyePosition();
+}
+
+// Mirrors the remote characters into the store so they render, collide with the local
+// hitscan and show up in the proximity grid like local ones
+static void syncRemoteCharacters(CharacterStore& characters, const std::vector<RemoteCharacter>& remote) {
+	bool sameSet = characters.size() == remote.size();
+	for (size_t i = 0; sameSet && i < remote.size(); i++) {
+		sameSet = characters.getTeams()[i] == static_cast<CharacterStore::Team>(remote[i].team);
+	}
+	if (!sameSet) {
+		characters.clear();
+		for (const RemoteCharacter& character : remote) {
+			characters.create(character.position, static_cast<CharacterStore::Team>(character.team), character.yaw);
+		}
+		return;
+	}
+	for (size_t i = 0; i < remote.size(); i++) {
+		characters.setPosition(i, remote[i].position);
+		characters.setYaw(i, remote[i].yaw);
+	}
+}
+
+// Advances the camera one simulation step from the WASD state
+// With a controller the move collides with the map and Y-lock means walking on the floor;
+// without one (noclip) the camera moves freely
+static void updateMovement(Camera& camera, CharacterController* controller, const Uint8* state, float deltaTime) {
+	PlayerInput input = sampleInput(camera, state);
+
+	// Gravity keeps acting when no key is held, so the controller runs every tick
+	if (controller) {
+		PlayerMovement::step(*controller, input, deltaTime);
+		camera.Position = controller->getEyePosition();
+		return;
+	}
+
+	glm::vec3 movement = PlayerMovement::getWishDirection(input);
+	if (glm::length(movement) > 0.0f) {
+		glm::vec3 newPosition = camera.Position + movement * (PlayerMovement::getSpeed(input.weapon) * deltaTime);
+
+		if (camera.isYLocked) {
+			newPosition.y = camera.lockedY;  // Maintain the locked Y position
+		}
+
+		camera.Position = newPosition;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	// Command line options
+	std::string gpuProfileCsv;
+	std::string cpuTracePath;
+	int cpuTraceFrames = 300;
+	int tickRate = DEFAULT_TICK_RATE;
+	std::string benchmarkPath;
+	std::string benchmarkOut = "benchmark.json";
+	std::string recordPath;
+	int swapInterval = 1;
+	int framesInFlight = 2;
+	float fpsCap = 0.0f;
+	bool pacingReport = false;
+	bool singleThread = false;
+	std::string microbenchName;
+	bool serverMode = false;
+	long long serverTicks = 0;
+	int serverBots = 5;
+	int serverMatches = 1;
+	int serverPort = 0;
+	bool unthrottled = false;
+	std::string connectAddress;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--gpu-profile") == 0 && i + 1 < argc) {
+			gpuProfileCsv = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc) {
+			cpuTracePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--trace-frames") == 0 && i + 1 < argc) {
+			cpuTraceFrames = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--tickrate") == 0 && i + 1 < argc) {
+			tickRate = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--vsync") == 0 && i + 1 < argc) {
+			std::string mode = argv[++i];
+			swapInterval = mode == "off" ? 0 : (mode == "adaptive" ? -1 : 1);
+		}
+		else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+			framesInFlight = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--fps-cap") == 0 && i + 1 < argc) {
+			fpsCap = static_cast<float>(std::atof(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--pacing-report") == 0) {
+			pacingReport = true;
+		}
+		else if (std::strcmp(argv[i], "--single-thread") == 0) {
+			singleThread = true;
+		}
+		else if (std::strcmp(argv[i], "--microbench") == 0 && i + 1 < argc) {
+			microbenchName = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--server") == 0) {
+			serverMode = true;
+		}
+		else if (std::strcmp(argv[i], "--server-ticks") == 0 && i + 1 < argc) {
+			serverTicks = std::max(0ll, std::atoll(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+			serverBots = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--matches") == 0 && i + 1 < argc) {
+			serverMatches = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+			serverPort = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--unthrottled") == 0) {
+			unthrottled = true;
+		}
+		else if (std::strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+			connectAddress = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+			benchmarkPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--benchmark-out") == 0 && i + 1 < argc) {
+			benchmarkOut = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--record-path") == 0 && i + 1 < argc) {
+			recordPath = argv[++i];
+		}
+	}
+
+	// CPU-only subsystem benchmarks; no window needed
+	if (!microbenchName.empty()) {
+		return Microbenchmarks::run(microbenchName) ? 0 : -1;
+	}
+
+	// Headless deterministic flythrough instead of interactive play
+	bool benchmarkMode = !benchmarkPath.empty();
+	FlythroughPath flythrough;
+	if (benchmarkMode && !flythrough.load(benchmarkPath)) {
+		return -1;
+	}
+
+	// Play on a dedicated server instead of against local bots, e.g. --connect 127.0.0.1:27015
+	bool clientMode = !connectAddress.empty() && !benchmarkMode;
+	SocketAddress serverAddress;
+	if (clientMode) {
+		size_t colon = connectAddress.rfind(':');
+		int port = colon == std::string::npos ? 0 : std::atoi(connectAddress.c_str() + colon + 1);
+		if (port <= 0 || port > 65535 || !SocketAddress::parse(connectAddress.substr(0, colon), static_cast<uint16_t>(port), serverAddress)) {
+			std::cerr << "Invalid server address (expected ip:port): " << connectAddress << std::endl;
+			return -1;
+		}
+	}
+
+	// CPU trace covers startup plus the first cpuTraceFrames presented frames
+	CpuProfiler::setThreadName("Main");
+	CpuProfiler::setRecording(!cpuTracePath.empty());
+	std::atomic<unsigned long long> presentedFrames(0);
+
+	// Engine-wide job system; this thread is worker 0
+	JobSystem jobs;
+	if (!jobs.initialize()) return -1;
+
+	// Dedicated server: simulation only, no window or GL, any number of matches sharing the map
+	if (serverMode) {
+		DedicatedServer server(jobs);
+		if (!server.initialize("Assets/Dust2/Dust2.obj")) return -1;
+		for (int match = 0; match < serverMatches; match++) {
+			uint16_t port = serverPort > 0 ? static_cast<uint16_t>(serverPort + match) : 0;
+			server.addMatch(serverBots, BENCHMARK_SEED + match, port);
+		}
+		server.run(tickRate, serverTicks, unthrottled);
+		return 0;
+	}
 
-int main() {
 	// Initialize the window
-	WindowManager window("CG_Project1", 1366, 768);
-	if (!window.initialize()) return -1;
+	WindowManager window("CG_Project1", WINDOW_WIDTH, WINDOW_HEIGHT);
+	if (!window.initialize(benchmarkMode)) return -1;
+
+	// Frame pacing: swap interval, GPU queue depth and optional FPS cap
+	if (!benchmarkMode) swapInterval = window.setSwapInterval(swapInterval);
+	FramePacer framePacer;
+	framePacer.setMaxFramesInFlight(framesInFlight);
+	framePacer.setFpsCap(fpsCap);
+	framesInFlight = framePacer.getMaxFramesInFlight();
 
 	// Load the map
 	OBJLoader mapLoader;
@@ -38,6 +513,16 @@ int main() {
 		return -1;
 	}
 
+	// Collision geometry for player movement; off in benchmark mode, whose route goes through walls
+	MapBVH mapBvh;
+	bool collisionEnabled = mapBvh.build(mapLoader) && !benchmarkMode;
+
+	// Walkable surface for bots, cached next to the map because building it takes a while
+	NavMesh navMesh;
+	navMesh.loadOrBuild(mapLoader, "Assets/Dust2/Dust2.navmesh");
+	PathService pathService(navMesh);
+	PathResult debugPath;
+
 	// Load all weapons
 	OBJLoader rifleLoader, pistolLoader, knifeLoader;
 	
@@ -59,6 +544,12 @@ int main() {
 	}
 	std::cout << "Knife loaded successfully. Materials: " << knifeLoader.getMaterials().size() << std::endl;
 
+	// Parsing made no GL calls; the textures go to the GPU now that there is a context
+	mapLoader.uploadTextures();
+	rifleLoader.uploadTextures();
+	pistolLoader.uploadTextures();
+	knifeLoader.uploadTextures();
+
 	// Initialize the renderer with all models
 	Renderer renderer;
 	if (!renderer.initialize(mapLoader) || 
@@ -67,15 +558,30 @@ int main() {
 		return -1;
 	}
 
-	// Load and use the shader program
-	ShaderProgram shader("VertexShader.glsl", "FragmentShader.glsl");
+	// Load the shader variants used every frame up front
+	ShaderPermutationCache shaderCache("VertexShader.glsl", "FragmentShader.glsl");
+	shaderCache.prewarm({ ShaderFeature::WORLD_LIT, ShaderFeature::WORLD_LIT_INSTANCED, ShaderFeature::WORLD, ShaderFeature::HUD });
+	const ShaderProgram& shader = shaderCache.get(ShaderFeature::WORLD_LIT);
+	const ShaderProgram& characterShader = shaderCache.get(ShaderFeature::WORLD_LIT_INSTANCED);
+	const ShaderProgram& weaponShader = shaderCache.get(ShaderFeature::WORLD);
+	const ShaderProgram& hudShader = shaderCache.get(ShaderFeature::HUD);
 	shader.use();
 
+	// Dynamic point lights, binned into clusters every frame
+	ClusteredLighting lighting;
+	if (!lighting.initialize()) {
+		std::cerr << "Failed to initialize clustered lighting." << std::endl;
+		return -1;
+	}
+	std::vector<PointLight> lights;
+	float muzzleFlashTimer = 0.0f;
+
 	// Set up camera
 	Camera camera(glm::vec3(-18.0f, 4.21f, 18.0f));
-	camera.MovementSpeed = KNIFE_SPEED;  // Set initial speed to match starting weapon (KNIFE)
+	CharacterController playerController(mapBvh);
+	playerController.setEyePosition(camera.Position);
 	bool running = true;
-	SDL_SetRelativeMouseMode(SDL_TRUE);
+	if (!benchmarkMode) SDL_SetRelativeMouseMode(SDL_TRUE);
 
 	// Initialize skybox
 	std::vector<std::string> faces{
@@ -96,7 +602,33 @@ int main() {
 	ShaderProgram skyboxShader("SkyboxVertexShader.glsl", "SkyboxFragmentShader.glsl");
 
 	// Initialize crosshair
-	Crosshair crosshair(1366.0f, 768.0f);
+	Crosshair crosshair(static_cast<float>(WINDOW_WIDTH), static_cast<float>(WINDOW_HEIGHT));
+
+	// Offscreen scene target and the governor that picks its resolution
+	SceneFramebuffer sceneTarget(window.getWidth(), window.getHeight());
+	PerformanceGovernor governor(FRAME_BUDGET_MS);
+	if (!sceneTarget.initialize() || !governor.initialize()) {
+		std::cerr << "Failed to initialize dynamic resolution." << std::endl;
+		return -1;
+	}
+
+	// Per-pass GPU timings, only when asked for as CSV or needed for the benchmark report;
+	// otherwise no timestamp queries are issued at all
+	GpuProfiler gpuProfiler;
+	if (!gpuProfileCsv.empty() && !gpuProfiler.openCsv(gpuProfileCsv)) {
+		return -1;
+	}
+	if (!gpuProfileCsv.empty() || benchmarkMode) {
+		gpuProfiler.setEnabled(true);
+		renderer.setProfiler(&gpuProfiler);
+	}
+
+	// Benchmark runs keep the resolution fixed so frame times stay comparable
+	governor.setAdaptive(!benchmarkMode);
+	BenchmarkReport benchmarkReport;
+	int benchmarkFrame = 0;
+	int benchmarkFrameCount = static_cast<int>(flythrough.getDuration() / BENCHMARK_TIMESTEP);
+	unsigned long long lastGpuResultsFrame = 0;
 
 	// Load character models
 	OBJLoader ctModelLoader, tModelLoader;
@@ -109,18 +641,34 @@ int main() {
 		return -1;
 	}
 
+	ctModelLoader.uploadTextures();
+	tModelLoader.uploadTextures();
+
 	// Initialize character models in renderer
 	if (!renderer.initializeCharacterModels(ctModelLoader, tModelLoader)) {
 		std::cerr << "Failed to initialize character models." << std::endl;
 		return -1;
 	}
 
+	// Hitscan queries against the map and the characters' model bounds
+	SceneQuery sceneQuery(mapBvh);
+	sceneQuery.setCharacterModel(CharacterStore::Team::CT, ctModelLoader);
+	sceneQuery.setCharacterModel(CharacterStore::Team::T, tModelLoader);
+
+	// Who can see whom through the map, for the AI
+	LineOfSight lineOfSight(mapBvh);
+
+	// Who is near whom, for melee and anything else range based
+	SpatialGrid characterGrid;
+	characterGrid.initialize(mapBvh.getBoundsMin(), mapBvh.getBoundsMax(), PROXIMITY_CELL_SIZE);
+	std::vector<EntityHandle> nearbyCharacters;
+
 	// Create characters with random offsets
-	std::mt19937 rng(static_cast<unsigned int>(time(nullptr)));
+	std::mt19937 rng(benchmarkMode ? BENCHMARK_SEED : static_cast<unsigned int>(time(nullptr)));
 	std::uniform_real_distribution<float> posOffset(-1.0f, 1.0f);
 	std::uniform_real_distribution<float> rotOffset(-180.0f, 180.0f);
 
-	std::vector<Character> characters;
+	CharacterStore characters;
 
 	// CT positions (CT spawn area)
 	glm::vec3 ctPositions[] = {
@@ -139,195 +687,352 @@ int main() {
 		glm::vec3(-18.0f, 3.21f, 18.0f)
 	};
 
-	// Spawn CTs
+	// Spawn CTs, facing roughly towards T spawn. A connected client gets its characters
+	// from the server instead.
 	for (const auto& basePos : ctPositions) {
+		if (clientMode) break;
 		glm::vec3 offsetPos = basePos + glm::vec3(posOffset(rng), 0.0f, posOffset(rng));
 		float offsetRot = rotOffset(rng);
-		characters.emplace_back(offsetPos, Character::Team::CT, offsetRot);
+		characters.create(offsetPos, CharacterStore::Team::CT, 90.0f + offsetRot);
 	}
 
 	// Spawn Ts
 	for (const auto& basePos : tPositions) {
+		if (clientMode) break;
 		glm::vec3 offsetPos = basePos + glm::vec3(posOffset(rng), 0.0f, posOffset(rng));
 		float offsetRot = rotOffset(rng);
-		characters.emplace_back(offsetPos, Character::Team::T, offsetRot);
-	}
-
-	while (running) {
-		float currentFrame = SDL_GetTicks() / 1000.0f;
-		
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-
-		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
-			if (event.type == SDL_QUIT) running = false;
-			if (event.type == SDL_MOUSEWHEEL) camera.ProcessMouseScroll(static_cast<float>(event.wheel.y));
-			if (event.type == SDL_KEYDOWN) {
-				switch (event.key.keysym.sym) {
-					case SDLK_1:
-						currentWeapon = Renderer::WeaponType::RIFLE;
-						camera.MovementSpeed = RIFLE_SPEED;
-						std::cout << "Switched to RIFLE" << std::endl;
-						break;
-					case SDLK_2:
-						currentWeapon = Renderer::WeaponType::PISTOL;
-						camera.MovementSpeed = PISTOL_SPEED;
-						std::cout << "Switched to PISTOL" << std::endl;
-						break;
-					case SDLK_3:
-						currentWeapon = Renderer::WeaponType::KNIFE;
-						camera.MovementSpeed = KNIFE_SPEED;
-						std::cout << "Switched to KNIFE" << std::endl;
-						break;
-					case SDLK_ESCAPE:
-						running = false;
-						break;
-					case SDLK_e:
-						camera.toggleYLock();
-						std::cout << "Camera Y-Lock: " << (camera.isYLocked ? "Enabled" : "Disabled") << std::endl;
-						break;
-				}
-			}
+		characters.create(offsetPos, CharacterStore::Team::T, -90.0f + offsetRot);
+	}
+
+	// Every character is a bot defending its spawn; the benchmark keeps them still
+	BotSystem bots(navMesh, pathService);
+	if (!benchmarkMode) {
+		for (size_t i = 0; i < characters.size(); i++) {
+			bots.add(characters.handleAt(i), characters.getPositions()[i]);
 		}
+	}
 
-		// Camera movement
-		const Uint8* state = SDL_GetKeyboardState(nullptr);
-		glm::vec3 movement(0.0f);
-		if (state[SDL_SCANCODE_W] || state[SDL_SCANCODE_S] || 
-			state[SDL_SCANCODE_A] || state[SDL_SCANCODE_D]) {
-			
-			if (camera.isYLocked) {
-				// When Y-locked, use a flattened front vector for forward/backward movement
-				glm::vec3 flatFront = glm::normalize(glm::vec3(camera.Front.x, 0.0f, camera.Front.z));
-				glm::vec3 flatRight = glm::normalize(glm::vec3(camera.Right.x, 0.0f, camera.Right.z));
-				
-				if (state[SDL_SCANCODE_W]) movement += flatFront;
-				if (state[SDL_SCANCODE_S]) movement -= flatFront;
-				if (state[SDL_SCANCODE_A]) movement -= flatRight;
-				if (state[SDL_SCANCODE_D]) movement += flatRight;
-			} else {
-				// Normal movement when not Y-locked
-				if (state[SDL_SCANCODE_W]) movement += camera.Front;
-				if (state[SDL_SCANCODE_S]) movement -= camera.Front;
-				if (state[SDL_SCANCODE_A]) movement -= camera.Right;
-				if (state[SDL_SCANCODE_D]) movement += camera.Right;
+	// Transform hierarchy for the viewmodels, which hang off the camera. The viewmodel is
+	// drawn in view space, so the camera node itself stays identity.
+	TransformHierarchy transforms;
+	TransformId cameraNode = transforms.create(TransformHierarchy::ROOT);
+	TransformId viewmodelNodes[3];
+	for (int weapon = 0; weapon < 3; weapon++) {
+		TransformId offset = transforms.create(cameraNode, viewmodelOffset(VIEWMODEL_PLACEMENTS[weapon]));
+		viewmodelNodes[weapon] = transforms.create(offset, viewmodelMesh(VIEWMODEL_PLACEMENTS[weapon], 0.0f));
+	}
+
+	// Networked play: the server owns every character, this client predicts its own player
+	// and draws the others a little in the past
+	ReplicationClient netClient;
+	PlayerPrediction prediction(mapBvh);
+	SnapshotInterpolator interpolator(static_cast<float>(tickRate), CLIENT_INTERPOLATION_DELAY);
+	std::vector<RemoteCharacter> remoteCharacters;
+	bool fireQueued = false;
+	float lastRemoteSampleTime = 0.0f;
+	if (clientMode) {
+		if (!netClient.connect(serverAddress)) return -1;
+		std::cout << "Connecting to " << connectAddress << std::endl;
+	}
+
+	// Fixed-rate simulation; rendering interpolates between the last two tick states
+	SimulationClock simClock(tickRate);
+	InputLatch inputLatch;
+	glm::vec3 previousPosition = camera.Position;
+	simClock.reset();
+
+	// GL-side state, handed to the render thread while it runs
+	RenderContext renderContext = {
+		window, renderer, mapLoader, shader, characterShader, weaponShader, hudShader, skyboxShader, skybox, crosshair,
+		lighting, lights, sceneTarget, governor, gpuProfiler, framePacer, inputLatch, presentedFrames,
+		swapInterval, framesInFlight, pacingReport, CpuProfiler::now(), ~0ULL
+	};
+
+	// Threaded rendering: this thread simulates and publishes snapshots, the render thread
+	// owns the GL context and always draws the newest one. Benchmarks stay single threaded
+	// so every simulated frame is rendered exactly once.
+	bool threadedRendering = !benchmarkMode && !singleThread;
+	TripleBuffer<RenderSnapshot> snapshots;
+	RenderSnapshot inlineSnapshot;
+	long long unrenderedSampleNs = -1;
+	std::atomic<bool> renderRunning(true);
+	std::thread renderThread;
+
+	if (threadedRendering) {
+		window.releaseCurrent();
+		renderThread = std::thread([&]() {
+			CpuProfiler::setThreadName("Render");
+			if (!window.makeCurrent()) {
+				renderRunning = false;
+				return;
 			}
 
-			// Normalize and apply movement
-			if (glm::length(movement) > 0.0f) {
-				movement = glm::normalize(movement);
-				glm::vec3 newPosition = camera.Position + movement * (camera.MovementSpeed * deltaTime);
-				
-				if (camera.isYLocked) {
-					newPosition.y = camera.lockedY;  // Maintain the locked Y position
+			while (renderRunning) {
+				renderContext.framePacer.waitForFrameStart();
+
+				// Take the newest state only now, so the frame starts from the freshest input
+				while (!snapshots.acquire()) {
+					if (!renderRunning) break;
+					SDL_Delay(1);
 				}
-				
-				camera.Position = newPosition;
+				if (!renderRunning) break;
+
+				const RenderSnapshot& snapshot = snapshots.readBuffer();
+				applyRenderSettings(renderContext, snapshot);
+				renderFrame(renderContext, snapshot);
+				presentFrame(renderContext, snapshot);
 			}
+			window.releaseCurrent();
+		});
+	}
+
+	while (running && renderRunning) {
+		if (!threadedRendering) framePacer.waitForFrameStart();
+		PROFILE_SCOPE("Frame");
+		long long frameStartNs = CpuProfiler::now();
+		int ticks = benchmarkMode ? simClock.advanceBy(BENCHMARK_TIMESTEP) : simClock.advance();
+		float currentFrame = static_cast<float>(simClock.getTime()) + simClock.getAlpha() * simClock.getTickDelta();
+
+		{
+			PROFILE_SCOPE("Events");
+			SDL_Event event;
+			while (SDL_PollEvent(&event)) {
+				if (event.type == SDL_QUIT) running = false;
+				inputLatch.handleEvent(event);
+				if (event.type == SDL_MOUSEWHEEL) camera.ProcessMouseScroll(static_cast<float>(event.wheel.y));
+				if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT &&
+					currentWeapon != Renderer::WeaponType::KNIFE) {
+					muzzleFlashTimer = MUZZLE_FLASH_DURATION;
+					fireQueued = clientMode;  // The server decides what the shot hit
+
+					RayHit hit;
+					if (sceneQuery.raycastClosest(camera.Position, camera.Front, HITSCAN_RANGE, hit)) {
+						int index = characters.indexOf(hit.character);
+						if (index >= 0) {
+							std::cout << "Hit " << (characters.getTeams()[index] == CharacterStore::Team::CT ? "CT" : "T")
+								<< " character " << hit.character.index << " at " << hit.distance << std::endl;
+						} else if (hit.materialIndex != RayHit::NO_MATERIAL) {
+							std::cout << "Hit " << mapLoader.getMaterials()[hit.materialIndex].name << " at " << hit.distance << std::endl;
+						}
+					}
+				}
+				if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT &&
+					currentWeapon == Renderer::WeaponType::KNIFE) {
+					nearbyCharacters.clear();
+					characterGrid.queryRadius(camera.Position, KNIFE_RANGE, nearbyCharacters);
+					for (EntityHandle handle : nearbyCharacters) {
+						int index = characters.indexOf(handle);
+						if (index < 0) continue;
+						std::cout << "Knifed " << (characters.getTeams()[index] == CharacterStore::Team::CT ? "CT" : "T")
+							<< " character " << handle.index << std::endl;
+					}
+				}
+				if (event.type == SDL_KEYDOWN) {
+					switch (event.key.keysym.sym) {
+						case SDLK_1:
+							currentWeapon = Renderer::WeaponType::RIFLE;
+							std::cout << "Switched to RIFLE" << std::endl;
+							break;
+						case SDLK_2:
+							currentWeapon = Renderer::WeaponType::PISTOL;
+							std::cout << "Switched to PISTOL" << std::endl;
+							break;
+						case SDLK_3:
+							currentWeapon = Renderer::WeaponType::KNIFE;
+							std::cout << "Switched to KNIFE" << std::endl;
+							break;
+						case SDLK_ESCAPE:
+							running = false;
+							break;
+						case SDLK_e:
+							camera.toggleYLock();
+							std::cout << "Camera Y-Lock: " << (camera.isYLocked ? "Enabled" : "Disabled") << std::endl;
+							break;
+						case SDLK_n:
+							if (mapBvh.getTriangleCount() == 0) break;
+							collisionEnabled = !collisionEnabled;
+							if (collisionEnabled) playerController.setEyePosition(camera.Position);
+							std::cout << "Noclip: " << (collisionEnabled ? "Disabled" : "Enabled") << std::endl;
+							break;
+						case SDLK_g:
+							// Path from the player to the first T, printed once answered
+							for (size_t i = 0; i < characters.size(); i++) {
+								if (characters.getTeams()[i] != CharacterStore::Team::T) continue;
+								glm::vec3 feet = camera.Position - glm::vec3(0.0f, CharacterStore::EYE_HEIGHT, 0.0f);
+								pathService.request(feet, characters.getPositions()[i], debugPath);
+								break;
+							}
+							break;
+						case SDLK_F2:
+							// Cycle frames in flight 1 -> 2 -> 3 -> driver default
+							framesInFlight = (framesInFlight + 1) % (FramePacer::MAX_FRAMES_IN_FLIGHT + 1);
+							break;
+						case SDLK_F3:
+							// Cycle vsync on -> off -> adaptive
+							swapInterval = swapInterval == 1 ? 0 : (swapInterval == 0 ? -1 : 1);
+							break;
+						case SDLK_p:
+							if (!recordPath.empty()) {
+								CameraPose pose = { camera.Position, camera.Yaw, camera.Pitch };
+								if (FlythroughPath::appendPose(recordPath, pose)) {
+									std::cout << "Recorded path point to " << recordPath << std::endl;
+								}
+							}
+							break;
+					}
+				}
+			}
+		}
+
+		// Run the simulation in fixed ticks; keyboard state is sampled once per frame
+		const Uint8* state = SDL_GetKeyboardState(nullptr);
+		for (int tick = 0; tick < ticks; tick++) {
+			previousPosition = camera.Position;
+			if (clientMode) updateNetworkedPlayer(camera, netClient, prediction, interpolator, state, fireQueued, simClock.getTickDelta());
+			else updateMovement(camera, collisionEnabled ? &playerController : nullptr, state, simClock.getTickDelta());
+			if (muzzleFlashTimer > 0.0f) muzzleFlashTimer -= simClock.getTickDelta();
+			bots.update(characters, lineOfSight, characterGrid, simClock.getTickDelta(), &jobs);
 		}
 
-		// Mouse motion for camera rotation
-		int xrel, yrel;
-		SDL_GetRelativeMouseState(&xrel, &yrel);
-		camera.ProcessMouseMovement(static_cast<float>(xrel), static_cast<float>(-yrel));
-
-		// Clear the screen and depth buffer
-		glEnable(GL_DEPTH_TEST);
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
-		// Set up view and projection matrices
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 800.0f / 600.0f, 0.1f, 100.0f);
-		glm::mat4 view = camera.GetViewMatrix();
-		
-		// Map model matrix
-		glm::mat4 mapModel = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f));	
-		
-		
-		// Update weapon positioning
-		glm::vec3 weaponPosition;
-		float weaponScale;
-		glm::vec3 weaponRotationAngles;
-
-		switch (currentWeapon) {
-			case Renderer::WeaponType::RIFLE:
-				weaponPosition = glm::vec3(0.4f, -0.3f, -0.6f);
-				weaponScale = 0.005f;
-				weaponRotationAngles = glm::vec3(0.0f, 180.0f, 0.0f);
-				break;
-			case Renderer::WeaponType::PISTOL:
-				weaponPosition = glm::vec3(0.18f, -0.2f, -0.6f);
-				weaponScale = 0.03f;
-				weaponRotationAngles = glm::vec3(0.0f, -90.0f, 0.0f);
-				break;
-			case Renderer::WeaponType::KNIFE:
-				weaponPosition = glm::vec3(0.1f, -0.2f, -0.5f);
-				weaponScale = 0.1f;
-				weaponRotationAngles = glm::vec3(0.0f, 180.0f, 15.0f);
-				break;
-		}
-
-		glm::mat4 weaponModel = glm::mat4(1.0f);
-		weaponModel = glm::translate(weaponModel, weaponPosition);
-		
-		weaponModel = glm::rotate(weaponModel, glm::radians(weaponRotationAngles.y), glm::vec3(0.0f, 1.0f, 0.0f));
-		weaponModel = glm::rotate(weaponModel, glm::radians(weaponRotationAngles.x), glm::vec3(1.0f, 0.0f, 0.0f));
-		weaponModel = glm::rotate(weaponModel, glm::radians(weaponRotationAngles.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		// The flythrough drives the camera directly in benchmark mode
+		if (benchmarkMode) {
+			int pathFrame = std::max(0, benchmarkFrame - BENCHMARK_WARMUP_FRAMES);
+			CameraPose pose = flythrough.sample(static_cast<float>(pathFrame) / benchmarkFrameCount);
+			camera.setPose(pose.position, pose.yaw, pose.pitch);
+			previousPosition = camera.Position;
+		}
 
+		// Knife bobbing is the only animated transform; everything else stays cached
 		if (currentWeapon == Renderer::WeaponType::KNIFE) {
-			float bobbingOffset = sin(currentFrame * 2.0f) * 0.02f;
-			weaponModel = glm::translate(weaponModel, glm::vec3(0.0f, bobbingOffset, 0.0f));
+			const ViewmodelPlacement& knife = VIEWMODEL_PLACEMENTS[static_cast<int>(Renderer::WeaponType::KNIFE)];
+			transforms.setLocal(viewmodelNodes[static_cast<int>(Renderer::WeaponType::KNIFE)], viewmodelMesh(knife, sin(currentFrame * 2.0f) * 0.02f));
+		}
+		// Remote characters follow the interpolator's clock, which advances once per frame
+		if (clientMode) {
+			interpolator.advance(currentFrame - lastRemoteSampleTime);
+			lastRemoteSampleTime = currentFrame;
+			if (interpolator.sample(netClient.hasPlayer() ? netClient.getPlayerIndex() : ~0u, remoteCharacters)) {
+				syncRemoteCharacters(characters, remoteCharacters);
+			}
+		}
+		characters.updateModelMatrices(&jobs);
+		sceneQuery.updateCharacters(characters);
+		lineOfSight.update(characters, &jobs);
+		characterGrid.sync(characters);
+		pathService.process(&jobs);
+		if (debugPath.status == PathResult::Status::FOUND) {
+			float length = 0.0f;
+			for (size_t i = 1; i < debugPath.points.size(); i++) length += glm::distance(debugPath.points[i - 1], debugPath.points[i]);
+			std::cout << "Path: " << debugPath.points.size() << " waypoints, " << length << " units" << std::endl;
+			debugPath.status = PathResult::Status::NONE;
+		}
+		else if (debugPath.status == PathResult::Status::NOT_FOUND) {
+			std::cout << "Path: unreachable" << std::endl;
+			debugPath.status = PathResult::Status::NONE;
 		}
+		transforms.update();
 
-		weaponModel = glm::scale(weaponModel, glm::vec3(weaponScale));
+		// Late-latch mouse look right before the view-dependent state is captured
+		float xrel, yrel;
+		inputLatch.latch(xrel, yrel);
+		camera.ProcessMouseMovement(xrel, -yrel);
 
-		// Add slight tilt for better viewing angle (common for all weapons)
-		weaponModel = glm::rotate(weaponModel, glm::radians(-10.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		// Motion from snapshots the render thread skipped still has to count towards latency
+		if (!threadedRendering || !snapshots.hasUnread()) unrenderedSampleNs = -1;
+		if (unrenderedSampleNs < 0) unrenderedSampleNs = inputLatch.getLatchedSampleNs();
 
-		// Only apply pitch rotation (vertical movement)
-		float pitch = camera.Pitch * 0.1f; 
-		glm::mat4 weaponRotation = glm::mat4(1.0f);
-		weaponRotation = glm::rotate(weaponRotation, glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+		// Capture everything the frame needs; the snapshot is not touched again once published
+		RenderSnapshot& snapshot = threadedRendering ? snapshots.writeBuffer() : inlineSnapshot;
+		snapshot.cameraPosition = glm::mix(previousPosition, camera.Position, simClock.getAlpha());
+		snapshot.cameraFront = camera.Front;
+		snapshot.cameraUp = camera.Up;
+		snapshot.cameraPitch = camera.Pitch;
+		snapshot.cameraZoom = camera.Zoom;
+		snapshot.weapon = currentWeapon;
+		snapshot.weaponModel = transforms.getWorld(viewmodelNodes[static_cast<int>(currentWeapon)]);
+		snapshot.muzzleFlash = muzzleFlashTimer > 0.0f;
+		snapshot.inputSampleNs = unrenderedSampleNs;
+		snapshot.swapInterval = swapInterval;
+		snapshot.framesInFlight = framesInFlight;
+		// Slots are recycled, so one that already holds this version can skip the copy
+		if (snapshot.characterVersion != characters.getTransformVersion()) {
+			// The render side builds the instance matrices from position and yaw with the kernel
+			snapshot.characterPositions.clear();
+			snapshot.characterYaws.clear();
+			for (int pass = 0; pass < 2; pass++) {
+				CharacterStore::Team team = pass == 0 ? CharacterStore::Team::CT : CharacterStore::Team::T;
+				for (size_t i = 0; i < characters.size(); i++) {
+					if (characters.getTeams()[i] != team) continue;
+					snapshot.characterPositions.push_back(characters.getPositions()[i]);
+					snapshot.characterYaws.push_back(characters.getYaws()[i]);
+				}
+				if (pass == 0) snapshot.ctCount = snapshot.characterPositions.size();
+			}
+			snapshot.characterVersion = characters.getTransformVersion();
+		}
 
-		// Final transformation
-		glm::mat4 weaponTransform = projection * weaponModel;
+		if (threadedRendering) {
+			snapshots.publish();
 
-		// debug output
-		//std::cout << "Camera Position: " << camera.Position.x << ", " << camera.Position.y << ", " << camera.Position.z << std::endl;
-		//std::cout << "Camera Front: " << camera.Front.x << ", " << camera.Front.y << ", " << camera.Front.z << std::endl;
+			// Publish about once a millisecond; the render thread only ever picks the newest
+			SDL_Delay(1);
+		}
+		else {
+			applyRenderSettings(renderContext, snapshot);
+			renderFrame(renderContext, snapshot);
+			presentFrame(renderContext, snapshot);
+		}
 
-		// Draw skybox first
-		glDepthFunc(GL_LEQUAL);  // Change depth function so depth test passes when values are equal to depth buffer's content
-		glm::mat4 skyboxView = glm::mat4(glm::mat3(camera.GetViewMatrix())); // Remove translation from the view matrix
-		skyboxShader.use();
-		skyboxShader.setUniform("view", skyboxView);
-		skyboxShader.setUniform("projection", projection);
-		skybox.render(skyboxShader);
-		glDepthFunc(GL_LESS); // Set depth function back to default
+		// Threaded, the simulation loop runs far more often than frames are presented
+		if (CpuProfiler::isRecording() && presentedFrames.load(std::memory_order_relaxed) >= static_cast<unsigned long long>(std::max(cpuTraceFrames, 0))) {
+			CpuProfiler::setRecording(false);
+			CpuProfiler::exportChromeTrace(cpuTracePath);
+		}
 
-		// Render the map
-		shader.use();
-		shader.setUniform("model", mapModel);
-		shader.setUniform("view", view);
-		shader.setUniform("projection", projection);
-		renderer.render(shader, mapLoader);
+		if (benchmarkMode) {
+			// GPU results arrive a few frames late, keyed by the frame they belong to
+			if (gpuProfiler.getResultsFrame() != lastGpuResultsFrame &&
+				gpuProfiler.getResultsFrame() >= static_cast<unsigned long long>(BENCHMARK_WARMUP_FRAMES)) {
+				double gpuFrameMs = 0.0;
+				for (const auto& timing : gpuProfiler.getResults()) {
+					gpuFrameMs = std::max(gpuFrameMs, timing.startMs + timing.durationMs);
+				}
+				benchmarkReport.addGpuFrame(gpuFrameMs);
+			}
+			lastGpuResultsFrame = gpuProfiler.getResultsFrame();
 
-		// Render characters
-		for (const auto& character : characters) {
-			renderer.renderCharacter(shader, character);
+			if (benchmarkFrame >= BENCHMARK_WARMUP_FRAMES) {
+				benchmarkReport.addCpuFrame((CpuProfiler::now() - frameStartNs) / 1000000.0);
+			}
+			if (++benchmarkFrame >= BENCHMARK_WARMUP_FRAMES + benchmarkFrameCount) {
+				running = false;
+			}
 		}
+	}
 
-		// Render the weapon
-		shader.setUniform("model", weaponTransform);
-		shader.setUniform("view", weaponRotation);
-		shader.setUniform("projection", glm::mat4(1.0f));
-		renderer.renderWeapon(shader, currentWeapon);
+	// Take the context back so GL objects are destroyed on the thread that owns it
+	if (threadedRendering) {
+		renderRunning = false;
+		renderThread.join();
+		window.makeCurrent();
+	}
 
-		// render the crosshair
-		crosshair.render(shader);
+	if (gpuProfiler.getDroppedFrames() > 0) {
+		std::cout << "GPU profiler: dropped results for " << gpuProfiler.getDroppedFrames() << " of "
+			<< gpuProfiler.getProfiledFrames() << " frames (queries not ready after "
+			<< GpuProfiler::FRAME_LATENCY << " frames)" << std::endl;
+	}
+
+	if (benchmarkMode) {
+		benchmarkReport.print();
+		const char* glRenderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+		benchmarkReport.writeJson(benchmarkOut, benchmarkPath, glRenderer ? glRenderer : "unknown");
+	}
 
-		window.swapBuffers();
+	// Quit before the trace frame count was reached
+	if (CpuProfiler::isRecording()) {
+		CpuProfiler::setRecording(false);
+		CpuProfiler::exportChromeTrace(cpuTracePath);
 	}
 
 	return 0;
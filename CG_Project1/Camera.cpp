@@ -113,4 +113,11 @@ void Camera::toggleYLock() {
 	if (isYLocked) {
 		lockedY = Position.y;  // Store current Y position
 	}
+}
+
+void Camera::setPose(const glm::vec3& position, float yaw, float pitch) {
+	Position = position;
+	Yaw = yaw;
+	Pitch = pitch;
+	updateCameraVectors();
 }
\ No newline at end of file
@@ -60,6 +60,9 @@ public:
 	// Add new method
 	void toggleYLock();
 
+	// Places the camera directly, e.g. from a recorded flythrough
+	void setPose(const glm::vec3& position, float yaw, float pitch);
+
 private:
 	// Calculates the front vector from the Camera's (updated) Euler Angles
 	void updateCameraVectors();
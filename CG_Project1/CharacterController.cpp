@@ -0,0 +1,477 @@
+#include "CharacterController.hpp"
+#include "MapBVH.hpp"
+#include "CharacterStore.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// CS player proportions at 64 units to one: 72 tall, 32 wide, eyes at 64, 18 unit steps
+	const float RADIUS = 0.25f;
+	const float HEIGHT = 1.125f;
+	const float STEP_HEIGHT = 0.28f;
+	const float GRAVITY = 12.5f;
+	const float MAX_FALL_SPEED = 20.0f;
+
+	// Gap kept between the capsule and anything it stops against
+	const float SKIN_WIDTH = 0.005f;
+
+	// Surfaces at most ~45 degrees steep count as floor
+	const float WALKABLE_NORMAL_Y = 0.7f;
+
+	const int MAX_SLIDES = 4;
+	const int DEPENETRATION_PASSES = 4;
+
+	const glm::vec3 CAPSULE_AXIS(0.0f, HEIGHT - 2.0f * RADIUS, 0.0f);
+
+	// Ray against the face (p0, p0 + e1, p0 + e2) pushed out by the radius towards the ray.
+	// A triangle when the face is half a parallelogram, a parallelogram otherwise.
+	bool rayOffsetFace(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& p0,
+		const glm::vec3& e1, const glm::vec3& e2, bool parallelogram, float& t, glm::vec3& normal) {
+		glm::vec3 n = glm::cross(e1, e2);
+		float length = glm::length(n);
+		if (length < 1e-12f) return false;
+		n /= length;
+
+		float distance = glm::dot(origin - p0, n);
+		if (distance < 0.0f) {
+			n = -n;
+			distance = -distance;
+		}
+		// Already within the radius of the plane: either touching the face, which
+		// depenetration deals with, or beside it, where an edge is hit first
+		if (distance < RADIUS) return false;
+
+		float approach = glm::dot(direction, n);
+		if (approach >= -1e-8f) return false;
+
+		float hitT = (distance - RADIUS) / -approach;
+		if (hitT >= t) return false;
+
+		glm::vec3 w = origin + direction * hitT - n * RADIUS - p0;
+		float d00 = glm::dot(e1, e1);
+		float d01 = glm::dot(e1, e2);
+		float d11 = glm::dot(e2, e2);
+		float d20 = glm::dot(w, e1);
+		float d21 = glm::dot(w, e2);
+		float denominator = d00 * d11 - d01 * d01;
+		if (std::fabs(denominator) < 1e-20f) return false;
+		float u = (d11 * d20 - d01 * d21) / denominator;
+		float v = (d00 * d21 - d01 * d20) / denominator;
+		if (u < 0.0f || v < 0.0f) return false;
+		if (parallelogram ? (u > 1.0f || v > 1.0f) : (u + v > 1.0f)) return false;
+
+		t = hitT;
+		normal = n;
+		return true;
+	}
+
+	float raySphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& center) {
+		glm::vec3 oc = origin - center;
+		float b = glm::dot(direction, oc);
+		float c = glm::dot(oc, oc) - RADIUS * RADIUS;
+		float h = b * b - c;
+		if (h <= 0.0f) return -1.0f;
+		return -b - std::sqrt(h);
+	}
+
+	// Ray against the capsule of the given radius around segment pa-pb; the direction is unit length
+	bool rayCapsule(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& pa, const glm::vec3& pb,
+		float& t, glm::vec3& normal) {
+		glm::vec3 ba = pb - pa;
+		glm::vec3 oa = origin - pa;
+		float baba = glm::dot(ba, ba);
+		float bard = glm::dot(ba, direction);
+		float baoa = glm::dot(ba, oa);
+		float a = baba - bard * bard;
+
+		float hitT = -1.0f;
+		if (baba < 1e-12f || a < 1e-8f * baba) {
+			// Moving along the axis: only the end caps can be hit first
+			float t0 = raySphere(origin, direction, pa);
+			float t1 = raySphere(origin, direction, pb);
+			hitT = t0 < 0.0f ? t1 : (t1 < 0.0f ? t0 : std::min(t0, t1));
+		} else {
+			float b = baba * glm::dot(direction, oa) - baoa * bard;
+			float c = baba * glm::dot(oa, oa) - baoa * baoa - RADIUS * RADIUS * baba;
+			float h = b * b - a * c;
+			if (h < 0.0f) return false;
+
+			hitT = (-b - std::sqrt(h)) / a;
+			float y = baoa + hitT * bard;
+			if (y <= 0.0f || y >= baba) {
+				hitT = raySphere(origin, direction, y <= 0.0f ? pa : pb);
+			}
+		}
+		if (hitT < 0.0f || hitT >= t) return false;
+
+		glm::vec3 point = origin + direction * hitT;
+		float s = baba > 1e-12f ? glm::clamp(glm::dot(point - pa, ba) / baba, 0.0f, 1.0f) : 0.0f;
+		glm::vec3 away = point - (pa + ba * s);
+		float length = glm::length(away);
+		if (length < 1e-12f) return false;
+
+		t = hitT;
+		normal = away / length;
+		return true;
+	}
+
+	// Sweeps the capsule segment origin..origin + CAPSULE_AXIS along a unit direction. The
+	// capsule touches the triangle exactly when its bottom center is inside the triangle
+	// extruded by -axis and inflated by the radius, so this is a ray cast against that
+	// rounded prism: its five faces pushed out, and capsules around its nine edges.
+	bool sweepTriangle(const glm::vec3& origin, const glm::vec3& direction, const MapBVH::Triangle& triangle,
+		float& t, glm::vec3& normal) {
+		const glm::vec3 v[3] = { triangle.v0, triangle.v1, triangle.v2 };
+		const glm::vec3 lowered[3] = { v[0] - CAPSULE_AXIS, v[1] - CAPSULE_AXIS, v[2] - CAPSULE_AXIS };
+		bool hit = false;
+
+		glm::vec3 e1 = v[1] - v[0];
+		glm::vec3 e2 = v[2] - v[0];
+		hit |= rayOffsetFace(origin, direction, v[0], e1, e2, false, t, normal);
+		hit |= rayOffsetFace(origin, direction, lowered[0], e1, e2, false, t, normal);
+
+		for (int i = 0; i < 3; i++) {
+			int j = (i + 1) % 3;
+			hit |= rayOffsetFace(origin, direction, v[i], v[j] - v[i], -CAPSULE_AXIS, true, t, normal);
+			hit |= rayCapsule(origin, direction, v[i], v[j], t, normal);
+			hit |= rayCapsule(origin, direction, lowered[i], lowered[j], t, normal);
+			hit |= rayCapsule(origin, direction, v[i], lowered[i], t, normal);
+		}
+		return hit;
+	}
+
+	glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		glm::vec3 ab = b - a;
+		glm::vec3 ac = c - a;
+		glm::vec3 ap = p - a;
+		float d1 = glm::dot(ab, ap);
+		float d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+		glm::vec3 bp = p - b;
+		float d3 = glm::dot(ab, bp);
+		float d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3) return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+		glm::vec3 cp = p - c;
+		float d5 = glm::dot(ab, cp);
+		float d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6) return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denominator = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	void closestPointsSegments(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2,
+		glm::vec3& c1, glm::vec3& c2) {
+		glm::vec3 d1 = q1 - p1;
+		glm::vec3 d2 = q2 - p2;
+		glm::vec3 r = p1 - p2;
+		float a = glm::dot(d1, d1);
+		float e = glm::dot(d2, d2);
+		float f = glm::dot(d2, r);
+		float s = 0.0f;
+		float t = 0.0f;
+
+		if (a <= 1e-12f && e <= 1e-12f) {
+			c1 = p1;
+			c2 = p2;
+			return;
+		}
+		if (a <= 1e-12f) {
+			t = glm::clamp(f / e, 0.0f, 1.0f);
+		} else {
+			float c = glm::dot(d1, r);
+			if (e <= 1e-12f) {
+				s = glm::clamp(-c / a, 0.0f, 1.0f);
+			} else {
+				float b = glm::dot(d1, d2);
+				float denominator = a * e - b * b;
+				s = denominator != 0.0f ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+				if (t < 0.0f) {
+					t = 0.0f;
+					s = glm::clamp(-c / a, 0.0f, 1.0f);
+				} else if (t > 1.0f) {
+					t = 1.0f;
+					s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+				}
+			}
+		}
+		c1 = p1 + d1 * s;
+		c2 = p2 + d2 * t;
+	}
+
+	// Closest points between segment a-b and a triangle; returns the squared distance
+	float closestPointsSegmentTriangle(const glm::vec3& a, const glm::vec3& b, const MapBVH::Triangle& triangle,
+		glm::vec3& onSegment, glm::vec3& onTriangle) {
+		// A segment passing through the triangle touches it at the crossing point
+		glm::vec3 n = glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+		float da = glm::dot(a - triangle.v0, n);
+		float db = glm::dot(b - triangle.v0, n);
+		if (da * db < 0.0f) {
+			glm::vec3 crossing = a + (b - a) * (da / (da - db));
+			glm::vec3 offset = closestPointOnTriangle(crossing, triangle.v0, triangle.v1, triangle.v2) - crossing;
+			if (glm::dot(offset, offset) < 1e-12f) {
+				onSegment = onTriangle = crossing;
+				return 0.0f;
+			}
+		}
+
+		// Otherwise the closest pair involves a segment end or a triangle edge
+		onSegment = a;
+		onTriangle = closestPointOnTriangle(a, triangle.v0, triangle.v1, triangle.v2);
+		float best = glm::dot(onTriangle - a, onTriangle - a);
+
+		glm::vec3 point = closestPointOnTriangle(b, triangle.v0, triangle.v1, triangle.v2);
+		float distance = glm::dot(point - b, point - b);
+		if (distance < best) {
+			best = distance;
+			onSegment = b;
+			onTriangle = point;
+		}
+
+		const glm::vec3 v[3] = { triangle.v0, triangle.v1, triangle.v2 };
+		for (int i = 0; i < 3; i++) {
+			glm::vec3 c1, c2;
+			closestPointsSegments(a, b, v[i], v[(i + 1) % 3], c1, c2);
+			distance = glm::dot(c2 - c1, c2 - c1);
+			if (distance < best) {
+				best = distance;
+				onSegment = c1;
+				onTriangle = c2;
+			}
+		}
+		return best;
+	}
+
+	// How far to advance towards a hit so the capsule ends SKIN_WIDTH off the surface
+	float travelTo(float distance, const glm::vec3& direction, const glm::vec3& normal) {
+		float approach = std::max(-glm::dot(direction, normal), 0.1f);
+		return std::max(distance - SKIN_WIDTH / approach, 0.0f);
+	}
+
+	// Removes the motion into each touched plane; two planes leave only the crease between them
+	glm::vec3 clipToPlanes(const glm::vec3& motion, const glm::vec3* planes, int planeCount) {
+		for (int i = 0; i < planeCount; i++) {
+			glm::vec3 clipped = motion - planes[i] * std::min(glm::dot(motion, planes[i]), 0.0f);
+			bool valid = true;
+			for (int j = 0; j < planeCount && valid; j++) {
+				if (j != i && glm::dot(clipped, planes[j]) < -1e-5f) valid = false;
+			}
+			if (valid) return clipped;
+		}
+
+		if (planeCount >= 2) {
+			glm::vec3 crease = glm::cross(planes[planeCount - 2], planes[planeCount - 1]);
+			float length = glm::length(crease);
+			if (length > 1e-6f) {
+				crease /= length;
+				return crease * glm::dot(crease, motion);
+			}
+		}
+		return glm::vec3(0.0f);
+	}
+}
+
+CharacterController::CharacterController(const MapBVH& map)
+	: map(map), feet(0.0f), verticalSpeed(0.0f), grounded(false), candidates(), triangleTests(0) {
+	candidates.reserve(256);
+}
+
+void CharacterController::setEyePosition(const glm::vec3& eyePosition) {
+	feet = eyePosition - glm::vec3(0.0f, CharacterStore::EYE_HEIGHT, 0.0f);
+	verticalSpeed = 0.0f;
+	grounded = false;
+}
+
+glm::vec3 CharacterController::getEyePosition() const {
+	return feet + glm::vec3(0.0f, CharacterStore::EYE_HEIGHT, 0.0f);
+}
+
+CharacterController::State CharacterController::getState() const {
+	State state = { feet, verticalSpeed, grounded };
+	return state;
+}
+
+void CharacterController::setState(const State& state) {
+	feet = state.feet;
+	verticalSpeed = state.verticalSpeed;
+	grounded = state.grounded;
+}
+
+void CharacterController::move(const glm::vec3& displacement, float deltaTime, bool walking) {
+	triangleTests = 0;
+	depenetrate();
+
+	if (!walking) {
+		verticalSpeed = 0.0f;
+		grounded = false;
+		feet = slide(feet, displacement, nullptr);
+		return;
+	}
+
+	glm::vec3 horizontal(displacement.x, 0.0f, displacement.z);
+	if (glm::dot(horizontal, horizontal) > 0.0f) {
+		feet = stepSlide(feet, horizontal);
+	}
+
+	// Stay on the floor walking down stairs and slopes instead of launching off every edge
+	if (grounded) {
+		glm::vec3 down(0.0f, -STEP_HEIGHT, 0.0f);
+		SweepHit hit = sweep(feet, down);
+		if (hit.hit && hit.normal.y >= WALKABLE_NORMAL_Y) {
+			feet.y -= travelTo(hit.distance, glm::vec3(0.0f, -1.0f, 0.0f), hit.normal);
+			verticalSpeed = 0.0f;
+			return;
+		}
+		grounded = false;
+	}
+
+	verticalSpeed = std::max(verticalSpeed - GRAVITY * deltaTime, -MAX_FALL_SPEED);
+	bool landed = false;
+	feet = slide(feet, glm::vec3(0.0f, verticalSpeed * deltaTime, 0.0f), &landed);
+	if (landed) {
+		grounded = true;
+		verticalSpeed = 0.0f;
+	}
+}
+
+CharacterController::SweepHit CharacterController::sweep(const glm::vec3& from, const glm::vec3& displacement) {
+	SweepHit result = { false, 0.0f, glm::vec3(0.0f) };
+	float length = glm::length(displacement);
+	if (length < 1e-7f) return result;
+	glm::vec3 direction = displacement / length;
+
+	glm::vec3 bottom = from + glm::vec3(0.0f, RADIUS, 0.0f);
+	glm::vec3 top = bottom + CAPSULE_AXIS;
+	glm::vec3 margin(RADIUS + SKIN_WIDTH);
+	candidates.clear();
+	map.queryBox(glm::min(bottom, bottom + displacement) - margin, glm::max(top, top + displacement) + margin, candidates);
+
+	float t = length;
+	for (uint32_t index : candidates) {
+		const MapBVH::Triangle& triangle = map.getTriangle(index);
+
+		// Cheap reject: the whole swept capsule stays more than a radius off the triangle's plane
+		glm::vec3 n = glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+		float nLength = glm::length(n);
+		if (nLength < 1e-12f) continue;
+		n /= nLength;
+		float d0 = glm::dot(bottom - triangle.v0, n);
+		float dAxis = glm::dot(CAPSULE_AXIS, n);
+		float dMove = glm::dot(displacement, n);
+		float lowest = d0 + std::min(dAxis, 0.0f) + std::min(dMove, 0.0f);
+		float highest = d0 + std::max(dAxis, 0.0f) + std::max(dMove, 0.0f);
+		if (lowest > RADIUS || highest < -RADIUS) continue;
+
+		triangleTests++;
+		glm::vec3 normal;
+		if (sweepTriangle(bottom, direction, triangle, t, normal)) {
+			result.hit = true;
+			result.distance = t;
+			result.normal = normal;
+		}
+	}
+	return result;
+}
+
+glm::vec3 CharacterController::slide(const glm::vec3& from, const glm::vec3& displacement, bool* landed) {
+	glm::vec3 position = from;
+	glm::vec3 remaining = displacement;
+	glm::vec3 planes[MAX_SLIDES];
+	int planeCount = 0;
+
+	for (int i = 0; i < MAX_SLIDES; i++) {
+		float length = glm::length(remaining);
+		if (length < 1e-6f) break;
+		glm::vec3 direction = remaining / length;
+
+		SweepHit hit = sweep(position, remaining);
+		if (!hit.hit) {
+			position += remaining;
+			break;
+		}
+
+		float travel = travelTo(hit.distance, direction, hit.normal);
+		position += direction * travel;
+		if (landed && hit.normal.y >= WALKABLE_NORMAL_Y) *landed = true;
+
+		planes[planeCount++] = hit.normal;
+		remaining = clipToPlanes(direction * (length - travel), planes, planeCount);
+
+		// Never let the slide turn the motion around; that is what makes corners jitter
+		if (glm::dot(remaining, displacement) <= 0.0f) break;
+	}
+	return position;
+}
+
+glm::vec3 CharacterController::stepSlide(const glm::vec3& from, const glm::vec3& displacement) {
+	glm::vec3 target = from + displacement;
+	glm::vec3 plain = slide(from, displacement, nullptr);
+	glm::vec3 missed = target - plain;
+	if (glm::dot(missed, missed) < 1e-10f) return plain;
+
+	// Blocked: try the same move from a step higher, then put the capsule back down
+	glm::vec3 up(0.0f, STEP_HEIGHT, 0.0f);
+	SweepHit ceiling = sweep(from, up);
+	float raise = ceiling.hit ? travelTo(ceiling.distance, glm::vec3(0.0f, 1.0f, 0.0f), ceiling.normal) : STEP_HEIGHT;
+	if (raise <= SKIN_WIDTH) return plain;
+
+	glm::vec3 stepped = slide(from + glm::vec3(0.0f, raise, 0.0f), displacement, nullptr);
+	SweepHit floor = sweep(stepped, glm::vec3(0.0f, -raise, 0.0f));
+	if (!floor.hit || floor.normal.y < WALKABLE_NORMAL_Y) return plain;
+	stepped.y -= travelTo(floor.distance, glm::vec3(0.0f, -1.0f, 0.0f), floor.normal);
+
+	// Keep whichever got further across the floor
+	glm::vec2 plainMove(plain.x - from.x, plain.z - from.z);
+	glm::vec2 steppedMove(stepped.x - from.x, stepped.z - from.z);
+	return glm::dot(steppedMove, steppedMove) > glm::dot(plainMove, plainMove) + 1e-8f ? stepped : plain;
+}
+
+void CharacterController::depenetrate() {
+	for (int pass = 0; pass < DEPENETRATION_PASSES; pass++) {
+		glm::vec3 bottom = feet + glm::vec3(0.0f, RADIUS, 0.0f);
+		glm::vec3 top = bottom + CAPSULE_AXIS;
+		glm::vec3 margin(RADIUS);
+		candidates.clear();
+		map.queryBox(bottom - margin, top + margin, candidates);
+
+		bool pushed = false;
+		for (uint32_t index : candidates) {
+			const MapBVH::Triangle& triangle = map.getTriangle(index);
+			bottom = feet + glm::vec3(0.0f, RADIUS, 0.0f);
+			top = bottom + CAPSULE_AXIS;
+
+			glm::vec3 onSegment, onTriangle;
+			float distanceSquared = closestPointsSegmentTriangle(bottom, top, triangle, onSegment, onTriangle);
+			if (distanceSquared >= (RADIUS - 1e-4f) * (RADIUS - 1e-4f)) continue;
+			triangleTests++;
+
+			float distance = std::sqrt(distanceSquared);
+			glm::vec3 away;
+			if (distance > 1e-6f) {
+				away = (onSegment - onTriangle) / distance;
+			} else {
+				// Cut right through: leave through whichever side the capsule's middle is on
+				glm::vec3 n = glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+				if (glm::dot(n, n) < 1e-24f) continue;
+				n = glm::normalize(n);
+				away = glm::dot((bottom + top) * 0.5f - triangle.v0, n) >= 0.0f ? n : -n;
+			}
+			feet += away * (RADIUS - distance + SKIN_WIDTH);
+			if (away.y >= WALKABLE_NORMAL_Y) grounded = true;
+			pushed = true;
+		}
+		if (!pushed) break;
+	}
+}
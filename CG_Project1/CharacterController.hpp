@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class MapBVH;
+
+// Moves an upright capsule through the map. Each move sweeps the capsule against the
+// triangles the BVH returns for the swept bounds, stops just short of the first contact and
+// slides the rest of the motion along the surfaces it touched. Walking adds gravity, steps
+// up ledges lower than the step height and keeps the capsule on the floor going downhill.
+// Proportions follow a CS player scaled so the eye sits one unit above the feet.
+class CharacterController {
+public:
+	// Everything a move depends on besides the map, so a move can be replayed exactly
+	struct State {
+		glm::vec3 feet;
+		float verticalSpeed;
+		bool grounded;
+	};
+
+	explicit CharacterController(const MapBVH& map);
+
+	// Places the capsule so its eye is at the given point and drops any fall speed
+	void setEyePosition(const glm::vec3& eyePosition);
+	glm::vec3 getEyePosition() const;
+	const glm::vec3& getFeetPosition() const { return feet; }
+
+	// Resolves one tick of motion. Walking ignores the vertical part of the displacement;
+	// otherwise the capsule flies without gravity but still collides.
+	void move(const glm::vec3& displacement, float deltaTime, bool walking);
+
+	bool isGrounded() const { return grounded; }
+
+	State getState() const;
+	void setState(const State& state);
+
+	// Narrow-phase triangle tests done by the last move(), for profiling
+	size_t getLastTriangleTests() const { return triangleTests; }
+
+private:
+	struct SweepHit {
+		bool hit;
+		float distance;
+		glm::vec3 normal;
+	};
+
+	SweepHit sweep(const glm::vec3& from, const glm::vec3& displacement);
+	glm::vec3 slide(const glm::vec3& from, const glm::vec3& displacement, bool* landed);
+	glm::vec3 stepSlide(const glm::vec3& from, const glm::vec3& displacement);
+	void depenetrate();
+
+	const MapBVH& map;
+	glm::vec3 feet;
+	float verticalSpeed;
+	bool grounded;
+
+	std::vector<uint32_t> candidates;  // Reused by every query so moving never allocates
+	size_t triangleTests;
+};
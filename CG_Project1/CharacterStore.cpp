@@ -0,0 +1,167 @@
+#include "CharacterStore.hpp"
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include "TransformKernel.hpp"
+#include "MemoryUsage.hpp"
+
+const float CharacterStore::MODEL_SCALE = 0.025f;
+const float CharacterStore::EYE_HEIGHT = 1.0f;
+
+namespace {
+	// Entities per job when rebuilding matrices
+	const size_t MATRIX_GRAIN_SIZE = 4096;
+}
+
+CharacterStore::CharacterStore()
+	: positions(), yaws(), teams(), flags(), modelMatrices(), denseToSlot(), slots(), freeSlots()
+	, anyDirty(false), transformVersion(0) {}
+
+EntityHandle CharacterStore::create(const glm::vec3& position, Team team, float yawDegrees) {
+	uint32_t slotIndex;
+	if (!freeSlots.empty()) {
+		slotIndex = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		slotIndex = static_cast<uint32_t>(slots.size());
+		Slot slot = { 0, EntityHandle::INVALID_INDEX };
+		slots.push_back(slot);
+	}
+
+	uint32_t denseIndex = static_cast<uint32_t>(positions.size());
+	slots[slotIndex].denseIndex = denseIndex;
+
+	positions.push_back(position);
+	yaws.push_back(yawDegrees);
+	teams.push_back(team);
+	flags.push_back(FLAG_TRANSFORM_DIRTY);
+	modelMatrices.emplace_back(1.0f);
+	denseToSlot.push_back(slotIndex);
+	anyDirty = true;
+
+	return EntityHandle(slotIndex, slots[slotIndex].generation);
+}
+
+bool CharacterStore::destroy(EntityHandle handle) {
+	int index = indexOf(handle);
+	if (index < 0) return false;
+
+	// Move the last entity into the hole to keep the arrays packed
+	size_t last = positions.size() - 1;
+	size_t dense = static_cast<size_t>(index);
+	if (dense != last) {
+		positions[dense] = positions[last];
+		yaws[dense] = yaws[last];
+		teams[dense] = teams[last];
+		flags[dense] = flags[last];
+		modelMatrices[dense] = modelMatrices[last];
+		denseToSlot[dense] = denseToSlot[last];
+		slots[denseToSlot[dense]].denseIndex = static_cast<uint32_t>(dense);
+	}
+
+	positions.pop_back();
+	yaws.pop_back();
+	teams.pop_back();
+	flags.pop_back();
+	modelMatrices.pop_back();
+	denseToSlot.pop_back();
+	transformVersion++;
+
+	Slot& slot = slots[handle.index];
+	slot.generation++;
+	slot.denseIndex = EntityHandle::INVALID_INDEX;
+	freeSlots.push_back(handle.index);
+	return true;
+}
+
+bool CharacterStore::isAlive(EntityHandle handle) const {
+	return indexOf(handle) >= 0;
+}
+
+void CharacterStore::reserve(size_t count) {
+	positions.reserve(count);
+	yaws.reserve(count);
+	teams.reserve(count);
+	flags.reserve(count);
+	modelMatrices.reserve(count);
+	denseToSlot.reserve(count);
+	slots.reserve(count);
+}
+
+void CharacterStore::clear() {
+	// Destroy through the slot table so outstanding handles go stale
+	for (uint32_t slotIndex : denseToSlot) {
+		slots[slotIndex].generation++;
+		slots[slotIndex].denseIndex = EntityHandle::INVALID_INDEX;
+		freeSlots.push_back(slotIndex);
+	}
+	positions.clear();
+	yaws.clear();
+	teams.clear();
+	flags.clear();
+	modelMatrices.clear();
+	denseToSlot.clear();
+	anyDirty = false;
+	transformVersion++;
+}
+
+int CharacterStore::indexOf(EntityHandle handle) const {
+	if (handle.index >= slots.size()) return -1;
+	const Slot& slot = slots[handle.index];
+	if (slot.generation != handle.generation || slot.denseIndex == EntityHandle::INVALID_INDEX) return -1;
+	return static_cast<int>(slot.denseIndex);
+}
+
+EntityHandle CharacterStore::handleAt(size_t index) const {
+	uint32_t slotIndex = denseToSlot[index];
+	return EntityHandle(slotIndex, slots[slotIndex].generation);
+}
+
+void CharacterStore::setPosition(size_t index, const glm::vec3& position) {
+	positions[index] = position;
+	markDirty(index);
+}
+
+void CharacterStore::setYaw(size_t index, float yawDegrees) {
+	yaws[index] = yawDegrees;
+	markDirty(index);
+}
+
+void CharacterStore::updateModelMatrices(JobSystem* jobs) {
+	if (!anyDirty) return;
+	anyDirty = false;
+
+	PROFILE_SCOPE("CharacterStore::updateModelMatrices");
+	if (jobs) {
+		jobs->parallelFor(positions.size(), MATRIX_GRAIN_SIZE, [this](size_t begin, size_t end) { updateRange(begin, end); });
+	}
+	else {
+		updateRange(0, positions.size());
+	}
+	transformVersion++;
+}
+
+void CharacterStore::updateRange(size_t begin, size_t end) {
+	size_t i = begin;
+	while (i < end) {
+		if (!(flags[i] & FLAG_TRANSFORM_DIRTY)) {
+			i++;
+			continue;
+		}
+
+		// Hand each run of consecutive dirty entities to the batch kernel
+		size_t runEnd = i;
+		while (runEnd < end && (flags[runEnd] & FLAG_TRANSFORM_DIRTY)) {
+			flags[runEnd] &= static_cast<uint8_t>(~FLAG_TRANSFORM_DIRTY);
+			runEnd++;
+		}
+		TransformBatch batch = { &positions[i], &yaws[i], nullptr, MODEL_SCALE, runEnd - i };
+		TransformKernel::build(batch, &modelMatrices[i][0][0]);
+		i = runEnd;
+	}
+}
+
+size_t CharacterStore::getMemoryUsage() const {
+	return vectorBytes(positions) + vectorBytes(yaws) + vectorBytes(teams) + vectorBytes(flags) + vectorBytes(modelMatrices)
+		+ vectorBytes(denseToSlot) + vectorBytes(slots) + vectorBytes(freeSlots);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class JobSystem;
+
+// Stable reference to an entity. The generation changes whenever a slot is reused, so a
+// handle to a destroyed entity never resolves to whatever took its place.
+struct EntityHandle {
+	static const uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+	uint32_t index;
+	uint32_t generation;
+
+	EntityHandle() : index(INVALID_INDEX), generation(0) {}
+	EntityHandle(uint32_t index, uint32_t generation) : index(index), generation(generation) {}
+
+	bool isNull() const { return index == INVALID_INDEX; }
+	bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+// Characters as parallel arrays (struct of arrays). Live entities are packed at the front
+// of every array so per-frame systems stream through exactly the fields they use; destroy
+// moves the last entity into the hole. Handles resolve through a slot table and survive
+// that compaction. Model matrices are cached and only rebuilt for entities marked dirty.
+class CharacterStore {
+public:
+	enum class Team : uint8_t { CT, T };
+
+	enum Flag : uint8_t {
+		FLAG_TRANSFORM_DIRTY = 1 << 0,
+		FLAG_HIDDEN = 1 << 1
+	};
+
+	// Uniform scale applied to the character models
+	static const float MODEL_SCALE;
+
+	// Eye above the entity's position, which is at its feet
+	static const float EYE_HEIGHT;
+
+	CharacterStore();
+
+	EntityHandle create(const glm::vec3& position, Team team, float yawDegrees);
+	bool destroy(EntityHandle handle);
+	bool isAlive(EntityHandle handle) const;
+	void reserve(size_t count);
+	void clear();
+
+	size_t size() const { return positions.size(); }
+	size_t getMemoryUsage() const;  // Heap bytes held
+
+	// Dense index of a live entity, -1 for stale or null handles
+	int indexOf(EntityHandle handle) const;
+	EntityHandle handleAt(size_t index) const;
+
+	// Dense arrays of size(); pointers are invalidated by create and destroy. Writers going
+	// through the raw arrays must call markDirty for entities whose transform they touched.
+	glm::vec3* getPositions() { return positions.data(); }
+	const glm::vec3* getPositions() const { return positions.data(); }
+	float* getYaws() { return yaws.data(); }
+	const float* getYaws() const { return yaws.data(); }
+	const Team* getTeams() const { return teams.data(); }
+	uint8_t* getFlags() { return flags.data(); }
+	const uint8_t* getFlags() const { return flags.data(); }
+	const glm::mat4* getModelMatrices() const { return modelMatrices.data(); }
+
+	void setPosition(size_t index, const glm::vec3& position);
+	void setYaw(size_t index, float yawDegrees);
+	void markDirty(size_t index) {
+		flags[index] |= FLAG_TRANSFORM_DIRTY;
+		anyDirty = true;
+	}
+
+	// Rebuilds the model matrices of dirty entities, split across jobs if a system is given.
+	// Returns immediately when nothing is dirty.
+	void updateModelMatrices(JobSystem* jobs = nullptr);
+
+	// Bumped whenever a model matrix changes or entities are added or removed
+	unsigned long long getTransformVersion() const { return transformVersion; }
+
+private:
+	struct Slot {
+		uint32_t generation;
+		uint32_t denseIndex;  // INVALID_INDEX while the slot is free
+	};
+
+	// Dense, one entry per live entity
+	std::vector<glm::vec3> positions;
+	std::vector<float> yaws;
+	std::vector<Team> teams;
+	std::vector<uint8_t> flags;
+	std::vector<glm::mat4> modelMatrices;
+	std::vector<uint32_t> denseToSlot;
+
+	// Sparse, indexed by handle
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+
+	bool anyDirty;
+	unsigned long long transformVersion;
+
+	void updateRange(size_t begin, size_t end);
+};
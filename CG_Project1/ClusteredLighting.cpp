@@ -0,0 +1,213 @@
+#include "ClusteredLighting.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLUSTERED_LIGHTING_SSE 1
+#endif
+
+ClusteredLighting::ClusteredLighting()
+	: lightDataBuffer(0), lightDataTexture(0)
+	, clusterGridBuffer(0), clusterGridTexture(0)
+	, lightIndexBuffer(0), lightIndexTexture(0)
+	, zNear(0.1f), zFar(100.0f) {}
+
+ClusteredLighting::~ClusteredLighting() {
+	GLuint buffers[] = { lightDataBuffer, clusterGridBuffer, lightIndexBuffer };
+	GLuint textures[] = { lightDataTexture, clusterGridTexture, lightIndexTexture };
+	glDeleteBuffers(3, buffers);
+	glDeleteTextures(3, textures);
+}
+
+bool ClusteredLighting::initialize() {
+	glGenBuffers(1, &lightDataBuffer);
+	glGenBuffers(1, &clusterGridBuffer);
+	glGenBuffers(1, &lightIndexBuffer);
+	glGenTextures(1, &lightDataTexture);
+	glGenTextures(1, &clusterGridTexture);
+	glGenTextures(1, &lightIndexTexture);
+
+	if (!lightDataBuffer || !clusterGridBuffer || !lightIndexBuffer) {
+		std::cerr << "Failed to create clustered lighting buffers" << std::endl;
+		return false;
+	}
+
+	clusterGrid.assign(CLUSTER_COUNT * 2, 0);
+	upload();
+	return true;
+}
+
+void ClusteredLighting::update(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+	float zNear, float zFar) {
+	this->zNear = zNear;
+	this->zFar = zFar;
+
+	transformLights(lights, view);
+
+	// Pass 1: find the cluster range of every light and count lights per cluster
+	ranges.resize(lights.size());
+	lightData.clear();
+	std::fill(clusterGrid.begin(), clusterGrid.end(), 0u);
+
+	std::vector<unsigned int> visibleLights;
+	visibleLights.reserve(lights.size());
+	for (size_t i = 0; i < lights.size(); i++) {
+		if (!computeRange(viewX[i], viewY[i], viewZ[i], lights[i].radius, projection, ranges[i])) {
+			continue;
+		}
+
+		unsigned int lightIndex = static_cast<unsigned int>(lightData.size() / 2);
+		lightData.push_back(glm::vec4(viewX[i], viewY[i], viewZ[i], lights[i].radius));
+		lightData.push_back(glm::vec4(lights[i].color * lights[i].intensity, 1.0f));
+		ranges[lightIndex] = ranges[i];
+		visibleLights.push_back(lightIndex);
+
+		const ClusterRange& r = ranges[lightIndex];
+		for (int z = r.minZ; z <= r.maxZ; z++)
+			for (int y = r.minY; y <= r.maxY; y++)
+				for (int x = r.minX; x <= r.maxX; x++)
+					clusterGrid[((z * CLUSTERS_Y + y) * CLUSTERS_X + x) * 2 + 1]++;
+	}
+
+	// Prefix sum gives every cluster its slice of the index list
+	unsigned int offset = 0;
+	for (int c = 0; c < CLUSTER_COUNT; c++) {
+		clusterGrid[c * 2] = offset;
+		offset += clusterGrid[c * 2 + 1];
+		clusterGrid[c * 2 + 1] = 0;
+	}
+	lightIndices.resize(offset);
+
+	// Pass 2: scatter light indices into their clusters
+	for (unsigned int lightIndex : visibleLights) {
+		const ClusterRange& r = ranges[lightIndex];
+		for (int z = r.minZ; z <= r.maxZ; z++)
+			for (int y = r.minY; y <= r.maxY; y++)
+				for (int x = r.minX; x <= r.maxX; x++) {
+					unsigned int* cluster = &clusterGrid[((z * CLUSTERS_Y + y) * CLUSTERS_X + x) * 2];
+					lightIndices[cluster[0] + cluster[1]] = lightIndex;
+					cluster[1]++;
+				}
+	}
+
+	upload();
+}
+
+void ClusteredLighting::transformLights(const std::vector<PointLight>& lights, const glm::mat4& view) {
+	// Padded to a multiple of 4 so the SIMD loop never needs a tail
+	size_t count = lights.size();
+	size_t padded = (count + 3) & ~static_cast<size_t>(3);
+	viewX.resize(padded);
+	viewY.resize(padded);
+	viewZ.resize(padded);
+
+#ifdef CLUSTERED_LIGHTING_SSE
+	// Gather into SoA first, then transform 4 lights per iteration in place
+	for (size_t i = 0; i < padded; i++) {
+		glm::vec3 p = i < count ? lights[i].position : glm::vec3(0.0f);
+		viewX[i] = p.x;
+		viewY[i] = p.y;
+		viewZ[i] = p.z;
+	}
+
+	for (size_t i = 0; i < padded; i += 4) {
+		__m128 x = _mm_loadu_ps(&viewX[i]);
+		__m128 y = _mm_loadu_ps(&viewY[i]);
+		__m128 z = _mm_loadu_ps(&viewZ[i]);
+
+		__m128 outX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view[0][0]), x), _mm_mul_ps(_mm_set1_ps(view[1][0]), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view[2][0]), z), _mm_set1_ps(view[3][0])));
+		__m128 outY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view[0][1]), x), _mm_mul_ps(_mm_set1_ps(view[1][1]), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view[2][1]), z), _mm_set1_ps(view[3][1])));
+		__m128 outZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view[0][2]), x), _mm_mul_ps(_mm_set1_ps(view[1][2]), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view[2][2]), z), _mm_set1_ps(view[3][2])));
+
+		_mm_storeu_ps(&viewX[i], outX);
+		_mm_storeu_ps(&viewY[i], outY);
+		_mm_storeu_ps(&viewZ[i], outZ);
+	}
+#else
+	for (size_t i = 0; i < count; i++) {
+		glm::vec4 p = view * glm::vec4(lights[i].position, 1.0f);
+		viewX[i] = p.x;
+		viewY[i] = p.y;
+		viewZ[i] = p.z;
+	}
+#endif
+}
+
+bool ClusteredLighting::computeRange(float x, float y, float z, float radius, const glm::mat4& projection, ClusterRange& range) const {
+	// View space looks down -Z, so depth is the negated z
+	float minDepth = std::max(-z - radius, zNear);
+	float maxDepth = std::min(-z + radius, zFar);
+	if (minDepth > maxDepth) return false;
+
+	// Conservative NDC bounds of the light's view-space AABB: each extent is
+	// divided by whichever depth pushes it furthest from the screen center
+	float minX = x - radius, maxX = x + radius;
+	float minY = y - radius, maxY = y + radius;
+	float ndcMinX = projection[0][0] * minX / (minX < 0.0f ? minDepth : maxDepth);
+	float ndcMaxX = projection[0][0] * maxX / (maxX > 0.0f ? minDepth : maxDepth);
+	float ndcMinY = projection[1][1] * minY / (minY < 0.0f ? minDepth : maxDepth);
+	float ndcMaxY = projection[1][1] * maxY / (maxY > 0.0f ? minDepth : maxDepth);
+	if (ndcMinX > 1.0f || ndcMaxX < -1.0f || ndcMinY > 1.0f || ndcMaxY < -1.0f) return false;
+
+	range.minX = std::max(0, static_cast<int>(std::floor((ndcMinX * 0.5f + 0.5f) * CLUSTERS_X)));
+	range.maxX = std::min(CLUSTERS_X - 1, static_cast<int>(std::floor((ndcMaxX * 0.5f + 0.5f) * CLUSTERS_X)));
+	range.minY = std::max(0, static_cast<int>(std::floor((ndcMinY * 0.5f + 0.5f) * CLUSTERS_Y)));
+	range.maxY = std::min(CLUSTERS_Y - 1, static_cast<int>(std::floor((ndcMaxY * 0.5f + 0.5f) * CLUSTERS_Y)));
+	range.minZ = depthSlice(minDepth);
+	range.maxZ = depthSlice(maxDepth);
+	return true;
+}
+
+int ClusteredLighting::depthSlice(float depth) const {
+	// Exponential slicing keeps clusters roughly cube shaped along the view frustum
+	float slice = std::log(depth / zNear) * CLUSTERS_Z / std::log(zFar / zNear);
+	return std::max(0, std::min(CLUSTERS_Z - 1, static_cast<int>(slice)));
+}
+
+void ClusteredLighting::upload() {
+	// Buffer textures cannot be empty, so keep at least one element in each
+	if (lightData.empty()) lightData.push_back(glm::vec4(0.0f));
+	if (lightIndices.empty()) lightIndices.push_back(0);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, lightDataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, lightData.size() * sizeof(glm::vec4), lightData.data(), GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightDataBuffer);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterGridBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, clusterGrid.size() * sizeof(unsigned int), clusterGrid.data(), GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, clusterGridTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, clusterGridBuffer);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, lightIndexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, lightIndices.size() * sizeof(unsigned int), lightIndices.data(), GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, lightIndexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, lightIndexBuffer);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::bind(const ShaderProgram& shaderProgram, int firstTextureUnit, float viewportWidth, float viewportHeight) const {
+	glActiveTexture(GL_TEXTURE0 + firstTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+	glActiveTexture(GL_TEXTURE0 + firstTextureUnit + 1);
+	glBindTexture(GL_TEXTURE_BUFFER, clusterGridTexture);
+	glActiveTexture(GL_TEXTURE0 + firstTextureUnit + 2);
+	glBindTexture(GL_TEXTURE_BUFFER, lightIndexTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	float logRatio = std::log(zFar / zNear);
+	shaderProgram.setUniform("lightData", firstTextureUnit);
+	shaderProgram.setUniform("clusterGrid", firstTextureUnit + 1);
+	shaderProgram.setUniform("lightIndices", firstTextureUnit + 2);
+	shaderProgram.setUniform("clusterDims", glm::vec3(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z));
+	shaderProgram.setUniform("clusterScreenSize", glm::vec2(viewportWidth, viewportHeight));
+	shaderProgram.setUniform("clusterDepthScale", CLUSTERS_Z / logRatio);
+	shaderProgram.setUniform("clusterDepthBias", -CLUSTERS_Z * std::log(zNear) / logRatio);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ShaderProgram.hpp"
+
+struct PointLight {
+	glm::vec3 position;  // World space
+	float radius;        // Light has no influence past this distance
+	glm::vec3 color;
+	float intensity;
+
+	PointLight(const glm::vec3& position, float radius, const glm::vec3& color, float intensity)
+		: position(position), radius(radius), color(color), intensity(intensity) {}
+};
+
+// Bins point lights into a view-space froxel grid (screen tiles x exponential depth slices)
+// on the CPU and uploads the per-cluster light lists as buffer textures for the LIT shader variant.
+class ClusteredLighting {
+public:
+	static const int CLUSTERS_X = 16;
+	static const int CLUSTERS_Y = 9;
+	static const int CLUSTERS_Z = 24;
+	static const int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+	ClusteredLighting();
+	~ClusteredLighting();
+
+	bool initialize();
+
+	// Rebuilds the cluster light lists for this frame's camera and uploads them
+	void update(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+		float zNear, float zFar);
+
+	// Binds the light buffers starting at firstTextureUnit and sets the lighting uniforms
+	void bind(const ShaderProgram& shaderProgram, int firstTextureUnit, float viewportWidth, float viewportHeight) const;
+
+private:
+	struct ClusterRange {
+		int minX, maxX;
+		int minY, maxY;
+		int minZ, maxZ;
+	};
+
+	// GL buffers and the buffer textures that view them
+	GLuint lightDataBuffer, lightDataTexture;
+	GLuint clusterGridBuffer, clusterGridTexture;
+	GLuint lightIndexBuffer, lightIndexTexture;
+
+	float zNear;
+	float zFar;
+
+	// Scratch storage reused every frame
+	std::vector<float> viewX, viewY, viewZ;
+	std::vector<ClusterRange> ranges;
+	std::vector<glm::vec4> lightData;        // 2 texels per light: view position + radius, color * intensity
+	std::vector<unsigned int> clusterGrid;   // 2 values per cluster: offset into lightIndices, count
+	std::vector<unsigned int> lightIndices;
+
+	void transformLights(const std::vector<PointLight>& lights, const glm::mat4& view);
+	bool computeRange(float x, float y, float z, float radius, const glm::mat4& projection, ClusterRange& range) const;
+	int depthSlice(float depth) const;
+	void upload();
+};
@@ -0,0 +1,110 @@
+#include "CpuProfiler.hpp"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> CpuProfiler::recording(false);
+
+namespace {
+	struct ThreadBuffer {
+		std::unique_ptr<CpuProfileEvent[]> events;
+		std::atomic<size_t> count;
+		int threadId;
+		std::string threadName;
+
+		explicit ThreadBuffer(int threadId)
+			: events(new CpuProfileEvent[CpuProfiler::EVENTS_PER_THREAD]), count(0), threadId(threadId), threadName() {}
+	};
+
+	// Buffers outlive their threads so a trace can still be exported after workers exit
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+	ThreadBuffer& localBuffer() {
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock(registryMutex);
+			registry.emplace_back(new ThreadBuffer(static_cast<int>(registry.size())));
+			buffer = registry.back().get();
+		}
+		return *buffer;
+	}
+
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	void writeEscaped(std::ofstream& out, const std::string& text) {
+		for (char c : text) {
+			if (c == '"' || c == '\\') out << '\\';
+			out << c;
+		}
+	}
+}
+
+long long CpuProfiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void CpuProfiler::record(const char* name, long long startNs, long long endNs) {
+	ThreadBuffer& buffer = localBuffer();
+	size_t index = buffer.count.load(std::memory_order_relaxed);
+	if (index >= EVENTS_PER_THREAD) return;  // Full: drop rather than allocate mid-frame
+
+	CpuProfileEvent& event = buffer.events[index];
+	event.name = name;
+	event.startNs = startNs;
+	event.durationNs = endNs - startNs;
+
+	// Publish the event to a concurrent exporter only after it is fully written
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const std::string& name) {
+	ThreadBuffer& buffer = localBuffer();
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer.threadName = name;
+}
+
+bool CpuProfiler::exportChromeTrace(const std::string& path) {
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		std::cerr << "Failed to open trace file: " << path << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	size_t totalEvents = 0;
+	bool first = true;
+	out << std::fixed << std::setprecision(3);
+	out << "{\"traceEvents\":[\n";
+
+	for (const auto& buffer : registry) {
+		if (!buffer->threadName.empty()) {
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"args\":{\"name\":\"";
+			writeEscaped(out, buffer->threadName);
+			out << "\"}}";
+			first = false;
+		}
+
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			const CpuProfileEvent& event = buffer->events[i];
+			// Chrome trace timestamps are in microseconds
+			out << (first ? "" : ",\n") << "{\"name\":\"";
+			writeEscaped(out, event.name);
+			out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"ts\":" << event.startNs / 1000.0
+				<< ",\"dur\":" << event.durationNs / 1000.0 << "}";
+			first = false;
+		}
+		totalEvents += count;
+	}
+
+	out << "\n]}\n";
+	std::cout << "Wrote " << totalEvents << " profiler events to " << path << std::endl;
+	return true;
+}
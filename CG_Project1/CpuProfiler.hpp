@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+// Define CPU_PROFILER_ENABLED to 0 to compile every PROFILE_SCOPE out entirely
+#ifndef CPU_PROFILER_ENABLED
+#define CPU_PROFILER_ENABLED 1
+#endif
+
+struct CpuProfileEvent {
+	const char* name;   // Must be a string literal or otherwise outlive the export
+	long long startNs;
+	long long durationNs;
+};
+
+// Records RAII zones into per-thread buffers and exports them as Chrome trace JSON
+// (chrome://tracing or ui.perfetto.dev). Each thread only ever appends to its own buffer,
+// so recording takes no locks; a lock is only taken the first time a thread records.
+class CpuProfiler {
+public:
+	static const size_t EVENTS_PER_THREAD = 1 << 17;
+
+	static void setRecording(bool enabled) { recording.store(enabled, std::memory_order_relaxed); }
+	static bool isRecording() { return recording.load(std::memory_order_relaxed); }
+
+	// Nanoseconds since the profiler epoch on a monotonic high-resolution clock
+	static long long now();
+
+	static void record(const char* name, long long startNs, long long endNs);
+	static void setThreadName(const std::string& name);
+
+	static bool exportChromeTrace(const std::string& path);
+
+private:
+	static std::atomic<bool> recording;
+};
+
+class CpuProfileZone {
+public:
+	explicit CpuProfileZone(const char* name)
+		: name(name), startNs(CpuProfiler::isRecording() ? CpuProfiler::now() : -1) {}
+
+	~CpuProfileZone() {
+		if (startNs >= 0) CpuProfiler::record(name, startNs, CpuProfiler::now());
+	}
+
+	CpuProfileZone(const CpuProfileZone&) = delete;
+	CpuProfileZone& operator=(const CpuProfileZone&) = delete;
+
+private:
+	const char* name;
+	long long startNs;
+};
+
+#define CPU_PROFILER_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_INNER(a, b)
+
+#if CPU_PROFILER_ENABLED
+#define PROFILE_SCOPE(name) CpuProfileZone CPU_PROFILER_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
@@ -50,19 +50,16 @@ void Crosshair::render(const ShaderProgram& shaderProgram) {
     
     glDisable(GL_DEPTH_TEST);
     
+    // Expects the ShaderFeature::HUD variant, which only needs the projection and line color
     shaderProgram.use();
     
     glm::mat4 ortho = glm::ortho(-windowWidth/2, windowWidth/2, -windowHeight/2, windowHeight/2);
     shaderProgram.setUniform("projection", ortho);
-    shaderProgram.setUniform("view", glm::mat4(1.0f));
-    shaderProgram.setUniform("model", glm::mat4(1.0f));
-    shaderProgram.setUniform("isCrosshair", true);
+    shaderProgram.setUniform("color", color);
     
     glBindVertexArray(VAO);
     glDrawArrays(GL_LINES, 0, 4);
     glBindVertexArray(0);
     
-    shaderProgram.setUniform("isCrosshair", false);
-    
     if (depthTest) glEnable(GL_DEPTH_TEST);
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "DedicatedServer.hpp"
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace {
+	const long long REPORT_INTERVAL_NS = 1000000000ll;
+
+	double kilobytes(size_t bytes) {
+		return bytes / 1024.0;
+	}
+}
+
+DedicatedServer::DedicatedServer(JobSystem& jobs) : jobs(jobs), assets(), matches() {}
+
+bool DedicatedServer::initialize(const std::string& mapPath) {
+	PROFILE_SCOPE("DedicatedServer::initialize");
+	return assets.load(mapPath);
+}
+
+Match& DedicatedServer::addMatch(size_t botsPerTeam, unsigned int seed, uint16_t port) {
+	matches.push_back(std::unique_ptr<Match>(new Match(assets, static_cast<unsigned int>(matches.size()))));
+	Match& match = *matches.back();
+	match.spawnBots(botsPerTeam, seed);
+	if (port != 0 && match.replicate(port)) {
+		std::cout << "Server: match " << match.getId() << " replicating on UDP port " << port << std::endl;
+	}
+	return match;
+}
+
+void DedicatedServer::tick(float dt) {
+	PROFILE_SCOPE("DedicatedServer::tick");
+
+	// Matches share nothing writable, so each is one job; a single match has nothing to run
+	// beside it and parallelizes inside instead
+	if (matches.size() == 1) {
+		matches[0]->tick(dt, &jobs);
+		return;
+	}
+	jobs.parallelFor(matches.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) matches[i]->tick(dt);
+	});
+}
+
+void DedicatedServer::printMatches() const {
+	size_t perMatch = 0;
+	for (const std::unique_ptr<Match>& match : matches) {
+		std::cout << "  match " << std::setw(3) << match->getId() << ": " << match->getCharacters().size() << " characters ("
+			<< match->getPlayerCount() << " players), "
+			<< std::fixed << std::setprecision(3) << match->getLifetimeMeanTickMs() << " ms per tick, "
+			<< std::setprecision(0) << kilobytes(match->getMemoryUsage()) << " KB, "
+			<< match->getShotsHit() << "/" << match->getShotsFired() << " shots hit";
+		if (match->getPlayerShotsFired() > 0) {
+			std::cout << ", players " << match->getPlayerShotsHit() << "/" << match->getPlayerShotsFired() << " shots hit ("
+				<< match->getPlayerHitsRewound() << " only with rewinding)";
+		}
+		const ReplicationServer* replication = match->getReplication();
+		if (replication && replication->getSendFailures() > 0) std::cout << ", " << replication->getSendFailures() << " snapshots unsent";
+		std::cout << std::endl;
+		perMatch += match->getMemoryUsage();
+	}
+	std::cout << "  shared map data " << std::fixed << std::setprecision(0) << kilobytes(assets.getMemoryUsage())
+		<< " KB, matches " << kilobytes(perMatch) << " KB in total" << std::endl;
+}
+
+void DedicatedServer::run(int tickRate, long long ticks, bool unthrottled) {
+	float dt = 1.0f / tickRate;
+	long long tickNs = 1000000000ll / tickRate;
+	std::cout << "Server: " << matches.size() << " matches on " << jobs.getWorkerCount() << " workers, " << tickRate << " Hz"
+		<< (unthrottled ? ", unthrottled" : "") << std::endl;
+
+	long long runStart = CpuProfiler::now();
+	long long reportStart = runStart;
+	long long reportTicks = 0;
+	long long ran = 0;
+	std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+	while (ticks == 0 || ran < ticks) {
+		tick(dt);
+		long long tickEnd = CpuProfiler::now();
+		reportTicks++;
+		ran++;
+
+		if (tickEnd - reportStart >= REPORT_INTERVAL_NS) {
+			// The slowest match is what holds a server tick back
+			double meanMs = 0.0, worstMs = 0.0;
+			for (const std::unique_ptr<Match>& match : matches) {
+				meanMs += match->getMeanTickMs();
+				worstMs = std::max(worstMs, match->getWorstTickMs());
+				match->resetTickWindow();
+			}
+			if (!matches.empty()) meanMs /= matches.size();
+
+			double seconds = (tickEnd - reportStart) / 1e9;
+			std::cout << "Server: " << std::fixed << std::setprecision(0) << reportTicks / seconds << " ticks/s, match tick "
+				<< std::setprecision(3) << meanMs << " ms mean, " << worstMs << " ms worst" << std::endl;
+			reportStart = tickEnd;
+			reportTicks = 0;
+		}
+
+		if (!unthrottled) {
+			nextTick += std::chrono::nanoseconds(tickNs);
+			std::this_thread::sleep_until(nextTick);
+		}
+	}
+
+	double seconds = (CpuProfiler::now() - runStart) / 1e9;
+	std::cout << "Server: ran " << ran << " ticks in " << std::fixed << std::setprecision(2) << seconds << " s ("
+		<< std::setprecision(0) << ran / std::max(seconds, 1e-9) << " ticks/s)" << std::endl;
+	printMatches();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MapAssets.hpp"
+#include "Match.hpp"
+
+class JobSystem;
+
+// Hosts any number of matches in one process with no window and no GL context. The map is
+// loaded once and shared read-only; every match keeps only its own dynamic state and the
+// matches of a server tick run side by side on the job system, one job each. A lone match
+// spreads its own subsystems over the pool instead. Ticks either at the tick rate like a
+// real server or as fast as it can, for bot training and load tests.
+class DedicatedServer {
+public:
+	explicit DedicatedServer(JobSystem& jobs);
+
+	// Loads geometry without textures and builds the collision and navigation data
+	bool initialize(const std::string& mapPath);
+
+	// Adds a match with bots per team around the two spawns; the seed makes it repeatable.
+	// With a port the match replicates to clients there.
+	Match& addMatch(size_t botsPerTeam, unsigned int seed, uint16_t port = 0);
+
+	void tick(float dt);
+
+	// Runs the given number of ticks (forever if 0), printing throughput once a second and
+	// each match's tick time and memory at the end. Unthrottled it never sleeps, otherwise
+	// it keeps to the tick rate.
+	void run(int tickRate, long long ticks, bool unthrottled);
+
+	size_t getMatchCount() const { return matches.size(); }
+	const Match& getMatch(size_t index) const { return *matches[index]; }
+	const MapAssets& getAssets() const { return assets; }
+
+private:
+	JobSystem& jobs;
+	MapAssets assets;
+	std::vector<std::unique_ptr<Match>> matches;  // Matches never move once created
+
+	void printMatches() const;
+};
@@ -0,0 +1,79 @@
+#include "FlythroughPath.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace {
+	template <typename T>
+	T catmullRom(const T& p0, const T& p1, const T& p2, const T& p3, float t) {
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2
+			+ (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	}
+}
+
+FlythroughPath::FlythroughPath() : points(), duration(20.0f) {}
+
+bool FlythroughPath::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "Failed to open flythrough path: " << path << std::endl;
+		return false;
+	}
+
+	points.clear();
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream lineStream(line);
+		std::string prefix;
+		lineStream >> prefix;
+
+		if (prefix == "duration") {
+			lineStream >> duration;
+		}
+		else if (prefix == "p") {
+			CameraPose pose;
+			lineStream >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >> pose.pitch;
+			points.push_back(pose);
+		}
+	}
+
+	if (points.size() < 2 || duration <= 0.0f) {
+		std::cerr << "Flythrough path needs at least 2 points and a positive duration: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool FlythroughPath::appendPose(const std::string& path, const CameraPose& pose) {
+	std::ofstream file(path, std::ios::app);
+	if (!file.is_open()) {
+		std::cerr << "Failed to open flythrough path for recording: " << path << std::endl;
+		return false;
+	}
+	file << "p " << pose.position.x << " " << pose.position.y << " " << pose.position.z
+		<< " " << pose.yaw << " " << pose.pitch << "\n";
+	return true;
+}
+
+CameraPose FlythroughPath::sample(float t) const {
+	t = std::max(0.0f, std::min(1.0f, t));
+	int segments = static_cast<int>(points.size()) - 1;
+	float scaled = t * segments;
+	int i = std::min(static_cast<int>(scaled), segments - 1);
+	float local = scaled - i;
+
+	// Endpoints are clamped, so the curve starts and ends exactly on the first/last point
+	const CameraPose& p0 = points[std::max(i - 1, 0)];
+	const CameraPose& p1 = points[i];
+	const CameraPose& p2 = points[i + 1];
+	const CameraPose& p3 = points[std::min(i + 2, segments)];
+
+	CameraPose pose;
+	pose.position = catmullRom(p0.position, p1.position, p2.position, p3.position, local);
+	pose.yaw = catmullRom(p0.yaw, p1.yaw, p2.yaw, p3.yaw, local);
+	pose.pitch = catmullRom(p0.pitch, p1.pitch, p2.pitch, p3.pitch, local);
+	return pose;
+}
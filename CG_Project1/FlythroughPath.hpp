@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct CameraPose {
+	glm::vec3 position;
+	float yaw;
+	float pitch;
+};
+
+// Camera path for deterministic benchmark runs. Poses are interpolated with a
+// Catmull-Rom spline so the camera moves smoothly through the control points.
+//
+// File format, one entry per line:
+//   duration <seconds>
+//   p <x> <y> <z> <yaw> <pitch>
+// Lines starting with '#' are comments.
+class FlythroughPath {
+public:
+	FlythroughPath();
+
+	bool load(const std::string& path);
+
+	// Appends a control point to a path file, used to record new paths in game
+	static bool appendPose(const std::string& path, const CameraPose& pose);
+
+	// t in [0, 1] over the whole path
+	CameraPose sample(float t) const;
+
+	float getDuration() const { return duration; }
+
+private:
+	std::vector<CameraPose> points;
+	float duration;
+};
@@ -2,15 +2,59 @@
 out vec4 FragColor;
 
 in vec2 TexCoord;
+#ifdef TEXTURED
 uniform sampler2D texture1;
+uniform float lodBias;  // Raised by the PerformanceGovernor to sample coarser mips
+#endif
 uniform vec3 color;
-uniform bool isCrosshair;
 
-void main()
+#ifdef LIT
+in vec3 ViewPos;
+in vec3 ViewNormal;
+
+uniform samplerBuffer lightData;      // 2 texels per light: view position + radius, color * intensity
+uniform usamplerBuffer clusterGrid;   // Per cluster: offset into lightIndices, light count
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterDims;
+uniform vec2 clusterScreenSize;
+uniform float clusterDepthScale;
+uniform float clusterDepthBias;
+uniform vec3 ambient;
+
+vec3 computeLighting()
 {
-    if (isCrosshair) {
-        FragColor = vec4(1.0, 0.0, 0.0, 1.0);  // Always red for crosshair
-    } else {
-        FragColor = texture(texture1, TexCoord);  // Use texture for other objects
+    vec3 normal = normalize(ViewNormal);
+    ivec3 dims = ivec3(clusterDims);
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterScreenSize * clusterDims.xy);
+    int slice = int(log(-ViewPos.z) * clusterDepthScale + clusterDepthBias);
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), dims - 1);
+
+    uvec2 range = texelFetch(clusterGrid, (cluster.z * dims.y + cluster.y) * dims.x + cluster.x).xy;
+    vec3 result = ambient;
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 positionRadius = texelFetch(lightData, light * 2);
+        vec3 lightColor = texelFetch(lightData, light * 2 + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - ViewPos;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - (distance * distance) / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+        float diffuse = max(dot(normal, toLight / max(distance, 0.0001)), 0.0);
+        result += lightColor * diffuse * falloff * falloff;
     }
-}
\ No newline at end of file
+    return result;
+}
+#endif
+
+void main()
+{
+#if defined(TEXTURED) && !defined(CROSSHAIR)
+    FragColor = texture(texture1, TexCoord, lodBias);
+#else
+    FragColor = vec4(color, 1.0);
+#endif
+
+#ifdef LIT
+    FragColor.rgb *= computeLighting();
+#endif
+}
@@ -0,0 +1,128 @@
+#include "FramePacer.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+
+namespace {
+	// Sleep granularity can be a few ms on some platforms, so stop sleeping this early and spin
+	const long long SPIN_MARGIN_NS = 2000000;
+}
+
+FramePacer::FramePacer()
+	: maxFramesInFlight(2)
+	, fpsCap(0.0f)
+	, fenceIndex(0)
+	, nextFrameNs(0)
+	, windowStartNs(CpuProfiler::now())
+	, sleepNs(0), spinNs(0), fenceWaitNs(0), windowFrames(0)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		fences[i] = nullptr;
+	}
+}
+
+FramePacer::~FramePacer() {
+	releaseFences();
+}
+
+void FramePacer::releaseFences() {
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (fences[i]) {
+			glDeleteSync(fences[i]);
+			fences[i] = nullptr;
+		}
+	}
+}
+
+void FramePacer::setMaxFramesInFlight(int frames) {
+	maxFramesInFlight = std::max(0, std::min(MAX_FRAMES_IN_FLIGHT, frames));
+	releaseFences();
+}
+
+void FramePacer::setFpsCap(float fps) {
+	fpsCap = std::max(0.0f, fps);
+	nextFrameNs = 0;
+}
+
+void FramePacer::waitForFrameStart() {
+	PROFILE_SCOPE("FramePacer::waitForFrameStart");
+	if (fpsCap <= 0.0f) return;
+
+	long long interval = static_cast<long long>(1000000000.0 / fpsCap);
+	long long now = CpuProfiler::now();
+
+	// Fell more than a frame behind (or first frame): restart the schedule instead of bursting
+	if (nextFrameNs == 0 || now - nextFrameNs > interval) {
+		nextFrameNs = now;
+	}
+
+	waitUntil(nextFrameNs);
+	nextFrameNs += interval;
+}
+
+void FramePacer::waitUntil(long long targetNs) {
+	long long now = CpuProfiler::now();
+	if (targetNs - now > SPIN_MARGIN_NS) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(targetNs - now - SPIN_MARGIN_NS));
+		long long afterSleep = CpuProfiler::now();
+		sleepNs += afterSleep - now;
+		now = afterSleep;
+	}
+
+	long long spinStart = now;
+	while (now < targetNs) {
+		std::this_thread::yield();
+		now = CpuProfiler::now();
+	}
+	spinNs += now - spinStart;
+}
+
+void FramePacer::afterSwap() {
+	PROFILE_SCOPE("FramePacer::afterSwap");
+	windowFrames++;
+	if (maxFramesInFlight == 0) return;
+
+	if (fences[fenceIndex]) glDeleteSync(fences[fenceIndex]);
+	fences[fenceIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// The fence from maxFramesInFlight - 1 swaps ago; with 1 frame in flight that is this frame's
+	int waitIndex = (fenceIndex - (maxFramesInFlight - 1) + MAX_FRAMES_IN_FLIGHT) % MAX_FRAMES_IN_FLIGHT;
+	fenceIndex = (fenceIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+
+	GLsync fence = fences[waitIndex];
+	if (!fence) return;
+
+	long long start = CpuProfiler::now();
+	glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);  // 100 ms safety timeout
+	fenceWaitNs += CpuProfiler::now() - start;
+
+	glDeleteSync(fence);
+	fences[waitIndex] = nullptr;
+}
+
+std::string FramePacer::takeReport(float inputLatencyMs) {
+	long long now = CpuProfiler::now();
+	double windowMs = (now - windowStartNs) / 1000000.0;
+	double frames = std::max(1, windowFrames);
+
+	// Sleeping is the only time the CPU is actually idle; spinning and fence waits may burn a core
+	double busyPercent = windowMs > 0.0 ? 100.0 * (1.0 - (sleepNs / 1000000.0) / windowMs) : 100.0;
+
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(2)
+		<< "frames in flight " << maxFramesInFlight
+		<< ", fps cap " << fpsCap
+		<< ": " << (windowFrames * 1000.0 / std::max(windowMs, 1.0)) << " fps"
+		<< ", CPU busy " << busyPercent << "%"
+		<< ", fence wait " << (fenceWaitNs / 1000000.0) / frames << " ms/frame"
+		<< ", spin " << (spinNs / 1000000.0) / frames << " ms/frame"
+		<< ", input latency " << inputLatencyMs << " ms";
+
+	windowStartNs = now;
+	sleepNs = spinNs = fenceWaitNs = 0;
+	windowFrames = 0;
+	return report.str();
+}
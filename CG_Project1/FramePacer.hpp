@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+
+// Frame pacing on top of the swap interval. A fence goes in after every swap, and the
+// CPU waits on the fence from N frames ago so the driver can never queue more than N
+// frames ahead. With vsync off or adaptive, an optional FPS cap sleeps most of the
+// remaining frame time and spins the last bit on the performance counter for precision.
+class FramePacer {
+public:
+	static const int MAX_FRAMES_IN_FLIGHT = 3;
+
+	FramePacer();
+	~FramePacer();
+
+	// 1..MAX_FRAMES_IN_FLIGHT, 0 leaves queuing up to the driver
+	void setMaxFramesInFlight(int frames);
+	int getMaxFramesInFlight() const { return maxFramesInFlight; }
+
+	// Frames per second, 0 for uncapped
+	void setFpsCap(float fps);
+	float getFpsCap() const { return fpsCap; }
+
+	// Call at the start of a frame, before input is read
+	void waitForFrameStart();
+
+	// Call right after the buffer swap
+	void afterSwap();
+
+	// Averages over the current reporting window, then resets it
+	std::string takeReport(float inputLatencyMs);
+
+private:
+	int maxFramesInFlight;
+	float fpsCap;
+
+	GLsync fences[MAX_FRAMES_IN_FLIGHT];
+	int fenceIndex;
+
+	long long nextFrameNs;
+
+	// Reporting window
+	long long windowStartNs;
+	long long sleepNs;
+	long long spinNs;
+	long long fenceWaitNs;
+	int windowFrames;
+
+	void releaseFences();
+	void waitUntil(long long targetNs);
+};
@@ -0,0 +1,119 @@
+#include "GpuProfiler.hpp"
+#include <iostream>
+
+const int GpuProfiler::FRAME_LATENCY;
+
+GpuProfiler::GpuProfiler()
+	: currentPool(0), frameNumber(0), droppedFrames(0), enabled(false), times(), results(), resultsFrame(0) {}
+
+GpuProfiler::~GpuProfiler() {
+	for (auto& pool : pools) {
+		if (!pool.queries.empty()) {
+			glDeleteQueries(static_cast<GLsizei>(pool.queries.size()), pool.queries.data());
+		}
+	}
+}
+
+bool GpuProfiler::openCsv(const std::string& path) {
+	csv.open(path);
+	if (!csv.is_open()) {
+		std::cerr << "Failed to open GPU profile CSV: " << path << std::endl;
+		return false;
+	}
+	csv << "frame,scope,depth,start_ms,duration_ms\n";
+	return true;
+}
+
+void GpuProfiler::beginFrame() {
+	if (!enabled) return;
+	FramePool& pool = pools[currentPool];
+
+	// This pool was last used FRAME_LATENCY frames ago; if the GPU still is not done with it
+	// the frame is dropped from the results instead of waiting
+	if (pool.pending && !resolve(pool)) {
+		droppedFrames++;
+	}
+
+	pool.scopes.clear();
+	pool.openScopes.clear();
+	pool.usedQueries = 0;
+	pool.frameNumber = frameNumber;
+	pool.pending = false;
+}
+
+void GpuProfiler::endFrame() {
+	if (!enabled) return;
+	FramePool& pool = pools[currentPool];
+	while (!pool.openScopes.empty()) {
+		endScope();
+	}
+	pool.pending = !pool.scopes.empty();
+
+	currentPool = (currentPool + 1) % FRAME_LATENCY;
+	frameNumber++;
+}
+
+void GpuProfiler::beginScope(const char* name) {
+	if (!enabled) return;
+	FramePool& pool = pools[currentPool];
+	Scope scope;
+	scope.name = name;
+	scope.depth = static_cast<int>(pool.openScopes.size());
+	scope.beginQuery = timestamp(pool);
+	scope.endQuery = -1;
+	pool.openScopes.push_back(static_cast<int>(pool.scopes.size()));
+	pool.scopes.push_back(scope);
+}
+
+void GpuProfiler::endScope() {
+	if (!enabled) return;
+	FramePool& pool = pools[currentPool];
+	if (pool.openScopes.empty()) return;
+	pool.scopes[pool.openScopes.back()].endQuery = timestamp(pool);
+	pool.openScopes.pop_back();
+}
+
+int GpuProfiler::timestamp(FramePool& pool) {
+	if (pool.usedQueries == static_cast<int>(pool.queries.size())) {
+		// Grow the pool; it settles at the frame's peak scope count after the first frames
+		size_t oldSize = pool.queries.size();
+		size_t newSize = oldSize == 0 ? 64 : oldSize * 2;
+		pool.queries.resize(newSize);
+		glGenQueries(static_cast<GLsizei>(newSize - oldSize), &pool.queries[oldSize]);
+	}
+
+	int index = pool.usedQueries++;
+	glQueryCounter(pool.queries[index], GL_TIMESTAMP);
+	return index;
+}
+
+bool GpuProfiler::resolve(FramePool& pool) {
+	// Queries complete in order, so the last one being ready means all of them are
+	GLint available = 0;
+	glGetQueryObjectiv(pool.queries[pool.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return false;
+
+	times.resize(pool.usedQueries);
+	for (int i = 0; i < pool.usedQueries; i++) {
+		glGetQueryObjectui64v(pool.queries[i], GL_QUERY_RESULT, &times[i]);
+	}
+
+	results.clear();
+	GLuint64 frameStart = times[pool.scopes.front().beginQuery];
+	for (const auto& scope : pool.scopes) {
+		GpuTiming timing;
+		timing.name = scope.name;
+		timing.depth = scope.depth;
+		timing.startMs = (times[scope.beginQuery] - frameStart) / 1000000.0;
+		timing.durationMs = (times[scope.endQuery] - times[scope.beginQuery]) / 1000000.0;
+		results.push_back(timing);
+
+		if (csv.is_open()) {
+			csv << pool.frameNumber << ',' << timing.name << ',' << timing.depth << ','
+				<< timing.startMs << ',' << timing.durationMs << '\n';
+		}
+	}
+	resultsFrame = pool.frameNumber;
+	pool.pending = false;
+	return true;
+}
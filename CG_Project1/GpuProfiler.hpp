@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <fstream>
+
+struct GpuTiming {
+	std::string name;
+	int depth;        // Nesting level, 0 for top-level passes
+	double startMs;   // Relative to the first scope of the frame
+	double durationMs;
+};
+
+// Per-scope GPU timings from GL_TIMESTAMP queries. Each frame records into its own query
+// pool; pools are recycled FRAME_LATENCY frames later, by which point the results are
+// normally available, so reading them back never stalls the CPU. Starts disabled, in which
+// case every call returns without issuing queries.
+class GpuProfiler {
+public:
+	static const int FRAME_LATENCY = 3;
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+
+	// Starts writing one CSV row per scope per resolved frame
+	bool openCsv(const std::string& path);
+
+	void beginFrame();
+	void endFrame();
+
+	// Scopes nest; name must stay valid until the frame's results are resolved
+	void beginScope(const char* name);
+	void endScope();
+
+	// Timings of the most recently resolved frame
+	const std::vector<GpuTiming>& getResults() const { return results; }
+	unsigned long long getResultsFrame() const { return resultsFrame; }
+
+	// Frames whose queries were still in flight when their pool came round again
+	unsigned long long getDroppedFrames() const { return droppedFrames; }
+	unsigned long long getProfiledFrames() const { return frameNumber; }
+
+private:
+	struct Scope {
+		const char* name;
+		int depth;
+		int beginQuery;
+		int endQuery;
+	};
+
+	struct FramePool {
+		std::vector<GLuint> queries;
+		std::vector<Scope> scopes;
+		std::vector<int> openScopes;
+		int usedQueries;
+		unsigned long long frameNumber;
+		bool pending;
+
+		FramePool() : queries(), scopes(), openScopes(), usedQueries(0), frameNumber(0), pending(false) {}
+	};
+
+	FramePool pools[FRAME_LATENCY];
+	int currentPool;
+	unsigned long long frameNumber;
+	unsigned long long droppedFrames;
+	bool enabled;
+
+	std::vector<GLuint64> times;  // Scratch for resolve, kept to avoid a per-frame allocation
+	std::vector<GpuTiming> results;
+	unsigned long long resultsFrame;
+	std::ofstream csv;
+
+	int timestamp(FramePool& pool);
+	bool resolve(FramePool& pool);
+};
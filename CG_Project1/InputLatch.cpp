@@ -0,0 +1,54 @@
+#include "InputLatch.hpp"
+#include "CpuProfiler.hpp"
+
+InputLatch::InputLatch()
+	: pendingX(0.0f), pendingY(0.0f)
+	, oldestSampleNs(-1), latchedSampleNs(-1)
+	, averageLatencyMs(0.0f) {}
+
+void InputLatch::handleEvent(const SDL_Event& event) {
+	if (event.type == SDL_MOUSEMOTION) {
+		accumulate(event.motion);
+	}
+}
+
+void InputLatch::accumulate(const SDL_MouseMotionEvent& motion) {
+	pendingX += static_cast<float>(motion.xrel);
+	pendingY += static_cast<float>(motion.yrel);
+	if (oldestSampleNs < 0) {
+		oldestSampleNs = CpuProfiler::now();
+	}
+}
+
+void InputLatch::latch(float& xrel, float& yrel) {
+	PROFILE_SCOPE("InputLatch::latch");
+
+	// Only motion is pulled here; everything else stays queued for next frame's poll
+	SDL_PumpEvents();
+	SDL_Event events[64];
+	int count;
+	while ((count = SDL_PeepEvents(events, 64, SDL_GETEVENT, SDL_MOUSEMOTION, SDL_MOUSEMOTION)) > 0) {
+		for (int i = 0; i < count; i++) {
+			accumulate(events[i].motion);
+		}
+	}
+
+	xrel = pendingX;
+	yrel = pendingY;
+	latchedSampleNs = oldestSampleNs;
+	pendingX = 0.0f;
+	pendingY = 0.0f;
+	oldestSampleNs = -1;
+}
+
+void InputLatch::markPresented(long long sampleNs) {
+	if (sampleNs < 0) return;
+
+	long long presentNs = CpuProfiler::now();
+	float latencyMs = static_cast<float>((presentNs - sampleNs) / 1000000.0);
+	averageLatencyMs = averageLatencyMs == 0.0f ? latencyMs : averageLatencyMs * 0.95f + latencyMs * 0.05f;
+
+	if (CpuProfiler::isRecording()) {
+		CpuProfiler::record("InputToPresent", sampleNs, presentNs);
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <SDL.h>
+
+// Late-latched mouse look. Motion from the regular event poll is accumulated, and latch()
+// pumps the OS queue once more right before the view matrix is built so the newest motion
+// still makes it into this frame. Each motion sample is timestamped when it is dequeued,
+// which gives an input-to-present latency per frame.
+class InputLatch {
+public:
+	InputLatch();
+
+	// Feed every polled event; only SDL_MOUSEMOTION is consumed
+	void handleEvent(const SDL_Event& event);
+
+	// Collects motion that arrived since the poll and returns the total for this frame
+	void latch(float& xrel, float& yrel);
+
+	// Dequeue time of the oldest sample in the last latch, -1 if there was no motion
+	long long getLatchedSampleNs() const { return latchedSampleNs; }
+
+	// Call right after the swap of the frame that used the given latch; may run on the render thread
+	void markPresented(long long sampleNs);
+
+	float getAverageLatencyMs() const { return averageLatencyMs; }
+
+private:
+	float pendingX;
+	float pendingY;
+	long long oldestSampleNs;   // Dequeue time of the oldest motion not yet latched, -1 if none
+	long long latchedSampleNs;  // Oldest motion that went into the last latch, -1 if none
+	float averageLatencyMs;
+
+	void accumulate(const SDL_MouseMotionEvent& motion);
+};
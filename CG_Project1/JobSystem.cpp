@@ -0,0 +1,264 @@
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+namespace {
+	// Power of two; a full deque runs new submissions inline instead of growing
+	const long long DEQUE_CAPACITY = 4096;
+	const long long DEQUE_MASK = DEQUE_CAPACITY - 1;
+
+	// Jobs are recycled round robin, skipping slots whose job has not been copied out yet.
+	// Twice the deque size, so a full deque plus the jobs being run still leaves free slots.
+	const size_t JOB_POOL_SIZE = 2 * DEQUE_CAPACITY;
+
+	// Failed steal rounds before an idle worker parks
+	const int IDLE_SPINS = 64;
+
+	thread_local const JobSystem* workerOwner = nullptr;
+	thread_local int workerIndex = -1;
+}
+
+// Chase-Lev deque after Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+// Models", with a fixed-size buffer.
+struct JobSystem::Worker {
+	std::atomic<long long> top;
+	std::atomic<long long> bottom;
+	std::unique_ptr<std::atomic<Job*>[]> buffer;
+
+	std::unique_ptr<Job[]> pool;
+	std::unique_ptr<std::atomic<bool>[]> poolBusy;
+	size_t nextPoolSlot;
+	unsigned int stealSeed;
+
+	explicit Worker(unsigned int seed)
+		: top(0), bottom(0), buffer(new std::atomic<Job*>[DEQUE_CAPACITY])
+		, pool(new Job[JOB_POOL_SIZE]), poolBusy(new std::atomic<bool>[JOB_POOL_SIZE]), nextPoolSlot(0), stealSeed(seed) {
+		for (size_t i = 0; i < JOB_POOL_SIZE; i++) poolBusy[i].store(false, std::memory_order_relaxed);
+	}
+
+	// Owner only. A slot stays busy from here until whichever thread runs the job has copied
+	// it, so a thief that stole it never reads a slot the owner is refilling. Null if every
+	// slot is still busy.
+	Job* allocate() {
+		for (size_t attempt = 0; attempt < JOB_POOL_SIZE; attempt++) {
+			size_t slot = nextPoolSlot++ & (JOB_POOL_SIZE - 1);
+			if (poolBusy[slot].load(std::memory_order_acquire)) continue;
+			poolBusy[slot].store(true, std::memory_order_relaxed);
+			pool[slot].slotBusy = &poolBusy[slot];
+			return &pool[slot];
+		}
+		return nullptr;
+	}
+
+	// Owner only
+	bool push(Job* job) {
+		long long b = bottom.load(std::memory_order_relaxed);
+		long long t = top.load(std::memory_order_acquire);
+		if (b - t >= DEQUE_CAPACITY) return false;
+
+		buffer[b & DEQUE_MASK].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only
+	Job* pop() {
+		long long b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = buffer[b & DEQUE_MASK].load(std::memory_order_relaxed);
+		if (t == b) {
+			// Last job: race the thieves for it
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				job = nullptr;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// Any thread
+	Job* steal() {
+		long long t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = bottom.load(std::memory_order_acquire);
+		if (t >= b) return nullptr;
+
+		Job* job = buffer[t & DEQUE_MASK].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return job;
+	}
+};
+
+JobSystem::JobSystem() : workers(), threads(), running(false), sleepingWorkers(0) {}
+
+JobSystem::~JobSystem() {
+	shutdown();
+}
+
+bool JobSystem::initialize(unsigned int workerCount) {
+	if (running) return true;
+
+	if (workerCount == 0) {
+		workerCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (unsigned int i = 0; i < workerCount; i++) {
+		workers.emplace_back(new Worker(i * 2654435761u + 1u));
+	}
+
+	// The calling thread is worker 0
+	workerOwner = this;
+	workerIndex = 0;
+	running = true;
+
+	try {
+		for (unsigned int i = 1; i < workerCount; i++) {
+			threads.emplace_back(&JobSystem::workerLoop, this, static_cast<int>(i));
+		}
+	}
+	catch (const std::system_error& e) {
+		std::cerr << "Failed to start job worker: " << e.what() << std::endl;
+		shutdown();
+		return false;
+	}
+	return true;
+}
+
+void JobSystem::shutdown() {
+	if (!running) return;
+
+	running = false;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeCondition.notify_all();
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+	workers.clear();
+
+	if (workerOwner == this) {
+		workerOwner = nullptr;
+		workerIndex = -1;
+	}
+}
+
+int JobSystem::currentWorker() const {
+	return workerOwner == this ? workerIndex : -1;
+}
+
+void JobSystem::submit(JobCounter& counter, JobFunction function, void* data, size_t begin, size_t end) {
+	counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+	int index = currentWorker();
+	if (index < 0) {
+		Job job = { function, data, begin, end, &counter, nullptr };
+		execute(job);
+		return;
+	}
+
+	Worker& worker = *workers[index];
+	Job* job = worker.allocate();
+	if (!job) {
+		Job direct = { function, data, begin, end, &counter, nullptr };
+		execute(direct);
+		return;
+	}
+	job->function = function;
+	job->data = data;
+	job->begin = begin;
+	job->end = end;
+	job->counter = &counter;
+
+	if (!worker.push(job)) {
+		execute(*job);
+		return;
+	}
+
+	if (sleepingWorkers.load(std::memory_order_relaxed) > 0) {
+		wakeCondition.notify_one();
+	}
+}
+
+void JobSystem::wait(JobCounter& counter) {
+	PROFILE_SCOPE("JobSystem::wait");
+	int index = currentWorker();
+	while (!counter.isDone()) {
+		Job* job = findJob(index);
+		if (job) {
+			execute(*job);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+Job* JobSystem::findJob(int index) {
+	if (index >= 0) {
+		Job* job = workers[index]->pop();
+		if (job) return job;
+	}
+
+	// Start at a pseudo-random victim so thieves spread out
+	size_t count = workers.size();
+	unsigned int seed = index >= 0 ? (workers[index]->stealSeed = workers[index]->stealSeed * 1664525u + 1013904223u) : 0u;
+	for (size_t i = 0; i < count; i++) {
+		size_t victim = (seed + i) % count;
+		if (static_cast<int>(victim) == index) continue;
+		Job* job = workers[victim]->steal();
+		if (job) return job;
+	}
+	return nullptr;
+}
+
+void JobSystem::execute(const Job& job) {
+	// Copy out first, then hand the pool slot back to its owner
+	Job local = job;
+	if (local.slotBusy) local.slotBusy->store(false, std::memory_order_release);
+	local.function(local.data, local.begin, local.end);
+	local.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerLoop(int index) {
+	workerOwner = this;
+	workerIndex = index;
+	CpuProfiler::setThreadName("Worker " + std::to_string(index));
+
+	int idleRounds = 0;
+	while (running.load(std::memory_order_relaxed)) {
+		Job* job = findJob(index);
+		if (job) {
+			execute(*job);
+			idleRounds = 0;
+			continue;
+		}
+
+		if (++idleRounds < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Park; the timeout covers a submit that raced with going to sleep
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+		wakeCondition.wait_for(lock, std::chrono::milliseconds(1));
+		sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+		idleRounds = 0;
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of outstanding jobs in a batch. Every submit increments it and every finished
+// job decrements it; JobSystem::wait() helps run jobs until it reaches zero.
+class JobCounter {
+public:
+	JobCounter() : pending(0) {}
+
+	bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> pending;
+};
+
+typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+struct Job {
+	JobFunction function;
+	void* data;
+	size_t begin;
+	size_t end;
+	JobCounter* counter;
+	std::atomic<bool>* slotBusy;  // Pool slot to free once the job is copied out; null if not pooled
+};
+
+// Work-stealing scheduler. Each worker owns a Chase-Lev deque: it pushes and pops its own
+// jobs LIFO at the bottom while idle workers steal FIFO from the top. The thread that
+// calls initialize() is worker 0 and runs jobs whenever it waits. Threads outside the
+// system (e.g. the render thread) run their submissions inline.
+class JobSystem {
+public:
+	JobSystem();
+	~JobSystem();
+
+	// workerCount 0 uses one worker per hardware thread, including the calling thread
+	bool initialize(unsigned int workerCount = 0);
+	void shutdown();
+
+	unsigned int getWorkerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+	// Queues function(data, begin, end); data must stay valid until the counter is waited on
+	void submit(JobCounter& counter, JobFunction function, void* data, size_t begin = 0, size_t end = 0);
+
+	// Runs jobs on this thread until every job counted by the counter has finished
+	void wait(JobCounter& counter);
+
+	// Queues task(); the task object must outlive the wait on the counter
+	template <typename Task>
+	void run(JobCounter& counter, Task& task) {
+		submit(counter, &invokeTask<Task>, &task);
+	}
+
+	// Calls body(begin, end) over [0, count) in chunks of at most grainSize and blocks until done
+	template <typename Body>
+	void parallelFor(size_t count, size_t grainSize, const Body& body) {
+		if (count == 0) return;
+		grainSize = std::max<size_t>(grainSize, 1);
+		if (count <= grainSize || workers.size() <= 1) {
+			body(static_cast<size_t>(0), count);
+			return;
+		}
+
+		JobCounter counter;
+		void* data = const_cast<void*>(static_cast<const void*>(&body));
+		for (size_t begin = 0; begin < count; begin += grainSize) {
+			submit(counter, &invokeRange<Body>, data, begin, std::min(begin + grainSize, count));
+		}
+		wait(counter);
+	}
+
+private:
+	struct Worker;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+	std::atomic<bool> running;
+
+	// Idle workers park here so an empty system does not burn cores
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	std::atomic<int> sleepingWorkers;
+
+	template <typename Task>
+	static void invokeTask(void* data, size_t, size_t) {
+		(*static_cast<Task*>(data))();
+	}
+
+	template <typename Body>
+	static void invokeRange(void* data, size_t begin, size_t end) {
+		(*static_cast<const Body*>(data))(begin, end);
+	}
+
+	int currentWorker() const;
+	Job* findJob(int workerIndex);
+	void execute(const Job& job);
+	void workerLoop(int workerIndex);
+};
@@ -0,0 +1,213 @@
+#include "LagCompensation.hpp"
+#include "MemoryUsage.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+const size_t LagCompensation::HISTORY_TICKS;
+
+namespace {
+	// Into [0, 360); stored yaws are not normalized and may be any number of turns off
+	float wrapYaw(float yaw) {
+		float wrapped = std::fmod(yaw, 360.0f);
+		return wrapped < 0.0f ? wrapped + 360.0f : wrapped;
+	}
+
+	// Along the shorter way round
+	float blendYaw(float from, float to, float t) {
+		from = wrapYaw(from);
+		float delta = wrapYaw(to) - from;
+		if (delta > 180.0f) delta -= 360.0f;
+		else if (delta < -180.0f) delta += 360.0f;
+		return from + delta * t;
+	}
+}
+
+LagCompensation::LagCompensation()
+	: positions(), yaws(), generations(), teams(), frameTicks(HISTORY_TICKS, 0), slotCapacity(0), newestTick(0), recorded(false) {
+	for (int team = 0; team < 2; team++) {
+		modelMin[team] = glm::vec3(0.0f);
+		modelMax[team] = glm::vec3(0.0f);
+		sphereHeight[team] = 0.0f;
+		sphereRadius[team] = 0.0f;
+	}
+}
+
+void LagCompensation::setCharacterBounds(CharacterStore::Team team, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	int index = static_cast<int>(team);
+	modelMin[index] = boundsMin;
+	modelMax[index] = boundsMax;
+
+	float horizontal = 0.0f;
+	for (float x : { boundsMin.x, boundsMax.x }) {
+		for (float z : { boundsMin.z, boundsMax.z }) horizontal = std::max(horizontal, std::sqrt(x * x + z * z));
+	}
+	float halfHeight = (boundsMax.y - boundsMin.y) * 0.5f;
+	sphereHeight[index] = (boundsMin.y + halfHeight) * CharacterStore::MODEL_SCALE;
+	sphereRadius[index] = std::sqrt(horizontal * horizontal + halfHeight * halfHeight) * CharacterStore::MODEL_SCALE;
+}
+
+void LagCompensation::growSlots(size_t slots) {
+	// Rare: only when a handle slot appears beyond every one seen so far. Frames are
+	// spread out to the new stride in place, last first.
+	size_t capacity = std::max(slots, slotCapacity * 2);
+	positions.resize(HISTORY_TICKS * capacity);
+	yaws.resize(HISTORY_TICKS * capacity);
+	generations.resize(HISTORY_TICKS * capacity);
+	teams.resize(HISTORY_TICKS * capacity);
+	for (size_t frame = HISTORY_TICKS; frame-- > 0;) {
+		for (size_t slot = capacity; slot-- > 0;) {
+			size_t to = frame * capacity + slot;
+			bool old = slot < slotCapacity;
+			size_t from = frame * slotCapacity + slot;
+			positions[to] = old ? positions[from] : glm::vec3(0.0f);
+			yaws[to] = old ? yaws[from] : 0.0f;
+			generations[to] = old ? generations[from] : 0;
+			teams[to] = old ? teams[from] : 0;
+		}
+	}
+	slotCapacity = capacity;
+}
+
+void LagCompensation::record(const CharacterStore& characters, uint32_t tick) {
+	PROFILE_SCOPE("LagCompensation::record");
+	size_t slots = 0;
+	for (size_t i = 0; i < characters.size(); i++) slots = std::max<size_t>(slots, characters.handleAt(i).index + 1);
+	if (slots > slotCapacity) growSlots(slots);
+
+	size_t frame = tick % HISTORY_TICKS;
+	size_t base = frame * slotCapacity;
+	std::fill(generations.begin() + base, generations.begin() + base + slotCapacity, 0u);
+
+	const glm::vec3* storePositions = characters.getPositions();
+	const float* storeYaws = characters.getYaws();
+	const CharacterStore::Team* storeTeams = characters.getTeams();
+	const uint8_t* flags = characters.getFlags();
+	for (size_t i = 0; i < characters.size(); i++) {
+		if (flags[i] & CharacterStore::FLAG_HIDDEN) continue;
+		EntityHandle handle = characters.handleAt(i);
+		size_t at = base + handle.index;
+		positions[at] = storePositions[i];
+		yaws[at] = storeYaws[i];
+		generations[at] = handle.generation + 1;
+		teams[at] = static_cast<uint8_t>(storeTeams[i]);
+	}
+	frameTicks[frame] = tick;
+	newestTick = tick;
+	recorded = true;
+}
+
+uint32_t LagCompensation::getOldestTick() const {
+	uint32_t oldest = newestTick >= HISTORY_TICKS - 1 ? newestTick - static_cast<uint32_t>(HISTORY_TICKS - 1) : 0;
+	// Skip frames not yet written after the first ticks or a gap in recording
+	while (oldest < newestTick && frameTicks[oldest % HISTORY_TICKS] != oldest) oldest++;
+	return oldest;
+}
+
+double LagCompensation::clampTick(double tick) const {
+	return std::min(std::max(tick, static_cast<double>(getOldestTick())), static_cast<double>(newestTick));
+}
+
+void LagCompensation::findFrames(double tick, size_t& from, size_t& to, float& t) const {
+	double clamped = clampTick(tick);
+	uint32_t whole = static_cast<uint32_t>(clamped);
+	from = whole % HISTORY_TICKS;
+	to = whole < newestTick ? (whole + 1) % HISTORY_TICKS : from;
+	t = static_cast<float>(clamped - whole);
+}
+
+bool LagCompensation::blendSlot(size_t slot, size_t from, size_t to, float t, glm::vec3& position, float& yaw) const {
+	size_t a = from * slotCapacity + slot;
+	if (generations[a] == 0) return false;
+	position = positions[a];
+	yaw = yaws[a];
+
+	// A character gone or replaced by the next frame stays where it was last
+	size_t b = to * slotCapacity + slot;
+	if (generations[b] == generations[a]) {
+		position = glm::mix(position, positions[b], t);
+		yaw = blendYaw(yaw, yaws[b], t);
+	}
+	return true;
+}
+
+bool LagCompensation::raycast(double tick, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, EntityHandle shooter, RayHit& hit) const {
+	PROFILE_SCOPE("LagCompensation::raycast");
+	float length = glm::length(direction);
+	if (!recorded || length < 1e-12f) return false;
+	glm::vec3 unit = direction / length;
+
+	size_t from, to;
+	float t;
+	findFrames(tick, from, to, t);
+
+	bool found = false;
+	float limit = maxDistance;
+	const uint32_t* fromGenerations = &generations[from * slotCapacity];
+	for (size_t slot = 0; slot < slotCapacity; slot++) {
+		if (fromGenerations[slot] == 0) continue;
+		if (slot == shooter.index && fromGenerations[slot] == shooter.generation + 1) continue;
+
+		// Yaw is only blended for characters past the broad phase
+		size_t a = from * slotCapacity + slot;
+		size_t b = to * slotCapacity + slot;
+		bool moving = generations[b] == generations[a];
+		glm::vec3 position = moving ? glm::mix(positions[a], positions[b], t) : positions[a];
+		int team = teams[a];
+		const glm::vec3& boxMin = modelMin[team];
+		const glm::vec3& boxMax = modelMax[team];
+
+		// Bounding sphere first, which rejects most characters before any trigonometry
+		float radius = sphereRadius[team];
+		glm::vec3 toCenter = position + glm::vec3(0.0f, sphereHeight[team], 0.0f) - origin;
+		float along = glm::dot(toCenter, unit);
+		float offAxisSquared = glm::dot(toCenter, toCenter) - along * along;
+		if (offAxisSquared > radius * radius || along + radius < 0.0f || along - radius > limit) continue;
+
+		// Into the model's space: undo translation, yaw and scale; distances stay in world units
+		float radians = glm::radians(moving ? blendYaw(yaws[a], yaws[b], t) : yaws[a]);
+		float c = std::cos(radians), s = std::sin(radians);
+		glm::vec3 offset = (origin - position) / CharacterStore::MODEL_SCALE;
+		glm::vec3 localOrigin(c * offset.x - s * offset.z, offset.y, s * offset.x + c * offset.z);
+		glm::vec3 localDirection = glm::vec3(c * unit.x - s * unit.z, unit.y, s * unit.x + c * unit.z) / CharacterStore::MODEL_SCALE;
+
+		float tNear = -1e30f;
+		float tFar = 1e30f;
+		bool outside = false;
+		for (int axis = 0; axis < 3 && !outside; axis++) {
+			if (std::fabs(localDirection[axis]) < 1e-12f) {
+				outside = localOrigin[axis] < boxMin[axis] || localOrigin[axis] > boxMax[axis];
+				continue;
+			}
+			float inverseDirection = 1.0f / localDirection[axis];
+			float t0 = (boxMin[axis] - localOrigin[axis]) * inverseDirection;
+			float t1 = (boxMax[axis] - localOrigin[axis]) * inverseDirection;
+			tNear = std::max(tNear, std::min(t0, t1));
+			tFar = std::min(tFar, std::max(t0, t1));
+		}
+		if (outside || tNear > tFar || tNear <= 0.0f || tNear >= limit) continue;
+
+		found = true;
+		limit = tNear;
+		hit.distance = tNear;
+		hit.materialIndex = RayHit::NO_MATERIAL;
+		hit.character = EntityHandle(static_cast<uint32_t>(slot), fromGenerations[slot] - 1);
+	}
+
+	if (found) hit.position = origin + unit * hit.distance;
+	return found;
+}
+
+bool LagCompensation::samplePosition(EntityHandle handle, double tick, glm::vec3& out) const {
+	if (!recorded || handle.index >= slotCapacity) return false;
+	size_t from, to;
+	float t;
+	findFrames(tick, from, to, t);
+	if (generations[from * slotCapacity + handle.index] != handle.generation + 1) return false;
+	float yaw;
+	return blendSlot(handle.index, from, to, t, out, yaw);
+}
+
+size_t LagCompensation::getMemoryUsage() const {
+	return vectorBytes(positions) + vectorBytes(yaws) + vectorBytes(generations) + vectorBytes(teams) + vectorBytes(frameTicks);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CharacterStore.hpp"
+#include "SceneQuery.hpp"
+
+// Where every character stood over the last HISTORY_TICKS ticks, so a shot can be checked
+// against the world its shooter saw rather than the one the server has moved on to. Each
+// tick records a frame of feet, yaw, generation and team for every handle slot, each field
+// in its own array, into a fixed ring of frames; a character's history is its slot's column
+// through the ring. Rewinding to a time reads the two frames around it and blends each
+// character between them, then tests the ray against the oriented boxes it gives, the same
+// boxes SceneQuery uses. A rewind costs the same however far back it goes, and requests
+// beyond the ring are clamped to its oldest frame.
+class LagCompensation {
+public:
+	// Half a second at 64 Hz
+	static const size_t HISTORY_TICKS = 32;
+
+	LagCompensation();
+
+	// Model-space box per team, usually SceneQuery's
+	void setCharacterBounds(CharacterStore::Team team, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	// Takes this tick's frame; ticks are expected to count up by one. Hidden characters are left out.
+	void record(const CharacterStore& characters, uint32_t tick);
+
+	bool hasHistory() const { return recorded; }
+	uint32_t getNewestTick() const { return newestTick; }
+	uint32_t getOldestTick() const;
+	// The tick a rewind to this time really uses, after clamping to the history
+	double clampTick(double tick) const;
+
+	// Closest character the ray hits with everyone placed where they were at the fractional
+	// tick; the shooter is never hit. Distances are in world units along the normalized direction.
+	bool raycast(double tick, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, EntityHandle shooter, RayHit& hit) const;
+
+	// Feet of one character at the fractional tick; false if it was not there
+	bool samplePosition(EntityHandle handle, double tick, glm::vec3& out) const;
+
+	size_t getMemoryUsage() const;  // Heap bytes held
+
+private:
+	glm::vec3 modelMin[2];
+	glm::vec3 modelMax[2];
+	// World-space sphere around the feet axis that holds the box at any yaw, so the broad
+	// phase needs no rotation: its height above the feet and its radius
+	float sphereHeight[2];
+	float sphereRadius[2];
+
+	// Frame f, slot s at f * slotCapacity + s
+	std::vector<glm::vec3> positions;
+	std::vector<float> yaws;
+	std::vector<uint32_t> generations;  // Handle generation + 1; 0 when no character held the slot
+	std::vector<uint8_t> teams;
+	std::vector<uint32_t> frameTicks;
+	size_t slotCapacity;
+	uint32_t newestTick;
+	bool recorded;
+
+	void growSlots(size_t slots);
+	// The two frames around a clamped tick and the blend between them
+	void findFrames(double tick, size_t& from, size_t& to, float& t) const;
+	// Feet and yaw of a slot blended between two frames; false if it was empty in the first
+	bool blendSlot(size_t slot, size_t from, size_t to, float t, glm::vec3& position, float& yaw) const;
+};
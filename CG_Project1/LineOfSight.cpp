@@ -0,0 +1,124 @@
+#include "LineOfSight.hpp"
+#include "MapBVH.hpp"
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
+#include <algorithm>
+
+namespace {
+	// Rows get shorter towards the end of the triangle, so keep jobs small and let stealing balance them
+	const size_t ROW_GRAIN = 4;
+}
+
+LineOfSight::LineOfSight(const MapBVH& map)
+	: map(map), eyes(), handles(), moved(), pairs(), visibility(), rowTraced(), wordsPerRow(0)
+	, moveTolerance(0.001f), lastTracedPairs(0), lastCachedPairs(0) {}
+
+void LineOfSight::update(const CharacterStore& characters, JobSystem* jobs) {
+	PROFILE_SCOPE("LineOfSight::update");
+	size_t count = characters.size();
+
+	if (count != eyes.size()) {
+		wordsPerRow = (count + 63) / 64;
+		eyes.assign(count, glm::vec3(0.0f));
+		handles.clear();
+		pairs.assign(count * wordsPerRow, 0);
+		visibility.assign(count * wordsPerRow, 0);
+	}
+	handles.resize(count);
+	moved.resize(count);
+
+	const glm::vec3* positions = characters.getPositions();
+	float toleranceSquared = moveTolerance * moveTolerance;
+	bool anyMoved = false;
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 eye = positions[i] + glm::vec3(0.0f, CharacterStore::EYE_HEIGHT, 0.0f);
+		EntityHandle handle = characters.handleAt(i);
+		glm::vec3 offset = eye - eyes[i];
+		moved[i] = handles[i] != handle || glm::dot(offset, offset) > toleranceSquared;
+		if (moved[i]) {
+			eyes[i] = eye;
+			handles[i] = handle;
+			anyMoved = true;
+		}
+	}
+
+	size_t pairCount = count > 1 ? count * (count - 1) / 2 : 0;
+	lastTracedPairs = 0;
+	lastCachedPairs = pairCount;
+	if (!anyMoved) return;
+
+	rowTraced.assign(count, 0);
+	if (jobs) {
+		jobs->parallelFor(count, ROW_GRAIN, [this](size_t begin, size_t end) {
+			for (size_t row = begin; row < end; row++) traceRow(row);
+		});
+		jobs->parallelFor(count, ROW_GRAIN * 4, [this](size_t begin, size_t end) {
+			for (size_t row = begin; row < end; row++) mirrorRow(row);
+		});
+	} else {
+		for (size_t row = 0; row < count; row++) traceRow(row);
+		for (size_t row = 0; row < count; row++) mirrorRow(row);
+	}
+
+	for (uint32_t traced : rowTraced) lastTracedPairs += traced;
+	lastCachedPairs = pairCount - lastTracedPairs;
+}
+
+void LineOfSight::traceRow(size_t row) {
+	const glm::vec3& origin = eyes[row];
+	uint64_t* bits = &pairs[row * wordsPerRow];
+	size_t count = eyes.size();
+
+	MapBVH::RayPacket packet;
+	packet.count = 0;
+	size_t targets[8];
+	uint32_t traced = 0;
+
+	for (size_t column = row + 1; column <= count; column++) {
+		// Queue the pair if either end moved; trace once the packet is full or the row is done
+		if (column < count && (moved[row] || moved[column])) {
+			glm::vec3 delta = eyes[column] - origin;
+			float distance = glm::length(delta);
+			if (distance < 1e-4f) {
+				bits[column / 64] |= 1ull << (column % 64);
+			} else {
+				int lane = packet.count++;
+				for (int axis = 0; axis < 3; axis++) {
+					packet.origin[axis][lane] = origin[axis];
+					packet.direction[axis][lane] = delta[axis] / distance;
+				}
+				packet.maxDistance[lane] = distance;
+				targets[lane] = column;
+			}
+		}
+
+		if (packet.count == 8 || (column == count && packet.count > 0)) {
+			uint32_t blocked = map.occluded(packet);
+			for (int lane = 0; lane < packet.count; lane++) {
+				uint64_t bit = 1ull << (targets[lane] % 64);
+				if (blocked & (1u << lane)) bits[targets[lane] / 64] &= ~bit;
+				else bits[targets[lane] / 64] |= bit;
+			}
+			traced += packet.count;
+			packet.count = 0;
+		}
+	}
+	rowTraced[row] = traced;
+}
+
+void LineOfSight::mirrorRow(size_t row) {
+	// Pairs above the diagonal come from this row, the ones below from the other rows
+	uint64_t* out = &visibility[row * wordsPerRow];
+	std::copy(&pairs[row * wordsPerRow], &pairs[row * wordsPerRow] + wordsPerRow, out);
+
+	uint64_t rowBit = 1ull << (row % 64);
+	size_t rowWord = row / 64;
+	for (size_t other = 0; other < row; other++) {
+		if (pairs[other * wordsPerRow + rowWord] & rowBit) out[other / 64] |= 1ull << (other % 64);
+	}
+}
+
+size_t LineOfSight::getMemoryUsage() const {
+	return vectorBytes(eyes) + vectorBytes(handles) + vectorBytes(moved) + vectorBytes(pairs) + vectorBytes(visibility) + vectorBytes(rowTraced);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CharacterStore.hpp"
+
+class MapBVH;
+class JobSystem;
+
+// Which characters can see each other through the map, recomputed once per tick for every
+// pair. Each character's rays to the others share its eye as origin, so they are traced as
+// coherent 8-ray packets, and rows are spread across the job system. Pairs where neither
+// eye moved since they were last traced keep their previous answer.
+class LineOfSight {
+public:
+	explicit LineOfSight(const MapBVH& map);
+
+	// Brings the matrix up to date with the store's current eye positions. Rows follow the
+	// store's dense order: a row whose entity moved or changed (destroy fills holes from the
+	// back) is traced again, and a different character count starts over.
+	void update(const CharacterStore& characters, JobSystem* jobs = nullptr);
+
+	// Dense store indices as of the last update
+	bool canSee(size_t from, size_t to) const {
+		return (visibility[from * wordsPerRow + to / 64] >> (to % 64)) & 1;
+	}
+
+	// Visibility bitset of one character, wordsPerRow 64-bit words; bit j is character j
+	const uint64_t* getRow(size_t index) const { return &visibility[index * wordsPerRow]; }
+	size_t getWordsPerRow() const { return wordsPerRow; }
+	size_t size() const { return eyes.size(); }
+	size_t getMemoryUsage() const;  // Heap bytes held
+
+	// Eyes closer together than this to their last traced position count as not moved
+	void setMoveTolerance(float tolerance) { moveTolerance = tolerance; }
+
+	// Forgets every cached pair, e.g. after the map changed
+	void invalidate() { handles.clear(); }
+
+	size_t getLastTracedPairs() const { return lastTracedPairs; }
+	size_t getLastCachedPairs() const { return lastCachedPairs; }
+
+private:
+	const MapBVH& map;
+
+	std::vector<glm::vec3> eyes;         // Eye each row was last traced from
+	std::vector<EntityHandle> handles;   // Who owned each row at the last update
+	std::vector<uint8_t> moved;
+	std::vector<uint64_t> pairs;         // Row i holds j > i only, written by one job per row
+	std::vector<uint64_t> visibility;    // Symmetric, built from pairs
+	std::vector<uint32_t> rowTraced;     // Rays traced by each row's job
+	size_t wordsPerRow;
+	float moveTolerance;
+
+	size_t lastTracedPairs;
+	size_t lastCachedPairs;
+
+	void traceRow(size_t row);
+	void mirrorRow(size_t row);
+};
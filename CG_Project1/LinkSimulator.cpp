@@ -0,0 +1,33 @@
+#include "LinkSimulator.hpp"
+#include <algorithm>
+
+LinkSimulator::LinkSimulator(unsigned int seed)
+	: settings(), rng(seed), held(), due(), submitted(0), dropped(0) {}
+
+void LinkSimulator::submit(const Datagram& datagram, long long nowNs) {
+	submitted++;
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	if (settings.lossPercent > 0.0f && unit(rng) * 100.0f < settings.lossPercent) {
+		dropped++;
+		return;
+	}
+
+	// Held in the order they fall due, which jitter may reshuffle
+	float delayMs = settings.latencyMs + settings.jitterMs * unit(rng);
+	Held entry;
+	entry.dueNs = nowNs + static_cast<long long>(delayMs * 1000000.0f);
+	entry.datagram = datagram;
+	auto position = std::upper_bound(held.begin(), held.end(), entry.dueNs, [](long long dueNs, const Held& other) { return dueNs < other.dueNs; });
+	held.insert(position, entry);
+}
+
+size_t LinkSimulator::flush(UdpSocket& socket, long long nowNs) {
+	size_t count = 0;
+	while (count < held.size() && held[count].dueNs <= nowNs) count++;
+	if (count == 0) return 0;
+
+	due.clear();
+	for (size_t i = 0; i < count; i++) due.push_back(held[i].datagram);
+	held.erase(held.begin(), held.begin() + count);
+	return socket.send(due.data(), due.size());
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "UdpSocket.hpp"
+
+struct LinkSettings {
+	float lossPercent;  // Chance each datagram is dropped
+	float latencyMs;    // One way
+	float jitterMs;     // Added to the latency, uniformly up to this much, so datagrams can arrive out of order
+
+	LinkSettings() : lossPercent(0.0f), latencyMs(0.0f), jitterMs(0.0f) {}
+	LinkSettings(float lossPercent, float latencyMs, float jitterMs) : lossPercent(lossPercent), latencyMs(latencyMs), jitterMs(jitterMs) {}
+};
+
+// Stands between a sender and its socket to make a perfect loopback behave like a bad
+// network: datagrams are dropped, held back for the latency plus jitter and then sent in
+// one batch. With default settings everything goes out on the next flush. Time is passed
+// in rather than read, so tests can run a simulated clock as fast as they like.
+class LinkSimulator {
+public:
+	explicit LinkSimulator(unsigned int seed = 1);
+
+	void setSettings(const LinkSettings& settings) { this->settings = settings; }
+	const LinkSettings& getSettings() const { return settings; }
+
+	void submit(const Datagram& datagram, long long nowNs);
+	// Sends everything that is due; returns how many went out
+	size_t flush(UdpSocket& socket, long long nowNs);
+
+	size_t getSubmitted() const { return submitted; }
+	size_t getDropped() const { return dropped; }
+	size_t getHeldBack() const { return held.size(); }
+
+private:
+	struct Held {
+		long long dueNs;
+		Datagram datagram;
+	};
+
+	LinkSettings settings;
+	std::mt19937 rng;
+	std::vector<Held> held;
+	std::vector<Datagram> due;
+
+	size_t submitted;
+	size_t dropped;
+};
@@ -0,0 +1,39 @@
+#include "MapAssets.hpp"
+#include "CpuProfiler.hpp"
+#include <iostream>
+
+namespace {
+	const char* CT_MODEL_PATH = "Assets/Players/CT/CT.obj";
+	const char* T_MODEL_PATH = "Assets/Players/T/T.obj";
+}
+
+MapAssets::MapAssets() : mapLoader(), ctModelLoader(), tModelLoader(), bvh(), navMesh() {}
+
+bool MapAssets::load(const std::string& mapPath) {
+	PROFILE_SCOPE("MapAssets::load");
+
+	if (!mapLoader.loadOBJ(mapPath)) {
+		std::cerr << "Failed to load map model." << std::endl;
+		return false;
+	}
+	if (!ctModelLoader.loadOBJ(CT_MODEL_PATH) || !tModelLoader.loadOBJ(T_MODEL_PATH)) {
+		std::cerr << "Failed to load character models." << std::endl;
+		return false;
+	}
+	if (!bvh.build(mapLoader)) {
+		std::cerr << "Failed to build map collision." << std::endl;
+		return false;
+	}
+
+	std::string navMeshPath = mapPath.substr(0, mapPath.find_last_of('.')) + ".navmesh";
+	if (!navMesh.loadOrBuild(mapLoader, navMeshPath)) {
+		std::cerr << "Failed to build navmesh." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+size_t MapAssets::getMemoryUsage() const {
+	return mapLoader.getMemoryUsage() + ctModelLoader.getMemoryUsage() + tModelLoader.getMemoryUsage()
+		+ bvh.getMemoryUsage() + navMesh.getMemoryUsage();
+}
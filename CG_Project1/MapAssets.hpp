@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "OBJLoader.hpp"
+#include "MapBVH.hpp"
+#include "NavMesh.hpp"
+
+// The parts of a map that a match only ever reads: the parsed geometry, the character models
+// hitscan tests against, the collision BVH and the navmesh. Loaded once per process and
+// handed out const, so any number of matches can share them across threads without locks.
+class MapAssets {
+public:
+	MapAssets();
+
+	MapAssets(const MapAssets&) = delete;
+	MapAssets& operator=(const MapAssets&) = delete;
+
+	// Geometry only, no textures; the navmesh is cached next to the map
+	bool load(const std::string& mapPath);
+
+	const OBJLoader& getMap() const { return mapLoader; }
+	const OBJLoader& getCtModel() const { return ctModelLoader; }
+	const OBJLoader& getTModel() const { return tModelLoader; }
+	const MapBVH& getBvh() const { return bvh; }
+	const NavMesh& getNavMesh() const { return navMesh; }
+
+	size_t getMemoryUsage() const;  // Heap bytes held
+
+private:
+	OBJLoader mapLoader;
+	OBJLoader ctModelLoader;
+	OBJLoader tModelLoader;
+	MapBVH bvh;
+	NavMesh navMesh;
+};
@@ -0,0 +1,671 @@
+#include "MapBVH.hpp"
+#include "OBJLoader.hpp"
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define MAP_BVH_SSE 1
+
+#if defined(_MSC_VER)
+#define MAP_BVH_AVX2_TARGET
+#define MAP_BVH_AVX2 1
+#elif defined(__GNUC__)
+#define MAP_BVH_AVX2_TARGET __attribute__((target("avx2,fma")))
+#define MAP_BVH_AVX2 1
+#endif
+#endif
+
+const int MapBVH::MAX_DEPTH;
+
+namespace {
+	const int BIN_COUNT = 16;
+	const uint32_t MAX_LEAF_TRIANGLES = 8;
+
+	// SAH costs relative to one node visit. Leaves are tested 8 triangles at a time, so
+	// they are priced per packet rather than per triangle, which favors full leaves.
+	const float TRAVERSAL_COST = 1.0f;
+	const float PACKET_COST = 1.5f;
+
+	uint32_t packetCount(uint32_t triangleCount) {
+		return (triangleCount + 7) / 8;
+	}
+
+	struct Bounds {
+		glm::vec3 min;
+		glm::vec3 max;
+
+		Bounds() : min(1e30f), max(-1e30f) {}
+
+		void grow(const glm::vec3& point) {
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+
+		void grow(const Bounds& other) {
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		// Half the surface area, which is all the heuristic needs
+		float area() const {
+			glm::vec3 extent = max - min;
+			if (extent.x < 0.0f) return 0.0f;
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	float nodeArea(const MapBVH::Node& node) {
+		glm::vec3 extent = node.boundsMax - node.boundsMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	// Below this the triangle is edge-on to the ray, or a padding lane
+	const float DETERMINANT_EPSILON = 1e-10f;
+
+	// Hits closer than this to the origin are ignored so rays leaving a surface don't hit it
+	const float MIN_HIT_DISTANCE = 1e-5f;
+
+	// ray is origin xyz then unit direction xyz. Returns a bit per lane hit in
+	// (MIN_HIT_DISTANCE, maxDistance) and writes those lanes' distances.
+	typedef uint32_t (*PacketTest)(const MapBVH::TrianglePacket& packet, const float* ray, float maxDistance, float* distances);
+
+	// Moller-Trumbore, one lane at a time
+	uint32_t intersectPacketScalar(const MapBVH::TrianglePacket& packet, const float* ray, float maxDistance, float* distances) {
+		uint32_t mask = 0;
+		for (int lane = 0; lane < 8; lane++) {
+			float e1x = packet.e1[0][lane], e1y = packet.e1[1][lane], e1z = packet.e1[2][lane];
+			float e2x = packet.e2[0][lane], e2y = packet.e2[1][lane], e2z = packet.e2[2][lane];
+
+			float px = ray[4] * e2z - ray[5] * e2y;
+			float py = ray[5] * e2x - ray[3] * e2z;
+			float pz = ray[3] * e2y - ray[4] * e2x;
+			float determinant = e1x * px + e1y * py + e1z * pz;
+			if (std::fabs(determinant) < DETERMINANT_EPSILON) continue;
+			float inverse = 1.0f / determinant;
+
+			float tx = ray[0] - packet.v0[0][lane];
+			float ty = ray[1] - packet.v0[1][lane];
+			float tz = ray[2] - packet.v0[2][lane];
+			float u = (tx * px + ty * py + tz * pz) * inverse;
+			if (u < 0.0f || u > 1.0f) continue;
+
+			float qx = ty * e1z - tz * e1y;
+			float qy = tz * e1x - tx * e1z;
+			float qz = tx * e1y - ty * e1x;
+			float v = (ray[3] * qx + ray[4] * qy + ray[5] * qz) * inverse;
+			if (v < 0.0f || u + v > 1.0f) continue;
+
+			float t = (e2x * qx + e2y * qy + e2z * qz) * inverse;
+			if (t > MIN_HIT_DISTANCE && t < maxDistance) {
+				distances[lane] = t;
+				mask |= 1u << lane;
+			}
+		}
+		return mask;
+	}
+
+#ifdef MAP_BVH_SSE
+	// The same test on four lanes starting at offset
+	uint32_t intersectHalfSse(const MapBVH::TrianglePacket& packet, int offset, const float* ray, float maxDistance, float* distances) {
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 dx = _mm_set1_ps(ray[3]), dy = _mm_set1_ps(ray[4]), dz = _mm_set1_ps(ray[5]);
+		__m128 e1x = _mm_loadu_ps(packet.e1[0] + offset), e1y = _mm_loadu_ps(packet.e1[1] + offset), e1z = _mm_loadu_ps(packet.e1[2] + offset);
+		__m128 e2x = _mm_loadu_ps(packet.e2[0] + offset), e2y = _mm_loadu_ps(packet.e2[1] + offset), e2z = _mm_loadu_ps(packet.e2[2] + offset);
+
+		__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+		__m128 valid = _mm_cmpge_ps(_mm_andnot_ps(signMask, determinant), _mm_set1_ps(DETERMINANT_EPSILON));
+		__m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+		__m128 tx = _mm_sub_ps(_mm_set1_ps(ray[0]), _mm_loadu_ps(packet.v0[0] + offset));
+		__m128 ty = _mm_sub_ps(_mm_set1_ps(ray[1]), _mm_loadu_ps(packet.v0[1] + offset));
+		__m128 tz = _mm_sub_ps(_mm_set1_ps(ray[2]), _mm_loadu_ps(packet.v0[2] + offset));
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverse);
+
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverse);
+		__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+
+		const __m128 zero = _mm_setzero_ps();
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+		valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+		valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, _mm_set1_ps(MIN_HIT_DISTANCE)));
+		valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(maxDistance)));
+
+		_mm_storeu_ps(distances + offset, t);
+		return static_cast<uint32_t>(_mm_movemask_ps(valid)) << offset;
+	}
+
+	uint32_t intersectPacketSse(const MapBVH::TrianglePacket& packet, const float* ray, float maxDistance, float* distances) {
+		return intersectHalfSse(packet, 0, ray, maxDistance, distances) | intersectHalfSse(packet, 4, ray, maxDistance, distances);
+	}
+
+#ifdef MAP_BVH_AVX2
+	// All eight lanes at once
+	MAP_BVH_AVX2_TARGET
+	uint32_t intersectPacketAvx(const MapBVH::TrianglePacket& packet, const float* ray, float maxDistance, float* distances) {
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		__m256 dx = _mm256_set1_ps(ray[3]), dy = _mm256_set1_ps(ray[4]), dz = _mm256_set1_ps(ray[5]);
+		__m256 e1x = _mm256_loadu_ps(packet.e1[0]), e1y = _mm256_loadu_ps(packet.e1[1]), e1z = _mm256_loadu_ps(packet.e1[2]);
+		__m256 e2x = _mm256_loadu_ps(packet.e2[0]), e2y = _mm256_loadu_ps(packet.e2[1]), e2z = _mm256_loadu_ps(packet.e2[2]);
+
+		__m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+		__m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+		__m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+		__m256 determinant = _mm256_fmadd_ps(e1z, pz, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1x, px)));
+		__m256 valid = _mm256_cmp_ps(_mm256_andnot_ps(signMask, determinant), _mm256_set1_ps(DETERMINANT_EPSILON), _CMP_GE_OQ);
+		__m256 inverse = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+		__m256 tx = _mm256_sub_ps(_mm256_set1_ps(ray[0]), _mm256_loadu_ps(packet.v0[0]));
+		__m256 ty = _mm256_sub_ps(_mm256_set1_ps(ray[1]), _mm256_loadu_ps(packet.v0[1]));
+		__m256 tz = _mm256_sub_ps(_mm256_set1_ps(ray[2]), _mm256_loadu_ps(packet.v0[2]));
+		__m256 u = _mm256_mul_ps(_mm256_fmadd_ps(tz, pz, _mm256_fmadd_ps(ty, py, _mm256_mul_ps(tx, px))), inverse);
+
+		__m256 qx = _mm256_fmsub_ps(ty, e1z, _mm256_mul_ps(tz, e1y));
+		__m256 qy = _mm256_fmsub_ps(tz, e1x, _mm256_mul_ps(tx, e1z));
+		__m256 qz = _mm256_fmsub_ps(tx, e1y, _mm256_mul_ps(ty, e1x));
+		__m256 v = _mm256_mul_ps(_mm256_fmadd_ps(dz, qz, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dx, qx))), inverse);
+		__m256 t = _mm256_mul_ps(_mm256_fmadd_ps(e2z, qz, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2x, qx))), inverse);
+
+		const __m256 zero = _mm256_setzero_ps();
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(MIN_HIT_DISTANCE), _CMP_GT_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(maxDistance), _CMP_LT_OQ));
+
+		_mm256_storeu_ps(distances, t);
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(valid));
+		_mm256_zeroupper();
+		return mask;
+	}
+
+	// Any-hit traversal of 8 rays at once: boxes are tested against all rays in one pass,
+	// and each leaf triangle against every ray still live in that subtree
+	MAP_BVH_AVX2_TARGET
+	uint32_t occludedPacketAvx(const std::vector<MapBVH::Node>& nodes, const std::vector<MapBVH::TrianglePacket>& packets,
+		const std::vector<uint32_t>& leafPackets, const MapBVH::RayPacket& rays, const float* inverseDirections) {
+		__m256 ox = _mm256_loadu_ps(rays.origin[0]), oy = _mm256_loadu_ps(rays.origin[1]), oz = _mm256_loadu_ps(rays.origin[2]);
+		__m256 dx = _mm256_loadu_ps(rays.direction[0]), dy = _mm256_loadu_ps(rays.direction[1]), dz = _mm256_loadu_ps(rays.direction[2]);
+		__m256 ix = _mm256_loadu_ps(inverseDirections), iy = _mm256_loadu_ps(inverseDirections + 8), iz = _mm256_loadu_ps(inverseDirections + 16);
+		__m256 maxDistance = _mm256_loadu_ps(rays.maxDistance);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+		uint32_t live = rays.count >= 8 ? 0xFFu : (1u << rays.count) - 1u;
+		uint32_t blocked = 0;
+
+		uint32_t stack[MapBVH::MAX_DEPTH];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0 && blocked != live) {
+			uint32_t nodeIndex = stack[--stackSize];
+			const MapBVH::Node& node = nodes[nodeIndex];
+
+			__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin.x), ox), ix);
+			__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax.x), ox), ix);
+			__m256 tNear = _mm256_max_ps(_mm256_min_ps(t0, t1), zero);
+			__m256 tFar = _mm256_min_ps(_mm256_max_ps(t0, t1), maxDistance);
+			t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin.y), oy), iy);
+			t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax.y), oy), iy);
+			tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+			tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+			t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin.z), oz), iz);
+			t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax.z), oz), iz);
+			tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+			tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+
+			uint32_t active = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ))) & live & ~blocked;
+			if (active == 0) continue;
+
+			if (node.count == 0) {
+				stack[stackSize++] = node.leftFirst + 1;
+				stack[stackSize++] = node.leftFirst;
+				continue;
+			}
+
+			// Rays in the lanes now, one triangle broadcast to all of them at a time
+			uint32_t firstPacket = leafPackets[nodeIndex];
+			for (uint32_t i = 0; i < node.count; i++) {
+				const MapBVH::TrianglePacket& packet = packets[firstPacket + i / 8];
+				uint32_t lane = i % 8;
+				__m256 e1x = _mm256_set1_ps(packet.e1[0][lane]), e1y = _mm256_set1_ps(packet.e1[1][lane]), e1z = _mm256_set1_ps(packet.e1[2][lane]);
+				__m256 e2x = _mm256_set1_ps(packet.e2[0][lane]), e2y = _mm256_set1_ps(packet.e2[1][lane]), e2z = _mm256_set1_ps(packet.e2[2][lane]);
+
+				__m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+				__m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+				__m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+				__m256 determinant = _mm256_fmadd_ps(e1z, pz, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1x, px)));
+				__m256 valid = _mm256_cmp_ps(_mm256_andnot_ps(signMask, determinant), _mm256_set1_ps(DETERMINANT_EPSILON), _CMP_GE_OQ);
+				__m256 inverse = _mm256_div_ps(one, determinant);
+
+				__m256 tx = _mm256_sub_ps(ox, _mm256_set1_ps(packet.v0[0][lane]));
+				__m256 ty = _mm256_sub_ps(oy, _mm256_set1_ps(packet.v0[1][lane]));
+				__m256 tz = _mm256_sub_ps(oz, _mm256_set1_ps(packet.v0[2][lane]));
+				__m256 u = _mm256_mul_ps(_mm256_fmadd_ps(tz, pz, _mm256_fmadd_ps(ty, py, _mm256_mul_ps(tx, px))), inverse);
+
+				__m256 qx = _mm256_fmsub_ps(ty, e1z, _mm256_mul_ps(tz, e1y));
+				__m256 qy = _mm256_fmsub_ps(tz, e1x, _mm256_mul_ps(tx, e1z));
+				__m256 qz = _mm256_fmsub_ps(tx, e1y, _mm256_mul_ps(ty, e1x));
+				__m256 v = _mm256_mul_ps(_mm256_fmadd_ps(dz, qz, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dx, qx))), inverse);
+				__m256 t = _mm256_mul_ps(_mm256_fmadd_ps(e2z, qz, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2x, qx))), inverse);
+
+				valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+				valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+				valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+				valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(MIN_HIT_DISTANCE), _CMP_GT_OQ));
+				valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, maxDistance, _CMP_LT_OQ));
+
+				blocked |= static_cast<uint32_t>(_mm256_movemask_ps(valid)) & active;
+				if ((active & ~blocked) == 0) break;
+			}
+		}
+		_mm256_zeroupper();
+		return blocked;
+	}
+#endif
+#endif
+
+	PacketTest packetTest(TransformKernel::Path path) {
+		switch (path) {
+#ifdef MAP_BVH_AVX2
+			case TransformKernel::Path::AVX2:
+				return &intersectPacketAvx;
+#endif
+#ifdef MAP_BVH_SSE
+			case TransformKernel::Path::SSE2:
+				return &intersectPacketSse;
+#endif
+			default:
+				return &intersectPacketScalar;
+		}
+	}
+
+	// Keeps the slab test free of 0 * inf for axis-aligned rays
+	float safeInverse(float value) {
+		if (std::fabs(value) > 1e-20f) return 1.0f / value;
+		return value < 0.0f ? -1e30f : 1e30f;
+	}
+
+	bool intersectBox(const MapBVH::Node& node, const glm::vec3& origin, const glm::vec3& inverseDirection,
+		float maxDistance, float& entry) {
+		glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return entry <= exit;
+	}
+}
+
+MapBVH::MapBVH()
+	: nodes(), triangles(), materialIndices(), packets(), leafPackets(), emptyBounds(0.0f)
+	, kernelPath(TransformKernel::bestPath()) {}
+
+bool MapBVH::build(const OBJLoader& loader) {
+	PROFILE_SCOPE("MapBVH::build");
+
+	nodes.clear();
+	triangles.clear();
+	materialIndices.clear();
+	packets.clear();
+	leafPackets.clear();
+
+	const std::vector<Material>& materials = loader.getMaterials();
+	for (size_t m = 0; m < materials.size(); m++) {
+		const Material& material = materials[m];
+		for (size_t i = 0; i + 2 < material.indices.size(); i += 3) {
+			Triangle triangle = {
+				material.vertices[material.indices[i]],
+				material.vertices[material.indices[i + 1]],
+				material.vertices[material.indices[i + 2]]
+			};
+			triangles.push_back(triangle);
+			materialIndices.push_back(static_cast<uint32_t>(m));
+		}
+	}
+
+	if (triangles.empty()) {
+		std::cerr << "MapBVH: no triangles to build from" << std::endl;
+		return false;
+	}
+
+	uint32_t triangleCount = static_cast<uint32_t>(triangles.size());
+	std::vector<glm::vec3> centroids(triangleCount);
+	std::vector<uint32_t> order(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		const Triangle& triangle = triangles[i];
+		centroids[i] = (triangle.v0 + triangle.v1 + triangle.v2) * (1.0f / 3.0f);
+		order[i] = i;
+	}
+
+	// A binary tree over N leaves never needs more than 2N - 1 nodes, so this never reallocates
+	nodes.reserve(2 * triangleCount);
+	Node root;
+	root.leftFirst = 0;
+	root.count = triangleCount;
+	updateBounds(root, order);
+	nodes.push_back(root);
+	subdivide(0, centroids, order, 0);
+
+	// Put the triangles in leaf order so a leaf's range indexes them directly
+	std::vector<Triangle> sortedTriangles(triangleCount);
+	std::vector<uint32_t> sortedMaterials(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		sortedTriangles[i] = triangles[order[i]];
+		sortedMaterials[i] = materialIndices[order[i]];
+	}
+	triangles.swap(sortedTriangles);
+	materialIndices.swap(sortedMaterials);
+	buildPackets();
+
+	std::cout << "MapBVH: " << triangleCount << " triangles, " << nodes.size() << " nodes" << std::endl;
+	return true;
+}
+
+void MapBVH::updateBounds(Node& node, const std::vector<uint32_t>& order) const {
+	Bounds bounds;
+	for (uint32_t i = 0; i < node.count; i++) {
+		const Triangle& triangle = triangles[order[node.leftFirst + i]];
+		bounds.grow(triangle.v0);
+		bounds.grow(triangle.v1);
+		bounds.grow(triangle.v2);
+	}
+	node.boundsMin = bounds.min;
+	node.boundsMax = bounds.max;
+}
+
+void MapBVH::subdivide(uint32_t nodeIndex, std::vector<glm::vec3>& centroids, std::vector<uint32_t>& order, int depth) {
+	uint32_t first = nodes[nodeIndex].leftFirst;
+	uint32_t count = nodes[nodeIndex].count;
+	if (count <= 2 || depth >= MAX_DEPTH - 1) return;
+
+	Bounds centroidBounds;
+	for (uint32_t i = 0; i < count; i++) {
+		centroidBounds.grow(centroids[order[first + i]]);
+	}
+
+	// Binned SAH: bucket the centroids along each axis and evaluate every bucket boundary
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = 1e30f;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+		if (extent <= 1e-6f) continue;
+
+		Bounds binBounds[BIN_COUNT];
+		uint32_t binCounts[BIN_COUNT] = {};
+		float scale = BIN_COUNT / extent;
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t triangleIndex = order[first + i];
+			int bin = std::min(BIN_COUNT - 1, static_cast<int>((centroids[triangleIndex][axis] - centroidBounds.min[axis]) * scale));
+			const Triangle& triangle = triangles[triangleIndex];
+			binBounds[bin].grow(triangle.v0);
+			binBounds[bin].grow(triangle.v1);
+			binBounds[bin].grow(triangle.v2);
+			binCounts[bin]++;
+		}
+
+		// Left-to-right prefix areas, then a right-to-left sweep to combine them
+		float leftAreas[BIN_COUNT - 1];
+		uint32_t leftCounts[BIN_COUNT - 1];
+		Bounds left;
+		uint32_t leftCount = 0;
+		for (int split = 0; split < BIN_COUNT - 1; split++) {
+			left.grow(binBounds[split]);
+			leftCount += binCounts[split];
+			leftAreas[split] = left.area();
+			leftCounts[split] = leftCount;
+		}
+
+		Bounds right;
+		uint32_t rightCount = 0;
+		for (int split = BIN_COUNT - 1; split > 0; split--) {
+			right.grow(binBounds[split]);
+			rightCount += binCounts[split];
+			if (leftCounts[split - 1] == 0 || rightCount == 0) continue;
+
+			float cost = packetCount(leftCounts[split - 1]) * leftAreas[split - 1] + packetCount(rightCount) * right.area();
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	// Every centroid in the same spot: no split can separate them
+	if (bestAxis < 0) return;
+
+	float area = nodeArea(nodes[nodeIndex]);
+	float leafCost = PACKET_COST * packetCount(count) * area;
+	float splitCost = TRAVERSAL_COST * area + PACKET_COST * bestCost;
+	if (splitCost >= leafCost && count <= MAX_LEAF_TRIANGLES) return;
+
+	float scale = BIN_COUNT / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+	uint32_t* begin = order.data() + first;
+	uint32_t* middle = std::partition(begin, begin + count, [&](uint32_t triangleIndex) {
+		int bin = std::min(BIN_COUNT - 1, static_cast<int>((centroids[triangleIndex][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+		return bin < bestSplit;
+	});
+	uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+	if (leftCount == 0 || leftCount == count) return;
+
+	uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+	Node leftChild;
+	leftChild.leftFirst = first;
+	leftChild.count = leftCount;
+	updateBounds(leftChild, order);
+	Node rightChild;
+	rightChild.leftFirst = first + leftCount;
+	rightChild.count = count - leftCount;
+	updateBounds(rightChild, order);
+	nodes.push_back(leftChild);
+	nodes.push_back(rightChild);
+
+	nodes[nodeIndex].leftFirst = leftIndex;
+	nodes[nodeIndex].count = 0;
+
+	subdivide(leftIndex, centroids, order, depth + 1);
+	subdivide(leftIndex + 1, centroids, order, depth + 1);
+}
+
+void MapBVH::queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& out) const {
+	if (nodes.empty()) return;
+
+	uint32_t stack[MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+		if (node.boundsMin.x > boxMax.x || node.boundsMax.x < boxMin.x ||
+			node.boundsMin.y > boxMax.y || node.boundsMax.y < boxMin.y ||
+			node.boundsMin.z > boxMax.z || node.boundsMax.z < boxMin.z) {
+			continue;
+		}
+
+		if (node.count == 0) {
+			stack[stackSize++] = node.leftFirst;
+			stack[stackSize++] = node.leftFirst + 1;
+			continue;
+		}
+
+		for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+			const Triangle& triangle = triangles[i];
+			glm::vec3 triangleMin = glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2));
+			glm::vec3 triangleMax = glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2));
+			if (triangleMin.x <= boxMax.x && triangleMax.x >= boxMin.x &&
+				triangleMin.y <= boxMax.y && triangleMax.y >= boxMin.y &&
+				triangleMin.z <= boxMax.z && triangleMax.z >= boxMin.z) {
+				out.push_back(i);
+			}
+		}
+	}
+}
+
+void MapBVH::buildPackets() {
+	leafPackets.assign(nodes.size(), 0);
+	for (size_t i = 0; i < nodes.size(); i++) {
+		const Node& node = nodes[i];
+		if (node.count == 0) continue;
+
+		// Leaves hold at most 8 triangles unless the build could not split them at all
+		leafPackets[i] = static_cast<uint32_t>(packets.size());
+		for (uint32_t first = 0; first < node.count; first += 8) {
+			TrianglePacket packet = {};
+			for (uint32_t lane = 0; lane < 8 && first + lane < node.count; lane++) {
+				const Triangle& triangle = triangles[node.leftFirst + first + lane];
+				glm::vec3 e1 = triangle.v1 - triangle.v0;
+				glm::vec3 e2 = triangle.v2 - triangle.v0;
+				for (int axis = 0; axis < 3; axis++) {
+					packet.v0[axis][lane] = triangle.v0[axis];
+					packet.e1[axis][lane] = e1[axis];
+					packet.e2[axis][lane] = e2[axis];
+				}
+			}
+			packets.push_back(packet);
+		}
+	}
+}
+
+void MapBVH::setKernelPath(TransformKernel::Path path) {
+	kernelPath = TransformKernel::isSupported(path) ? path : TransformKernel::bestPath();
+}
+
+bool MapBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const {
+	return traverse(origin, direction, maxDistance, QueryMode::CLOSEST, &hit, nullptr) > 0;
+}
+
+bool MapBVH::raycastAny(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	return traverse(origin, direction, maxDistance, QueryMode::ANY, nullptr, nullptr) > 0;
+}
+
+size_t MapBVH::raycastAll(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<Hit>& hits) const {
+	return traverse(origin, direction, maxDistance, QueryMode::ALL, nullptr, &hits);
+}
+
+size_t MapBVH::traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, QueryMode mode,
+	Hit* closest, std::vector<Hit>* all) const {
+	if (nodes.empty()) return 0;
+	float length = glm::length(direction);
+	if (length < 1e-12f) return 0;
+
+	glm::vec3 unit = direction / length;
+	glm::vec3 inverseDirection(safeInverse(unit.x), safeInverse(unit.y), safeInverse(unit.z));
+	const float ray[6] = { origin.x, origin.y, origin.z, unit.x, unit.y, unit.z };
+	PacketTest test = packetTest(kernelPath);
+
+	struct Entry {
+		uint32_t node;
+		float distance;
+	};
+	Entry stack[MAX_DEPTH];
+	int stackSize = 0;
+
+	float rootEntry;
+	if (!intersectBox(nodes[0], origin, inverseDirection, maxDistance, rootEntry)) return 0;
+	stack[stackSize++] = { 0, rootEntry };
+
+	// Closest-hit queries shrink this as they go, culling everything further away
+	float limit = maxDistance;
+	size_t hitCount = 0;
+	float distances[8];
+
+	while (stackSize > 0) {
+		Entry entry = stack[--stackSize];
+		if (entry.distance > limit) continue;
+		const Node& node = nodes[entry.node];
+
+		if (node.count > 0) {
+			uint32_t leafPacketCount = packetCount(node.count);
+			for (uint32_t p = 0; p < leafPacketCount; p++) {
+				uint32_t mask = test(packets[leafPackets[entry.node] + p], ray, limit, distances);
+				for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+					if ((mask & 1) == 0) continue;
+					Hit hit = { distances[lane], node.leftFirst + p * 8 + lane };
+					if (mode == QueryMode::ANY) return 1;
+					if (mode == QueryMode::ALL) {
+						all->push_back(hit);
+						hitCount++;
+					} else if (hit.distance < limit) {
+						limit = hit.distance;
+						*closest = hit;
+						hitCount = 1;
+					}
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so closest-hit queries can cull the other one
+		float leftEntry, rightEntry;
+		bool hitLeft = intersectBox(nodes[node.leftFirst], origin, inverseDirection, limit, leftEntry);
+		bool hitRight = intersectBox(nodes[node.leftFirst + 1], origin, inverseDirection, limit, rightEntry);
+		if (hitLeft && hitRight) {
+			if (leftEntry <= rightEntry) {
+				stack[stackSize++] = { node.leftFirst + 1, rightEntry };
+				stack[stackSize++] = { node.leftFirst, leftEntry };
+			} else {
+				stack[stackSize++] = { node.leftFirst, leftEntry };
+				stack[stackSize++] = { node.leftFirst + 1, rightEntry };
+			}
+		} else if (hitLeft) {
+			stack[stackSize++] = { node.leftFirst, leftEntry };
+		} else if (hitRight) {
+			stack[stackSize++] = { node.leftFirst + 1, rightEntry };
+		}
+	}
+	return hitCount;
+}
+
+uint32_t MapBVH::occluded(const RayPacket& packet) const {
+	if (nodes.empty() || packet.count <= 0) return 0;
+
+#ifdef MAP_BVH_AVX2
+	if (kernelPath == TransformKernel::Path::AVX2) {
+		// Unused lanes get a harmless ray; they are masked out of the result anyway
+		RayPacket rays = packet;
+		float inverseDirections[24];
+		for (int lane = 0; lane < 8; lane++) {
+			if (lane >= packet.count) {
+				for (int axis = 0; axis < 3; axis++) {
+					rays.origin[axis][lane] = 0.0f;
+					rays.direction[axis][lane] = axis == 1 ? 1.0f : 0.0f;
+				}
+				rays.maxDistance[lane] = 0.0f;
+			}
+			for (int axis = 0; axis < 3; axis++) {
+				inverseDirections[axis * 8 + lane] = safeInverse(rays.direction[axis][lane]);
+			}
+		}
+		return occludedPacketAvx(nodes, packets, leafPackets, rays, inverseDirections);
+	}
+#endif
+
+	// Without AVX2 the rays go through the single-ray any-hit walk one by one
+	uint32_t blocked = 0;
+	for (int lane = 0; lane < packet.count && lane < 8; lane++) {
+		glm::vec3 origin(packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane]);
+		glm::vec3 direction(packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane]);
+		if (raycastAny(origin, direction, packet.maxDistance[lane])) blocked |= 1u << lane;
+	}
+	return blocked;
+}
+
+size_t MapBVH::getMemoryUsage() const {
+	return vectorBytes(nodes) + vectorBytes(triangles) + vectorBytes(materialIndices) + vectorBytes(packets) + vectorBytes(leafPackets);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "TransformKernel.hpp"
+
+class OBJLoader;
+
+// Static bounding volume hierarchy over the map triangles, built once at load with a
+// binned surface area heuristic. Triangles are reordered so every leaf owns a contiguous
+// range, and each keeps the index of the OBJLoader material it came from. Leaves are also
+// packed into 8-wide triangle packets so a ray tests a whole leaf in one SIMD pass.
+class MapBVH {
+public:
+	struct Triangle {
+		glm::vec3 v0;
+		glm::vec3 v1;
+		glm::vec3 v2;
+	};
+
+	// 32 bytes: two per cache line. Leaves have count > 0 and their triangles start at
+	// leftFirst; inner nodes have count == 0 and children at leftFirst and leftFirst + 1.
+	struct Node {
+		glm::vec3 boundsMin;
+		uint32_t leftFirst;
+		glm::vec3 boundsMax;
+		uint32_t count;
+	};
+
+	// One leaf's triangles as struct of arrays, 8 lanes per component. Lanes past the
+	// leaf's triangle count are degenerate and never hit.
+	struct TrianglePacket {
+		float v0[3][8];
+		float e1[3][8];  // v1 - v0
+		float e2[3][8];  // v2 - v0
+	};
+
+	struct Hit {
+		float distance;
+		uint32_t triangle;
+	};
+
+	// Up to 8 rays traced together. Coherent rays (one origin, similar directions) visit
+	// mostly the same nodes, so each node's box test is done once for all of them.
+	struct RayPacket {
+		float origin[3][8];
+		float direction[3][8];  // Unit length
+		float maxDistance[8];
+		int count;
+	};
+
+	MapBVH();
+
+	// Collects every material's triangles and builds the tree; false if there are none
+	bool build(const OBJLoader& loader);
+
+	// Appends the triangles whose bounds overlap the box; the vector is not cleared, so
+	// callers can keep one around and avoid allocating per query
+	void queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& out) const;
+
+	// Ray queries against both sides of every triangle. The direction does not have to be
+	// normalized; distances are measured along it in world units.
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const;
+	bool raycastAny(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	// Appends every hit, in no particular order; returns how many were added
+	size_t raycastAll(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<Hit>& hits) const;
+
+	// Bit per packet ray that is blocked before its max distance
+	uint32_t occluded(const RayPacket& packet) const;
+
+	// Kernel used for the packet tests; the widest one the CPU supports by default
+	void setKernelPath(TransformKernel::Path path);
+	TransformKernel::Path getKernelPath() const { return kernelPath; }
+
+	const Triangle& getTriangle(uint32_t index) const { return triangles[index]; }
+	uint32_t getMaterialIndex(uint32_t index) const { return materialIndices[index]; }
+	size_t getTriangleCount() const { return triangles.size(); }
+	size_t getNodeCount() const { return nodes.size(); }
+	size_t getMemoryUsage() const;  // Heap bytes held
+	const std::vector<Node>& getNodes() const { return nodes; }
+
+	const glm::vec3& getBoundsMin() const { return nodes.empty() ? emptyBounds : nodes[0].boundsMin; }
+	const glm::vec3& getBoundsMax() const { return nodes.empty() ? emptyBounds : nodes[0].boundsMax; }
+
+	// Deep enough for any tree this builder produces; leaves are split down to a few triangles
+	static const int MAX_DEPTH = 64;
+
+private:
+	enum class QueryMode { CLOSEST, ANY, ALL };
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+	std::vector<uint32_t> materialIndices;
+	std::vector<TrianglePacket> packets;
+	std::vector<uint32_t> leafPackets;  // Per node: first packet of a leaf, unused for inner nodes
+	glm::vec3 emptyBounds;
+	TransformKernel::Path kernelPath;
+
+	size_t traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, QueryMode mode,
+		Hit* closest, std::vector<Hit>* all) const;
+	void buildPackets();
+
+	void subdivide(uint32_t nodeIndex, std::vector<glm::vec3>& centroids, std::vector<uint32_t>& order, int depth);
+	void updateBounds(Node& node, const std::vector<uint32_t>& order) const;
+};
@@ -0,0 +1,227 @@
+#include "Match.hpp"
+#include "MapAssets.hpp"
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
+#include "PlayerMovement.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+	// Same spawns as the client, bots spread over the floor within a radius of them
+	const glm::vec3 CT_SPAWN(7.0f, -3.18f, -58.0f);
+	const glm::vec3 T_SPAWN(-17.0f, 3.21f, 20.0f);
+	const float SPAWN_RADIUS = 8.0f;
+
+	const float PROXIMITY_CELL_SIZE = 2.0f;
+
+	// Engaged bots fire this often, from the eye at the target's chest
+	const float FIRE_INTERVAL = 0.1f;
+	const float FIRE_RANGE = 100.0f;
+	const float CHEST_HEIGHT = 0.7f;
+
+	// Inputs bunched up by jitter beyond this many are run in the same tick to catch up
+	const size_t INPUT_BACKLOG = 2;
+}
+
+Match::Match(const MapAssets& assets, unsigned int id)
+	: assets(assets), id(id), paths(assets.getNavMesh()), characters(), sceneQuery(assets.getBvh()), lineOfSight(assets.getBvh())
+	, grid(), bots(assets.getNavMesh(), paths), replication(), players(), weapons(), snapshot(), lagCompensation(), clockNs(0), tickCount(0), shotsFired(0), shotsHit(0)
+	, playerShotsFired(0), playerShotsHit(0), playerHitsRewound(0), totalTickNs(0)
+	, windowTickNs(0), windowWorstNs(0), windowTicks(0) {
+	sceneQuery.setCharacterModel(CharacterStore::Team::CT, assets.getCtModel());
+	sceneQuery.setCharacterModel(CharacterStore::Team::T, assets.getTModel());
+	for (CharacterStore::Team team : { CharacterStore::Team::CT, CharacterStore::Team::T }) {
+		lagCompensation.setCharacterBounds(team, sceneQuery.getModelMin(team), sceneQuery.getModelMax(team));
+	}
+	grid.initialize(assets.getBvh().getBoundsMin(), assets.getBvh().getBoundsMax(), PROXIMITY_CELL_SIZE);
+}
+
+void Match::spawnBots(size_t perTeam, unsigned int seed) {
+	const NavMesh& navMesh = assets.getNavMesh();
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	const glm::vec3 spawns[] = { CT_SPAWN, T_SPAWN };
+	const CharacterStore::Team teams[] = { CharacterStore::Team::CT, CharacterStore::Team::T };
+	for (int side = 0; side < 2; side++) {
+		// Polygons near the spawn that can reach it
+		uint32_t spawnPolygon = navMesh.findPolygon(spawns[side]);
+		std::vector<uint32_t> candidates;
+		for (size_t p = 0; p < navMesh.getPolygonCount(); p++) {
+			const NavMesh::Polygon& polygon = navMesh.getPolygon(static_cast<uint32_t>(p));
+			glm::vec3 offset = polygon.center - spawns[side];
+			if (offset.x * offset.x + offset.z * offset.z > SPAWN_RADIUS * SPAWN_RADIUS) continue;
+			if (spawnPolygon != NavMesh::NONE && polygon.region != navMesh.getPolygon(spawnPolygon).region) continue;
+			candidates.push_back(static_cast<uint32_t>(p));
+		}
+
+		for (size_t i = 0; i < perTeam; i++) {
+			glm::vec3 position = spawns[side];
+			if (!candidates.empty()) {
+				const NavMesh::Polygon& polygon = navMesh.getPolygon(candidates[rng() % candidates.size()]);
+				position = glm::vec3(glm::mix(polygon.boundsMin.x, polygon.boundsMax.x, unit(rng)), polygon.center.y,
+					glm::mix(polygon.boundsMin.z, polygon.boundsMax.z, unit(rng)));
+			}
+			float yaw = unit(rng) * 360.0f - 180.0f;
+			bots.add(characters.create(position, teams[side], yaw), position);
+		}
+	}
+	refreshQueries(nullptr);
+}
+
+void Match::refreshQueries(JobSystem* jobs) {
+	characters.updateModelMatrices(jobs);
+	sceneQuery.updateCharacters(characters);
+	lineOfSight.update(characters, jobs);
+	grid.sync(characters);
+}
+
+void Match::fire(float dt) {
+	PROFILE_SCOPE("Match::fire");
+
+	// Bots fire in turn rather than all on the same tick
+	uint32_t fireTicks = static_cast<uint32_t>(std::max(1l, std::lround(FIRE_INTERVAL / dt)));
+	const glm::vec3* positions = characters.getPositions();
+	RayHit hit;
+	for (size_t bot = 0; bot < bots.size(); bot++) {
+		if (bots.getMode(bot) != BotSystem::Mode::ENGAGE || (bot + tickCount) % fireTicks != 0) continue;
+		int shooter = characters.indexOf(bots.getCharacter(bot));
+		int target = characters.indexOf(bots.getTarget(bot));
+		if (shooter < 0 || target < 0) continue;
+
+		glm::vec3 eye = positions[shooter] + glm::vec3(0.0f, CharacterStore::EYE_HEIGHT, 0.0f);
+		glm::vec3 chest = positions[target] + glm::vec3(0.0f, CHEST_HEIGHT, 0.0f);
+		shotsFired++;
+		if (sceneQuery.raycastClosest(eye, chest - eye, FIRE_RANGE, hit) && hit.character == bots.getTarget(bot)) shotsHit++;
+	}
+}
+
+void Match::tick(float dt, JobSystem* jobs) {
+	PROFILE_SCOPE("Match::tick");
+	long long start = CpuProfiler::now();
+
+	clockNs += static_cast<long long>(dt * 1e9);
+	if (replication) updatePlayers(dt);
+	bots.update(characters, lineOfSight, grid, dt, jobs);
+	paths.process(jobs);
+	refreshQueries(jobs);
+	fire(dt);
+	if (replication) sendSnapshot();
+	tickCount++;
+
+	long long elapsed = CpuProfiler::now() - start;
+	totalTickNs += elapsed;
+	windowTickNs += elapsed;
+	windowWorstNs = std::max(windowWorstNs, elapsed);
+	windowTicks++;
+}
+
+void Match::updatePlayers(float dt) {
+	PROFILE_SCOPE("Match::updatePlayers");
+	replication->receive(clockNs);
+
+	// Clients that timed out lose their character
+	for (size_t p = players.size(); p-- > 0;) {
+		bool connected = false;
+		for (size_t c = 0; c < replication->getClientCount() && !connected; c++) connected = replication->getClientId(c) == players[p].clientId;
+		if (connected) continue;
+		characters.destroy(players[p].character);
+		players.erase(players.begin() + p);
+	}
+
+	for (size_t c = 0; c < replication->getClientCount(); c++) {
+		uint32_t clientId = replication->getClientId(c);
+		auto player = std::find_if(players.begin(), players.end(), [&](const Player& existing) { return existing.clientId == clientId; });
+		if (player == players.end()) {
+			// A full match stays full: the client keeps watching but gets no character
+			if (characters.size() >= SnapshotCodec::MAX_ENTITIES) continue;
+			// Teams alternate as clients join, starting at the spawn with the eye where the client's camera starts
+			bool ct = players.size() % 2 == 0;
+			glm::vec3 eye = (ct ? CT_SPAWN : T_SPAWN) + glm::vec3(0.0f, CharacterStore::EYE_HEIGHT, 0.0f);
+			Player joined = { clientId, EntityHandle(), std::unique_ptr<CharacterController>(new CharacterController(assets.getBvh())), 0, 0 };
+			joined.controller->setEyePosition(eye);
+			joined.character = characters.create(joined.controller->getFeetPosition(), ct ? CharacterStore::Team::CT : CharacterStore::Team::T, 0.0f);
+			players.push_back(std::move(joined));
+			player = players.end() - 1;
+		}
+
+		// One input a tick, the same rate the client samples them; a backlog is worked off at once
+		PlayerInput input;
+		size_t budget = 1 + (replication->getQueuedInputs(c) > INPUT_BACKLOG ? replication->getQueuedInputs(c) - INPUT_BACKLOG : 0);
+		int index = characters.indexOf(player->character);
+		for (size_t i = 0; i < budget && replication->popInput(c, input); i++) {
+			// Shots leave from where the eye was when the input was sampled, before it moves
+			if (input.buttons & PlayerInput::FIRE) firePlayerShot(player->character, player->controller->getEyePosition(), input);
+			PlayerMovement::step(*player->controller, input, dt);
+			player->lastInput = input.sequence;
+			player->weapon = input.weapon;
+			if (index >= 0) characters.setYaw(index, 180.0f - input.yaw);  // Camera yaw to model yaw
+		}
+		if (index >= 0) characters.setPosition(index, player->controller->getFeetPosition());
+
+		PlayerCorrection correction = { player->lastInput, player->controller->getState() };
+		replication->setPlayer(c, player->character.index, correction);
+	}
+}
+
+void Match::firePlayerShot(EntityHandle shooter, const glm::vec3& eye, const PlayerInput& input) {
+	PROFILE_SCOPE("Match::firePlayerShot");
+	playerShotsFired++;
+	if (!lagCompensation.hasHistory()) return;
+
+	// The map does not move, so only characters are rewound; it just limits the ray
+	glm::vec3 direction = PlayerMovement::getViewDirection(input);
+	float range = FIRE_RANGE;
+	RayHit hit;
+	if (sceneQuery.raycastClosest(eye, direction, range, hit, SceneQuery::QUERY_MAP)) range = hit.distance;
+	if (!lagCompensation.raycast(input.viewTick, eye, direction, range, shooter, hit)) return;
+	playerShotsHit++;
+
+	// The same shot against the characters as they are now
+	RayHit present;
+	bool hitNow = sceneQuery.raycastClosest(eye, direction, range, present, SceneQuery::QUERY_CHARACTERS) && present.character == hit.character;
+	if (!hitNow) playerHitsRewound++;
+}
+
+void Match::sendSnapshot() {
+	weapons.assign(characters.size(), 0);
+	for (const Player& player : players) {
+		int index = characters.indexOf(player.character);
+		if (index >= 0) weapons[index] = player.weapon;
+	}
+	SnapshotCodec::capture(characters, weapons.data(), static_cast<uint32_t>(tickCount), snapshot);
+	replication->send(snapshot, clockNs);
+	// Recorded from the same state the snapshot carries, so a client's view tick finds it here
+	lagCompensation.record(characters, static_cast<uint32_t>(tickCount));
+}
+
+bool Match::replicate(uint16_t port, const LinkSettings& link) {
+	// Every snapshot has to fit a datagram, so the characters already in the match must too
+	if (characters.size() > SnapshotCodec::MAX_ENTITIES) {
+		std::cerr << "Match " << id << ": " << characters.size() << " characters is more than the " << SnapshotCodec::MAX_ENTITIES
+			<< " a replicated match can hold" << std::endl;
+		return false;
+	}
+	replication.reset(new ReplicationServer());
+	replication->setLink(link);
+	if (replication->open(port)) return true;
+	replication.reset();
+	return false;
+}
+
+void Match::resetTickWindow() {
+	windowTickNs = 0;
+	windowWorstNs = 0;
+	windowTicks = 0;
+}
+
+size_t Match::getMemoryUsage() const {
+	return sizeof(Match) + paths.getMemoryUsage() + characters.getMemoryUsage() + sceneQuery.getMemoryUsage()
+		+ lineOfSight.getMemoryUsage() + grid.getMemoryUsage() + bots.getMemoryUsage() + players.capacity() * sizeof(Player)
+		+ players.size() * sizeof(CharacterController) + vectorBytes(weapons) + lagCompensation.getMemoryUsage();
+}
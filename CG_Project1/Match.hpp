@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "CharacterStore.hpp"
+#include "CharacterController.hpp"
+#include "PathService.hpp"
+#include "SceneQuery.hpp"
+#include "LineOfSight.hpp"
+#include "SpatialGrid.hpp"
+#include "BotSystem.hpp"
+#include "LagCompensation.hpp"
+#include "Replication.hpp"
+
+class MapAssets;
+class JobSystem;
+
+// One simulated match: bots moving over the navmesh and shooting hitscan at whoever they
+// engage. Everything it owns is the dynamic state of this match alone; the map data comes
+// from shared MapAssets that it only reads, so matches can tick on different threads at once.
+// A match must not move once bots are added, since path results are answered in place.
+// Replicated matches also give every connected client a character of its own, moved only
+// by the inputs that client sends. Their shots are checked against the characters as the
+// client saw them, rewound to the time it was showing.
+class Match {
+public:
+	Match(const MapAssets& assets, unsigned int id);
+
+	Match(const Match&) = delete;
+	Match& operator=(const Match&) = delete;
+
+	// Bots per team, spread over the floor around the two spawns; the seed makes runs repeatable
+	void spawnBots(size_t perTeam, unsigned int seed);
+
+	// Jobs spread the subsystems over the pool; without them the match runs on the calling thread
+	void tick(float dt, JobSystem* jobs = nullptr);
+
+	// Runs client inputs at the start of every tick and sends a snapshot to clients at the
+	// end, on this UDP port (any free one for 0) over a link with these settings. Fails if
+	// the match already has more characters than a snapshot can carry.
+	bool replicate(uint16_t port, const LinkSettings& link = LinkSettings());
+	const ReplicationServer* getReplication() const { return replication.get(); }
+	size_t getPlayerCount() const { return players.size(); }
+
+	unsigned int getId() const { return id; }
+	const CharacterStore& getCharacters() const { return characters; }
+
+	long long getTickCount() const { return tickCount; }
+	long long getShotsFired() const { return shotsFired; }
+	long long getShotsHit() const { return shotsHit; }
+	// Client shots, and how many of the hits would have missed without rewinding
+	long long getPlayerShotsFired() const { return playerShotsFired; }
+	long long getPlayerShotsHit() const { return playerShotsHit; }
+	long long getPlayerHitsRewound() const { return playerHitsRewound; }
+
+	// Tick time since the last reset of the window, and over the match's life
+	double getMeanTickMs() const { return windowTicks > 0 ? windowTickNs / 1e6 / windowTicks : 0.0; }
+	double getWorstTickMs() const { return windowWorstNs / 1e6; }
+	double getLifetimeMeanTickMs() const { return tickCount > 0 ? totalTickNs / 1e6 / tickCount : 0.0; }
+	void resetTickWindow();
+
+	// Heap bytes of this match's own state, which is all an extra match costs
+	size_t getMemoryUsage() const;
+
+private:
+	const MapAssets& assets;
+	unsigned int id;
+
+	PathService paths;
+	CharacterStore characters;
+	SceneQuery sceneQuery;
+	LineOfSight lineOfSight;
+	SpatialGrid grid;
+	BotSystem bots;
+
+	// A character driven by a client's inputs through the same movement the client predicts
+	struct Player {
+		uint32_t clientId;
+		EntityHandle character;
+		std::unique_ptr<CharacterController> controller;
+		uint32_t lastInput;
+		uint8_t weapon;
+	};
+
+	std::unique_ptr<ReplicationServer> replication;
+	std::vector<Player> players;
+	std::vector<uint8_t> weapons;  // By store index, for snapshots
+	Snapshot snapshot;
+	LagCompensation lagCompensation;
+	long long clockNs;  // Match time, which replication runs on
+
+	long long tickCount;
+	long long shotsFired;
+	long long shotsHit;
+	long long playerShotsFired;
+	long long playerShotsHit;
+	long long playerHitsRewound;
+
+	long long totalTickNs;
+	long long windowTickNs;
+	long long windowWorstNs;
+	long long windowTicks;
+
+	// Brings the query structures up to date with the store after characters moved
+	void refreshQueries(JobSystem* jobs);
+	void fire(float dt);
+	// Joins and drops players to match the connected clients and runs their inputs
+	void updatePlayers(float dt);
+	void firePlayerShot(EntityHandle shooter, const glm::vec3& eye, const PlayerInput& input);
+	void sendSnapshot();
+};
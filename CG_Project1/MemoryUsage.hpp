@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Heap bytes reserved by a vector, for the memory figures subsystems report. Nested
+// containers are the caller's to add up.
+template <typename T>
+size_t vectorBytes(const std::vector<T>& v) {
+	return v.capacity() * sizeof(T);
+}
@@ -0,0 +1,1337 @@
+#include "Microbenchmarks.hpp"
+#include "JobSystem.hpp"
+#include "CharacterStore.hpp"
+#include "TransformKernel.hpp"
+#include "MapBVH.hpp"
+#include "CharacterController.hpp"
+#include "SceneQuery.hpp"
+#include "LineOfSight.hpp"
+#include "SpatialGrid.hpp"
+#include "NavMesh.hpp"
+#include "PathService.hpp"
+#include "BotSystem.hpp"
+#include "BitStream.hpp"
+#include "Replication.hpp"
+#include "MapAssets.hpp"
+#include "Match.hpp"
+#include "PlayerPrediction.hpp"
+#include "SnapshotInterpolator.hpp"
+#include "LagCompensation.hpp"
+#include "OBJLoader.hpp"
+#include "FlythroughPath.hpp"
+#include "CpuProfiler.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+	const int REPETITIONS = 5;
+
+	// Best of REPETITIONS runs, in milliseconds
+	template <typename Fn>
+	double timeBest(Fn fn) {
+		double best = 1e30;
+		for (int i = 0; i < REPETITIONS; i++) {
+			long long start = CpuProfiler::now();
+			fn();
+			best = std::min(best, (CpuProfiler::now() - start) / 1000000.0);
+		}
+		return best;
+	}
+
+	void printResult(const char* name, double ms, double baselineMs) {
+		std::cout << "  " << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << ms << " ms" << std::setprecision(2) << std::setw(8) << baselineMs / ms << "x" << std::endl;
+	}
+
+	// The obvious alternative: one locked FIFO shared by all workers
+	class MutexQueuePool {
+	public:
+		explicit MutexQueuePool(unsigned int threadCount) : stopping(false), pending(0) {
+			for (unsigned int i = 0; i < threadCount; i++) {
+				threads.emplace_back([this]() { workerLoop(); });
+			}
+		}
+
+		~MutexQueuePool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			available.notify_all();
+			for (auto& thread : threads) thread.join();
+		}
+
+		void submit(std::function<void()> task) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				tasks.push(std::move(task));
+				pending++;
+			}
+			available.notify_one();
+		}
+
+		void waitIdle() {
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [this]() { return pending == 0; });
+		}
+
+	private:
+		std::vector<std::thread> threads;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable available;
+		std::condition_variable finished;
+		bool stopping;
+		int pending;
+
+		void workerLoop() {
+			for (;;) {
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+					if (stopping && tasks.empty()) return;
+					task = std::move(tasks.front());
+					tasks.pop();
+				}
+				task();
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--pending == 0) finished.notify_all();
+			}
+		}
+	};
+
+	// Per-element work roughly the cost of a small transform update
+	void heavyKernel(const float* input, float* output, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			float x = input[i];
+			output[i] = std::sqrt(x * x + 1.0f) * std::sin(x) + std::cos(x * 0.5f);
+		}
+	}
+
+	void incrementJob(void* data, size_t, size_t) {
+		static_cast<std::atomic<int>*>(data)->fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// The old array-of-structs layout, kept here as the baseline
+	struct AosCharacter {
+		glm::vec3 position;
+		CharacterStore::Team team;
+		float rotation;
+
+		glm::mat4 getModelMatrix() const {
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, position);
+			model = glm::rotate(model, glm::radians(rotation), glm::vec3(0.0f, 1.0f, 0.0f));
+			model = glm::scale(model, glm::vec3(CharacterStore::MODEL_SCALE));
+			return model;
+		}
+	};
+
+	void benchmarkEntities() {
+		const size_t ENTITY_COUNT = 100000;
+		const size_t CHURN_COUNT = ENTITY_COUNT / 10;
+		const float STEP = 1.0f / 64.0f;
+
+		std::mt19937 rng(1337);
+		std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+
+		std::vector<AosCharacter> aos(ENTITY_COUNT);
+		CharacterStore store;
+		store.reserve(ENTITY_COUNT);
+		for (size_t i = 0; i < ENTITY_COUNT; i++) {
+			glm::vec3 position(coordinate(rng), 0.0f, coordinate(rng));
+			CharacterStore::Team team = (i & 1) ? CharacterStore::Team::T : CharacterStore::Team::CT;
+			float yaw = angle(rng);
+			aos[i].position = position;
+			aos[i].team = team;
+			aos[i].rotation = yaw;
+			store.create(position, team, yaw);
+		}
+
+		JobSystem jobs;
+		jobs.initialize();
+		std::cout << "Entities: " << ENTITY_COUNT << ", " << jobs.getWorkerCount() << " workers" << std::endl;
+
+		// Movement: walk forward along the facing and turn a little
+		std::cout << "update (position + yaw)" << std::endl;
+		double aosUpdateMs = timeBest([&]() {
+			for (auto& character : aos) {
+				float radians = glm::radians(character.rotation);
+				character.position += glm::vec3(std::sin(radians), 0.0f, std::cos(radians)) * STEP;
+				character.rotation += 0.5f;
+			}
+		});
+		printResult("AoS", aosUpdateMs, aosUpdateMs);
+
+		double soaUpdateMs = timeBest([&]() {
+			glm::vec3* positions = store.getPositions();
+			float* yaws = store.getYaws();
+			for (size_t i = 0; i < store.size(); i++) {
+				float radians = glm::radians(yaws[i]);
+				positions[i] += glm::vec3(std::sin(radians), 0.0f, std::cos(radians)) * STEP;
+				yaws[i] += 0.5f;
+				store.markDirty(i);
+			}
+		});
+		printResult("SoA", soaUpdateMs, aosUpdateMs);
+
+		// Model matrices: glm translate * rotate * scale per draw against the cached rebuild
+		std::cout << "model matrices" << std::endl;
+		std::vector<glm::mat4> aosMatrices(ENTITY_COUNT);
+		double aosMatrixMs = timeBest([&]() {
+			for (size_t i = 0; i < ENTITY_COUNT; i++) aosMatrices[i] = aos[i].getModelMatrix();
+		});
+		printResult("AoS getModelMatrix", aosMatrixMs, aosMatrixMs);
+
+		double soaMatrixMs = timeBest([&]() {
+			for (size_t i = 0; i < store.size(); i++) store.markDirty(i);
+			store.updateModelMatrices();
+		});
+		printResult("SoA rebuild (all dirty)", soaMatrixMs, aosMatrixMs);
+
+		double soaJobMatrixMs = timeBest([&]() {
+			for (size_t i = 0; i < store.size(); i++) store.markDirty(i);
+			store.updateModelMatrices(&jobs);
+		});
+		printResult("SoA rebuild, jobs", soaJobMatrixMs, aosMatrixMs);
+
+		// Iteration: a query touching only team and position
+		std::cout << "iteration (team + radius query)" << std::endl;
+		volatile size_t aosHits = 0, soaHits = 0;
+		double aosQueryMs = timeBest([&]() {
+			size_t hits = 0;
+			for (const auto& character : aos) {
+				if (character.team == CharacterStore::Team::T && glm::dot(character.position, character.position) < 2500.0f) hits++;
+			}
+			aosHits = hits;
+		});
+		printResult("AoS", aosQueryMs, aosQueryMs);
+
+		double soaQueryMs = timeBest([&]() {
+			size_t hits = 0;
+			const glm::vec3* positions = store.getPositions();
+			const CharacterStore::Team* teams = store.getTeams();
+			for (size_t i = 0; i < store.size(); i++) {
+				if (teams[i] == CharacterStore::Team::T && glm::dot(positions[i], positions[i]) < 2500.0f) hits++;
+			}
+			soaHits = hits;
+		});
+		printResult("SoA", soaQueryMs, aosQueryMs);
+		if (aosHits != soaHits) {
+			std::cout << "  query mismatch: AoS " << aosHits << " hits, SoA " << soaHits << std::endl;
+		}
+
+		// Churn: destroy and respawn 10%, then make sure the stale handles are rejected
+		std::cout << "churn (" << CHURN_COUNT << " destroy + create)" << std::endl;
+		std::vector<EntityHandle> victims;
+		for (size_t i = 0; i < CHURN_COUNT; i++) {
+			victims.push_back(store.handleAt((i * 7919) % store.size()));
+		}
+		std::sort(victims.begin(), victims.end(), [](const EntityHandle& a, const EntityHandle& b) { return a.index < b.index; });
+		victims.erase(std::unique(victims.begin(), victims.end()), victims.end());
+
+		long long churnStart = CpuProfiler::now();
+		for (const auto& handle : victims) store.destroy(handle);
+		for (size_t i = 0; i < victims.size(); i++) {
+			store.create(glm::vec3(coordinate(rng), 0.0f, coordinate(rng)), CharacterStore::Team::CT, angle(rng));
+		}
+		double churnMs = (CpuProfiler::now() - churnStart) / 1000000.0;
+
+		size_t staleResolved = 0;
+		for (const auto& handle : victims) {
+			if (store.isAlive(handle)) staleResolved++;
+		}
+		std::cout << "  " << std::left << std::setw(28) << "SoA" << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << churnMs << " ms, " << staleResolved << " stale handles resolved (expected 0)" << std::endl;
+	}
+
+	void benchmarkTransforms() {
+		const size_t ENTITY_COUNT = 100000;
+		const size_t GRAIN_SIZE = 4096;
+
+		std::mt19937 rng(1337);
+		std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+
+		std::vector<glm::vec3> positions(ENTITY_COUNT);
+		std::vector<float> yaws(ENTITY_COUNT);
+		for (size_t i = 0; i < ENTITY_COUNT; i++) {
+			positions[i] = glm::vec3(coordinate(rng), 0.0f, coordinate(rng));
+			yaws[i] = angle(rng);
+		}
+		std::vector<glm::mat4> reference(ENTITY_COUNT), output(ENTITY_COUNT);
+		TransformBatch batch = { positions.data(), yaws.data(), nullptr, CharacterStore::MODEL_SCALE, ENTITY_COUNT };
+
+		std::cout << "Transform kernel: " << ENTITY_COUNT << " yaw matrices, best path " << TransformKernel::pathName(TransformKernel::bestPath()) << std::endl;
+		double glmMs = timeBest([&]() {
+			for (size_t i = 0; i < ENTITY_COUNT; i++) {
+				glm::mat4 model = glm::mat4(1.0f);
+				model = glm::translate(model, positions[i]);
+				model = glm::rotate(model, glm::radians(yaws[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+				reference[i] = glm::scale(model, glm::vec3(CharacterStore::MODEL_SCALE));
+			}
+		});
+		printResult("glm translate/rotate/scale", glmMs, glmMs);
+
+		const TransformKernel::Path paths[] = { TransformKernel::Path::SCALAR, TransformKernel::Path::SSE2, TransformKernel::Path::AVX2 };
+		for (TransformKernel::Path path : paths) {
+			if (!TransformKernel::isSupported(path)) continue;
+			double ms = timeBest([&]() { TransformKernel::build(batch, &output[0][0][0], path); });
+			printResult(TransformKernel::pathName(path), ms, glmMs);
+
+			float maxError = 0.0f;
+			for (size_t i = 0; i < ENTITY_COUNT; i++) {
+				for (int column = 0; column < 4; column++) {
+					glm::vec4 difference = glm::abs(output[i][column] - reference[i][column]);
+					maxError = std::max(maxError, std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)));
+				}
+			}
+			if (maxError > 1e-5f) {
+				std::cout << "  " << TransformKernel::pathName(path) << " differs from glm by " << maxError << std::endl;
+			}
+		}
+
+		JobSystem jobs;
+		jobs.initialize();
+		double jobMs = timeBest([&]() {
+			jobs.parallelFor(ENTITY_COUNT, GRAIN_SIZE, [&](size_t begin, size_t end) {
+				TransformBatch range = { batch.positions + begin, batch.yawsDegrees + begin, nullptr, batch.uniformScale, end - begin };
+				TransformKernel::build(range, &output[begin][0][0]);
+			});
+		});
+		printResult("best path, jobs", jobMs, glmMs);
+	}
+
+	// Replays the benchmark flythrough through the player controller at the default tick rate.
+	// The path is a free camera route, so its deltas are fed in as input and the capsule
+	// slides along whatever walls the route cuts through.
+	void benchmarkCollision() {
+		const float TICK_RATE = 64.0f;
+		const float BUDGET_US = 50.0f;
+		const size_t BOX_QUERIES = 20000;
+
+		OBJLoader mapLoader;
+		if (!mapLoader.loadOBJ("Assets/Dust2/Dust2.obj")) return;
+		FlythroughPath path;
+		if (!path.load("Assets/Benchmark/Dust2Flythrough.path")) return;
+
+		MapBVH bvh;
+		double buildMs = timeBest([&]() { bvh.build(mapLoader); });
+		std::cout << "map BVH, " << bvh.getTriangleCount() << " triangles, " << bvh.getNodeCount()
+			<< " nodes, built in " << std::fixed << std::setprecision(2) << buildMs << " ms" << std::endl;
+
+		// Broadphase alone: player-sized boxes along the path, BVH against testing every triangle
+		std::vector<glm::vec3> boxCenters(BOX_QUERIES);
+		for (size_t i = 0; i < BOX_QUERIES; i++) {
+			boxCenters[i] = path.sample(static_cast<float>(i) / BOX_QUERIES).position;
+		}
+		const glm::vec3 boxExtent(0.6f, 1.2f, 0.6f);
+		std::vector<uint32_t> found;
+		found.reserve(1024);
+		volatile size_t sink = 0;
+
+		std::cout << "box queries, " << BOX_QUERIES << " player-sized boxes" << std::endl;
+		double scanMs = timeBest([&]() {
+			for (size_t q = 0; q < BOX_QUERIES; q++) {
+				found.clear();
+				glm::vec3 boxMin = boxCenters[q] - boxExtent;
+				glm::vec3 boxMax = boxCenters[q] + boxExtent;
+				for (uint32_t i = 0; i < bvh.getTriangleCount(); i++) {
+					const MapBVH::Triangle& triangle = bvh.getTriangle(i);
+					glm::vec3 triangleMin = glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2));
+					glm::vec3 triangleMax = glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2));
+					if (glm::all(glm::lessThanEqual(triangleMin, boxMax)) && glm::all(glm::greaterThanEqual(triangleMax, boxMin))) {
+						found.push_back(i);
+					}
+				}
+				sink = sink + found.size();
+			}
+		});
+		printResult("linear scan", scanMs, scanMs);
+
+		double bvhMs = timeBest([&]() {
+			for (size_t q = 0; q < BOX_QUERIES; q++) {
+				found.clear();
+				bvh.queryBox(boxCenters[q] - boxExtent, boxCenters[q] + boxExtent, found);
+				sink = sink + found.size();
+			}
+		});
+		printResult("MapBVH::queryBox", bvhMs, scanMs);
+
+		// Full movement ticks, flying along the route and walking it with gravity and steps
+		int tickCount = static_cast<int>(path.getDuration() * TICK_RATE);
+		for (int walking = 0; walking < 2; walking++) {
+			CharacterController controller(bvh);
+			std::vector<double> tickUs;
+			tickUs.reserve(tickCount);
+			size_t triangleTests = 0;
+
+			for (int repetition = 0; repetition < REPETITIONS; repetition++) {
+				controller.setEyePosition(path.sample(0.0f).position);
+				for (int tick = 0; tick < tickCount; tick++) {
+					glm::vec3 from = path.sample(static_cast<float>(tick) / tickCount).position;
+					glm::vec3 to = path.sample(static_cast<float>(tick + 1) / tickCount).position;
+					long long start = CpuProfiler::now();
+					controller.move(to - from, 1.0f / TICK_RATE, walking != 0);
+					tickUs.push_back((CpuProfiler::now() - start) / 1000.0);
+					triangleTests += controller.getLastTriangleTests();
+				}
+			}
+
+			std::sort(tickUs.begin(), tickUs.end());
+			double totalUs = 0.0;
+			for (double us : tickUs) totalUs += us;
+			double meanUs = totalUs / tickUs.size();
+			double p99Us = tickUs[tickUs.size() * 99 / 100];
+			double maxUs = tickUs.back();
+			glm::vec3 end = controller.getEyePosition();
+			std::cout << (walking ? "walking" : "flying") << ", " << tickCount << " ticks x " << REPETITIONS << std::endl;
+			std::cout << std::fixed << std::setprecision(2)
+				<< "  mean " << meanUs << " us, p99 " << p99Us << " us, max " << maxUs << " us, "
+				<< static_cast<double>(triangleTests) / tickUs.size() << " triangle tests per tick"
+				<< (p99Us <= BUDGET_US ? " (within " : " (over ") << BUDGET_US << " us budget)" << std::endl;
+			std::cout << "  ended at " << end.x << ", " << end.y << ", " << end.z << std::endl;
+		}
+	}
+
+	// Rays from points along the benchmark route in random directions, the mix a hitscan
+	// weapon or line-of-sight check produces. Throughput is per core, on this thread only.
+	void benchmarkRaycast() {
+		const size_t RAY_COUNT = 1 << 18;
+		const size_t BRUTE_FORCE_RAYS = 2000;
+		const float MAX_DISTANCE = 200.0f;
+
+		OBJLoader mapLoader;
+		if (!mapLoader.loadOBJ("Assets/Dust2/Dust2.obj")) return;
+		FlythroughPath path;
+		if (!path.load("Assets/Benchmark/Dust2Flythrough.path")) return;
+		MapBVH bvh;
+		if (!bvh.build(mapLoader)) return;
+
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::normal_distribution<float> gaussian(0.0f, 1.0f);
+		std::vector<glm::vec3> origins(RAY_COUNT), directions(RAY_COUNT);
+		for (size_t i = 0; i < RAY_COUNT; i++) {
+			origins[i] = path.sample(unit(rng)).position;
+			glm::vec3 direction(gaussian(rng), gaussian(rng) * 0.3f, gaussian(rng));
+			directions[i] = glm::normalize(direction);
+		}
+
+		std::vector<float> reference(RAY_COUNT);
+		std::cout << "raycasts, " << RAY_COUNT << " rays from the benchmark route, " << bvh.getTriangleCount() << " triangles" << std::endl;
+
+		// Brute force on a subset, scaled up, as the baseline and to check the tree against
+		bvh.setKernelPath(TransformKernel::Path::SCALAR);
+		std::vector<float> bruteForce(BRUTE_FORCE_RAYS);
+		double bruteMs = timeBest([&]() {
+			for (size_t r = 0; r < BRUTE_FORCE_RAYS; r++) {
+				float best = MAX_DISTANCE;
+				for (uint32_t i = 0; i < bvh.getTriangleCount(); i++) {
+					const MapBVH::Triangle& triangle = bvh.getTriangle(i);
+					glm::vec3 e1 = triangle.v1 - triangle.v0, e2 = triangle.v2 - triangle.v0;
+					glm::vec3 p = glm::cross(directions[r], e2);
+					float determinant = glm::dot(e1, p);
+					if (std::fabs(determinant) < 1e-10f) continue;
+					glm::vec3 t = origins[r] - triangle.v0;
+					float u = glm::dot(t, p) / determinant;
+					if (u < 0.0f || u > 1.0f) continue;
+					glm::vec3 q = glm::cross(t, e1);
+					float v = glm::dot(directions[r], q) / determinant;
+					if (v < 0.0f || u + v > 1.0f) continue;
+					float distance = glm::dot(e2, q) / determinant;
+					if (distance > 1e-5f && distance < best) best = distance;
+				}
+				bruteForce[r] = best;
+			}
+		}) * RAY_COUNT / BRUTE_FORCE_RAYS;
+		printResult("brute force (extrapolated)", bruteMs, bruteMs);
+
+		const TransformKernel::Path paths[] = { TransformKernel::Path::SCALAR, TransformKernel::Path::SSE2, TransformKernel::Path::AVX2 };
+		for (TransformKernel::Path kernel : paths) {
+			if (!TransformKernel::isSupported(kernel)) continue;
+			bvh.setKernelPath(kernel);
+
+			std::vector<float> distances(RAY_COUNT);
+			double ms = timeBest([&]() {
+				for (size_t r = 0; r < RAY_COUNT; r++) {
+					MapBVH::Hit hit;
+					distances[r] = bvh.raycast(origins[r], directions[r], MAX_DISTANCE, hit) ? hit.distance : MAX_DISTANCE;
+				}
+			});
+			std::string name = std::string("closest hit, ") + TransformKernel::pathName(kernel);
+			printResult(name.c_str(), ms, bruteMs);
+			std::cout << "    " << std::fixed << std::setprecision(2) << RAY_COUNT / ms / 1000.0 << " M rays/s" << std::endl;
+
+			if (kernel == TransformKernel::Path::SCALAR) reference = distances;
+			size_t mismatches = 0;
+			for (size_t r = 0; r < RAY_COUNT; r++) {
+				float expected = r < BRUTE_FORCE_RAYS ? bruteForce[r] : reference[r];
+				if (std::fabs(distances[r] - expected) > 1e-3f) mismatches++;
+			}
+			if (mismatches > 0) std::cout << "    " << mismatches << " rays disagree with the reference" << std::endl;
+		}
+
+		bvh.setKernelPath(TransformKernel::bestPath());
+		volatile size_t sink = 0;
+		double anyMs = timeBest([&]() {
+			size_t blocked = 0;
+			for (size_t r = 0; r < RAY_COUNT; r++) {
+				if (bvh.raycastAny(origins[r], directions[r], MAX_DISTANCE)) blocked++;
+			}
+			sink = blocked;
+		});
+		printResult("any hit, best path", anyMs, bruteMs);
+		std::cout << "    " << std::fixed << std::setprecision(2) << RAY_COUNT / anyMs / 1000.0 << " M rays/s" << std::endl;
+
+		std::vector<MapBVH::Hit> hits;
+		double allMs = timeBest([&]() {
+			size_t total = 0;
+			for (size_t r = 0; r < RAY_COUNT; r++) {
+				hits.clear();
+				total += bvh.raycastAll(origins[r], directions[r], MAX_DISTANCE, hits);
+			}
+			sink = total;
+		});
+		printResult("all hits, best path", allMs, bruteMs);
+
+		// The scene query adds the character boxes on top of the map
+		CharacterStore characters;
+		for (int i = 0; i < 10; i++) {
+			characters.create(path.sample(i / 10.0f).position - glm::vec3(0.0f, 1.0f, 0.0f), i % 2 ? CharacterStore::Team::T : CharacterStore::Team::CT, 0.0f);
+		}
+		characters.updateModelMatrices();
+		OBJLoader ctModel;
+		OBJLoader tModel;
+		SceneQuery scene(bvh);
+		if (ctModel.loadOBJ("Assets/Players/CT/CT.obj") && tModel.loadOBJ("Assets/Players/T/T.obj")) {
+			scene.setCharacterModel(CharacterStore::Team::CT, ctModel);
+			scene.setCharacterModel(CharacterStore::Team::T, tModel);
+		}
+		scene.updateCharacters(characters);
+		double sceneMs = timeBest([&]() {
+			size_t characterHits = 0;
+			for (size_t r = 0; r < RAY_COUNT; r++) {
+				RayHit hit;
+				if (scene.raycastClosest(origins[r], directions[r], MAX_DISTANCE, hit) && !hit.character.isNull()) characterHits++;
+			}
+			sink = characterHits;
+		});
+		printResult("SceneQuery, 10 characters", sceneMs, bruteMs);
+		std::cout << "    " << std::fixed << std::setprecision(2) << RAY_COUNT / sceneMs / 1000.0 << " M rays/s" << std::endl;
+	}
+
+	// Every pair of characters scattered along the benchmark route, as a full matrix per tick
+	// and with a tenth of them moving between ticks
+	void benchmarkLineOfSight() {
+		const size_t CHARACTER_COUNT = 128;
+		const size_t MOVING_COUNT = CHARACTER_COUNT / 10;
+
+		OBJLoader mapLoader;
+		if (!mapLoader.loadOBJ("Assets/Dust2/Dust2.obj")) return;
+		FlythroughPath path;
+		if (!path.load("Assets/Benchmark/Dust2Flythrough.path")) return;
+		MapBVH bvh;
+		if (!bvh.build(mapLoader)) return;
+
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> offset(-3.0f, 3.0f);
+		CharacterStore characters;
+		for (size_t i = 0; i < CHARACTER_COUNT; i++) {
+			glm::vec3 position = path.sample(unit(rng)).position + glm::vec3(offset(rng), -CharacterStore::EYE_HEIGHT, offset(rng));
+			characters.create(position, i % 2 ? CharacterStore::Team::T : CharacterStore::Team::CT, 0.0f);
+		}
+
+		size_t pairCount = CHARACTER_COUNT * (CHARACTER_COUNT - 1) / 2;
+		std::cout << "line of sight, " << CHARACTER_COUNT << " characters, " << pairCount << " pairs" << std::endl;
+
+		// Reference: one any-hit ray per pair
+		std::vector<uint8_t> reference(CHARACTER_COUNT * CHARACTER_COUNT, 0);
+		auto tracePairs = [&]() {
+			const glm::vec3* positions = characters.getPositions();
+			glm::vec3 eyeOffset(0.0f, CharacterStore::EYE_HEIGHT, 0.0f);
+			for (size_t i = 0; i < CHARACTER_COUNT; i++) {
+				for (size_t j = i + 1; j < CHARACTER_COUNT; j++) {
+					glm::vec3 delta = positions[j] - positions[i];
+					bool visible = !bvh.raycastAny(positions[i] + eyeOffset, delta, glm::length(delta));
+					reference[i * CHARACTER_COUNT + j] = reference[j * CHARACTER_COUNT + i] = visible;
+				}
+			}
+		};
+
+		bvh.setKernelPath(TransformKernel::Path::SCALAR);
+		double scalarMs = timeBest(tracePairs);
+		printResult("per-pair rays, scalar", scalarMs, scalarMs);
+		bvh.setKernelPath(TransformKernel::bestPath());
+		double singleMs = timeBest(tracePairs);
+		std::string singleName = std::string("per-pair rays, ") + TransformKernel::pathName(bvh.getKernelPath());
+		printResult(singleName.c_str(), singleMs, scalarMs);
+
+		LineOfSight lineOfSight(bvh);
+		double packetMs = timeBest([&]() {
+			lineOfSight.invalidate();
+			lineOfSight.update(characters);
+		});
+		printResult("LineOfSight, packets", packetMs, scalarMs);
+
+		size_t mismatches = 0;
+		size_t visiblePairs = 0;
+		for (size_t i = 0; i < CHARACTER_COUNT; i++) {
+			for (size_t j = 0; j < CHARACTER_COUNT; j++) {
+				if (i == j) continue;
+				if (lineOfSight.canSee(i, j) != (reference[i * CHARACTER_COUNT + j] != 0)) mismatches++;
+				if (i < j && lineOfSight.canSee(i, j)) visiblePairs++;
+			}
+		}
+		std::cout << "    " << visiblePairs << " pairs visible";
+		if (mismatches > 0) std::cout << ", " << mismatches << " entries differ from per-pair rays";
+		std::cout << std::endl;
+
+		JobSystem jobs;
+		jobs.initialize();
+		double jobMs = timeBest([&]() {
+			lineOfSight.invalidate();
+			lineOfSight.update(characters, &jobs);
+		});
+		std::string jobName = "LineOfSight, packets, " + std::to_string(jobs.getWorkerCount()) + " workers";
+		printResult(jobName.c_str(), jobMs, scalarMs);
+
+		// Temporal caching: only pairs with a moving end are traced again
+		const int TICKS = 64;
+		size_t traced = 0;
+		double cachedMs = timeBest([&]() {
+			traced = 0;
+			for (int tick = 0; tick < TICKS; tick++) {
+				for (size_t i = 0; i < MOVING_COUNT; i++) {
+					size_t index = (tick * MOVING_COUNT + i * 7) % CHARACTER_COUNT;
+					characters.setPosition(index, characters.getPositions()[index] + glm::vec3(0.05f, 0.0f, 0.0f));
+				}
+				lineOfSight.update(characters, &jobs);
+				traced += lineOfSight.getLastTracedPairs();
+			}
+		}) / TICKS;
+		std::string cachedName = "cached, " + std::to_string(MOVING_COUNT) + " moving per tick";
+		printResult(cachedName.c_str(), cachedMs, scalarMs);
+		std::cout << "    " << traced / TICKS << " of " << pairCount << " pairs traced per tick" << std::endl;
+	}
+
+	// Proximity queries among many wandering entities: a linear scan per query against the
+	// grid, and keeping the grid current as a tenth of them move each tick
+	void benchmarkSpatialGrid() {
+		const size_t ENTITY_COUNT = 10000;
+		const size_t MOVING_COUNT = ENTITY_COUNT / 10;
+		const size_t QUERY_COUNT = 1000;
+		const float QUERY_RADIUS = 5.0f;
+		const float CELL_SIZE = 2.0f;
+		const int TICKS = 64;
+
+		OBJLoader mapLoader;
+		if (!mapLoader.loadOBJ("Assets/Dust2/Dust2.obj")) return;
+		FlythroughPath path;
+		if (!path.load("Assets/Benchmark/Dust2Flythrough.path")) return;
+		MapBVH bvh;
+		if (!bvh.build(mapLoader)) return;
+
+		// Spread around the route the way players crowd the playable parts of the map
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> step(-0.2f, 0.2f);
+		CharacterStore characters;
+		characters.reserve(ENTITY_COUNT);
+		for (size_t i = 0; i < ENTITY_COUNT; i++) {
+			glm::vec3 position = path.sample(unit(rng)).position + glm::vec3(offset(rng), -CharacterStore::EYE_HEIGHT, offset(rng));
+			characters.create(position, i % 2 ? CharacterStore::Team::T : CharacterStore::Team::CT, 0.0f);
+		}
+		std::vector<glm::vec3> queryCenters(QUERY_COUNT);
+		for (size_t q = 0; q < QUERY_COUNT; q++) {
+			queryCenters[q] = characters.getPositions()[(q * 7919) % ENTITY_COUNT];
+		}
+
+		SpatialGrid grid;
+		grid.initialize(bvh.getBoundsMin(), bvh.getBoundsMax(), CELL_SIZE);
+		grid.sync(characters);
+		std::cout << "spatial grid, " << ENTITY_COUNT << " entities, " << grid.getCellCount() << " cells of "
+			<< CELL_SIZE << " units" << std::endl;
+
+		std::vector<EntityHandle> found;
+		found.reserve(ENTITY_COUNT);
+		size_t scanFound = 0;
+		double scanMs = timeBest([&]() {
+			scanFound = 0;
+			const glm::vec3* positions = characters.getPositions();
+			float radiusSquared = QUERY_RADIUS * QUERY_RADIUS;
+			for (size_t q = 0; q < QUERY_COUNT; q++) {
+				found.clear();
+				for (size_t i = 0; i < ENTITY_COUNT; i++) {
+					glm::vec3 delta = positions[i] - queryCenters[q];
+					if (glm::dot(delta, delta) <= radiusSquared) found.push_back(characters.handleAt(i));
+				}
+				scanFound += found.size();
+			}
+		});
+		std::string queryName = std::to_string(QUERY_COUNT) + " radius queries, linear scan";
+		printResult(queryName.c_str(), scanMs, scanMs);
+
+		size_t gridFound = 0;
+		double gridMs = timeBest([&]() {
+			gridFound = 0;
+			for (size_t q = 0; q < QUERY_COUNT; q++) {
+				found.clear();
+				gridFound += grid.queryRadius(queryCenters[q], QUERY_RADIUS, found);
+			}
+		});
+		queryName = std::to_string(QUERY_COUNT) + " radius queries, grid";
+		printResult(queryName.c_str(), gridMs, scanMs);
+		std::cout << "    " << gridFound / QUERY_COUNT << " entities per query";
+		if (gridFound != scanFound) std::cout << ", differs from the scan (" << scanFound / QUERY_COUNT << ")";
+		std::cout << std::endl;
+
+		// Movers take a small random step each tick, like players walking
+		std::vector<size_t> movers(MOVING_COUNT);
+		auto moveSome = [&](int tick) {
+			glm::vec3* positions = characters.getPositions();
+			for (size_t i = 0; i < MOVING_COUNT; i++) {
+				movers[i] = (tick * 104729 + i * 9973) % ENTITY_COUNT;
+				positions[movers[i]] += glm::vec3(step(rng), 0.0f, step(rng));
+			}
+		};
+
+		double rebuildMs = timeBest([&]() {
+			for (int tick = 0; tick < TICKS; tick++) {
+				moveSome(tick);
+				grid.clear();
+				grid.sync(characters);
+			}
+		}) / TICKS;
+		printResult("rebuild every tick", rebuildMs, rebuildMs);
+
+		double syncMs = timeBest([&]() {
+			for (int tick = 0; tick < TICKS; tick++) {
+				moveSome(tick);
+				grid.sync(characters);
+			}
+		}) / TICKS;
+		printResult("sync with the store", syncMs, rebuildMs);
+
+		double updateMs = timeBest([&]() {
+			for (int tick = 0; tick < TICKS; tick++) {
+				moveSome(tick);
+				const glm::vec3* positions = characters.getPositions();
+				for (size_t i = 0; i < MOVING_COUNT; i++) {
+					grid.update(characters.handleAt(movers[i]), positions[movers[i]]);
+				}
+			}
+		}) / TICKS;
+		std::string updateName = "update " + std::to_string(MOVING_COUNT) + " movers";
+		printResult(updateName.c_str(), updateMs, rebuildMs);
+	}
+
+	// Navmesh build against loading it from the cache, then a tick's worth of path requests
+	// from bots spread over the map to a handful of objectives
+	void benchmarkNavigation() {
+		const size_t BOT_COUNT = 256;
+		const size_t GOAL_COUNT = 8;
+		const char* CACHE_PATH = "Assets/Dust2/Dust2.navmesh";
+
+		OBJLoader mapLoader;
+		if (!mapLoader.loadOBJ("Assets/Dust2/Dust2.obj")) return;
+
+		NavMesh navMesh;
+		double buildMs = timeBest([&]() { navMesh.build(mapLoader); });
+		if (navMesh.isEmpty() || !navMesh.save(CACHE_PATH)) return;
+		uint64_t source = NavMesh::hashSource(mapLoader);
+		double loadMs = timeBest([&]() { navMesh.load(CACHE_PATH, source); });
+		std::cout << "navmesh, " << navMesh.getPolygonCount() << " polygons, " << navMesh.getClusterCount() << " clusters" << std::endl;
+		printResult("build", buildMs, buildMs);
+		printResult("load from cache", loadMs, buildMs);
+
+		// Bots and goals on the largest region, where the playable map is
+		std::vector<size_t> regionSizes(navMesh.getRegionCount(), 0);
+		for (size_t p = 0; p < navMesh.getPolygonCount(); p++) regionSizes[navMesh.getPolygon(static_cast<uint32_t>(p)).region]++;
+		uint32_t mainRegion = static_cast<uint32_t>(std::max_element(regionSizes.begin(), regionSizes.end()) - regionSizes.begin());
+		std::mt19937 rng(17);
+		auto randomSpot = [&]() {
+			while (true) {
+				const NavMesh::Polygon& polygon = navMesh.getPolygon(static_cast<uint32_t>(rng() % navMesh.getPolygonCount()));
+				if (polygon.region == mainRegion) return polygon.center;
+			}
+		};
+		std::vector<glm::vec3> goals(GOAL_COUNT);
+		for (glm::vec3& goal : goals) goal = randomSpot();
+		std::vector<glm::vec3> starts(BOT_COUNT);
+		for (glm::vec3& start : starts) start = randomSpot();
+
+		PathService paths(navMesh);
+		std::vector<PathResult> results(BOT_COUNT);
+		auto requestAll = [&](JobSystem* jobs) {
+			for (size_t i = 0; i < BOT_COUNT; i++) {
+				paths.request(starts[i], goals[i % GOAL_COUNT], results[i]);
+			}
+			while (paths.process(jobs) > 0) {}
+		};
+
+		std::cout << BOT_COUNT << " path requests to " << GOAL_COUNT << " goals" << std::endl;
+		double coldMs = timeBest([&]() {
+			paths.clearCache();
+			requestAll(nullptr);
+		});
+		printResult("searched", coldMs, coldMs);
+
+		size_t found = 0;
+		size_t waypoints = 0;
+		for (const PathResult& result : results) {
+			if (result.status != PathResult::Status::FOUND) continue;
+			found++;
+			waypoints += result.points.size();
+		}
+		std::cout << "    " << found << " found, " << (found ? waypoints / found : 0) << " waypoints on average" << std::endl;
+
+		double warmMs = timeBest([&]() { requestAll(nullptr); });
+		printResult("cached corridors", warmMs, coldMs);
+
+		JobSystem jobs;
+		jobs.initialize();
+		double jobMs = timeBest([&]() {
+			paths.clearCache();
+			requestAll(&jobs);
+		});
+		std::string jobName = "searched, " + std::to_string(jobs.getWorkerCount()) + " workers";
+		printResult(jobName.c_str(), jobMs, coldMs);
+		std::cout << "    " << std::setprecision(1) << coldMs * 1000.0 / BOT_COUNT << " us per search, "
+			<< warmMs * 1000.0 / BOT_COUNT << " us per cached request" << std::endl;
+	}
+
+	// AI cost per tick as the bot count grows: thinking is held to its budget, so only the
+	// cheap per-bot movement pass should grow with the population
+	void benchmarkBots() {
+		// The last run lifts the budget to show what it is holding back
+		struct Run { size_t botCount; double budgetUs; };
+		const Run RUNS[] = { { 9, 250.0 }, { 100, 250.0 }, { 1000, 250.0 }, { 1000, 1e9 } };
+		const int WARMUP_TICKS = 16;
+		const int TICKS = 256;
+		const int SIGHT_INTERVAL = 16;  // Sight is not what is measured here, so refresh it rarely
+		const float TICK_DELTA = 1.0f / 64.0f;
+
+		OBJLoader mapLoader;
+		if (!mapLoader.loadOBJ("Assets/Dust2/Dust2.obj")) return;
+		NavMesh navMesh;
+		if (!navMesh.loadOrBuild(mapLoader, "Assets/Dust2/Dust2.navmesh")) return;
+		MapBVH bvh;
+		if (!bvh.build(mapLoader)) return;
+
+		std::vector<size_t> regionSizes(navMesh.getRegionCount(), 0);
+		for (size_t p = 0; p < navMesh.getPolygonCount(); p++) regionSizes[navMesh.getPolygon(static_cast<uint32_t>(p)).region]++;
+		uint32_t mainRegion = static_cast<uint32_t>(std::max_element(regionSizes.begin(), regionSizes.end()) - regionSizes.begin());
+
+		JobSystem jobs;
+		jobs.initialize();
+		std::cout << "bot AI, " << jobs.getWorkerCount() << " workers" << std::endl;
+
+		for (const Run& run : RUNS) {
+			size_t botCount = run.botCount;
+			std::mt19937 rng(23);
+			CharacterStore characters;
+			PathService paths(navMesh);
+			BotSystem bots(navMesh, paths);
+			bots.setThinkBudget(run.budgetUs);
+			for (size_t i = 0; i < botCount; i++) {
+				glm::vec3 home;
+				do {
+					const NavMesh::Polygon& polygon = navMesh.getPolygon(static_cast<uint32_t>(rng() % navMesh.getPolygonCount()));
+					home = polygon.center;
+					if (polygon.region == mainRegion) break;
+				} while (true);
+				bots.add(characters.create(home, i % 2 ? CharacterStore::Team::T : CharacterStore::Team::CT, 0.0f), home);
+			}
+
+			SpatialGrid grid;
+			grid.initialize(bvh.getBoundsMin(), bvh.getBoundsMax(), 2.0f);
+			LineOfSight sight(bvh);
+			double totalMs = 0.0, worstMs = 0.0, pathMs = 0.0;
+			size_t thinks = 0;
+			int engaged = 0;
+			for (int tick = -WARMUP_TICKS; tick < TICKS; tick++) {
+				grid.sync(characters);
+				if (tick % SIGHT_INTERVAL == 0 || tick == -WARMUP_TICKS) sight.update(characters, &jobs);
+
+				long long start = CpuProfiler::now();
+				bots.update(characters, sight, grid, TICK_DELTA, &jobs);
+				long long thought = CpuProfiler::now();
+				paths.process(&jobs);
+				long long end = CpuProfiler::now();
+				characters.updateModelMatrices(&jobs);
+				if (tick < 0) continue;
+
+				double updateMs = (thought - start) / 1000000.0;
+				totalMs += updateMs;
+				worstMs = std::max(worstMs, updateMs);
+				pathMs += (end - thought) / 1000000.0;
+				thinks += bots.getLastThinkCount();
+			}
+			for (size_t bot = 0; bot < bots.size(); bot++) {
+				if (bots.getMode(bot) == BotSystem::Mode::ENGAGE) engaged++;
+			}
+
+			std::cout << "  " << std::setw(5) << botCount << " bots, " << (run.budgetUs < 1e6 ? "budgeted  " : "unbudgeted") << "  " << std::fixed << std::setprecision(3)
+				<< totalMs / TICKS << " ms mean, " << worstMs << " ms worst per tick, "
+				<< thinks / TICKS << " thinking per tick, paths " << pathMs / TICKS << " ms, "
+				<< engaged << " engaged at the end" << std::endl;
+		}
+	}
+
+	// Snapshot replication to clients over loopback, on a clean link and through the loss and
+	// latency shim; the clock is simulated so the run does not wait out the latency
+	void benchmarkReplication() {
+		const size_t PLAYERS = 12;
+		const size_t CLIENTS = 10;
+		const int TICK_RATE = 64;
+		const int TICKS = 640;
+		const long long TICK_NS = 1000000000ll / TICK_RATE;
+		const LinkSettings LINKS[] = { LinkSettings(), LinkSettings(5.0f, 40.0f, 10.0f) };
+
+		SocketAddress loopback;
+		SocketAddress::parse("127.0.0.1", 0, loopback);
+		std::cout << "replication, " << PLAYERS << " players to " << CLIENTS << " clients at " << TICK_RATE << " Hz" << std::endl;
+
+		for (const LinkSettings& settings : LINKS) {
+			ReplicationServer server;
+			if (!server.open(0)) return;
+			server.setLink(settings);
+			loopback.port = server.getPort();
+
+			std::vector<std::unique_ptr<ReplicationClient>> clients;
+			for (size_t i = 0; i < CLIENTS; i++) {
+				clients.push_back(std::unique_ptr<ReplicationClient>(new ReplicationClient()));
+				if (!clients.back()->connect(loopback)) return;
+				clients.back()->setLink(settings);
+			}
+
+			// Players run circles of different sizes and switch weapons now and then
+			CharacterStore characters;
+			std::vector<uint8_t> weapons(PLAYERS, 0);
+			for (size_t i = 0; i < PLAYERS; i++) {
+				characters.create(glm::vec3(0.0f), i % 2 ? CharacterStore::Team::T : CharacterStore::Team::CT, 0.0f);
+			}
+
+			std::vector<Snapshot> sent(TICKS);
+			size_t mismatches = 0, checked = 0;
+			double serverMs = 0.0;
+			size_t fullBytes = 0;
+			for (int tick = 0; tick < TICKS; tick++) {
+				long long nowNs = tick * TICK_NS;
+				float t = tick / static_cast<float>(TICK_RATE);
+				for (size_t i = 0; i < PLAYERS; i++) {
+					float radius = 3.0f + i;
+					float angle = t * 4.0f / radius + i;
+					characters.setPosition(i, glm::vec3(std::cos(angle) * radius, 0.5f * std::sin(t + i), std::sin(angle) * radius));
+					characters.setYaw(i, glm::degrees(angle));
+					if ((tick + i * 37) % 200 == 0) weapons[i] = (weapons[i] + 1) % 3;
+				}
+				SnapshotCodec::capture(characters, weapons.data(), static_cast<uint32_t>(tick), sent[tick]);
+				if (tick == 0) {
+					BitWriter writer;
+					SnapshotCodec::encode(sent[tick], nullptr, writer);
+					fullBytes = writer.finish().size();
+				}
+
+				long long start = CpuProfiler::now();
+				server.receive(nowNs);
+				server.send(sent[tick], nowNs);
+				serverMs += (CpuProfiler::now() - start) / 1000000.0;
+
+				// Every decoded snapshot has to match what the server sent exactly
+				for (const std::unique_ptr<ReplicationClient>& client : clients) {
+					if (!client->update(nowNs)) continue;
+					const Snapshot& snapshot = client->getSnapshot();
+					const Snapshot& expected = sent[snapshot.tick];
+					checked++;
+					bool same = snapshot.entities.size() == expected.entities.size();
+					for (size_t e = 0; same && e < expected.entities.size(); e++) {
+						same = std::memcmp(&snapshot.entities[e], &expected.entities[e], sizeof(NetEntity)) == 0;
+					}
+					if (!same) mismatches++;
+				}
+			}
+
+			size_t received = 0, rejected = 0;
+			for (const std::unique_ptr<ReplicationClient>& client : clients) {
+				received += client->getSnapshotsReceived();
+				rejected += client->getSnapshotsRejected();
+			}
+			double perClientTick = static_cast<double>(server.getBytesSent()) / (CLIENTS * TICKS);
+			std::cout << "  " << (settings.lossPercent > 0.0f ? "5% loss, 40+10 ms" : "clean link       ") << std::fixed << std::setprecision(1)
+				<< "  " << perClientTick << " B per client per tick (full " << fullBytes << " B), "
+				<< 100.0 * server.getFullSnapshotsSent() / std::max<size_t>(server.getSnapshotsSent(), 1) << "% sent full, "
+				<< std::setprecision(1) << perClientTick * TICK_RATE * 8 / 1000.0 << " kbit/s" << std::endl;
+			std::cout << "  " << std::setw(19) << "" << received << " decoded, " << rejected << " stale, " << mismatches << "/" << checked
+				<< " mismatched, server " << std::setprecision(1) << serverMs * 1000.0 / TICKS << " us per tick" << std::endl;
+		}
+	}
+
+	// Linear blend of the server's own snapshots at a fractional tick; false if the
+	// character is not in both
+	bool sampleTruth(const std::vector<Snapshot>& truth, double tick, uint32_t index, glm::vec3& out) {
+		size_t from = static_cast<size_t>(tick);
+		if (from + 1 >= truth.size()) return false;
+		auto find = [index](const Snapshot& snapshot) -> const NetEntity* {
+			auto entity = std::lower_bound(snapshot.entities.begin(), snapshot.entities.end(), index,
+				[](const NetEntity& e, uint32_t i) { return e.index < i; });
+			return entity != snapshot.entities.end() && entity->index == index ? &*entity : nullptr;
+		};
+		const NetEntity* a = find(truth[from]);
+		const NetEntity* b = find(truth[from + 1]);
+		if (!a || !b) return false;
+		out = glm::mix(SnapshotCodec::getPosition(*a), SnapshotCodec::getPosition(*b), static_cast<float>(tick - from));
+		return true;
+	}
+
+	void benchmarkPrediction() {
+		const int TICK_RATE = 64;
+		const float TICK_DELTA = 1.0f / TICK_RATE;
+		const long long TICK_NS = 1000000000ll / TICK_RATE;
+		const int TICKS = 1280;
+		const int WARMUP_TICKS = 64;
+		const float INTERPOLATION_DELAY = 0.1f;
+		struct Run { const char* name; LinkSettings link; };
+		const Run RUNS[] = { { "clean link", LinkSettings() }, { "40+10 ms", LinkSettings(0.0f, 40.0f, 10.0f) },
+			{ "5% loss, 40+10 ms", LinkSettings(5.0f, 40.0f, 10.0f) }, { "25% loss, 80+20 ms", LinkSettings(25.0f, 80.0f, 20.0f) } };
+
+		MapAssets assets;
+		if (!assets.load("Assets/Dust2/Dust2.obj")) return;
+		std::cout << "prediction, one client against a local server with 8 bots at " << TICK_RATE << " Hz, link applied both ways" << std::endl;
+
+		for (const Run& run : RUNS) {
+			Match match(assets, 0);
+			match.spawnBots(4, 7);
+			if (!match.replicate(0, run.link)) return;
+			SocketAddress address;
+			SocketAddress::parse("127.0.0.1", match.getReplication()->getPort(), address);
+			ReplicationClient client;
+			if (!client.connect(address)) return;
+			client.setLink(run.link);
+
+			PlayerPrediction prediction(assets.getBvh());
+			SnapshotInterpolator interpolator(static_cast<float>(TICK_RATE), INTERPOLATION_DELAY);
+			std::vector<RemoteCharacter> remote;
+			std::vector<Snapshot> truth(TICKS);
+			const int SHOT_INTERVAL = 32;
+
+			double clientMs = 0.0, errorSum = 0.0, worstError = 0.0, unacknowledgedSum = 0.0;
+			size_t errorSamples = 0, predictedTicks = 0;
+			for (int tick = 0; tick < TICKS; tick++) {
+				long long nowNs = tick * TICK_NS;
+				long long start = CpuProfiler::now();
+
+				// Runs a pattern of walking, strafing and backing off while turning, switching weapons now and then
+				if (prediction.isStarted()) {
+					PlayerInput input = {};
+					const uint8_t PATTERN[] = { PlayerInput::FORWARD, PlayerInput::FORWARD | PlayerInput::LEFT, PlayerInput::BACK, PlayerInput::RIGHT };
+					input.buttons = PATTERN[(tick / 96) % 4];
+					input.weapon = static_cast<uint8_t>((tick / 192) % 3);
+					input.walking = true;
+					input.yaw = -90.0f + 60.0f * std::sin(tick * 0.01f);
+					input.pitch = 10.0f * std::sin(tick * 0.03f);
+
+					// Now and then fire at the nearest character in plain view, as drawn last frame
+					if (tick % SHOT_INTERVAL == 0) {
+						glm::vec3 eye = prediction.getEyePosition();
+						float nearest = 1e30f;
+						for (const RemoteCharacter& character : remote) {
+							glm::vec3 toChest = character.position + glm::vec3(0.0f, 0.7f, 0.0f) - eye;
+							float distance = glm::length(toChest);
+							if (distance >= nearest || distance < 1e-3f || assets.getBvh().raycastAny(eye, toChest / distance, distance)) continue;
+							nearest = distance;
+							input.buttons |= PlayerInput::FIRE;
+							input.yaw = glm::degrees(std::atan2(toChest.z, toChest.x));
+							input.pitch = glm::degrees(std::asin(toChest.y / distance));
+							input.viewTick = interpolator.getRenderTick();
+						}
+					}
+					prediction.predict(input, TICK_DELTA);
+					client.sendInput(input);
+				}
+
+				if (client.update(nowNs)) {
+					interpolator.push(client.getSnapshot());
+					if (client.hasPlayer()) {
+						if (!prediction.isStarted()) prediction.reset(client.getCorrection().state);
+						else prediction.reconcile(client.getCorrection());
+					}
+				}
+				interpolator.advance(TICK_DELTA);
+				interpolator.sample(client.getPlayerIndex(), remote);
+				clientMs += (CpuProfiler::now() - start) / 1000000.0;
+
+				// Remote characters against the server's truth at the same instant
+				if (tick >= WARMUP_TICKS) {
+					for (const RemoteCharacter& character : remote) {
+						glm::vec3 expected;
+						if (!sampleTruth(truth, interpolator.getRenderTick(), character.index, expected)) continue;
+						double error = glm::length(character.position - expected);
+						errorSum += error;
+						worstError = std::max(worstError, error);
+						errorSamples++;
+					}
+					unacknowledgedSum += prediction.getUnacknowledged();
+					predictedTicks++;
+				}
+
+				match.tick(TICK_DELTA);
+				SnapshotCodec::capture(match.getCharacters(), nullptr, static_cast<uint32_t>(tick), truth[tick]);
+			}
+
+			std::cout << "  " << std::left << std::setw(19) << run.name << std::right << std::fixed << std::setprecision(1)
+				<< prediction.getCorrections() << " corrections (worst " << std::setprecision(3) << prediction.getWorstCorrection() << "), "
+				<< match.getReplication()->getInputsSkipped() << " inputs lost, " << std::setprecision(1)
+				<< unacknowledgedSum / std::max<size_t>(predictedTicks, 1) << " ticks predicted ahead" << std::endl;
+			std::cout << "  " << std::setw(19) << "" << "remote error mean " << std::setprecision(3) << errorSum / std::max<size_t>(errorSamples, 1)
+				<< " worst " << worstError << ", " << interpolator.getUnderruns() << " underruns, client "
+				<< std::setprecision(1) << clientMs * 1000.0 / TICKS << " us per tick" << std::endl;
+			std::cout << "  " << std::setw(19) << "" << "shots " << match.getPlayerShotsHit() << "/" << match.getPlayerShotsFired()
+				<< " registered, " << match.getPlayerHitsRewound() << " of them only with rewinding" << std::endl;
+		}
+	}
+
+	void benchmarkLagCompensation() {
+		const size_t PLAYERS = 64;
+		const int TICK_RATE = 64;
+		const int TICKS = 256;
+		const int SHOTS = 20000;
+		const float REWIND_MS[] = { 0.0f, 50.0f, 100.0f, 250.0f, 1000.0f };
+		const float SPACING = 6.0f;
+		const float RADIUS = 2.0f;
+		const float SPEED = 7.0f;
+		const float CHEST = 0.7f;
+		// Model-space box a CT-sized player fills once scaled
+		const glm::vec3 BOX_MIN(-16.0f, 0.0f, -16.0f);
+		const glm::vec3 BOX_MAX(16.0f, 72.0f, 16.0f);
+
+		// Players run small circles on an 8 by 8 grid; positions are exact at any fractional tick
+		auto positionAt = [&](size_t i, double tick) {
+			float t = static_cast<float>(tick / TICK_RATE);
+			float angle = t * SPEED / RADIUS + i;
+			glm::vec3 center((i % 8) * SPACING - 21.0f, 0.0f, (i / 8) * SPACING - 21.0f);
+			return center + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * RADIUS;
+		};
+
+		CharacterStore characters;
+		LagCompensation history;
+		for (CharacterStore::Team team : { CharacterStore::Team::CT, CharacterStore::Team::T }) history.setCharacterBounds(team, BOX_MIN, BOX_MAX);
+		std::vector<EntityHandle> handles;
+		for (size_t i = 0; i < PLAYERS; i++) handles.push_back(characters.create(positionAt(i, 0.0), i % 2 ? CharacterStore::Team::T : CharacterStore::Team::CT, 0.0f));
+
+		double recordMs = 0.0;
+		for (int tick = 0; tick < TICKS; tick++) {
+			for (size_t i = 0; i < PLAYERS; i++) {
+				characters.setPosition(i, positionAt(i, tick));
+				characters.setYaw(i, tick * 3.0f + i * 10.0f);
+			}
+			long long start = CpuProfiler::now();
+			history.record(characters, static_cast<uint32_t>(tick));
+			recordMs += (CpuProfiler::now() - start) / 1000000.0;
+		}
+		std::cout << "lag compensation, " << PLAYERS << " players, " << LagCompensation::HISTORY_TICKS << " tick history ("
+			<< history.getMemoryUsage() / 1024 << " KB)" << std::endl;
+		std::cout << "  record" << std::setw(14) << "" << std::fixed << std::setprecision(2) << recordMs * 1000.0 / TICKS << " us per tick" << std::endl;
+
+		// Shots from overhead at each target's chest where the shooter saw it, checked rewound and unrewound
+		std::mt19937 rng(41);
+		const glm::vec3 shooter(0.0f, 40.0f, 0.0f);
+		double newest = TICKS - 1;
+		for (float rewindMs : REWIND_MS) {
+			std::vector<double> viewTicks(SHOTS);
+			std::vector<size_t> targets(SHOTS);
+			std::uniform_real_distribution<double> jitter(0.0, 1.0);
+			for (int shot = 0; shot < SHOTS; shot++) {
+				viewTicks[shot] = std::max(0.0, newest - rewindMs * TICK_RATE / 1000.0 - jitter(rng));
+				targets[shot] = rng() % PLAYERS;
+			}
+
+			size_t rewoundHits = 0, presentHits = 0;
+			RayHit hit;
+			long long start = CpuProfiler::now();
+			for (int shot = 0; shot < SHOTS; shot++) {
+				glm::vec3 chest = positionAt(targets[shot], viewTicks[shot]) + glm::vec3(0.0f, CHEST, 0.0f);
+				if (history.raycast(viewTicks[shot], shooter, chest - shooter, 100.0f, EntityHandle(), hit) && hit.character == handles[targets[shot]]) rewoundHits++;
+			}
+			double rewoundNs = static_cast<double>(CpuProfiler::now() - start) / SHOTS;
+			for (int shot = 0; shot < SHOTS; shot++) {
+				glm::vec3 chest = positionAt(targets[shot], viewTicks[shot]) + glm::vec3(0.0f, CHEST, 0.0f);
+				if (history.raycast(newest, shooter, chest - shooter, 100.0f, EntityHandle(), hit) && hit.character == handles[targets[shot]]) presentHits++;
+			}
+
+			std::cout << "  rewind " << std::setw(4) << std::setprecision(0) << rewindMs << " ms";
+			double clampedMs = (newest - history.clampTick(newest - rewindMs * TICK_RATE / 1000.0)) * 1000.0 / TICK_RATE;
+			if (clampedMs + 1.0 < rewindMs) std::cout << " (clamped to " << clampedMs << ")";
+			else std::cout << std::setw(17) << "";
+			std::cout << std::setprecision(0) << std::setw(6) << rewoundNs << " ns per shot, hit " << std::setprecision(1)
+				<< 100.0 * rewoundHits / SHOTS << "% rewound, " << 100.0 * presentHits / SHOTS << "% unrewound" << std::endl;
+		}
+	}
+
+	void benchmarkJobSystem() {
+		const size_t ELEMENT_COUNT = 1 << 22;
+		const size_t GRAIN_SIZE = 1 << 14;
+		const int TINY_JOB_COUNT = 100000;
+
+		JobSystem jobs;
+		jobs.initialize();
+		unsigned int threadCount = jobs.getWorkerCount();
+		std::cout << "Job system: " << threadCount << " workers" << std::endl;
+
+		std::vector<float> input(ELEMENT_COUNT), output(ELEMENT_COUNT);
+		for (size_t i = 0; i < ELEMENT_COUNT; i++) {
+			input[i] = static_cast<float>(i % 1000) * 0.01f;
+		}
+
+		// Throughput: the same kernel split into GRAIN_SIZE chunks
+		std::cout << "parallel kernel, " << ELEMENT_COUNT << " elements, grain " << GRAIN_SIZE << std::endl;
+		double serialMs = timeBest([&]() { heavyKernel(input.data(), output.data(), 0, ELEMENT_COUNT); });
+		printResult("serial", serialMs, serialMs);
+
+		double jobMs = timeBest([&]() {
+			jobs.parallelFor(ELEMENT_COUNT, GRAIN_SIZE, [&](size_t begin, size_t end) {
+				heavyKernel(input.data(), output.data(), begin, end);
+			});
+		});
+		printResult("JobSystem::parallelFor", jobMs, serialMs);
+
+		double asyncMs = timeBest([&]() {
+			std::vector<std::future<void>> futures;
+			for (size_t begin = 0; begin < ELEMENT_COUNT; begin += GRAIN_SIZE) {
+				futures.push_back(std::async(std::launch::async, heavyKernel, input.data(), output.data(), begin, std::min(begin + GRAIN_SIZE, ELEMENT_COUNT)));
+			}
+			for (auto& future : futures) future.get();
+		});
+		printResult("std::async", asyncMs, serialMs);
+
+		{
+			MutexQueuePool pool(threadCount);
+			double queueMs = timeBest([&]() {
+				for (size_t begin = 0; begin < ELEMENT_COUNT; begin += GRAIN_SIZE) {
+					size_t end = std::min(begin + GRAIN_SIZE, ELEMENT_COUNT);
+					pool.submit([&input, &output, begin, end]() { heavyKernel(input.data(), output.data(), begin, end); });
+				}
+				pool.waitIdle();
+			});
+			printResult("mutex queue", queueMs, serialMs);
+		}
+
+		// Overhead: many near-empty jobs, where scheduling cost dominates
+		std::cout << "scheduling overhead, " << TINY_JOB_COUNT << " tiny jobs" << std::endl;
+		std::atomic<int> sink(0);
+		double tinySerialMs = timeBest([&]() {
+			for (int i = 0; i < TINY_JOB_COUNT; i++) sink.fetch_add(1, std::memory_order_relaxed);
+		});
+		printResult("serial", tinySerialMs, tinySerialMs);
+
+		double tinyJobMs = timeBest([&]() {
+			JobCounter counter;
+			for (int i = 0; i < TINY_JOB_COUNT; i++) {
+				jobs.submit(counter, &incrementJob, &sink);
+			}
+			jobs.wait(counter);
+		});
+		printResult("JobSystem::submit", tinyJobMs, tinySerialMs);
+
+		{
+			MutexQueuePool pool(threadCount);
+			double tinyQueueMs = timeBest([&]() {
+				for (int i = 0; i < TINY_JOB_COUNT; i++) {
+					pool.submit([&sink]() { sink.fetch_add(1, std::memory_order_relaxed); });
+				}
+				pool.waitIdle();
+			});
+			printResult("mutex queue", tinyQueueMs, tinySerialMs);
+		}
+		// std::async is left out here: 100k threads would measure thread creation, not scheduling
+	}
+}
+
+bool Microbenchmarks::run(const std::string& name) {
+	bool all = name == "all";
+	bool found = false;
+
+	if (all || name == "jobs") {
+		benchmarkJobSystem();
+		found = true;
+	}
+
+	if (all || name == "entities") {
+		benchmarkEntities();
+		found = true;
+	}
+
+	if (all || name == "transforms") {
+		benchmarkTransforms();
+		found = true;
+	}
+
+	if (all || name == "collision") {
+		benchmarkCollision();
+		found = true;
+	}
+
+	if (all || name == "raycast") {
+		benchmarkRaycast();
+		found = true;
+	}
+
+	if (all || name == "los") {
+		benchmarkLineOfSight();
+		found = true;
+	}
+
+	if (all || name == "grid") {
+		benchmarkSpatialGrid();
+		found = true;
+	}
+
+	if (all || name == "nav") {
+		benchmarkNavigation();
+		found = true;
+	}
+
+	if (all || name == "bots") {
+		benchmarkBots();
+		found = true;
+	}
+
+	if (all || name == "replication") {
+		benchmarkReplication();
+		found = true;
+	}
+
+	if (all || name == "prediction") {
+		benchmarkPrediction();
+		found = true;
+	}
+
+	if (all || name == "lagcomp") {
+		benchmarkLagCompensation();
+		found = true;
+	}
+
+	if (!found) {
+		std::cerr << "Unknown microbenchmark: " << name << " (available: all, jobs, entities, transforms, collision, raycast, los, grid, nav, bots, replication, prediction, lagcomp)" << std::endl;
+	}
+	return found;
+}
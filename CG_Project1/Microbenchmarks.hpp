@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Standalone CPU benchmarks for engine subsystems, run with --microbench <name> before any
+// window or GL context exists. Results go to stdout.
+namespace Microbenchmarks {
+	// "all" runs everything; returns false for an unknown name
+	bool run(const std::string& name);
+}
@@ -0,0 +1,905 @@
+#include "NavMesh.hpp"
+#include "OBJLoader.hpp"
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+namespace {
+	// Grid resolution and the character it is built for; the character matches CharacterController
+	const float CELL_SIZE = 0.25f;
+	const float AGENT_HEIGHT = 1.125f;
+	const float AGENT_RADIUS = 0.25f;
+	const float MAX_CLIMB = 0.28f;
+	const float WALKABLE_NORMAL_Y = 0.7f;
+
+	// Polygons never cross tiles of this many cells, which also caps their size
+	const int TILE_CELLS = 32;
+
+	// Smaller regions are ledges and specks on top of walls that nobody should path to
+	const size_t MIN_REGION_CELLS = 16;
+
+	// How far around a position findPolygon looks when nothing is right under it
+	const int FIND_RADIUS_CELLS = 4;
+
+	const char CACHE_MAGIC[4] = { 'N', 'A', 'V', 'M' };
+	const uint32_t CACHE_VERSION = 1;
+
+	// Column neighbours, in the order of Cell::neighbours
+	enum Direction { MINUS_X, PLUS_Z, PLUS_X, MINUS_Z };
+	const int DIRECTION_X[4] = { -1, 0, 1, 0 };
+	const int DIRECTION_Z[4] = { 0, 1, 0, -1 };
+
+	// Part of a triangle inside one column
+	struct Fragment {
+		uint32_t column;
+		float bottom;
+		float top;
+		bool walkable;
+	};
+
+	// Merged solid range of a column
+	struct Span {
+		float bottom;
+		float top;
+		bool walkable;
+	};
+
+	// Room for a standing character on top of a span
+	struct Cell {
+		float floor;
+		float ceiling;
+		uint32_t neighbours[4];
+		uint32_t region;
+		uint32_t polygon;
+	};
+
+	// Cell range of one polygon; cells are stored row by row
+	struct Rect {
+		int x;
+		int z;
+		int width;
+		int depth;
+		uint32_t firstCell;
+	};
+
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t source;
+		float origin[3];
+		float cellSize;
+		int32_t width;
+		int32_t depth;
+		uint32_t regionCount;
+		uint32_t polygonCount;
+		uint32_t linkCount;
+		uint32_t clusterCount;
+		uint32_t clusterLinkCount;
+		uint32_t floorCount;
+	};
+
+	// Splits a convex polygon where the axis coordinate equals offset. Vertices on the line go to both sides.
+	void dividePolygon(const glm::vec3* in, int count, glm::vec3* below, int& belowCount, glm::vec3* above, int& aboveCount, float offset, int axis) {
+		float distances[12];
+		for (int i = 0; i < count; i++) {
+			distances[i] = offset - in[i][axis];
+		}
+
+		belowCount = 0;
+		aboveCount = 0;
+		for (int i = 0, j = count - 1; i < count; j = i, i++) {
+			bool previousBelow = distances[j] >= 0.0f;
+			bool currentBelow = distances[i] >= 0.0f;
+			if (previousBelow != currentBelow) {
+				float s = distances[j] / (distances[j] - distances[i]);
+				glm::vec3 crossing = in[j] + (in[i] - in[j]) * s;
+				below[belowCount++] = crossing;
+				above[aboveCount++] = crossing;
+				if (distances[i] > 0.0f) below[belowCount++] = in[i];
+				else if (distances[i] < 0.0f) above[aboveCount++] = in[i];
+			}
+			else {
+				if (distances[i] >= 0.0f) {
+					below[belowCount++] = in[i];
+					if (distances[i] != 0.0f) continue;
+				}
+				above[aboveCount++] = in[i];
+			}
+		}
+	}
+
+	// Clips the triangle against every column it overlaps and records the height range of each piece
+	void rasterizeTriangle(const glm::vec3* triangle, bool walkable, const glm::vec3& origin, float cellSize, int width, int depth, std::vector<Fragment>& out) {
+		glm::vec3 low = glm::min(triangle[0], glm::min(triangle[1], triangle[2]));
+		glm::vec3 high = glm::max(triangle[0], glm::max(triangle[1], triangle[2]));
+		float inverse = 1.0f / cellSize;
+		int z0 = std::max(static_cast<int>(std::floor((low.z - origin.z) * inverse)), 0);
+		int z1 = std::min(static_cast<int>(std::floor((high.z - origin.z) * inverse)), depth - 1);
+		if (z0 > z1) return;
+
+		glm::vec3 rest[12], row[12], rowRest[12], cell[12], next[12];
+		int restCount = 3;
+		std::copy(triangle, triangle + 3, rest);
+
+		for (int z = z0; z <= z1; z++) {
+			int rowCount, nextCount;
+			dividePolygon(rest, restCount, row, rowCount, next, nextCount, origin.z + (z + 1) * cellSize, 2);
+			std::copy(next, next + nextCount, rest);
+			restCount = nextCount;
+			if (rowCount < 3) continue;
+
+			float rowLow = row[0].x, rowHigh = row[0].x;
+			for (int i = 1; i < rowCount; i++) {
+				rowLow = std::min(rowLow, row[i].x);
+				rowHigh = std::max(rowHigh, row[i].x);
+			}
+			int x0 = std::max(static_cast<int>(std::floor((rowLow - origin.x) * inverse)), 0);
+			int x1 = std::min(static_cast<int>(std::floor((rowHigh - origin.x) * inverse)), width - 1);
+
+			int rowRestCount = rowCount;
+			std::copy(row, row + rowCount, rowRest);
+			for (int x = x0; x <= x1; x++) {
+				int cellCount;
+				dividePolygon(rowRest, rowRestCount, cell, cellCount, next, nextCount, origin.x + (x + 1) * cellSize, 0);
+				std::copy(next, next + nextCount, rowRest);
+				rowRestCount = nextCount;
+				if (cellCount < 3) continue;
+
+				Fragment fragment = { static_cast<uint32_t>(z * width + x), cell[0].y, cell[0].y, walkable };
+				for (int i = 1; i < cellCount; i++) {
+					fragment.bottom = std::min(fragment.bottom, cell[i].y);
+					fragment.top = std::max(fragment.top, cell[i].y);
+				}
+				out.push_back(fragment);
+			}
+		}
+	}
+
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Scratch for one A* search at a time per thread; visit stamps spare clearing it between searches
+	struct SearchState {
+		struct OpenEntry {
+			float estimate;
+			float cost;
+			uint32_t node;
+			bool operator>(const OpenEntry& other) const { return estimate > other.estimate; }
+		};
+
+		std::vector<float> cost;
+		std::vector<uint32_t> parent;
+		std::vector<uint32_t> visited;
+		std::vector<OpenEntry> open;
+		uint32_t stamp;
+
+		SearchState() : cost(), parent(), visited(), open(), stamp(0) {}
+
+		void begin(size_t count) {
+			if (visited.size() < count) {
+				cost.resize(count);
+				parent.resize(count);
+				visited.resize(count, 0);
+			}
+			open.clear();
+			if (++stamp == 0) {
+				std::fill(visited.begin(), visited.end(), 0u);
+				stamp = 1;
+			}
+		}
+	};
+
+	thread_local SearchState polygonSearch;
+	thread_local SearchState clusterSearch;
+	thread_local std::vector<uint32_t> clusterRoute;
+	thread_local std::vector<uint32_t> allowedClusters;
+	thread_local uint32_t allowedStamp = 0;
+
+	// A* with straight-line costs between node positions. neighbours(node, visit) calls visit
+	// for every node reachable from node. Appends the route, start first.
+	template <typename Position, typename Neighbours>
+	bool findRoute(SearchState& state, size_t count, uint32_t start, uint32_t goal, const Position& position,
+		const Neighbours& neighbours, std::vector<uint32_t>& route) {
+		typedef SearchState::OpenEntry OpenEntry;
+		std::greater<OpenEntry> later;
+
+		state.begin(count);
+		glm::vec3 goalPosition = position(goal);
+		state.cost[start] = 0.0f;
+		state.parent[start] = NavMesh::NONE;
+		state.visited[start] = state.stamp;
+		OpenEntry first = { glm::distance(position(start), goalPosition), 0.0f, start };
+		state.open.push_back(first);
+
+		while (!state.open.empty()) {
+			std::pop_heap(state.open.begin(), state.open.end(), later);
+			OpenEntry entry = state.open.back();
+			state.open.pop_back();
+			if (entry.cost > state.cost[entry.node]) continue;  // Reached more cheaply since it was queued
+
+			if (entry.node == goal) {
+				size_t begin = route.size();
+				for (uint32_t node = goal; node != NavMesh::NONE; node = state.parent[node]) {
+					route.push_back(node);
+				}
+				std::reverse(route.begin() + begin, route.end());
+				return true;
+			}
+
+			glm::vec3 from = position(entry.node);
+			neighbours(entry.node, [&](uint32_t next) {
+				glm::vec3 to = position(next);
+				float cost = entry.cost + glm::distance(from, to);
+				if (state.visited[next] == state.stamp && cost >= state.cost[next]) return;
+				state.visited[next] = state.stamp;
+				state.cost[next] = cost;
+				state.parent[next] = entry.node;
+				OpenEntry queued = { cost + glm::distance(to, goalPosition), cost, next };
+				state.open.push_back(queued);
+				std::push_heap(state.open.begin(), state.open.end(), later);
+			});
+		}
+		return false;
+	}
+
+	// Twice the signed area of abc on the XZ plane; positive when c is to the right of ab
+	float triangleArea2(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		return (c.x - a.x) * (b.z - a.z) - (b.x - a.x) * (c.z - a.z);
+	}
+
+	bool samePoint(const glm::vec3& a, const glm::vec3& b) {
+		float dx = a.x - b.x;
+		float dz = a.z - b.z;
+		return dx * dx + dz * dz < 1e-8f;
+	}
+
+	template <typename T>
+	void writeArray(std::ofstream& out, const std::vector<T>& values) {
+		if (!values.empty()) out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	template <typename T>
+	bool readArray(std::ifstream& in, std::vector<T>& values, size_t count) {
+		values.resize(count);
+		if (count > 0) in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+		return static_cast<bool>(in);
+	}
+}
+
+const uint32_t NavMesh::NONE;
+
+NavMesh::NavMesh()
+	: polygons(), links(), clusters(), clusterLinks(), columnFloors(), floors(), origin(0.0f), cellSize(CELL_SIZE)
+	, width(0), depth(0), regionCount(0), sourceHash(0) {}
+
+void NavMesh::clear() {
+	polygons.clear();
+	links.clear();
+	clusters.clear();
+	clusterLinks.clear();
+	columnFloors.clear();
+	floors.clear();
+	origin = glm::vec3(0.0f);
+	cellSize = CELL_SIZE;
+	width = 0;
+	depth = 0;
+	regionCount = 0;
+	sourceHash = 0;
+}
+
+uint64_t NavMesh::hashSource(const OBJLoader& loader) {
+	uint64_t hash = 14695981039346656037ull;
+	const float settings[] = { CELL_SIZE, AGENT_HEIGHT, AGENT_RADIUS, MAX_CLIMB, WALKABLE_NORMAL_Y, static_cast<float>(TILE_CELLS), static_cast<float>(MIN_REGION_CELLS) };
+	hash = hashBytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+	hash = hashBytes(hash, settings, sizeof(settings));
+
+	for (const Material& material : loader.getMaterials()) {
+		for (size_t i = 0; i + 2 < material.indices.size(); i += 3) {
+			for (int corner = 0; corner < 3; corner++) {
+				const glm::vec3& vertex = material.vertices[material.indices[i + corner]];
+				hash = hashBytes(hash, &vertex, sizeof(vertex));
+			}
+		}
+	}
+	return hash;
+}
+
+bool NavMesh::build(const OBJLoader& loader) {
+	PROFILE_SCOPE("NavMesh::build");
+	clear();
+
+	// Triangle soup, walkable ones flagged by slope; windings in the map are not consistent
+	std::vector<glm::vec3> vertices;
+	std::vector<uint8_t> walkable;
+	glm::vec3 boundsMin(FLT_MAX);
+	glm::vec3 boundsMax(-FLT_MAX);
+	for (const Material& material : loader.getMaterials()) {
+		for (size_t i = 0; i + 2 < material.indices.size(); i += 3) {
+			glm::vec3 v0 = material.vertices[material.indices[i]];
+			glm::vec3 v1 = material.vertices[material.indices[i + 1]];
+			glm::vec3 v2 = material.vertices[material.indices[i + 2]];
+			glm::vec3 normal = glm::cross(v1 - v0, v2 - v0);
+			float length = glm::length(normal);
+			vertices.push_back(v0);
+			vertices.push_back(v1);
+			vertices.push_back(v2);
+			walkable.push_back(length > 0.0f && std::fabs(normal.y) / length >= WALKABLE_NORMAL_Y);
+			boundsMin = glm::min(boundsMin, glm::min(v0, glm::min(v1, v2)));
+			boundsMax = glm::max(boundsMax, glm::max(v0, glm::max(v1, v2)));
+		}
+	}
+	if (walkable.empty()) {
+		std::cerr << "NavMesh: no triangles to build from" << std::endl;
+		return false;
+	}
+
+	origin = boundsMin;
+	width = std::max(static_cast<int>(std::ceil((boundsMax.x - boundsMin.x) / cellSize)), 1);
+	depth = std::max(static_cast<int>(std::ceil((boundsMax.z - boundsMin.z) / cellSize)), 1);
+	size_t columnCount = static_cast<size_t>(width) * depth;
+
+	// Voxelize: every triangle becomes height ranges in the columns it covers
+	std::vector<Fragment> fragments;
+	fragments.reserve(walkable.size() * 16);
+	for (size_t t = 0; t < walkable.size(); t++) {
+		rasterizeTriangle(&vertices[t * 3], walkable[t] != 0, origin, cellSize, width, depth, fragments);
+	}
+	std::sort(fragments.begin(), fragments.end(), [](const Fragment& a, const Fragment& b) {
+		return a.column != b.column ? a.column < b.column : a.bottom < b.bottom;
+	});
+
+	// Merge overlapping fragments into solid spans. When two tops are within a step of each
+	// other either can be stood on; otherwise the higher one decides.
+	std::vector<uint32_t> columnCells(columnCount + 1, 0);
+	std::vector<Cell> cells;
+	std::vector<Span> spans;
+	size_t nextFragment = 0;
+	for (size_t column = 0; column < columnCount; column++) {
+		columnCells[column] = static_cast<uint32_t>(cells.size());
+		spans.clear();
+		while (nextFragment < fragments.size() && fragments[nextFragment].column == column) {
+			const Fragment& fragment = fragments[nextFragment++];
+			if (!spans.empty() && fragment.bottom <= spans.back().top) {
+				Span& span = spans.back();
+				if (fragment.top > span.top) {
+					span.walkable = fragment.top - span.top <= MAX_CLIMB ? (span.walkable || fragment.walkable) : fragment.walkable;
+					span.top = fragment.top;
+				}
+				else if (span.top - fragment.top <= MAX_CLIMB) {
+					span.walkable = span.walkable || fragment.walkable;
+				}
+			}
+			else {
+				Span span = { fragment.bottom, fragment.top, fragment.walkable };
+				spans.push_back(span);
+			}
+		}
+
+		for (size_t s = 0; s < spans.size(); s++) {
+			float ceiling = s + 1 < spans.size() ? spans[s + 1].bottom : FLT_MAX;
+			if (!spans[s].walkable || ceiling - spans[s].top < AGENT_HEIGHT) continue;
+			Cell cell = { spans[s].top, ceiling, { NONE, NONE, NONE, NONE }, NONE, NONE };
+			cells.push_back(cell);
+		}
+	}
+	columnCells[columnCount] = static_cast<uint32_t>(cells.size());
+	fragments.clear();
+	fragments.shrink_to_fit();
+
+	// Link cells a character can step between: a small height change and room to stand in both
+	for (int z = 0; z < depth; z++) {
+		for (int x = 0; x < width; x++) {
+			size_t column = static_cast<size_t>(z) * width + x;
+			for (uint32_t i = columnCells[column]; i < columnCells[column + 1]; i++) {
+				for (int d = 0; d < 4; d++) {
+					int nx = x + DIRECTION_X[d];
+					int nz = z + DIRECTION_Z[d];
+					if (nx < 0 || nz < 0 || nx >= width || nz >= depth) continue;
+					size_t neighbourColumn = static_cast<size_t>(nz) * width + nx;
+					float bestClimb = FLT_MAX;
+					for (uint32_t j = columnCells[neighbourColumn]; j < columnCells[neighbourColumn + 1]; j++) {
+						float climb = std::fabs(cells[j].floor - cells[i].floor);
+						float room = std::min(cells[i].ceiling, cells[j].ceiling) - std::max(cells[i].floor, cells[j].floor);
+						if (climb <= MAX_CLIMB && room >= AGENT_HEIGHT && climb < bestClimb) {
+							cells[i].neighbours[d] = j;
+							bestClimb = climb;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Erode: a cell within a radius of an edge can't hold a character's centre
+	int erosion = static_cast<int>(std::ceil(AGENT_RADIUS / cellSize - 0.001f));
+	std::vector<uint8_t> removed(cells.size(), 0);
+	std::vector<uint32_t> border;
+	for (int pass = 0; pass < erosion; pass++) {
+		border.clear();
+		for (uint32_t i = 0; i < cells.size(); i++) {
+			if (removed[i]) continue;
+			for (int d = 0; d < 4; d++) {
+				uint32_t n = cells[i].neighbours[d];
+				if (n == NONE || removed[n]) {
+					border.push_back(i);
+					break;
+				}
+			}
+		}
+		for (uint32_t i : border) removed[i] = 1;
+	}
+	for (uint32_t i = 0; i < cells.size(); i++) {
+		for (int d = 0; d < 4; d++) {
+			uint32_t& n = cells[i].neighbours[d];
+			if (removed[i] || (n != NONE && removed[n])) n = NONE;
+		}
+	}
+
+	// Regions: connected cells, dropping the tiny ones
+	std::vector<uint32_t> regionSizes;
+	std::vector<uint32_t> stack;
+	for (uint32_t seed = 0; seed < cells.size(); seed++) {
+		if (removed[seed] || cells[seed].region != NONE) continue;
+		uint32_t region = static_cast<uint32_t>(regionSizes.size());
+		uint32_t size = 0;
+		cells[seed].region = region;
+		stack.push_back(seed);
+		while (!stack.empty()) {
+			uint32_t i = stack.back();
+			stack.pop_back();
+			size++;
+			for (int d = 0; d < 4; d++) {
+				uint32_t n = cells[i].neighbours[d];
+				if (n != NONE && cells[n].region == NONE) {
+					cells[n].region = region;
+					stack.push_back(n);
+				}
+			}
+		}
+		regionSizes.push_back(size);
+	}
+	std::vector<uint32_t> regionRemap(regionSizes.size(), NONE);
+	for (size_t r = 0; r < regionSizes.size(); r++) {
+		if (regionSizes[r] >= MIN_REGION_CELLS) regionRemap[r] = regionCount++;
+	}
+	for (Cell& cell : cells) {
+		if (cell.region != NONE) cell.region = regionRemap[cell.region];
+	}
+
+	// Polygons: grow a rectangle from each unclaimed cell, first along +x, then whole rows
+	// along +z while every cell of the next row is linked to the one before it
+	std::vector<Rect> rects;
+	std::vector<uint32_t> rectCells;
+	std::vector<uint32_t> row, nextRow;
+	for (int z = 0; z < depth; z++) {
+		for (int x = 0; x < width; x++) {
+			size_t column = static_cast<size_t>(z) * width + x;
+			for (uint32_t seed = columnCells[column]; seed < columnCells[column + 1]; seed++) {
+				if (cells[seed].region == NONE || cells[seed].polygon != NONE) continue;
+
+				uint32_t polygonIndex = static_cast<uint32_t>(polygons.size());
+				uint32_t region = cells[seed].region;
+				int tileEndX = std::min(width, (x / TILE_CELLS + 1) * TILE_CELLS);
+				int tileEndZ = std::min(depth, (z / TILE_CELLS + 1) * TILE_CELLS);
+				auto claimable = [&](uint32_t n) { return n != NONE && cells[n].polygon == NONE && cells[n].region == region; };
+
+				row.assign(1, seed);
+				while (x + static_cast<int>(row.size()) < tileEndX && claimable(cells[row.back()].neighbours[PLUS_X])) {
+					row.push_back(cells[row.back()].neighbours[PLUS_X]);
+				}
+
+				Rect rect = { x, z, static_cast<int>(row.size()), 0, static_cast<uint32_t>(rectCells.size()) };
+				while (true) {
+					for (uint32_t i : row) cells[i].polygon = polygonIndex;
+					rectCells.insert(rectCells.end(), row.begin(), row.end());
+					rect.depth++;
+					if (z + rect.depth >= tileEndZ) break;
+
+					nextRow.clear();
+					for (size_t k = 0; k < row.size(); k++) {
+						uint32_t n = cells[row[k]].neighbours[PLUS_Z];
+						if (!claimable(n) || (k > 0 && cells[nextRow.back()].neighbours[PLUS_X] != n)) break;
+						nextRow.push_back(n);
+					}
+					if (nextRow.size() != row.size()) break;
+					row.swap(nextRow);
+				}
+
+				Polygon polygon;
+				float low = FLT_MAX, high = -FLT_MAX;
+				for (uint32_t k = 0; k < static_cast<uint32_t>(rect.width * rect.depth); k++) {
+					low = std::min(low, cells[rectCells[rect.firstCell + k]].floor);
+					high = std::max(high, cells[rectCells[rect.firstCell + k]].floor);
+				}
+				uint32_t middle = rectCells[rect.firstCell + (rect.depth / 2) * rect.width + rect.width / 2];
+				polygon.boundsMin = glm::vec3(origin.x + rect.x * cellSize, low, origin.z + rect.z * cellSize);
+				polygon.boundsMax = glm::vec3(origin.x + (rect.x + rect.width) * cellSize, high, origin.z + (rect.z + rect.depth) * cellSize);
+				polygon.center = glm::vec3(origin.x + (rect.x + rect.width * 0.5f) * cellSize, cells[middle].floor, origin.z + (rect.z + rect.depth * 0.5f) * cellSize);
+				polygon.firstLink = 0;
+				polygon.linkCount = 0;
+				polygon.region = region;
+				polygon.cluster = NONE;
+				polygons.push_back(polygon);
+				rects.push_back(rect);
+			}
+		}
+	}
+
+	// Portals: runs of edge cells whose neighbours belong to the same polygon
+	for (uint32_t p = 0; p < polygons.size(); p++) {
+		const Rect& rect = rects[p];
+		polygons[p].firstLink = static_cast<uint32_t>(links.size());
+
+		for (int d = 0; d < 4; d++) {
+			bool alongZ = d == MINUS_X || d == PLUS_X;
+			int edgeLength = alongZ ? rect.depth : rect.width;
+			uint32_t runPolygon = NONE;
+			int runStart = 0;
+			float runStartHeight = 0.0f, runEndHeight = 0.0f;
+
+			for (int k = 0; k <= edgeLength; k++) {
+				uint32_t neighbourPolygon = NONE;
+				float height = 0.0f;
+				if (k < edgeLength) {
+					int rowIndex = alongZ ? k : (d == PLUS_Z ? rect.depth - 1 : 0);
+					int columnIndex = alongZ ? (d == PLUS_X ? rect.width - 1 : 0) : k;
+					uint32_t cell = rectCells[rect.firstCell + rowIndex * rect.width + columnIndex];
+					uint32_t n = cells[cell].neighbours[d];
+					if (n != NONE) {
+						neighbourPolygon = cells[n].polygon;
+						height = 0.5f * (cells[cell].floor + cells[n].floor);
+					}
+				}
+
+				if (neighbourPolygon == runPolygon && k < edgeLength) {
+					runEndHeight = height;
+					continue;
+				}
+
+				if (runPolygon != NONE) {
+					// Edge coordinates of the run, then left and right as seen crossing it
+					float edge = alongZ ? origin.x + (d == PLUS_X ? rect.x + rect.width : rect.x) * cellSize
+						: origin.z + (d == PLUS_Z ? rect.z + rect.depth : rect.z) * cellSize;
+					float from = (alongZ ? origin.z + rect.z * cellSize : origin.x + rect.x * cellSize) + runStart * cellSize;
+					float to = (alongZ ? origin.z + rect.z * cellSize : origin.x + rect.x * cellSize) + k * cellSize;
+					glm::vec3 low = alongZ ? glm::vec3(edge, runStartHeight, from) : glm::vec3(from, runStartHeight, edge);
+					glm::vec3 high = alongZ ? glm::vec3(edge, runEndHeight, to) : glm::vec3(to, runEndHeight, edge);
+					bool lowIsLeft = d == MINUS_X || d == PLUS_Z;
+					Link link = { runPolygon, lowIsLeft ? low : high, lowIsLeft ? high : low };
+					links.push_back(link);
+				}
+				runPolygon = neighbourPolygon;
+				runStart = k;
+				runStartHeight = height;
+				runEndHeight = height;
+			}
+		}
+		polygons[p].linkCount = static_cast<uint32_t>(links.size()) - polygons[p].firstLink;
+	}
+
+	// Clusters: polygons connected within one tile
+	std::vector<uint32_t> members;
+	for (uint32_t seed = 0; seed < polygons.size(); seed++) {
+		if (polygons[seed].cluster != NONE) continue;
+		uint32_t clusterIndex = static_cast<uint32_t>(clusters.size());
+		int tileX = rects[seed].x / TILE_CELLS;
+		int tileZ = rects[seed].z / TILE_CELLS;
+		size_t firstMember = members.size();
+		polygons[seed].cluster = clusterIndex;
+		stack.push_back(seed);
+		while (!stack.empty()) {
+			uint32_t p = stack.back();
+			stack.pop_back();
+			members.push_back(p);
+			for (uint32_t l = 0; l < polygons[p].linkCount; l++) {
+				uint32_t q = links[polygons[p].firstLink + l].polygon;
+				if (polygons[q].cluster == NONE && rects[q].x / TILE_CELLS == tileX && rects[q].z / TILE_CELLS == tileZ) {
+					polygons[q].cluster = clusterIndex;
+					stack.push_back(q);
+				}
+			}
+		}
+
+		Cluster cluster;
+		cluster.center = glm::vec3(0.0f);
+		for (size_t m = firstMember; m < members.size(); m++) {
+			cluster.center += polygons[members[m]].center;
+		}
+		cluster.center /= static_cast<float>(members.size() - firstMember);
+		cluster.firstLink = 0;
+		cluster.linkCount = 0;
+		clusters.push_back(cluster);
+	}
+
+	// Cluster graph: members are grouped by cluster in flood order, so walk them in runs
+	std::vector<uint32_t> neighbourClusters;
+	for (size_t m = 0; m < members.size();) {
+		uint32_t clusterIndex = polygons[members[m]].cluster;
+		neighbourClusters.clear();
+		for (; m < members.size() && polygons[members[m]].cluster == clusterIndex; m++) {
+			const Polygon& polygon = polygons[members[m]];
+			for (uint32_t l = 0; l < polygon.linkCount; l++) {
+				uint32_t other = polygons[links[polygon.firstLink + l].polygon].cluster;
+				if (other != clusterIndex) neighbourClusters.push_back(other);
+			}
+		}
+		std::sort(neighbourClusters.begin(), neighbourClusters.end());
+		neighbourClusters.erase(std::unique(neighbourClusters.begin(), neighbourClusters.end()), neighbourClusters.end());
+		clusters[clusterIndex].firstLink = static_cast<uint32_t>(clusterLinks.size());
+		clusters[clusterIndex].linkCount = static_cast<uint32_t>(neighbourClusters.size());
+		clusterLinks.insert(clusterLinks.end(), neighbourClusters.begin(), neighbourClusters.end());
+	}
+
+	// Floors per column, for finding the polygon under a position
+	columnFloors.assign(columnCount + 1, 0);
+	for (size_t column = 0; column < columnCount; column++) {
+		columnFloors[column] = static_cast<uint32_t>(floors.size());
+		for (uint32_t i = columnCells[column]; i < columnCells[column + 1]; i++) {
+			if (cells[i].polygon == NONE) continue;
+			Floor floor = { cells[i].floor, cells[i].polygon };
+			floors.push_back(floor);
+		}
+	}
+	columnFloors[columnCount] = static_cast<uint32_t>(floors.size());
+
+	sourceHash = hashSource(loader);
+
+	if (polygons.empty()) {
+		std::cerr << "NavMesh: nothing walkable" << std::endl;
+		return false;
+	}
+	std::cout << "NavMesh: " << polygons.size() << " polygons, " << clusters.size() << " clusters, "
+		<< regionCount << " regions" << std::endl;
+	return true;
+}
+
+bool NavMesh::save(const std::string& path) const {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+
+	CacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.source = sourceHash;
+	header.origin[0] = origin.x;
+	header.origin[1] = origin.y;
+	header.origin[2] = origin.z;
+	header.cellSize = cellSize;
+	header.width = width;
+	header.depth = depth;
+	header.regionCount = regionCount;
+	header.polygonCount = static_cast<uint32_t>(polygons.size());
+	header.linkCount = static_cast<uint32_t>(links.size());
+	header.clusterCount = static_cast<uint32_t>(clusters.size());
+	header.clusterLinkCount = static_cast<uint32_t>(clusterLinks.size());
+	header.floorCount = static_cast<uint32_t>(floors.size());
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	writeArray(out, polygons);
+	writeArray(out, links);
+	writeArray(out, clusters);
+	writeArray(out, clusterLinks);
+	writeArray(out, columnFloors);
+	writeArray(out, floors);
+	return static_cast<bool>(out);
+}
+
+bool NavMesh::load(const std::string& path, uint64_t expectedSource) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+
+	CacheHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+	if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION) {
+		std::cerr << "NavMesh: " << path << " is not a navmesh cache of this version" << std::endl;
+		return false;
+	}
+	if (header.source != expectedSource) {
+		std::cout << "NavMesh: " << path << " was built from a different map, rebuilding" << std::endl;
+		return false;
+	}
+	if (header.width <= 0 || header.depth <= 0 || static_cast<uint64_t>(header.width) * header.depth > (1ull << 26)) return false;
+
+	clear();
+	size_t columnCount = static_cast<size_t>(header.width) * header.depth;
+	bool ok = readArray(in, polygons, header.polygonCount)
+		&& readArray(in, links, header.linkCount)
+		&& readArray(in, clusters, header.clusterCount)
+		&& readArray(in, clusterLinks, header.clusterLinkCount)
+		&& readArray(in, columnFloors, columnCount + 1)
+		&& readArray(in, floors, header.floorCount);
+
+	// Indices are used unchecked later, so a damaged file must not get through
+	for (size_t p = 0; ok && p < polygons.size(); p++) {
+		const Polygon& polygon = polygons[p];
+		ok = static_cast<uint64_t>(polygon.firstLink) + polygon.linkCount <= links.size() && polygon.cluster < clusters.size();
+	}
+	for (size_t l = 0; ok && l < links.size(); l++) ok = links[l].polygon < polygons.size();
+	for (size_t c = 0; ok && c < clusters.size(); c++) {
+		ok = static_cast<uint64_t>(clusters[c].firstLink) + clusters[c].linkCount <= clusterLinks.size();
+	}
+	for (size_t l = 0; ok && l < clusterLinks.size(); l++) ok = clusterLinks[l] < clusters.size();
+	for (size_t c = 0; ok && c < columnCount; c++) ok = columnFloors[c] <= columnFloors[c + 1];
+	ok = ok && columnFloors[columnCount] == floors.size();
+	for (size_t f = 0; ok && f < floors.size(); f++) ok = floors[f].polygon < polygons.size();
+
+	if (!ok || polygons.empty()) {
+		std::cerr << "NavMesh: " << path << " is damaged" << std::endl;
+		clear();
+		return false;
+	}
+
+	origin = glm::vec3(header.origin[0], header.origin[1], header.origin[2]);
+	cellSize = header.cellSize;
+	width = header.width;
+	depth = header.depth;
+	regionCount = header.regionCount;
+	sourceHash = header.source;
+	return true;
+}
+
+bool NavMesh::loadOrBuild(const OBJLoader& loader, const std::string& cachePath) {
+	PROFILE_SCOPE("NavMesh::loadOrBuild");
+	if (load(cachePath, hashSource(loader))) {
+		std::cout << "NavMesh: " << polygons.size() << " polygons, " << clusters.size() << " clusters from " << cachePath << std::endl;
+		return true;
+	}
+	if (!build(loader)) return false;
+	if (!save(cachePath)) {
+		std::cerr << "NavMesh: could not write " << cachePath << std::endl;
+	}
+	return true;
+}
+
+uint32_t NavMesh::findPolygon(const glm::vec3& position) const {
+	if (floors.empty()) return NONE;
+
+	int cellX = static_cast<int>(std::floor((position.x - origin.x) / cellSize));
+	int cellZ = static_cast<int>(std::floor((position.z - origin.z) / cellSize));
+	uint32_t best = NONE;
+	float bestScore = FLT_MAX;
+
+	// Closest floor by distance, where floors above the feet count four times as far
+	for (int dz = -FIND_RADIUS_CELLS; dz <= FIND_RADIUS_CELLS; dz++) {
+		int z = cellZ + dz;
+		if (z < 0 || z >= depth) continue;
+		for (int dx = -FIND_RADIUS_CELLS; dx <= FIND_RADIUS_CELLS; dx++) {
+			int x = cellX + dx;
+			if (x < 0 || x >= width) continue;
+			size_t column = static_cast<size_t>(z) * width + x;
+			float horizontal = (dx * dx + dz * dz) * cellSize * cellSize;
+			for (uint32_t f = columnFloors[column]; f < columnFloors[column + 1]; f++) {
+				float below = position.y - floors[f].height;
+				if (below < -MAX_CLIMB) below *= 4.0f;
+				float score = horizontal + below * below;
+				if (score < bestScore) {
+					bestScore = score;
+					best = floors[f].polygon;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+bool NavMesh::findClusterRoute(uint32_t startCluster, uint32_t goalCluster, std::vector<uint32_t>& route) const {
+	route.clear();
+	return findRoute(clusterSearch, clusters.size(), startCluster, goalCluster,
+		[this](uint32_t c) { return clusters[c].center; },
+		[this](uint32_t c, const auto& visit) {
+			for (uint32_t l = 0; l < clusters[c].linkCount; l++) visit(clusterLinks[clusters[c].firstLink + l]);
+		}, route);
+}
+
+bool NavMesh::findCorridor(uint32_t startPolygon, uint32_t goalPolygon, std::vector<uint32_t>& corridor) const {
+	corridor.clear();
+	if (startPolygon >= polygons.size() || goalPolygon >= polygons.size()) return false;
+	if (polygons[startPolygon].region != polygons[goalPolygon].region) return false;
+
+	// Only polygons of the clusters on the coarse route are searched
+	uint32_t startCluster = polygons[startPolygon].cluster;
+	uint32_t goalCluster = polygons[goalPolygon].cluster;
+	if (allowedClusters.size() < clusters.size()) allowedClusters.resize(clusters.size(), 0);
+	if (++allowedStamp == 0) {
+		std::fill(allowedClusters.begin(), allowedClusters.end(), 0u);
+		allowedStamp = 1;
+	}
+	if (startCluster == goalCluster) {
+		allowedClusters[startCluster] = allowedStamp;
+	}
+	else if (findClusterRoute(startCluster, goalCluster, clusterRoute)) {
+		for (uint32_t c : clusterRoute) allowedClusters[c] = allowedStamp;
+	}
+
+	auto center = [this](uint32_t p) { return polygons[p].center; };
+	uint32_t stamp = allowedStamp;
+	bool found = findRoute(polygonSearch, polygons.size(), startPolygon, goalPolygon, center,
+		[this, stamp](uint32_t p, const auto& visit) {
+			for (uint32_t l = 0; l < polygons[p].linkCount; l++) {
+				uint32_t q = links[polygons[p].firstLink + l].polygon;
+				if (allowedClusters[polygons[q].cluster] == stamp) visit(q);
+			}
+		}, corridor);
+	if (found) return true;
+
+	// Same region, so a route exists; the cluster graph just did not capture it
+	return findRoute(polygonSearch, polygons.size(), startPolygon, goalPolygon, center,
+		[this](uint32_t p, const auto& visit) {
+			for (uint32_t l = 0; l < polygons[p].linkCount; l++) visit(links[polygons[p].firstLink + l].polygon);
+		}, corridor);
+}
+
+void NavMesh::stringPull(const glm::vec3& start, const glm::vec3& goal, const std::vector<uint32_t>& corridor, std::vector<glm::vec3>& points) const {
+	points.clear();
+	points.push_back(start);
+
+	// Portal left and right ends along the corridor, with the goal as the last, closed portal
+	thread_local std::vector<glm::vec3> lefts, rights;
+	lefts.clear();
+	rights.clear();
+	for (size_t i = 0; i + 1 < corridor.size(); i++) {
+		const Polygon& polygon = polygons[corridor[i]];
+		for (uint32_t l = 0; l < polygon.linkCount; l++) {
+			const Link& link = links[polygon.firstLink + l];
+			if (link.polygon == corridor[i + 1]) {
+				lefts.push_back(link.left);
+				rights.push_back(link.right);
+				break;
+			}
+		}
+	}
+	lefts.push_back(goal);
+	rights.push_back(goal);
+
+	// Funnel: narrow the left and right sides portal by portal; when one side crosses the
+	// other, its far end becomes a corner of the path and the funnel restarts from there
+	glm::vec3 apex = start, left = start, right = start;
+	size_t leftIndex = 0, rightIndex = 0;
+	for (size_t i = 0; i < lefts.size(); i++) {
+		if (triangleArea2(apex, right, rights[i]) <= 0.0f) {
+			if (samePoint(apex, right) || triangleArea2(apex, left, rights[i]) > 0.0f) {
+				right = rights[i];
+				rightIndex = i;
+			}
+			else {
+				apex = left;
+				if (!samePoint(points.back(), apex)) points.push_back(apex);
+				right = apex;
+				i = leftIndex;
+				rightIndex = leftIndex;
+				continue;
+			}
+		}
+		if (triangleArea2(apex, left, lefts[i]) >= 0.0f) {
+			if (samePoint(apex, left) || triangleArea2(apex, right, lefts[i]) < 0.0f) {
+				left = lefts[i];
+				leftIndex = i;
+			}
+			else {
+				apex = right;
+				if (!samePoint(points.back(), apex)) points.push_back(apex);
+				left = apex;
+				i = rightIndex;
+				leftIndex = rightIndex;
+				continue;
+			}
+		}
+	}
+	if (!samePoint(points.back(), goal) || points.size() == 1) points.push_back(goal);
+}
+
+size_t NavMesh::getMemoryUsage() const {
+	return vectorBytes(polygons) + vectorBytes(links) + vectorBytes(clusters) + vectorBytes(clusterLinks) + vectorBytes(columnFloors) + vectorBytes(floors);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class OBJLoader;
+
+// Walkable surface of the map for bots, built from the map's triangles along the lines of
+// Recast: triangles are voxelized into solid spans per grid column, the top of a walkable
+// span with room for a standing character above becomes a cell, cells are eroded by the
+// character radius and flood filled into connected regions, and every region is cut into
+// rectangles of cells that serve as the navigation polygons. Polygons never cross a tile
+// boundary; the connected polygons of a tile form a cluster, and searches plan over
+// clusters first.
+class NavMesh {
+public:
+	static const uint32_t NONE = 0xFFFFFFFFu;
+
+	struct Polygon {
+		glm::vec3 boundsMin;  // XZ extent of the rectangle, Y range of its floor
+		glm::vec3 boundsMax;
+		glm::vec3 center;     // On the floor
+		uint32_t firstLink;
+		uint32_t linkCount;
+		uint32_t region;      // Polygons in different regions can't reach each other
+		uint32_t cluster;
+	};
+
+	// Edge shared with a neighbouring polygon. Left and right are seen from this polygon
+	// looking into the neighbour, both on the floor.
+	struct Link {
+		uint32_t polygon;
+		glm::vec3 left;
+		glm::vec3 right;
+	};
+
+	struct Cluster {
+		glm::vec3 center;
+		uint32_t firstLink;  // Into the cluster links, which hold neighbouring cluster indices
+		uint32_t linkCount;
+	};
+
+	NavMesh();
+
+	// Builds from every material's triangles; false if nothing is walkable
+	bool build(const OBJLoader& loader);
+
+	// Loads the cache when it was built from the same triangles and settings, otherwise
+	// builds and writes it so the next start skips the build
+	bool loadOrBuild(const OBJLoader& loader, const std::string& cachePath);
+	bool save(const std::string& path) const;
+	bool load(const std::string& path, uint64_t expectedSource);
+
+	// Identifies the triangles and settings a mesh was built from
+	static uint64_t hashSource(const OBJLoader& loader);
+
+	// Polygon whose floor is under the position, or the closest floor within a metre or so;
+	// NONE if there is none
+	uint32_t findPolygon(const glm::vec3& position) const;
+
+	// Polygons from start to goal, both included. Plans over the cluster graph, then runs
+	// A* over the polygons of the clusters on that route only. False if unreachable.
+	bool findCorridor(uint32_t startPolygon, uint32_t goalPolygon, std::vector<uint32_t>& corridor) const;
+
+	// Replaces points with the shortest path through the corridor's portals (funnel
+	// algorithm), starting at start and ending at goal
+	void stringPull(const glm::vec3& start, const glm::vec3& goal, const std::vector<uint32_t>& corridor, std::vector<glm::vec3>& points) const;
+
+	const Polygon& getPolygon(uint32_t index) const { return polygons[index]; }
+	const Link* getLinks(uint32_t polygon) const { return &links[polygons[polygon].firstLink]; }
+	size_t getPolygonCount() const { return polygons.size(); }
+	size_t getClusterCount() const { return clusters.size(); }
+	size_t getRegionCount() const { return regionCount; }
+	uint64_t getSourceHash() const { return sourceHash; }
+	size_t getMemoryUsage() const;  // Heap bytes held
+	bool isEmpty() const { return polygons.empty(); }
+
+private:
+	// A walkable floor in a grid column, for finding the polygon under a position
+	struct Floor {
+		float height;
+		uint32_t polygon;
+	};
+
+	std::vector<Polygon> polygons;
+	std::vector<Link> links;
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> clusterLinks;
+	std::vector<uint32_t> columnFloors;  // First floor of each column, width * depth + 1 entries
+	std::vector<Floor> floors;
+	glm::vec3 origin;
+	float cellSize;
+	int width;
+	int depth;
+	uint32_t regionCount;
+	uint64_t sourceHash;
+
+	void clear();
+	bool findClusterRoute(uint32_t startCluster, uint32_t goalCluster, std::vector<uint32_t>& route) const;
+};
@@ -4,10 +4,14 @@
 #include <sstream>
 #include <glad/glad.h>
 #include <stb_image.h>
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
 
 OBJLoader::OBJLoader() : vertices(), uvs(), normals(), indices(), materials() {}
 
 bool OBJLoader::loadOBJ(const std::string& path) {
+	PROFILE_SCOPE("OBJLoader::loadOBJ");
+
 	std::ifstream objFile(path);
 	if (!objFile.is_open()) {
 		std::cerr << "Failed to open OBJ file: " << path << std::endl;
@@ -76,31 +80,53 @@ bool OBJLoader::loadOBJ(const std::string& path) {
 			// Triangulate the face (handle both triangles and quads)
 			for (size_t i = 2; i < vertexData.size(); i++) {
 				// For each triangle, process three vertices: 0, i-1, i
-				std::vector<size_t> triangleIndices = {0, i-1, i};
-				
-				for (size_t idx : triangleIndices) {
-					std::istringstream vertexStream(vertexData[idx]);
+				size_t triangleIndices[3] = {0, i-1, i};
+				int vIdx[3], uvIdx[3], nIdx[3];
+				bool valid = true;
+
+				for (int corner = 0; corner < 3; corner++) {
+					std::istringstream vertexStream(vertexData[triangleIndices[corner]]);
 					std::string vertexIndex, uvIndex, normalIndex;
 					
 					std::getline(vertexStream, vertexIndex, '/');
 					std::getline(vertexStream, uvIndex, '/');
 					std::getline(vertexStream, normalIndex);
 
-					int vIdx = std::stoi(vertexIndex) - 1;
-					int uvIdx = uvIndex.empty() ? -1 : std::stoi(uvIndex) - 1;
+					vIdx[corner] = std::stoi(vertexIndex) - 1;
+					uvIdx[corner] = uvIndex.empty() ? -1 : std::stoi(uvIndex) - 1;
+					nIdx[corner] = normalIndex.empty() ? -1 : std::stoi(normalIndex) - 1;
 
-					if (vIdx < 0 || static_cast<size_t>(vIdx) >= temp_vertices.size()) {
-						std::cerr << "Warning: Invalid vertex index" << std::endl;
-						continue;
+					if (vIdx[corner] < 0 || static_cast<size_t>(vIdx[corner]) >= temp_vertices.size()) {
+						valid = false;
 					}
+				}
 
-					currentMaterial->vertices.push_back(temp_vertices[vIdx]);
+				if (!valid) {
+					std::cerr << "Warning: Invalid vertex index" << std::endl;
+					continue;
+				}
+
+				// Flat normal used for corners that do not reference a vn entry
+				glm::vec3 edge1 = temp_vertices[vIdx[1]] - temp_vertices[vIdx[0]];
+				glm::vec3 edge2 = temp_vertices[vIdx[2]] - temp_vertices[vIdx[0]];
+				glm::vec3 faceNormal = glm::cross(edge1, edge2);
+				float faceNormalLength = glm::length(faceNormal);
+				faceNormal = faceNormalLength > 0.0f ? faceNormal / faceNormalLength : glm::vec3(0.0f, 1.0f, 0.0f);
+
+				for (int corner = 0; corner < 3; corner++) {
+					currentMaterial->vertices.push_back(temp_vertices[vIdx[corner]]);
 					
-					if (uvIdx >= 0 && static_cast<size_t>(uvIdx) < temp_uvs.size()) {
-						currentMaterial->uvs.push_back(temp_uvs[uvIdx]);
+					if (uvIdx[corner] >= 0 && static_cast<size_t>(uvIdx[corner]) < temp_uvs.size()) {
+						currentMaterial->uvs.push_back(temp_uvs[uvIdx[corner]]);
 					} else {
 						currentMaterial->uvs.push_back(glm::vec2(0.0f, 0.0f));
 					}
+
+					if (nIdx[corner] >= 0 && static_cast<size_t>(nIdx[corner]) < temp_normals.size()) {
+						currentMaterial->normals.push_back(temp_normals[nIdx[corner]]);
+					} else {
+						currentMaterial->normals.push_back(faceNormal);
+					}
 					
 					currentMaterial->indices.push_back(static_cast<unsigned int>(currentMaterial->vertices.size() - 1));
 				}
@@ -113,6 +139,8 @@ bool OBJLoader::loadOBJ(const std::string& path) {
 }
 
 bool OBJLoader::loadMTL(const std::string& mtlPath) {
+	PROFILE_SCOPE("OBJLoader::loadMTL");
+
 	std::ifstream mtlFile(mtlPath);
 	if (!mtlFile.is_open()) {
 		std::cerr << "Failed to open MTL file: " << mtlPath << std::endl;
@@ -144,17 +172,6 @@ bool OBJLoader::loadMTL(const std::string& mtlPath) {
 			}
 
 			material.textureFilename = texturePath;
-			material.textureID = loadTexture(texturePath);
-
-			if (material.textureID != 0) {
-				std::cout << "Successfully loaded texture for material " << material.name
-					<< " from path: " << texturePath
-					<< " with ID: " << material.textureID << std::endl;
-			}
-			else {
-				std::cerr << "Failed to load texture for material " << material.name
-					<< " from path: " << texturePath << std::endl;
-			}
 		}
 	}
 
@@ -166,7 +183,31 @@ bool OBJLoader::loadMTL(const std::string& mtlPath) {
 	return true;
 }
 
+bool OBJLoader::uploadTextures() {
+	PROFILE_SCOPE("OBJLoader::uploadTextures");
+
+	bool allLoaded = true;
+	for (Material& material : materials) {
+		if (material.textureFilename.empty() || material.textureID != 0) continue;
+		material.textureID = loadTexture(material.textureFilename);
+
+		if (material.textureID != 0) {
+			std::cout << "Successfully loaded texture for material " << material.name
+				<< " from path: " << material.textureFilename
+				<< " with ID: " << material.textureID << std::endl;
+		}
+		else {
+			std::cerr << "Failed to load texture for material " << material.name
+				<< " from path: " << material.textureFilename << std::endl;
+			allLoaded = false;
+		}
+	}
+	return allLoaded;
+}
+
 unsigned int OBJLoader::loadTexture(const std::string& textureFilename) {
+	PROFILE_SCOPE("OBJLoader::loadTexture");
+
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 	glBindTexture(GL_TEXTURE_2D, textureID);
@@ -213,4 +254,12 @@ const std::vector<Material>& OBJLoader::getMaterials() const {
 
 const std::vector<unsigned int>& OBJLoader::getIndices() const {
 	return indices;
-}
\ No newline at end of file
+}
+
+size_t OBJLoader::getMemoryUsage() const {
+	size_t bytes = vectorBytes(vertices) + vectorBytes(uvs) + vectorBytes(normals) + vectorBytes(indices) + vectorBytes(materials);
+	for (const Material& material : materials) {
+		bytes += vectorBytes(material.indices) + vectorBytes(material.vertices) + vectorBytes(material.uvs) + vectorBytes(material.normals);
+	}
+	return bytes;
+}
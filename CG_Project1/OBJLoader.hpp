@@ -12,18 +12,23 @@ struct Material {
 	std::vector<unsigned int> indices;  // Store indices for each material
 	std::vector<glm::vec3> vertices;    // Store vertices for each material
 	std::vector<glm::vec2> uvs;         // Store UVs for each material
+	std::vector<glm::vec3> normals;     // Store normals for each material (flat normal if the face has none)
 
-	Material() : name(), textureFilename(), textureID(0), indices(), vertices(), uvs() {}
+	Material() : name(), textureFilename(), textureID(0), indices(), vertices(), uvs(), normals() {}
 };
 
 class OBJLoader {
 public:
 	OBJLoader();
+	// Parses geometry and materials only and makes no GL calls, so it works with no context
 	bool loadOBJ(const std::string& path);
+	// Creates the GL textures of materials that have none yet; needs a current context
+	bool uploadTextures();
 	const std::vector<glm::vec3>& getVertices() const;
 	const std::vector<glm::vec2>& getUVs() const;
 	const std::vector<Material>& getMaterials() const;
 	const std::vector<unsigned int>& getIndices() const;
+	size_t getMemoryUsage() const;  // Heap bytes held by geometry, materials included
 
 private:
 	std::vector<glm::vec3> vertices;
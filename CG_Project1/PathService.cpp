@@ -0,0 +1,150 @@
+#include "PathService.hpp"
+#include "NavMesh.hpp"
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
+#include <algorithm>
+
+namespace {
+	const size_t DEFAULT_BATCH_LIMIT = 256;
+	const size_t DEFAULT_CACHE_CAPACITY = 1024;
+
+	// A search is a few dozen microseconds, so small jobs balance well
+	const size_t REQUEST_GRAIN = 8;
+}
+
+PathService::PathService(const NavMesh& navMesh)
+	: navMesh(navMesh), pending(), batch(), work(), batchLimit(DEFAULT_BATCH_LIMIT), cacheIndex(), cacheEntries()
+	, cacheCapacity(DEFAULT_CACHE_CAPACITY), nextEviction(0), cacheHits(0), cacheMisses(0) {}
+
+void PathService::request(const glm::vec3& start, const glm::vec3& goal, PathResult& result) {
+	result.status = PathResult::Status::PENDING;
+	result.fromCache = false;
+
+	for (Request& queued : pending) {
+		if (queued.result == &result) {
+			queued.start = start;
+			queued.goal = goal;
+			return;
+		}
+	}
+	Request request = { start, goal, &result };
+	pending.push_back(request);
+}
+
+void PathService::cancel(PathResult& result) {
+	auto found = std::find_if(pending.begin(), pending.end(), [&](const Request& queued) { return queued.result == &result; });
+	if (found == pending.end()) return;
+	pending.erase(found);
+	result.status = PathResult::Status::NONE;
+}
+
+void PathService::setCacheCapacity(size_t capacity) {
+	cacheCapacity = capacity;
+	clearCache();
+}
+
+void PathService::clearCache() {
+	cacheIndex.clear();
+	cacheEntries.clear();
+	nextEviction = 0;
+}
+
+void PathService::answer(size_t index) {
+	const Request& request = batch[index];
+	Work& item = work[index];
+	PathResult& result = *request.result;
+	item.cacheEntry = -1;
+	item.found = false;
+	result.points.clear();
+
+	uint32_t startPolygon = navMesh.findPolygon(request.start);
+	uint32_t goalPolygon = navMesh.findPolygon(request.goal);
+	if (startPolygon == NavMesh::NONE || goalPolygon == NavMesh::NONE) {
+		result.status = PathResult::Status::NOT_FOUND;
+		return;
+	}
+
+	// The cache is only read while the batch runs, so lookups need no lock
+	item.key = (static_cast<uint64_t>(startPolygon) << 32) | goalPolygon;
+	auto cached = cacheIndex.find(item.key);
+	const std::vector<uint32_t>* corridor;
+	if (cached != cacheIndex.end()) {
+		item.cacheEntry = static_cast<int>(cached->second);
+		corridor = &cacheEntries[cached->second].corridor;
+	}
+	else {
+		if (!navMesh.findCorridor(startPolygon, goalPolygon, item.corridor)) {
+			result.status = PathResult::Status::NOT_FOUND;
+			return;
+		}
+		corridor = &item.corridor;
+	}
+
+	item.found = true;
+	navMesh.stringPull(request.start, request.goal, *corridor, result.points);
+	result.fromCache = item.cacheEntry >= 0;
+	result.status = PathResult::Status::FOUND;
+}
+
+size_t PathService::process(JobSystem* jobs) {
+	PROFILE_SCOPE("PathService::process");
+	size_t count = std::min(pending.size(), batchLimit);
+	if (count == 0) return 0;
+
+	batch.assign(pending.begin(), pending.begin() + count);
+	pending.erase(pending.begin(), pending.begin() + count);
+	if (work.size() < count) work.resize(count);
+
+	if (navMesh.isEmpty()) {
+		for (size_t i = 0; i < count; i++) {
+			batch[i].result->points.clear();
+			batch[i].result->status = PathResult::Status::NOT_FOUND;
+		}
+		return count;
+	}
+
+	auto answerRange = [this](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) answer(i);
+	};
+	if (jobs) jobs->parallelFor(count, REQUEST_GRAIN, answerRange);
+	else answerRange(0, count);
+
+	// New corridors go into the cache once the batch is done
+	for (size_t i = 0; i < count; i++) {
+		Work& item = work[i];
+		if (!item.found) continue;
+		if (item.cacheEntry >= 0) {
+			cacheHits++;
+			continue;
+		}
+		cacheMisses++;
+		if (cacheCapacity == 0 || cacheIndex.count(item.key)) continue;
+
+		if (cacheEntries.size() < cacheCapacity) {
+			cacheIndex[item.key] = static_cast<uint32_t>(cacheEntries.size());
+			CacheEntry entry;
+			entry.key = item.key;
+			entry.corridor = item.corridor;
+			cacheEntries.push_back(entry);
+		}
+		else {
+			CacheEntry& entry = cacheEntries[nextEviction];
+			cacheIndex.erase(entry.key);
+			cacheIndex[item.key] = static_cast<uint32_t>(nextEviction);
+			entry.key = item.key;
+			entry.corridor = item.corridor;
+			nextEviction = (nextEviction + 1) % cacheCapacity;
+		}
+	}
+	return count;
+}
+
+size_t PathService::getMemoryUsage() const {
+	size_t bytes = vectorBytes(pending) + vectorBytes(batch) + vectorBytes(work) + vectorBytes(cacheEntries);
+	for (const Work& item : work) bytes += vectorBytes(item.corridor);
+	for (const CacheEntry& entry : cacheEntries) bytes += vectorBytes(entry.corridor);
+	// Buckets plus one node per entry, roughly what the common implementations allocate
+	bytes += cacheIndex.bucket_count() * sizeof(void*) + cacheIndex.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + 2 * sizeof(void*));
+	return bytes;
+}
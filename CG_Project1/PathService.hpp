@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+class NavMesh;
+class JobSystem;
+
+// Where the answer to a path request lands. The requester owns it and must keep it at the
+// same address until the request is answered or cancelled.
+struct PathResult {
+	enum class Status : uint8_t { NONE, PENDING, FOUND, NOT_FOUND };
+
+	Status status;
+	bool fromCache;                 // The corridor was reused from an earlier request
+	std::vector<glm::vec3> points;  // Start to goal, on the floor
+
+	PathResult() : status(Status::NONE), fromCache(false), points() {}
+};
+
+// Path queries for many bots at once. Requests queue up during a tick and process() answers
+// them as one batch spread over the job system, at most a batch limit of them per call so a
+// burst of requests costs a few ticks of latency instead of one long frame. Corridors are
+// cached by start and goal polygon, since bots keep travelling between the same spots.
+class PathService {
+public:
+	explicit PathService(const NavMesh& navMesh);
+
+	// Positions are at the feet. Re-requesting a pending result replaces its request.
+	void request(const glm::vec3& start, const glm::vec3& goal, PathResult& result);
+	void cancel(PathResult& result);
+
+	// Answers the oldest pending requests, up to the batch limit; returns how many
+	size_t process(JobSystem* jobs = nullptr);
+
+	void setBatchLimit(size_t limit) { batchLimit = limit > 0 ? limit : 1; }
+	void setCacheCapacity(size_t capacity);
+	void clearCache();
+
+	size_t getPendingCount() const { return pending.size(); }
+	size_t getCacheHits() const { return cacheHits; }
+	size_t getCacheMisses() const { return cacheMisses; }
+	size_t getMemoryUsage() const;  // Heap bytes held, the cache included
+
+private:
+	struct Request {
+		glm::vec3 start;
+		glm::vec3 goal;
+		PathResult* result;
+	};
+
+	// Per request of the batch being processed
+	struct Work {
+		uint64_t key;
+		int cacheEntry;  // -1 when the corridor was searched
+		bool found;
+		std::vector<uint32_t> corridor;
+	};
+
+	struct CacheEntry {
+		uint64_t key;
+		std::vector<uint32_t> corridor;
+	};
+
+	const NavMesh& navMesh;
+	std::vector<Request> pending;
+	std::vector<Request> batch;
+	std::vector<Work> work;
+	size_t batchLimit;
+
+	// Fixed number of entries, replaced oldest first
+	std::unordered_map<uint64_t, uint32_t> cacheIndex;
+	std::vector<CacheEntry> cacheEntries;
+	size_t cacheCapacity;
+	size_t nextEviction;
+
+	size_t cacheHits;
+	size_t cacheMisses;
+
+	void answer(size_t index);
+};
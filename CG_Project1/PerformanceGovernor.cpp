@@ -0,0 +1,106 @@
+#include "PerformanceGovernor.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+	const float MIN_SCALE = 0.5f;
+	const float MAX_SCALE = 1.0f;
+	const float SCALE_STEP = 0.05f;
+	const float MAX_LOD_BIAS = 1.5f;
+	const float LOD_BIAS_STEP = 0.25f;
+	const int COOLDOWN_FRAMES = 15;  // Frames to wait after a change before adjusting again
+}
+
+PerformanceGovernor::PerformanceGovernor(float frameBudgetMs)
+	: frameBudgetMs(frameBudgetMs)
+	, resolutionScale(1.0f)
+	, lodBias(0.0f)
+	, smoothedGpuTimeMs(0.0f)
+	, cooldown(0)
+	, adaptive(true)
+	, currentQuery(0)
+	, frameTimed(false)
+{
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		queries[i] = 0;
+		queryPending[i] = false;
+	}
+}
+
+PerformanceGovernor::~PerformanceGovernor() {
+	if (queries[0]) glDeleteQueries(QUERY_COUNT, queries);
+}
+
+bool PerformanceGovernor::initialize() {
+	glGenQueries(QUERY_COUNT, queries);
+	if (!queries[0]) {
+		std::cerr << "Failed to create GPU timer queries" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void PerformanceGovernor::beginFrame() {
+	// If this slot's result is still outstanding, skip timing this frame rather than wait for it
+	frameTimed = !queryPending[currentQuery];
+	if (!frameTimed) return;
+	glBeginQuery(GL_TIME_ELAPSED, queries[currentQuery]);
+	queryPending[currentQuery] = true;
+}
+
+void PerformanceGovernor::endFrame() {
+	if (frameTimed) {
+		glEndQuery(GL_TIME_ELAPSED);
+		currentQuery = (currentQuery + 1) % QUERY_COUNT;
+	}
+
+	collectResults();
+	if (adaptive) adjust();
+}
+
+void PerformanceGovernor::collectResults() {
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		if (!queryPending[i]) continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue;
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsedNs);
+		queryPending[i] = false;
+
+		float gpuTimeMs = static_cast<float>(elapsedNs) / 1000000.0f;
+		smoothedGpuTimeMs = smoothedGpuTimeMs == 0.0f ? gpuTimeMs : smoothedGpuTimeMs * 0.9f + gpuTimeMs * 0.1f;
+	}
+}
+
+void PerformanceGovernor::adjust() {
+	if (cooldown > 0) {
+		cooldown--;
+		return;
+	}
+	if (smoothedGpuTimeMs == 0.0f) return;
+
+	if (smoothedGpuTimeMs > frameBudgetMs * 0.95f) {
+		// Over budget: drop resolution first, then texture detail once resolution bottoms out
+		if (resolutionScale > MIN_SCALE) {
+			resolutionScale = std::max(MIN_SCALE, resolutionScale - SCALE_STEP);
+		}
+		else {
+			lodBias = std::min(MAX_LOD_BIAS, lodBias + LOD_BIAS_STEP);
+		}
+		cooldown = COOLDOWN_FRAMES;
+	}
+	else if (smoothedGpuTimeMs < frameBudgetMs * 0.75f) {
+		// Comfortably under budget: restore in the reverse order
+		if (lodBias > 0.0f) {
+			lodBias = std::max(0.0f, lodBias - LOD_BIAS_STEP);
+			cooldown = COOLDOWN_FRAMES;
+		}
+		else if (resolutionScale < MAX_SCALE) {
+			resolutionScale = std::min(MAX_SCALE, resolutionScale + SCALE_STEP);
+			cooldown = COOLDOWN_FRAMES;
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Keeps GPU frame time under a budget by trading resolution and texture detail.
+// GPU time is measured with GL_TIME_ELAPSED queries in a small ring, so results are
+// read a few frames late without ever stalling on the GPU.
+class PerformanceGovernor {
+public:
+	static const int QUERY_COUNT = 4;
+
+	PerformanceGovernor(float frameBudgetMs = 1000.0f / 60.0f);
+	~PerformanceGovernor();
+
+	bool initialize();
+
+	// Wrap the GPU work of one frame; endFrame also updates the scale and LOD bias
+	void beginFrame();
+	void endFrame();
+
+	// When not adaptive the scale and LOD bias stay fixed, e.g. for reproducible benchmarks
+	void setAdaptive(bool adaptive) { this->adaptive = adaptive; }
+
+	float getResolutionScale() const { return resolutionScale; }
+	float getLodBias() const { return lodBias; }
+	float getGpuTimeMs() const { return smoothedGpuTimeMs; }
+
+private:
+	float frameBudgetMs;
+	float resolutionScale;
+	float lodBias;
+	float smoothedGpuTimeMs;
+	int cooldown;
+	bool adaptive;
+
+	GLuint queries[QUERY_COUNT];
+	bool queryPending[QUERY_COUNT];
+	int currentQuery;
+	bool frameTimed;
+
+	void collectResults();
+	void adjust();
+};
@@ -0,0 +1,105 @@
+#include "PlayerMovement.hpp"
+#include "BitStream.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// By weapon: rifle slowest, knife fastest
+	const float WEAPON_SPEEDS[] = { 7.0f, 8.0f, 10.0f };
+	const int WEAPON_SPEED_COUNT = 3;
+	const float DEFAULT_SPEED = 10.0f;
+
+	// Input messages carry angles as 16 bit fractions of their range
+	const int ANGLE_BITS = 16;
+	const uint32_t ANGLE_STEPS = 1u << ANGLE_BITS;
+	const float PITCH_LIMIT = 90.0f;
+
+	const int BUTTON_BITS = 5;
+	const int WEAPON_BITS = 2;
+	// Only fired inputs carry the view time: whole ticks, then 1/256 ticks
+	const int VIEW_TICK_BITS = 32;
+	const int VIEW_FRACTION_BITS = 8;
+	const double VIEW_FRACTION_STEPS = 256.0;
+
+	uint32_t yawToSteps(float degrees) {
+		float turns = degrees / 360.0f;
+		turns -= std::floor(turns);
+		return static_cast<uint32_t>(std::lround(turns * ANGLE_STEPS)) & (ANGLE_STEPS - 1);
+	}
+
+	float yawFromSteps(uint32_t steps) {
+		return steps * (360.0f / ANGLE_STEPS);
+	}
+
+	uint32_t pitchToSteps(float degrees) {
+		float clamped = std::min(std::max(degrees, -PITCH_LIMIT), PITCH_LIMIT);
+		return static_cast<uint32_t>(std::lround((clamped + PITCH_LIMIT) / (2.0f * PITCH_LIMIT) * (ANGLE_STEPS - 1)));
+	}
+
+	float pitchFromSteps(uint32_t steps) {
+		return steps / static_cast<float>(ANGLE_STEPS - 1) * (2.0f * PITCH_LIMIT) - PITCH_LIMIT;
+	}
+}
+
+float PlayerMovement::getSpeed(uint8_t weapon) {
+	return weapon < WEAPON_SPEED_COUNT ? WEAPON_SPEEDS[weapon] : DEFAULT_SPEED;
+}
+
+void PlayerMovement::quantize(PlayerInput& input) {
+	input.yaw = yawFromSteps(yawToSteps(input.yaw));
+	input.pitch = pitchFromSteps(pitchToSteps(input.pitch));
+}
+
+void PlayerMovement::write(const PlayerInput& input, BitWriter& writer) {
+	writer.write(input.buttons, BUTTON_BITS);
+	writer.write(input.weapon, WEAPON_BITS);
+	writer.writeBool(input.walking);
+	writer.write(yawToSteps(input.yaw), ANGLE_BITS);
+	writer.write(pitchToSteps(input.pitch), ANGLE_BITS);
+	if (input.buttons & PlayerInput::FIRE) {
+		double whole = std::floor(input.viewTick);
+		uint32_t fraction = std::min(static_cast<uint32_t>((input.viewTick - whole) * VIEW_FRACTION_STEPS), (1u << VIEW_FRACTION_BITS) - 1);
+		writer.write(static_cast<uint32_t>(whole), VIEW_TICK_BITS);
+		writer.write(fraction, VIEW_FRACTION_BITS);
+	}
+}
+
+void PlayerMovement::read(BitReader& reader, PlayerInput& input) {
+	input.buttons = static_cast<uint8_t>(reader.read(BUTTON_BITS));
+	input.weapon = static_cast<uint8_t>(reader.read(WEAPON_BITS));
+	input.walking = reader.readBool();
+	input.yaw = yawFromSteps(reader.read(ANGLE_BITS));
+	input.pitch = pitchFromSteps(reader.read(ANGLE_BITS));
+	input.viewTick = 0.0;
+	if (input.buttons & PlayerInput::FIRE) {
+		input.viewTick = reader.read(VIEW_TICK_BITS);
+		input.viewTick += reader.read(VIEW_FRACTION_BITS) / VIEW_FRACTION_STEPS;
+	}
+}
+
+glm::vec3 PlayerMovement::getViewDirection(const PlayerInput& input) {
+	// The camera's front from the same angles
+	float yaw = glm::radians(input.yaw);
+	float pitch = glm::radians(input.pitch);
+	return glm::normalize(glm::vec3(std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch)));
+}
+
+glm::vec3 PlayerMovement::getWishDirection(const PlayerInput& input) {
+	glm::vec3 front = getViewDirection(input);
+	glm::vec3 right = glm::normalize(glm::cross(front, glm::vec3(0.0f, 1.0f, 0.0f)));
+	if (input.walking) {
+		front = glm::normalize(glm::vec3(front.x, 0.0f, front.z));
+		right = glm::normalize(glm::vec3(right.x, 0.0f, right.z));
+	}
+
+	glm::vec3 direction(0.0f);
+	if (input.buttons & PlayerInput::FORWARD) direction += front;
+	if (input.buttons & PlayerInput::BACK) direction -= front;
+	if (input.buttons & PlayerInput::LEFT) direction -= right;
+	if (input.buttons & PlayerInput::RIGHT) direction += right;
+	return glm::length(direction) > 0.0f ? glm::normalize(direction) : direction;
+}
+
+void PlayerMovement::step(CharacterController& controller, const PlayerInput& input, float dt) {
+	controller.move(getWishDirection(input) * (getSpeed(input.weapon) * dt), dt, input.walking);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "CharacterController.hpp"
+
+class BitWriter;
+class BitReader;
+
+// One tick of a player's input, as sampled on the client and replayed by the server
+struct PlayerInput {
+	enum Button : uint8_t {
+		FORWARD = 1 << 0,
+		BACK = 1 << 1,
+		LEFT = 1 << 2,
+		RIGHT = 1 << 3,
+		FIRE = 1 << 4
+	};
+
+	uint32_t sequence;  // Counts up from 1 per tick; 0 is no input
+	uint8_t buttons;
+	uint8_t weapon;     // Renderer::WeaponType, which sets the speed
+	bool walking;       // Y-locked: walk the floor under gravity; otherwise fly
+	float yaw;          // Camera angles in degrees
+	float pitch;
+	double viewTick;    // Server tick the client was showing when it fired, for lag compensation
+};
+
+// The server's result for the last input it ran, for the client to check its prediction with
+struct PlayerCorrection {
+	uint32_t sequence;
+	CharacterController::State state;
+};
+
+// Player movement as a pure function of controller state and input, so the client can
+// predict it and the server reproduce it bit for bit. Anything the server only learns
+// through the network (the view angles) must be quantized before either side simulates.
+namespace PlayerMovement {
+	float getSpeed(uint8_t weapon);
+
+	// Rounds the view angles to what the input message carries
+	void quantize(PlayerInput& input);
+
+	// Everything but the sequence, which messages send once for a run of inputs
+	void write(const PlayerInput& input, BitWriter& writer);
+	void read(BitReader& reader, PlayerInput& input);
+
+	// Where the camera looks, as a unit vector
+	glm::vec3 getViewDirection(const PlayerInput& input);
+
+	// Unit direction of the held keys, flattened when walking; zero if none or they cancel
+	glm::vec3 getWishDirection(const PlayerInput& input);
+
+	// One tick against the map; gravity still acts with no key held
+	void step(CharacterController& controller, const PlayerInput& input, float dt);
+}
@@ -0,0 +1,75 @@
+#include "PlayerPrediction.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Two seconds at 64 Hz; a server further behind than that gets snapped to
+	const size_t HISTORY_SIZE = 128;
+
+	// Same binary, same map and same inputs give the same floats; the tolerance only
+	// covers a server built with different floating point settings
+	const float POSITION_TOLERANCE = 0.001f;
+	const float SPEED_TOLERANCE = 0.01f;
+
+	// Correction offset kept per tick; anything larger than a teleport is shown at once
+	const float SMOOTHING_DECAY = 0.85f;
+	const float SMOOTHING_LIMIT = 2.0f;
+
+	bool sameState(const CharacterController::State& a, const CharacterController::State& b) {
+		return glm::length(a.feet - b.feet) <= POSITION_TOLERANCE && std::abs(a.verticalSpeed - b.verticalSpeed) <= SPEED_TOLERANCE
+			&& a.grounded == b.grounded;
+	}
+}
+
+PlayerPrediction::PlayerPrediction(const MapBVH& map)
+	: controller(map), history(HISTORY_SIZE), latest(0), acknowledged(0), started(false), smoothing(0.0f), corrections(0)
+	, worstCorrection(0.0f) {}
+
+void PlayerPrediction::reset(const CharacterController::State& state) {
+	controller.setState(state);
+	std::fill(history.begin(), history.end(), Entry());
+	latest = 0;
+	acknowledged = 0;
+	started = true;
+	smoothing = glm::vec3(0.0f);
+}
+
+void PlayerPrediction::predict(PlayerInput& input, float dt) {
+	input.sequence = ++latest;
+	PlayerMovement::quantize(input);
+	PlayerMovement::step(controller, input, dt);
+
+	Entry& entry = history[input.sequence % HISTORY_SIZE];
+	entry.input = input;
+	entry.dt = dt;
+	entry.after = controller.getState();
+
+	smoothing *= SMOOTHING_DECAY;
+}
+
+void PlayerPrediction::reconcile(const PlayerCorrection& correction) {
+	PROFILE_SCOPE("PlayerPrediction::reconcile");
+	if (!started || correction.sequence <= acknowledged || correction.sequence > latest) return;
+	acknowledged = correction.sequence;
+
+	const Entry& predicted = history[correction.sequence % HISTORY_SIZE];
+	bool remembered = predicted.input.sequence == correction.sequence;
+	if (remembered && sameState(predicted.after, correction.state)) return;
+
+	corrections++;
+	glm::vec3 before = controller.getEyePosition();
+	controller.setState(correction.state);
+	// Replay what the server has not run yet; inputs already overwritten are gone
+	for (uint32_t sequence = correction.sequence + 1; sequence <= latest; sequence++) {
+		Entry& entry = history[sequence % HISTORY_SIZE];
+		if (entry.input.sequence != sequence) continue;
+		PlayerMovement::step(controller, entry.input, entry.dt);
+		entry.after = controller.getState();
+	}
+
+	glm::vec3 jump = before - controller.getEyePosition();
+	worstCorrection = std::max(worstCorrection, glm::length(jump));
+	smoothing += jump;
+	if (glm::length(smoothing) > SMOOTHING_LIMIT) smoothing = glm::vec3(0.0f);
+}
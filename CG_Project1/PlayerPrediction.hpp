@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CharacterController.hpp"
+#include "PlayerMovement.hpp"
+
+class MapBVH;
+
+// Runs the local player's inputs ahead of the server. Each input is simulated the tick it
+// is sampled and kept, with the state it produced, until the server reports its own result
+// for it. A matching result just retires the input; a different one puts the controller
+// back to the server's state and replays every newer input on top. Both sides run the same
+// step over the same map, so that only happens when the server lost or skipped an input.
+// The jump a correction causes is spread over the next few ticks instead of shown at once.
+class PlayerPrediction {
+public:
+	explicit PlayerPrediction(const MapBVH& map);
+
+	// Starts over from the server's first state for the player; nothing is predicted before
+	void reset(const CharacterController::State& state);
+	bool isStarted() const { return started; }
+
+	// Numbers the input, rounds it to what the server will see and runs it
+	void predict(PlayerInput& input, float dt);
+
+	// Checks the prediction for the input the server last ran; older results are ignored
+	void reconcile(const PlayerCorrection& correction);
+
+	glm::vec3 getEyePosition() const { return controller.getEyePosition(); }
+	// Where to draw the view: the prediction plus what remains of the last correction
+	glm::vec3 getSmoothedEyePosition() const { return controller.getEyePosition() + smoothing; }
+
+	uint32_t getLatestSequence() const { return latest; }
+	uint32_t getUnacknowledged() const { return latest - acknowledged; }
+	size_t getCorrections() const { return corrections; }
+	float getWorstCorrection() const { return worstCorrection; }
+
+private:
+	struct Entry {
+		PlayerInput input;
+		float dt;
+		CharacterController::State after;
+	};
+
+	CharacterController controller;
+	std::vector<Entry> history;  // By sequence, modulo its size
+	uint32_t latest;
+	uint32_t acknowledged;
+	bool started;
+	glm::vec3 smoothing;
+
+	size_t corrections;
+	float worstCorrection;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Renderer.hpp"
+#include "CharacterStore.hpp"
+
+// Everything the render side needs for one frame, produced by the simulation side and
+// never modified after it is published.
+struct RenderSnapshot {
+	glm::vec3 cameraPosition;  // Already interpolated between the last two ticks
+	glm::vec3 cameraFront;
+	glm::vec3 cameraUp;
+	float cameraPitch;
+	float cameraZoom;
+	Renderer::WeaponType weapon;
+	glm::mat4 weaponModel;     // Viewmodel transform relative to the camera
+	bool muzzleFlash;
+	long long inputSampleNs;   // Oldest mouse sample included in the orientation, -1 if none
+
+	// Settings that have to be applied on the thread owning the GL context
+	int swapInterval;
+	int framesInFlight;
+
+	// Character transforms grouped by team (all CTs, then all Ts) so each team is one
+	// contiguous batch for the transform kernel. Only rewritten when characterVersion
+	// changes; the render side skips the upload when it has that version.
+	std::vector<glm::vec3> characterPositions;
+	std::vector<float> characterYaws;
+	size_t ctCount;
+	unsigned long long characterVersion;
+
+	RenderSnapshot()
+		: cameraPosition(0.0f), cameraFront(0.0f, 0.0f, -1.0f), cameraUp(0.0f, 1.0f, 0.0f)
+		, cameraPitch(0.0f), cameraZoom(60.0f), weapon(Renderer::WeaponType::KNIFE), weaponModel(1.0f)
+		, muzzleFlash(false), inputSampleNs(-1), swapInterval(1), framesInFlight(2)
+		, characterPositions(), characterYaws(), ctCount(0), characterVersion(0) {}
+};
@@ -1,8 +1,17 @@
 #include "Renderer.hpp"
 #include <glad/glad.h>
+#include <algorithm>
 #include <iostream>
-
-Renderer::Renderer() {}
+#include "CpuProfiler.hpp"
+
+Renderer::Renderer() : profiler(nullptr) {
+	ctInstances.VBO = 0;
+	ctInstances.capacity = 0;
+	ctInstances.count = 0;
+	tInstances.VBO = 0;
+	tInstances.capacity = 0;
+	tInstances.count = 0;
+}
 
 Renderer::~Renderer() {
 	cleanup();
@@ -16,6 +25,8 @@ bool Renderer::initialize(const OBJLoader& objLoader) {
 }
 
 void Renderer::setupBuffers(const OBJLoader& objLoader) {
+	PROFILE_SCOPE("Renderer::setupBuffers");
+
 	const auto& materials = objLoader.getMaterials();
 	materialBuffers.resize(materials.size());
 
@@ -39,6 +50,18 @@ void Renderer::setupBuffers(const OBJLoader& objLoader) {
 				vertexData.push_back(0.0f);
 				vertexData.push_back(0.0f);
 			}
+
+			// Normal
+			if (j < material.normals.size()) {
+				vertexData.push_back(material.normals[j].x);
+				vertexData.push_back(material.normals[j].y);
+				vertexData.push_back(material.normals[j].z);
+			}
+			else {
+				vertexData.push_back(0.0f);
+				vertexData.push_back(1.0f);
+				vertexData.push_back(0.0f);
+			}
 		}
 
 		glGenVertexArrays(1, &buffers.VAO);
@@ -55,18 +78,23 @@ void Renderer::setupBuffers(const OBJLoader& objLoader) {
 			material.indices.data(), GL_STATIC_DRAW);
 
 		// Position attribute
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
 
 		// Texture coordinate attribute
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
 		glEnableVertexAttribArray(1);
 
+		// Normal attribute
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+
 		glBindVertexArray(0);
 	}
 }
 
 void Renderer::render(const ShaderProgram& shaderProgram, const OBJLoader& objLoader) {
+	PROFILE_SCOPE("Renderer::render");
 	shaderProgram.use();
 	const auto& materials = objLoader.getMaterials();
 
@@ -79,12 +107,14 @@ void Renderer::render(const ShaderProgram& shaderProgram, const OBJLoader& objLo
 			glBindTexture(GL_TEXTURE_2D, material.textureID);
 			shaderProgram.setUniform("texture1", 0);
 
+			if (profiler) profiler->beginScope(material.name.c_str());
 			glBindVertexArray(buffers.VAO);
 			glDrawElements(GL_TRIANGLES,
 				static_cast<GLsizei>(material.indices.size()),
 				GL_UNSIGNED_INT,
 				0);
 			glBindVertexArray(0);
+			if (profiler) profiler->endScope();
 		}
 	}
 }
@@ -96,6 +126,11 @@ void Renderer::cleanup() {
 		glDeleteBuffers(1, &buffers.EBO);
 	}
 	materialBuffers.clear();
+
+	glDeleteBuffers(1, &ctInstances.VBO);
+	glDeleteBuffers(1, &tInstances.VBO);
+	ctInstances.VBO = 0;
+	tInstances.VBO = 0;
 }
 
 bool Renderer::initializeWeapons(const OBJLoader& rifleLoader, const OBJLoader& pistolLoader, const OBJLoader& knifeLoader) {
@@ -123,6 +158,7 @@ bool Renderer::initializeWeapons(const OBJLoader& rifleLoader, const OBJLoader&
 }
 
 void Renderer::renderWeapon(const ShaderProgram& shaderProgram, WeaponType currentWeapon) {
+	PROFILE_SCOPE("Renderer::renderWeapon");
 	//std::cout << "\n=== Weapon Render Debug ===\n";
 	//std::cout << "Rendering weapon type: " << static_cast<int>(currentWeapon) << std::endl;
 	
@@ -179,6 +215,7 @@ void Renderer::renderWeapon(const ShaderProgram& shaderProgram, WeaponType curre
 			glBindTexture(GL_TEXTURE_2D, material.textureID);
 			shaderProgram.setUniform("texture1", 0);
 
+			if (profiler) profiler->beginScope(material.name.c_str());
 			glBindVertexArray(buffers.VAO);
 			
 			// For knife, render both front and back faces
@@ -207,6 +244,7 @@ void Renderer::renderWeapon(const ShaderProgram& shaderProgram, WeaponType curre
 			}
 			
 			glBindVertexArray(0);
+			if (profiler) profiler->endScope();
 		}
 	}
 
@@ -220,6 +258,8 @@ void Renderer::renderWeapon(const ShaderProgram& shaderProgram, WeaponType curre
 }
 
 void Renderer::setupWeaponBuffers(const OBJLoader& objLoader, std::vector<MaterialBuffers>& buffers) {
+	PROFILE_SCOPE("Renderer::setupWeaponBuffers");
+
 	const auto& materials = objLoader.getMaterials();
 
 	for (size_t i = 0; i < materials.size(); i++) {
@@ -242,6 +282,18 @@ void Renderer::setupWeaponBuffers(const OBJLoader& objLoader, std::vector<Materi
 				vertexData.push_back(0.0f);
 				vertexData.push_back(0.0f);
 			}
+
+			// Normal
+			if (j < material.normals.size()) {
+				vertexData.push_back(material.normals[j].x);
+				vertexData.push_back(material.normals[j].y);
+				vertexData.push_back(material.normals[j].z);
+			}
+			else {
+				vertexData.push_back(0.0f);
+				vertexData.push_back(1.0f);
+				vertexData.push_back(0.0f);
+			}
 		}
 
 		glGenVertexArrays(1, &buffer.VAO);
@@ -258,13 +310,17 @@ void Renderer::setupWeaponBuffers(const OBJLoader& objLoader, std::vector<Materi
 			material.indices.data(), GL_STATIC_DRAW);
 
 		// Position attribute
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
 
 		// Texture coordinate attribute
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
 		glEnableVertexAttribArray(1);
 
+		// Normal attribute
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+
 		glBindVertexArray(0);
 	}
 }
@@ -284,29 +340,82 @@ bool Renderer::initializeCharacterModels(const OBJLoader& ctLoader, const OBJLoa
 	tBuffers.resize(tMaterials.size());
 	setupWeaponBuffers(this->tModel, tBuffers);
 
+	// Per-instance model matrices for both teams
+	setupInstanceAttributes(ctBuffers, ctInstances);
+	setupInstanceAttributes(tBuffers, tInstances);
+
 	return true;
 }
 
-void Renderer::renderCharacter(const ShaderProgram& shaderProgram, const Character& character) {
+void Renderer::setupInstanceAttributes(const std::vector<MaterialBuffers>& buffers, InstanceBuffer& instances) {
+	glGenBuffers(1, &instances.VBO);
+	instances.capacity = 0;
+	instances.count = 0;
+
+	for (const auto& material : buffers) {
+		glBindVertexArray(material.VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, instances.VBO);
+
+		// A mat4 attribute takes four consecutive locations, one column each
+		for (int column = 0; column < 4; column++) {
+			GLuint location = 3 + column;
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(location);
+			glVertexAttribDivisor(location, 1);
+		}
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool Renderer::uploadCharacterInstances(CharacterStore::Team team, const TransformBatch& batch) {
+	PROFILE_SCOPE("Renderer::uploadCharacterInstances");
+	InstanceBuffer& instances = team == CharacterStore::Team::CT ? ctInstances : tInstances;
+	instances.count = 0;
+	if (batch.count == 0) return true;
+
+	// Orphan the previous contents and let the kernel fill the new storage directly
+	glBindBuffer(GL_ARRAY_BUFFER, instances.VBO);
+	if (batch.count > instances.capacity) {
+		instances.capacity = std::max(batch.count, instances.capacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, instances.capacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+	}
+	void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, batch.count * sizeof(glm::mat4),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!mapped) {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return false;
+	}
+	{
+		PROFILE_SCOPE("TransformKernel::build");
+		TransformKernel::build(batch, static_cast<float*>(mapped));
+	}
+	// Unmapping fails when the store was corrupted meanwhile (e.g. a display mode change)
+	bool intact = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (intact) instances.count = batch.count;
+	return intact;
+}
+
+void Renderer::renderCharacters(const ShaderProgram& shaderProgram, CharacterStore::Team team) {
+	PROFILE_SCOPE("Renderer::renderCharacters");
 	const std::vector<MaterialBuffers>* characterBuffers;
 	const std::vector<Material>* materials;
+	const InstanceBuffer* instances;
 
-	if (character.team == Character::Team::CT) {
+	if (team == CharacterStore::Team::CT) {
 		characterBuffers = &ctBuffers;
 		materials = &ctModel.getMaterials();
+		instances = &ctInstances;
 	} else {
 		characterBuffers = &tBuffers;
 		materials = &tModel.getMaterials();
+		instances = &tInstances;
 	}
+	if (instances->count == 0) return;
 
-	// Get the model matrix from the character
-	glm::mat4 model = character.getModelMatrix();
-	
-	// Set all matrices
-	shaderProgram.setUniform("model", model);
 	// Note: view and projection matrices should be set before calling this function
 	// They are set in the main render loop
-
 	for (size_t i = 0; i < materials->size(); i++) {
 		const auto& material = (*materials)[i];
 		const auto& buffers = (*characterBuffers)[i];
@@ -316,16 +425,15 @@ void Renderer::renderCharacter(const ShaderProgram& shaderProgram, const Charact
 			glBindTexture(GL_TEXTURE_2D, material.textureID);
 			shaderProgram.setUniform("texture1", 0);
 
+			if (profiler) profiler->beginScope(material.name.c_str());
 			glBindVertexArray(buffers.VAO);
-			glDrawElements(GL_TRIANGLES,
+			glDrawElementsInstanced(GL_TRIANGLES,
 				static_cast<GLsizei>(material.indices.size()),
 				GL_UNSIGNED_INT,
-				0);
+				0,
+				static_cast<GLsizei>(instances->count));
 			glBindVertexArray(0);
+			if (profiler) profiler->endScope();
 		}
 	}
 }
-
-
-
-
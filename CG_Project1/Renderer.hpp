@@ -4,7 +4,9 @@
 #include "OBJLoader.hpp"
 #include <glm/glm.hpp>
 #include <vector>
-#include "Character.hpp"
+#include "CharacterStore.hpp"
+#include "GpuProfiler.hpp"
+#include "TransformKernel.hpp"
 
 class Renderer {
 public:
@@ -24,7 +26,18 @@ public:
 	bool initializeWeapons(const OBJLoader& rifleLoader, const OBJLoader& pistolLoader, const OBJLoader& knifeLoader);
 	void renderWeapon(const ShaderProgram& shaderProgram, WeaponType currentWeapon);
 	bool initializeCharacterModels(const OBJLoader& ctLoader, const OBJLoader& tLoader);
-	void renderCharacter(const ShaderProgram& shaderProgram, const Character& character);
+
+	// Replaces a team's instance model matrices, built by the transform kernel straight into
+	// the mapped buffer. The buffer keeps them across frames, so this is only needed when
+	// characters moved or the set changed. Returns false if the contents were lost.
+	bool uploadCharacterInstances(CharacterStore::Team team, const TransformBatch& batch);
+
+	// Draws every uploaded character of a team in one instanced call per material; the
+	// shader needs the INSTANCED feature
+	void renderCharacters(const ShaderProgram& shaderProgram, CharacterStore::Team team);
+
+	// When set, every material batch is wrapped in a GPU profiler scope
+	void setProfiler(GpuProfiler* profiler) { this->profiler = profiler; }
 
 private:
 	struct MaterialBuffers {
@@ -41,12 +54,24 @@ private:
 	std::vector<MaterialBuffers> ctBuffers;
 	std::vector<MaterialBuffers> tBuffers;
 
+	// Per-team model matrices for instanced character draws, grown on demand
+	struct InstanceBuffer {
+		unsigned int VBO;
+		size_t capacity;
+		size_t count;
+	};
+	InstanceBuffer ctInstances;
+	InstanceBuffer tInstances;
+
 	void setupBuffers(const OBJLoader& objLoader);
 	void setupWeaponBuffers(const OBJLoader& objLoader, std::vector<MaterialBuffers>& buffers);
+	void setupInstanceAttributes(const std::vector<MaterialBuffers>& buffers, InstanceBuffer& instances);
 
 	OBJLoader rifleLoader;
 	OBJLoader pistolLoader;
 	OBJLoader knifeLoader;
+
+	GpuProfiler* profiler;
 };
 
 
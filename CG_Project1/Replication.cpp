@@ -0,0 +1,335 @@
+#include "Replication.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	// Rejects stray datagrams from anything that is not this game
+	const uint32_t PROTOCOL_ID = 0xC5;
+	const int PROTOCOL_BITS = 8;
+
+	enum class MessageType : uint32_t { HELLO, ACK, SNAPSHOT, INPUT };
+	const int TYPE_BITS = 2;
+
+	const int TICK_BITS = 32;
+	const int BASELINE_AGE_BITS = 8;
+	const int SEQUENCE_BITS = 32;
+	const int ENTITY_INDEX_BITS = 16;
+
+	// Each input message repeats this many of the newest inputs; it takes that many lost
+	// datagrams in a row before the server misses one. At 40 bits an input it is cheap.
+	const size_t INPUT_REDUNDANCY = 4;
+	const int INPUT_COUNT_BITS = 3;
+	// A client that floods inputs only keeps this many of its oldest waiting
+	const size_t MAX_QUEUED_INPUTS = 64;
+
+	// The widest snapshot message: header, tick, baseline age, the snapshot itself and the
+	// player's correction; capping the snapshot's entities keeps this within one datagram
+	const size_t SNAPSHOT_HEADER_BITS = PROTOCOL_BITS + TYPE_BITS + TICK_BITS + 1 + BASELINE_AGE_BITS;
+	const size_t CORRECTION_BITS = 1 + ENTITY_INDEX_BITS + SEQUENCE_BITS + 5 * 32 + 1;
+	static_assert(SNAPSHOT_HEADER_BITS + SnapshotCodec::MAX_ENCODED_BITS + CORRECTION_BITS <= Datagram::MAX_SIZE * 8,
+		"A full snapshot of MAX_ENTITIES does not fit a datagram");
+
+	// Snapshots remembered on each side for delta encoding; 64 ticks is a second at 64 Hz,
+	// so a client whose acks stall that long gets a full snapshot
+	const size_t HISTORY_SIZE = 64;
+
+	const size_t RECEIVE_BATCH = 128;
+	const long long CLIENT_TIMEOUT_NS = 5000000000ll;
+	const long long HELLO_INTERVAL_NS = 250000000ll;
+
+	void writeHeader(BitWriter& writer, MessageType type) {
+		writer.clear();
+		writer.write(PROTOCOL_ID, PROTOCOL_BITS);
+		writer.write(static_cast<uint32_t>(type), TYPE_BITS);
+	}
+
+	bool readHeader(BitReader& reader, MessageType& type) {
+		if (reader.read(PROTOCOL_BITS) != PROTOCOL_ID) return false;
+		type = static_cast<MessageType>(reader.read(TYPE_BITS));
+		return !reader.isOverflowed();
+	}
+
+	// False if the message does not fit in a datagram
+	bool toDatagram(BitWriter& writer, const SocketAddress& address, Datagram& datagram) {
+		const std::vector<uint8_t>& bytes = writer.finish();
+		if (bytes.size() > Datagram::MAX_SIZE) return false;
+		datagram.address = address;
+		datagram.size = static_cast<uint16_t>(bytes.size());
+		std::memcpy(datagram.data, bytes.data(), bytes.size());
+		return true;
+	}
+
+	// Player state goes as raw floats so the client resumes from exactly the server's state
+	void writeFloat(float value, BitWriter& writer) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		writer.write(bits, 32);
+	}
+
+	float readFloat(BitReader& reader) {
+		uint32_t bits = reader.read(32);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	void writeCorrection(const PlayerCorrection& correction, BitWriter& writer) {
+		writer.write(correction.sequence, SEQUENCE_BITS);
+		for (int axis = 0; axis < 3; axis++) writeFloat(correction.state.feet[axis], writer);
+		writeFloat(correction.state.verticalSpeed, writer);
+		writer.writeBool(correction.state.grounded);
+	}
+
+	void readCorrection(BitReader& reader, PlayerCorrection& correction) {
+		correction.sequence = reader.read(SEQUENCE_BITS);
+		for (int axis = 0; axis < 3; axis++) correction.state.feet[axis] = readFloat(reader);
+		correction.state.verticalSpeed = readFloat(reader);
+		correction.state.grounded = reader.readBool();
+	}
+
+	// Receives everything waiting, in batches
+	void receiveAll(UdpSocket& socket, std::vector<Datagram>& incoming) {
+		incoming.resize(RECEIVE_BATCH);
+		size_t total = 0;
+		while (true) {
+			size_t got = socket.receive(incoming.data() + total, incoming.size() - total);
+			total += got;
+			if (total < incoming.size()) break;
+			incoming.resize(incoming.size() + RECEIVE_BATCH);
+		}
+		incoming.resize(total);
+	}
+}
+
+ReplicationServer::ReplicationServer()
+	: socket(), link(), clients(), history(HISTORY_SIZE), incoming(), writer(), nextClientId(0), bytesSent(0), snapshotsSent(0)
+	, fullSnapshotsSent(0), sendFailures(0), inputsSkipped(0) {}
+
+bool ReplicationServer::open(uint16_t port) {
+	return socket.open(port);
+}
+
+void ReplicationServer::readAck(BitReader& reader, Client& client) {
+	uint32_t tick = reader.read(TICK_BITS);
+	// Acks can arrive out of order; only ever move forward
+	if (!reader.isOverflowed() && (!client.acked || tick > client.ackedTick)) {
+		client.ackedTick = tick;
+		client.acked = true;
+	}
+}
+
+void ReplicationServer::readInputs(BitReader& reader, Client& client) {
+	readAck(reader, client);
+	size_t count = reader.read(INPUT_COUNT_BITS);
+	uint32_t newest = reader.read(SEQUENCE_BITS);
+	if (reader.isOverflowed() || count == 0 || count > newest) return;
+
+	// Newest first; copies of inputs already queued or run are dropped
+	for (size_t i = 0; i < count; i++) {
+		PlayerInput input;
+		PlayerMovement::read(reader, input);
+		input.sequence = newest - static_cast<uint32_t>(i);
+		if (reader.isOverflowed()) return;
+		if (input.sequence <= client.lastRunInput) continue;
+
+		auto position = std::lower_bound(client.inputs.begin(), client.inputs.end(), input.sequence,
+			[](const PlayerInput& queued, uint32_t sequence) { return queued.sequence < sequence; });
+		if (position != client.inputs.end() && position->sequence == input.sequence) continue;
+		if (client.inputs.size() >= MAX_QUEUED_INPUTS) return;
+		client.inputs.insert(position, input);
+	}
+}
+
+void ReplicationServer::receive(long long nowNs) {
+	PROFILE_SCOPE("ReplicationServer::receive");
+	receiveAll(socket, incoming);
+	for (const Datagram& datagram : incoming) {
+		BitReader reader(datagram.data, datagram.size);
+		MessageType type;
+		if (!readHeader(reader, type)) continue;
+
+		auto client = std::find_if(clients.begin(), clients.end(), [&](const Client& c) { return c.address == datagram.address; });
+		if (client == clients.end()) {
+			if (type != MessageType::HELLO) continue;
+			Client joined = {};
+			joined.address = datagram.address;
+			joined.id = nextClientId++;
+			joined.lastHeardNs = nowNs;
+			clients.push_back(joined);
+			continue;
+		}
+
+		client->lastHeardNs = nowNs;
+		if (type == MessageType::ACK) readAck(reader, *client);
+		else if (type == MessageType::INPUT) readInputs(reader, *client);
+	}
+
+	clients.erase(std::remove_if(clients.begin(), clients.end(), [&](const Client& c) { return nowNs - c.lastHeardNs > CLIENT_TIMEOUT_NS; }), clients.end());
+}
+
+bool ReplicationServer::popInput(size_t client, PlayerInput& input) {
+	Client& target = clients[client];
+	if (target.inputs.empty()) return false;
+
+	// Every input is sent several times, so a gap here means all its copies were lost
+	input = target.inputs.front();
+	target.inputs.erase(target.inputs.begin());
+	if (input.sequence != target.lastRunInput + 1 && target.lastRunInput != 0) inputsSkipped += input.sequence - target.lastRunInput - 1;
+	target.lastRunInput = input.sequence;
+	return true;
+}
+
+void ReplicationServer::setPlayer(size_t client, uint32_t entityIndex, const PlayerCorrection& correction) {
+	clients[client].hasPlayer = true;
+	clients[client].playerIndex = entityIndex;
+	clients[client].correction = correction;
+}
+
+const Snapshot* ReplicationServer::findBaseline(const Client& client, uint32_t tick) const {
+	if (!client.acked || client.ackedTick >= tick || tick - client.ackedTick >= HISTORY_SIZE) return nullptr;
+	const Snapshot& baseline = history[client.ackedTick % HISTORY_SIZE];
+	return baseline.tick == client.ackedTick ? &baseline : nullptr;
+}
+
+void ReplicationServer::send(const Snapshot& snapshot, long long nowNs) {
+	PROFILE_SCOPE("ReplicationServer::send");
+	history[snapshot.tick % HISTORY_SIZE] = snapshot;
+
+	Datagram datagram;
+	for (const Client& client : clients) {
+		const Snapshot* baseline = findBaseline(client, snapshot.tick);
+		writeHeader(writer, MessageType::SNAPSHOT);
+		writer.write(snapshot.tick, TICK_BITS);
+		writer.writeBool(baseline != nullptr);
+		if (baseline) writer.write(snapshot.tick - baseline->tick, BASELINE_AGE_BITS);
+		bool encoded = SnapshotCodec::encode(snapshot, baseline, writer);
+		writer.writeBool(client.hasPlayer);
+		if (client.hasPlayer) {
+			writer.write(client.playerIndex, ENTITY_INDEX_BITS);
+			writeCorrection(client.correction, writer);
+		}
+		if (!encoded || !toDatagram(writer, client.address, datagram)) {
+			// Only the first is printed; the count says whether it kept happening
+			if (sendFailures++ == 0) {
+				std::cerr << "Replication: snapshot of " << snapshot.entities.size() << " characters does not fit a datagram (at most "
+					<< SnapshotCodec::MAX_ENTITIES << ")" << std::endl;
+			}
+			continue;
+		}
+
+		link.submit(datagram, nowNs);
+		bytesSent += datagram.size;
+		snapshotsSent++;
+		if (!baseline) fullSnapshotsSent++;
+	}
+	link.flush(socket, nowNs);
+}
+
+ReplicationClient::ReplicationClient()
+	: socket(), server(), link(), history(HISTORY_SIZE), historyValid(HISTORY_SIZE, 0), incoming(), recentInputs(), writer(), latestTick(0)
+	, received(false), lastHelloNs(0), playing(false), playerIndex(0), correction(), bytesReceived(0), bytesSent(0), snapshotsReceived(0)
+	, snapshotsRejected(0) {}
+
+bool ReplicationClient::connect(const SocketAddress& server) {
+	this->server = server;
+	received = false;
+	lastHelloNs = 0;
+	playing = false;
+	recentInputs.clear();
+	std::fill(historyValid.begin(), historyValid.end(), 0);
+	return socket.open(0);
+}
+
+bool ReplicationClient::readSnapshot(BitReader& reader) {
+	uint32_t tick = reader.read(TICK_BITS);
+	const Snapshot* baseline = nullptr;
+	if (reader.readBool()) {
+		uint32_t baselineTick = tick - reader.read(BASELINE_AGE_BITS);
+		size_t slot = baselineTick % HISTORY_SIZE;
+		if (!historyValid[slot] || history[slot].tick != baselineTick) return false;
+		baseline = &history[slot];
+	}
+	if (reader.isOverflowed()) return false;
+	// Older than what we have already; it would only overwrite a baseline still in use
+	if (received && tick <= latestTick) return false;
+
+	// Decode aside first, since the slot it lands in may hold its own baseline
+	thread_local Snapshot decoded;
+	if (!SnapshotCodec::decode(reader, tick, baseline, decoded)) return false;
+	bool hasPlayer = reader.readBool();
+	uint32_t index = 0;
+	PlayerCorrection state = {};
+	if (hasPlayer) {
+		index = reader.read(ENTITY_INDEX_BITS);
+		readCorrection(reader, state);
+	}
+	if (reader.isOverflowed()) return false;
+
+	size_t slot = tick % HISTORY_SIZE;
+	std::swap(history[slot], decoded);
+	historyValid[slot] = 1;
+	latestTick = tick;
+	received = true;
+	playing = hasPlayer;
+	if (hasPlayer) {
+		playerIndex = index;
+		correction = state;
+	}
+	return true;
+}
+
+void ReplicationClient::sendInput(const PlayerInput& input) {
+	if (recentInputs.size() == INPUT_REDUNDANCY) recentInputs.erase(recentInputs.begin());
+	recentInputs.push_back(input);
+}
+
+void ReplicationClient::send(long long nowNs) {
+	Datagram datagram;
+	if (received && !recentInputs.empty()) {
+		// The ack rides along, newest input first
+		writeHeader(writer, MessageType::INPUT);
+		writer.write(latestTick, TICK_BITS);
+		writer.write(static_cast<uint32_t>(recentInputs.size()), INPUT_COUNT_BITS);
+		writer.write(recentInputs.back().sequence, SEQUENCE_BITS);
+		for (auto input = recentInputs.rbegin(); input != recentInputs.rend(); ++input) PlayerMovement::write(*input, writer);
+	}
+	else if (received) {
+		writeHeader(writer, MessageType::ACK);
+		writer.write(latestTick, TICK_BITS);
+	}
+	else {
+		if (lastHelloNs != 0 && nowNs - lastHelloNs < HELLO_INTERVAL_NS) return;
+		lastHelloNs = nowNs;
+		writeHeader(writer, MessageType::HELLO);
+	}
+	if (!toDatagram(writer, server, datagram)) return;
+	link.submit(datagram, nowNs);
+	bytesSent += datagram.size;
+}
+
+bool ReplicationClient::update(long long nowNs) {
+	PROFILE_SCOPE("ReplicationClient::update");
+	bool newer = false;
+	receiveAll(socket, incoming);
+	for (const Datagram& datagram : incoming) {
+		if (datagram.address != server) continue;
+		BitReader reader(datagram.data, datagram.size);
+		MessageType type;
+		if (!readHeader(reader, type) || type != MessageType::SNAPSHOT) continue;
+
+		bytesReceived += datagram.size;
+		if (readSnapshot(reader)) {
+			snapshotsReceived++;
+			newer = true;
+		}
+		else {
+			snapshotsRejected++;
+		}
+	}
+
+	send(nowNs);
+	link.flush(socket, nowNs);
+	return newer;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "BitStream.hpp"
+#include "LinkSimulator.hpp"
+#include "PlayerMovement.hpp"
+#include "Snapshot.hpp"
+#include "UdpSocket.hpp"
+
+// Server side of snapshot replication. Clients say hello, then acknowledge the newest
+// snapshot they have decoded; every send gives each client the current snapshot delta
+// encoded against the last one it acknowledged, or in full when it has none the server
+// still remembers. Nothing is resent: a lost snapshot is superseded by the next one.
+// Clients that play send their inputs, which queue here in sequence order for the game to
+// run; each snapshot to such a client also carries where its player ended up after the
+// last input run, so the client can check its prediction.
+class ReplicationServer {
+public:
+	ReplicationServer();
+
+	bool open(uint16_t port);
+	uint16_t getPort() const { return socket.getPort(); }
+
+	// Applied to everything the server sends
+	void setLink(const LinkSettings& settings) { link.setSettings(settings); }
+
+	// Reads hellos, acks and inputs; the tick runs the queued inputs after this
+	void receive(long long nowNs);
+	// Sends this snapshot to every client in one batch
+	void send(const Snapshot& snapshot, long long nowNs);
+
+	// Clients in join order; a client keeps its id while it stays connected
+	size_t getClientCount() const { return clients.size(); }
+	uint32_t getClientId(size_t client) const { return clients[client].id; }
+
+	// The client's oldest input not yet run; false if none is waiting. Inputs lost despite
+	// the redundant copies are skipped over, never waited for.
+	bool popInput(size_t client, PlayerInput& input);
+	size_t getQueuedInputs(size_t client) const { return clients[client].inputs.size(); }
+
+	// The character the client plays and its state after the last input run, sent with every snapshot
+	void setPlayer(size_t client, uint32_t entityIndex, const PlayerCorrection& correction);
+
+	size_t getBytesSent() const { return bytesSent; }
+	size_t getSnapshotsSent() const { return snapshotsSent; }
+	size_t getFullSnapshotsSent() const { return fullSnapshotsSent; }
+	// Snapshots that could not be sent because they did not fit a datagram
+	size_t getSendFailures() const { return sendFailures; }
+	size_t getInputsSkipped() const { return inputsSkipped; }
+
+private:
+	struct Client {
+		SocketAddress address;
+		uint32_t id;
+		uint32_t ackedTick;
+		bool acked;
+		long long lastHeardNs;
+
+		std::vector<PlayerInput> inputs;  // Waiting to run, oldest first
+		uint32_t lastRunInput;            // Sequence of the last input popped
+		bool hasPlayer;
+		uint32_t playerIndex;
+		PlayerCorrection correction;
+	};
+
+	UdpSocket socket;
+	LinkSimulator link;
+	std::vector<Client> clients;
+	std::vector<Snapshot> history;  // Sent snapshots by tick, modulo its size
+	std::vector<Datagram> incoming;
+	BitWriter writer;
+	uint32_t nextClientId;
+
+	size_t bytesSent;
+	size_t snapshotsSent;
+	size_t fullSnapshotsSent;
+	size_t sendFailures;
+	size_t inputsSkipped;
+
+	void readAck(BitReader& reader, Client& client);
+	void readInputs(BitReader& reader, Client& client);
+	const Snapshot* findBaseline(const Client& client, uint32_t tick) const;
+};
+
+// Client side: decodes snapshots against the ones it received before and acknowledges the
+// newest, which the server then encodes against. A playing client also sends its inputs,
+// each one repeated in the next few messages so that losing a datagram loses no input.
+class ReplicationClient {
+public:
+	ReplicationClient();
+
+	bool connect(const SocketAddress& server);
+
+	// Applied to everything the client sends
+	void setLink(const LinkSettings& settings) { link.setSettings(settings); }
+
+	// Sent with the next update; inputs must come in sequence order
+	void sendInput(const PlayerInput& input);
+
+	// Receives what has arrived and acknowledges it; true if a newer snapshot came in
+	bool update(long long nowNs);
+
+	bool hasSnapshot() const { return received; }
+	const Snapshot& getSnapshot() const { return history[latestTick % history.size()]; }
+
+	// Whether the server has given this client a character, which one, and the server's
+	// state for it as of the newest snapshot
+	bool hasPlayer() const { return playing; }
+	uint32_t getPlayerIndex() const { return playerIndex; }
+	const PlayerCorrection& getCorrection() const { return correction; }
+
+	size_t getBytesReceived() const { return bytesReceived; }
+	size_t getBytesSent() const { return bytesSent; }
+	size_t getSnapshotsReceived() const { return snapshotsReceived; }
+	size_t getSnapshotsRejected() const { return snapshotsRejected; }
+
+private:
+	UdpSocket socket;
+	SocketAddress server;
+	LinkSimulator link;
+	std::vector<Snapshot> history;  // Received snapshots by tick, modulo its size
+	std::vector<uint8_t> historyValid;
+	std::vector<Datagram> incoming;
+	std::vector<PlayerInput> recentInputs;  // Newest last, as many as each message repeats
+	BitWriter writer;
+	uint32_t latestTick;
+	bool received;
+	long long lastHelloNs;
+
+	bool playing;
+	uint32_t playerIndex;
+	PlayerCorrection correction;
+
+	size_t bytesReceived;
+	size_t bytesSent;
+	size_t snapshotsReceived;
+	size_t snapshotsRejected;
+
+	void send(long long nowNs);
+	bool readSnapshot(BitReader& reader);
+};
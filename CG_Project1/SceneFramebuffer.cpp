@@ -0,0 +1,56 @@
+#include "SceneFramebuffer.hpp"
+#include <algorithm>
+#include <iostream>
+
+SceneFramebuffer::SceneFramebuffer(int width, int height)
+	: width(width), height(height), scaledWidth(width), scaledHeight(height)
+	, FBO(0), colorTexture(0), depthRenderbuffer(0) {}
+
+SceneFramebuffer::~SceneFramebuffer() {
+	if (depthRenderbuffer) glDeleteRenderbuffers(1, &depthRenderbuffer);
+	if (colorTexture) glDeleteTextures(1, &colorTexture);
+	if (FBO) glDeleteFramebuffers(1, &FBO);
+}
+
+bool SceneFramebuffer::initialize() {
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+	glGenTextures(1, &colorTexture);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &depthRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) {
+		std::cerr << "Scene framebuffer is incomplete" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void SceneFramebuffer::bind(float resolutionScale) {
+	scaledWidth = std::max(1, std::min(width, static_cast<int>(width * resolutionScale)));
+	scaledHeight = std::max(1, std::min(height, static_cast<int>(height * resolutionScale)));
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, scaledWidth, scaledHeight);
+}
+
+void SceneFramebuffer::blitToScreen() const {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, scaledWidth, scaledHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Offscreen color + depth target the 3D scene is drawn into. Storage is allocated once at
+// native size; lower resolutions render into the bottom-left sub-rectangle, so changing
+// the scale never reallocates. The result is upscaled to the window with a linear blit.
+class SceneFramebuffer {
+public:
+	SceneFramebuffer(int width, int height);
+	~SceneFramebuffer();
+
+	bool initialize();
+
+	// Binds the framebuffer and sets the viewport to the scaled resolution
+	void bind(float resolutionScale);
+
+	// Upscales the rendered region to the default framebuffer and restores the full viewport
+	void blitToScreen() const;
+
+	int getScaledWidth() const { return scaledWidth; }
+	int getScaledHeight() const { return scaledHeight; }
+
+private:
+	int width;
+	int height;
+	int scaledWidth;
+	int scaledHeight;
+	GLuint FBO;
+	GLuint colorTexture;
+	GLuint depthRenderbuffer;
+};
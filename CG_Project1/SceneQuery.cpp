@@ -0,0 +1,174 @@
+#include "SceneQuery.hpp"
+#include "MapBVH.hpp"
+#include "OBJLoader.hpp"
+#include "MemoryUsage.hpp"
+#include <algorithm>
+#include <cmath>
+
+const uint32_t RayHit::NO_MATERIAL;
+
+SceneQuery::SceneQuery(const MapBVH& map)
+	: map(map), characterInverses(), characterSpheres(), characterHandles(), characterTeams(), characterVersion(~0ull) {
+	for (int team = 0; team < 2; team++) {
+		modelMin[team] = glm::vec3(0.0f);
+		modelMax[team] = glm::vec3(0.0f);
+	}
+}
+
+void SceneQuery::setCharacterModel(CharacterStore::Team team, const OBJLoader& model) {
+	glm::vec3 boundsMin(1e30f);
+	glm::vec3 boundsMax(-1e30f);
+	for (const Material& material : model.getMaterials()) {
+		for (const glm::vec3& vertex : material.vertices) {
+			boundsMin = glm::min(boundsMin, vertex);
+			boundsMax = glm::max(boundsMax, vertex);
+		}
+	}
+	if (boundsMin.x > boundsMax.x) return;
+
+	int index = static_cast<int>(team);
+	modelMin[index] = boundsMin;
+	modelMax[index] = boundsMax;
+	characterVersion = ~0ull;
+}
+
+void SceneQuery::updateCharacters(const CharacterStore& characters) {
+	if (characters.getTransformVersion() == characterVersion) return;
+	characterVersion = characters.getTransformVersion();
+
+	characterInverses.clear();
+	characterSpheres.clear();
+	characterHandles.clear();
+	characterTeams.clear();
+
+	const glm::mat4* models = characters.getModelMatrices();
+	const uint8_t* flags = characters.getFlags();
+	const CharacterStore::Team* teams = characters.getTeams();
+	for (size_t i = 0; i < characters.size(); i++) {
+		if (flags[i] & CharacterStore::FLAG_HIDDEN) continue;
+		int team = static_cast<int>(teams[i]);
+		glm::vec3 center = glm::vec3(models[i] * glm::vec4((modelMin[team] + modelMax[team]) * 0.5f, 1.0f));
+		float radius = glm::length(glm::vec3(models[i][0])) * glm::length(modelMax[team] - modelMin[team]) * 0.5f;
+		characterSpheres.push_back(glm::vec4(center, radius));
+		characterInverses.push_back(glm::inverse(models[i]));
+		characterHandles.push_back(characters.handleAt(i));
+		characterTeams.push_back(static_cast<uint8_t>(teams[i]));
+	}
+}
+
+bool SceneQuery::intersectCharacter(size_t index, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const {
+	const glm::vec4& sphere = characterSpheres[index];
+	glm::vec3 toCenter = glm::vec3(sphere) - origin;
+	float along = glm::dot(toCenter, direction);
+	float offAxisSquared = glm::dot(toCenter, toCenter) - along * along;
+	if (offAxisSquared > sphere.w * sphere.w || along + sphere.w < 0.0f || along - sphere.w > maxDistance) return false;
+
+	// The model matrix scales uniformly, so distances along the transformed ray stay in world units
+	const glm::mat4& inverse = characterInverses[index];
+	glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+	glm::vec3 localDirection = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+	int team = characterTeams[index];
+
+	float tNear = -1e30f;
+	float tFar = 1e30f;
+	for (int axis = 0; axis < 3; axis++) {
+		if (std::fabs(localDirection[axis]) < 1e-12f) {
+			if (localOrigin[axis] < modelMin[team][axis] || localOrigin[axis] > modelMax[team][axis]) return false;
+			continue;
+		}
+		float inverseDirection = 1.0f / localDirection[axis];
+		float t0 = (modelMin[team][axis] - localOrigin[axis]) * inverseDirection;
+		float t1 = (modelMax[team][axis] - localOrigin[axis]) * inverseDirection;
+		tNear = std::max(tNear, std::min(t0, t1));
+		tFar = std::min(tFar, std::max(t0, t1));
+	}
+	if (tNear > tFar || tNear <= 0.0f || tNear >= maxDistance) return false;
+
+	distance = tNear;
+	return true;
+}
+
+bool SceneQuery::raycastClosest(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit, unsigned filter) const {
+	float length = glm::length(direction);
+	if (length < 1e-12f) return false;
+	glm::vec3 unit = direction / length;
+
+	bool found = false;
+	float limit = maxDistance;
+	if (filter & QUERY_MAP) {
+		MapBVH::Hit mapHit;
+		if (map.raycast(origin, unit, limit, mapHit)) {
+			found = true;
+			limit = mapHit.distance;
+			hit.distance = mapHit.distance;
+			hit.materialIndex = map.getMaterialIndex(mapHit.triangle);
+			hit.character = EntityHandle();
+		}
+	}
+
+	if (filter & QUERY_CHARACTERS) {
+		for (size_t i = 0; i < characterHandles.size(); i++) {
+			float distance;
+			if (intersectCharacter(i, origin, unit, limit, distance)) {
+				found = true;
+				limit = distance;
+				hit.distance = distance;
+				hit.materialIndex = RayHit::NO_MATERIAL;
+				hit.character = characterHandles[i];
+			}
+		}
+	}
+
+	if (found) hit.position = origin + unit * hit.distance;
+	return found;
+}
+
+bool SceneQuery::raycastAny(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned filter) const {
+	float length = glm::length(direction);
+	if (length < 1e-12f) return false;
+	glm::vec3 unit = direction / length;
+
+	// Characters first: a handful of box tests are cheaper than a tree walk
+	if (filter & QUERY_CHARACTERS) {
+		for (size_t i = 0; i < characterHandles.size(); i++) {
+			float distance;
+			if (intersectCharacter(i, origin, unit, maxDistance, distance)) return true;
+		}
+	}
+	return (filter & QUERY_MAP) && map.raycastAny(origin, unit, maxDistance);
+}
+
+size_t SceneQuery::raycastAll(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<RayHit>& hits, unsigned filter) const {
+	hits.clear();
+	float length = glm::length(direction);
+	if (length < 1e-12f) return 0;
+	glm::vec3 unit = direction / length;
+
+	if (filter & QUERY_MAP) {
+		// Per thread so concurrent queries don't share it, and reused so they don't allocate
+		static thread_local std::vector<MapBVH::Hit> mapHits;
+		mapHits.clear();
+		map.raycastAll(origin, unit, maxDistance, mapHits);
+		for (const MapBVH::Hit& mapHit : mapHits) {
+			RayHit hit = { mapHit.distance, origin + unit * mapHit.distance, map.getMaterialIndex(mapHit.triangle), EntityHandle() };
+			hits.push_back(hit);
+		}
+	}
+
+	if (filter & QUERY_CHARACTERS) {
+		for (size_t i = 0; i < characterHandles.size(); i++) {
+			float distance;
+			if (intersectCharacter(i, origin, unit, maxDistance, distance)) {
+				RayHit hit = { distance, origin + unit * distance, RayHit::NO_MATERIAL, characterHandles[i] };
+				hits.push_back(hit);
+			}
+		}
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const RayHit& a, const RayHit& b) { return a.distance < b.distance; });
+	return hits.size();
+}
+
+size_t SceneQuery::getMemoryUsage() const {
+	return vectorBytes(characterInverses) + vectorBytes(characterSpheres) + vectorBytes(characterHandles) + vectorBytes(characterTeams);
+}
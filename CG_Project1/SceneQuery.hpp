@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CharacterStore.hpp"
+
+class MapBVH;
+class OBJLoader;
+
+struct RayHit {
+	static const uint32_t NO_MATERIAL = 0xFFFFFFFFu;
+
+	float distance;
+	glm::vec3 position;
+	uint32_t materialIndex;  // OBJLoader material of the map triangle, NO_MATERIAL for characters
+	EntityHandle character;  // Null unless a character was hit
+};
+
+// "What does this ray hit": map triangles through the BVH and characters as oriented boxes
+// taken from their model's extents and model matrix. Character boxes are refreshed from the
+// store only when its transform version changes, so querying every frame costs nothing extra.
+class SceneQuery {
+public:
+	enum Filter : unsigned {
+		QUERY_MAP = 1 << 0,
+		QUERY_CHARACTERS = 1 << 1,
+		QUERY_ALL = QUERY_MAP | QUERY_CHARACTERS
+	};
+
+	explicit SceneQuery(const MapBVH& map);
+
+	// Model-space bounds for a team's characters, from the vertices of its model
+	void setCharacterModel(CharacterStore::Team team, const OBJLoader& model);
+
+	// Picks up moved, added and removed characters; hidden ones are skipped
+	void updateCharacters(const CharacterStore& characters);
+
+	// The direction does not have to be normalized; distances are in world units. Characters
+	// whose box contains the origin are not hit, so rays can start at a character's eye.
+	bool raycastClosest(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit, unsigned filter = QUERY_ALL) const;
+	bool raycastAny(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned filter = QUERY_ALL) const;
+
+	// Replaces the contents of hits with every hit, nearest first
+	size_t raycastAll(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<RayHit>& hits, unsigned filter = QUERY_ALL) const;
+
+	// Model-space box of a team's characters, as set from its model
+	const glm::vec3& getModelMin(CharacterStore::Team team) const { return modelMin[static_cast<int>(team)]; }
+	const glm::vec3& getModelMax(CharacterStore::Team team) const { return modelMax[static_cast<int>(team)]; }
+
+	size_t getCharacterCount() const { return characterHandles.size(); }
+	size_t getMemoryUsage() const;  // Heap bytes held
+
+private:
+	const MapBVH& map;
+
+	// Model-space box per team, indexed by Team
+	glm::vec3 modelMin[2];
+	glm::vec3 modelMax[2];
+
+	// One entry per queryable character; the inverse model matrix takes rays into the box's
+	// space, the world-space bounding sphere (center, radius) rejects most rays before that
+	std::vector<glm::mat4> characterInverses;
+	std::vector<glm::vec4> characterSpheres;
+	std::vector<EntityHandle> characterHandles;
+	std::vector<uint8_t> characterTeams;
+	unsigned long long characterVersion;
+
+	bool intersectCharacter(size_t index, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+};
@@ -0,0 +1,46 @@
+#include "ShaderPermutationCache.hpp"
+#include <iostream>
+
+namespace {
+	// Indexed by bit position, must match the ShaderFeature enum
+	const char* const featureNames[ShaderFeature::COUNT] = {
+		"CROSSHAIR",
+		"TEXTURED",
+		"INSTANCED",
+		"LIT"
+	};
+}
+
+ShaderPermutationCache::ShaderPermutationCache(const std::string& vertexPath, const std::string& fragmentPath)
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), variants() {}
+
+const ShaderProgram& ShaderPermutationCache::get(unsigned int features) {
+	auto it = variants.find(features);
+	if (it != variants.end()) {
+		return *it->second;
+	}
+
+	std::cout << "Compiling shader variant 0x" << std::hex << features << std::dec
+		<< " (" << vertexPath << ", " << fragmentPath << ")" << std::endl;
+
+	std::unique_ptr<ShaderProgram> program(new ShaderProgram(vertexPath, fragmentPath, definesFor(features)));
+	const ShaderProgram& result = *program;
+	variants.emplace(features, std::move(program));
+	return result;
+}
+
+void ShaderPermutationCache::prewarm(std::initializer_list<unsigned int> featureSets) {
+	for (unsigned int features : featureSets) {
+		get(features);
+	}
+}
+
+std::vector<std::string> ShaderPermutationCache::definesFor(unsigned int features) {
+	std::vector<std::string> defines;
+	for (unsigned int bit = 0; bit < ShaderFeature::COUNT; bit++) {
+		if (features & (1u << bit)) {
+			defines.push_back(featureNames[bit]);
+		}
+	}
+	return defines;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <initializer_list>
+#include "ShaderProgram.hpp"
+
+// Feature bits used to specialize a shader at compile time instead of branching on uniforms.
+// Every set bit becomes a "#define <NAME>" injected into both shader stages.
+namespace ShaderFeature {
+	enum : unsigned int {
+		NONE = 0,
+		CROSSHAIR = 1u << 0,   // Flat colored screen-space lines, no texture or model/view transforms
+		TEXTURED = 1u << 1,    // Sample texture1 for the fragment color
+		INSTANCED = 1u << 2,   // Model matrix comes from a per-instance vertex attribute
+		LIT = 1u << 3,         // Clustered forward point lighting (see ClusteredLighting)
+		COUNT = 4
+	};
+
+	// Common permutation keys
+	constexpr unsigned int WORLD = TEXTURED;
+	constexpr unsigned int WORLD_LIT = TEXTURED | LIT;
+	constexpr unsigned int WORLD_INSTANCED = TEXTURED | INSTANCED;
+	constexpr unsigned int WORLD_LIT_INSTANCED = TEXTURED | LIT | INSTANCED;
+	constexpr unsigned int HUD = CROSSHAIR;
+}
+
+class ShaderPermutationCache {
+public:
+	ShaderPermutationCache(const std::string& vertexPath, const std::string& fragmentPath);
+
+	// Returns the variant for the given feature mask, compiling it on first use
+	const ShaderProgram& get(unsigned int features);
+
+	// Compiles the listed variants up front so the first frame does not hitch
+	void prewarm(std::initializer_list<unsigned int> featureSets);
+
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::unordered_map<unsigned int, std::unique_ptr<ShaderProgram>> variants;
+
+	static std::vector<std::string> definesFor(unsigned int features);
+};
@@ -5,9 +5,15 @@
 #include <glad/glad.h>
 
 ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath) {
-	std::string vertexCode = loadShaderSource(vertexPath);
-	std::string fragmentCode = loadShaderSource(fragmentPath);
+	link(loadShaderSource(vertexPath), loadShaderSource(fragmentPath));
+}
+
+ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines) {
+	link(injectDefines(loadShaderSource(vertexPath), defines),
+		injectDefines(loadShaderSource(fragmentPath), defines));
+}
 
+void ShaderProgram::link(const std::string& vertexCode, const std::string& fragmentCode) {
 	unsigned int vertexShader = compileShader(vertexCode, GL_VERTEX_SHADER);
 	unsigned int fragmentShader = compileShader(fragmentCode, GL_FRAGMENT_SHADER);
 
@@ -50,6 +56,24 @@ std::string ShaderProgram::loadShaderSource(const std::string& filepath) {
 	return buffer.str();
 }
 
+std::string ShaderProgram::injectDefines(const std::string& source, const std::vector<std::string>& defines) {
+	std::string defineBlock;
+	for (const auto& define : defines) {
+		defineBlock += "#define " + define + "\n";
+	}
+
+	// #version has to stay the first directive, so the defines go on the line after it
+	size_t insertPos = 0;
+	if (source.compare(0, 8, "#version") == 0) {
+		size_t lineEnd = source.find('\n');
+		insertPos = (lineEnd == std::string::npos) ? source.size() : lineEnd + 1;
+	}
+
+	std::string result = source;
+	result.insert(insertPos, defineBlock);
+	return result;
+}
+
 void ShaderProgram::checkCompileErrors(unsigned int shader, const std::string& type) {
 	int success;
 	char infoLog[1024];
@@ -82,6 +106,10 @@ void ShaderProgram::setUniform(const std::string& name, const glm::mat4& matrix)
 	glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, &matrix[0][0]);
 }
 
+void ShaderProgram::setUniform(const std::string& name, const glm::vec2& vector) const {
+	glUniform2fv(glGetUniformLocation(programID, name.c_str()), 1, &vector[0]);
+}
+
 void ShaderProgram::setUniform(const std::string& name, const glm::vec3& vector) const {
 	glUniform3fv(glGetUniformLocation(programID, name.c_str()), 1, &vector[0]);
 }
@@ -1,17 +1,21 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 class ShaderProgram {
 public:
 	ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath);
+	// Builds a specialized variant: each define is injected as "#define NAME" right after #version
+	ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines);
 	~ShaderProgram();
 
 	void use() const;
 	void setUniform(const std::string& name, int value) const;
 	void setUniform(const std::string& name, float value) const;
 	void setUniform(const std::string& name, const glm::mat4& matrix) const;
+	void setUniform(const std::string& name, const glm::vec2& vector) const;
 	void setUniform(const std::string& name, const glm::vec3& vector) const;
 	void setUniform(const std::string& name, bool value) const;
 
@@ -21,6 +25,8 @@ private:
 	unsigned int programID;
 	unsigned int compileShader(const std::string& source, unsigned int type);
 	std::string loadShaderSource(const std::string& filepath);
+	std::string injectDefines(const std::string& source, const std::vector<std::string>& defines);
+	void link(const std::string& vertexCode, const std::string& fragmentCode);
 	void checkCompileErrors(unsigned int shader, const std::string& type);
 	void checkLinkErrors();
 };
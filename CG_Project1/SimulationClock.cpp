@@ -0,0 +1,45 @@
+#include "SimulationClock.hpp"
+#include <cmath>
+
+SimulationClock::SimulationClock(int tickRate)
+	: tickRate(tickRate)
+	, tickDelta(1.0 / tickRate)
+	, accumulator(0.0)
+	, frameTime(0.0)
+	, time(0.0)
+	, tick(0)
+	, lastCounter(SDL_GetPerformanceCounter())
+	, counterPeriod(1.0 / static_cast<double>(SDL_GetPerformanceFrequency())) {}
+
+void SimulationClock::reset() {
+	accumulator = 0.0;
+	lastCounter = SDL_GetPerformanceCounter();
+}
+
+int SimulationClock::advance() {
+	Uint64 counter = SDL_GetPerformanceCounter();
+	double elapsed = (counter - lastCounter) * counterPeriod;
+	lastCounter = counter;
+	return advanceBy(elapsed);
+}
+
+int SimulationClock::advanceBy(double seconds) {
+	frameTime = seconds;
+	accumulator += seconds;
+
+	int ticks = 0;
+	while (accumulator >= tickDelta && ticks < MAX_TICKS_PER_FRAME) {
+		accumulator -= tickDelta;
+		ticks++;
+	}
+
+	// After a long hitch drop the whole ticks still owed but keep the partial one, so
+	// interpolation stays in [0, 1) and carries on from where it was
+	if (accumulator >= tickDelta) {
+		accumulator = std::fmod(accumulator, tickDelta);
+	}
+
+	tick += ticks;
+	time += ticks * tickDelta;
+	return ticks;
+}
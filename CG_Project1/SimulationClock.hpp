@@ -0,0 +1,39 @@
+#pragma once
+
+#include <SDL.h>
+
+// Fixed-timestep clock on SDL's high-resolution performance counter. Real elapsed time
+// is accumulated and consumed in whole ticks; the remainder becomes the interpolation
+// factor between the previous and current simulation states when rendering.
+class SimulationClock {
+public:
+	static const int MAX_TICKS_PER_FRAME = 8;  // Drop time beyond this instead of spiraling
+
+	explicit SimulationClock(int tickRate = 64);
+
+	// Restarts timing from now, e.g. after loading
+	void reset();
+
+	// Accumulates real time since the previous call and returns how many ticks to run
+	int advance();
+
+	// Same as advance() but with a fixed amount of time, for deterministic runs
+	int advanceBy(double seconds);
+
+	int getTickRate() const { return tickRate; }
+	float getTickDelta() const { return static_cast<float>(tickDelta); }
+	float getAlpha() const { return static_cast<float>(accumulator / tickDelta); }
+	float getFrameTime() const { return static_cast<float>(frameTime); }
+	double getTime() const { return time; }
+	unsigned long long getTick() const { return tick; }
+
+private:
+	int tickRate;
+	double tickDelta;
+	double accumulator;
+	double frameTime;
+	double time;
+	unsigned long long tick;
+	Uint64 lastCounter;
+	double counterPeriod;  // Seconds per performance counter step
+};
@@ -0,0 +1,219 @@
+#include "Snapshot.hpp"
+#include "BitStream.hpp"
+#include "CharacterStore.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+	const float POSITION_SCALE = 64.0f;
+	const int POSITION_BITS = 17;  // Signed, so +-1024 units at 1/64
+	const int YAW_BITS = 10;
+	const int YAW_DELTA_BITS = 6;  // Signed, about +-11 degrees
+	const int TEAM_BITS = 1;
+	const int WEAPON_BITS = 2;
+	const int GENERATION_BITS = 8;
+	const int INDEX_BITS = 16;
+	const int COUNT_BITS = 10;
+
+	// The widest entity is one written in full after an index that is not the next one
+	static_assert(SnapshotCodec::MAX_ENCODED_BITS == COUNT_BITS + SnapshotCodec::MAX_ENTITIES
+		* (1 + INDEX_BITS + 1 + GENERATION_BITS + 3 * POSITION_BITS + YAW_BITS + TEAM_BITS + WEAPON_BITS), "MAX_ENCODED_BITS is out of date");
+	static_assert(SnapshotCodec::MAX_ENTITIES < (1u << COUNT_BITS), "Entity count does not fit its field");
+
+	const uint32_t YAW_STEPS = 1u << YAW_BITS;
+	const int32_t POSITION_LIMIT = (1 << (POSITION_BITS - 1)) - 1;
+
+	// A moved position sends a 2 bit class picking the narrowest width all three deltas fit;
+	// the last class is the full coordinates. At 64 Hz a running character moves about 6
+	// steps a tick, so acks a tick or two old fit the first class.
+	const int POSITION_DELTA_BITS[] = { 5, 8, 12 };
+	const int POSITION_DELTA_CLASSES = 3;
+	const int POSITION_CLASS_BITS = 2;
+
+	int32_t signedLimit(int bits) {
+		return (1 << (bits - 1)) - 1;
+	}
+
+	// Shortest way round between two quantized yaws
+	int32_t yawDelta(uint16_t to, uint16_t from) {
+		int32_t delta = (static_cast<int32_t>(to) - from) & static_cast<int32_t>(YAW_STEPS - 1);
+		return delta >= static_cast<int32_t>(YAW_STEPS / 2) ? delta - static_cast<int32_t>(YAW_STEPS) : delta;
+	}
+
+	int32_t quantizePosition(float value) {
+		long scaled = std::lround(value * POSITION_SCALE);
+		return static_cast<int32_t>(std::min<long>(std::max<long>(scaled, -POSITION_LIMIT), POSITION_LIMIT));
+	}
+
+	uint16_t quantizeYaw(float degrees) {
+		long steps = std::lround(degrees / 360.0f * YAW_STEPS);
+		return static_cast<uint16_t>(static_cast<uint32_t>(steps) & (YAW_STEPS - 1));
+	}
+
+	bool samePosition(const NetEntity& a, const NetEntity& b) {
+		return a.position[0] == b.position[0] && a.position[1] == b.position[1] && a.position[2] == b.position[2];
+	}
+
+	void writeFull(const NetEntity& entity, BitWriter& writer) {
+		writer.write(entity.generation, GENERATION_BITS);
+		for (int axis = 0; axis < 3; axis++) writer.writeSigned(entity.position[axis], POSITION_BITS);
+		writer.write(entity.yaw, YAW_BITS);
+		writer.write(entity.team, TEAM_BITS);
+		writer.write(entity.weapon, WEAPON_BITS);
+	}
+
+	void readFull(BitReader& reader, NetEntity& entity) {
+		entity.generation = reader.read(GENERATION_BITS);
+		for (int axis = 0; axis < 3; axis++) entity.position[axis] = reader.readSigned(POSITION_BITS);
+		entity.yaw = static_cast<uint16_t>(reader.read(YAW_BITS));
+		entity.team = static_cast<uint8_t>(reader.read(TEAM_BITS));
+		entity.weapon = static_cast<uint8_t>(reader.read(WEAPON_BITS));
+	}
+
+	void writeChanges(const NetEntity& entity, const NetEntity& base, BitWriter& writer) {
+		bool moved = !samePosition(entity, base);
+		writer.writeBool(moved);
+		if (moved) {
+			int32_t delta[3];
+			int32_t largest = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				delta[axis] = entity.position[axis] - base.position[axis];
+				largest = std::max(largest, std::abs(delta[axis]));
+			}
+			int deltaClass = 0;
+			while (deltaClass < POSITION_DELTA_CLASSES && largest > signedLimit(POSITION_DELTA_BITS[deltaClass])) deltaClass++;
+			writer.write(static_cast<uint32_t>(deltaClass), POSITION_CLASS_BITS);
+			for (int axis = 0; axis < 3; axis++) {
+				if (deltaClass < POSITION_DELTA_CLASSES) writer.writeSigned(delta[axis], POSITION_DELTA_BITS[deltaClass]);
+				else writer.writeSigned(entity.position[axis], POSITION_BITS);
+			}
+		}
+
+		bool turned = entity.yaw != base.yaw;
+		writer.writeBool(turned);
+		if (turned) {
+			int32_t delta = yawDelta(entity.yaw, base.yaw);
+			bool small = std::abs(delta) <= signedLimit(YAW_DELTA_BITS);
+			writer.writeBool(small);
+			if (small) writer.writeSigned(delta, YAW_DELTA_BITS);
+			else writer.write(entity.yaw, YAW_BITS);
+		}
+
+		bool switched = entity.team != base.team || entity.weapon != base.weapon;
+		writer.writeBool(switched);
+		if (switched) {
+			writer.write(entity.team, TEAM_BITS);
+			writer.write(entity.weapon, WEAPON_BITS);
+		}
+	}
+
+	void readChanges(BitReader& reader, const NetEntity& base, NetEntity& entity) {
+		entity = base;
+		if (reader.readBool()) {
+			int deltaClass = static_cast<int>(reader.read(POSITION_CLASS_BITS));
+			for (int axis = 0; axis < 3; axis++) {
+				if (deltaClass < POSITION_DELTA_CLASSES) entity.position[axis] = base.position[axis] + reader.readSigned(POSITION_DELTA_BITS[deltaClass]);
+				else entity.position[axis] = reader.readSigned(POSITION_BITS);
+			}
+		}
+		if (reader.readBool()) {
+			if (reader.readBool()) entity.yaw = static_cast<uint16_t>((base.yaw + reader.readSigned(YAW_DELTA_BITS)) & (YAW_STEPS - 1));
+			else entity.yaw = static_cast<uint16_t>(reader.read(YAW_BITS));
+		}
+		if (reader.readBool()) {
+			entity.team = static_cast<uint8_t>(reader.read(TEAM_BITS));
+			entity.weapon = static_cast<uint8_t>(reader.read(WEAPON_BITS));
+		}
+	}
+
+	// Index is written as "one past the previous" in a single bit when it is, in full otherwise
+	void writeIndex(uint32_t index, uint32_t previous, BitWriter& writer) {
+		bool next = index == previous + 1;
+		writer.writeBool(next);
+		if (!next) writer.write(index, INDEX_BITS);
+	}
+
+	uint32_t readIndex(BitReader& reader, uint32_t previous) {
+		return reader.readBool() ? previous + 1 : reader.read(INDEX_BITS);
+	}
+}
+
+void SnapshotCodec::capture(const CharacterStore& characters, const uint8_t* weapons, uint32_t tick, Snapshot& out) {
+	out.tick = tick;
+	out.entities.resize(characters.size());
+	const glm::vec3* positions = characters.getPositions();
+	const float* yaws = characters.getYaws();
+	const CharacterStore::Team* teams = characters.getTeams();
+	for (size_t i = 0; i < characters.size(); i++) {
+		NetEntity& entity = out.entities[i];
+		EntityHandle handle = characters.handleAt(i);
+		entity.index = handle.index;
+		entity.generation = handle.generation & ((1u << GENERATION_BITS) - 1);
+		for (int axis = 0; axis < 3; axis++) entity.position[axis] = quantizePosition(positions[i][axis]);
+		entity.yaw = quantizeYaw(yaws[i]);
+		entity.team = static_cast<uint8_t>(teams[i]);
+		entity.weapon = weapons ? static_cast<uint8_t>(weapons[i] & ((1u << WEAPON_BITS) - 1)) : 0;
+	}
+	std::sort(out.entities.begin(), out.entities.end(), [](const NetEntity& a, const NetEntity& b) { return a.index < b.index; });
+}
+
+glm::vec3 SnapshotCodec::getPosition(const NetEntity& entity) {
+	return glm::vec3(entity.position[0], entity.position[1], entity.position[2]) / POSITION_SCALE;
+}
+
+float SnapshotCodec::getYaw(const NetEntity& entity) {
+	float degrees = entity.yaw * (360.0f / YAW_STEPS);
+	return degrees > 180.0f ? degrees - 360.0f : degrees;
+}
+
+bool SnapshotCodec::encode(const Snapshot& snapshot, const Snapshot* baseline, BitWriter& writer) {
+	if (snapshot.entities.size() > MAX_ENTITIES) return false;
+	writer.write(static_cast<uint32_t>(snapshot.entities.size()), COUNT_BITS);
+
+	// Both lists are sorted by index, so matching baseline entries are found in one walk
+	size_t b = 0;
+	uint32_t previous = 0xFFFFFFFFu;
+	for (const NetEntity& entity : snapshot.entities) {
+		writeIndex(entity.index, previous, writer);
+		previous = entity.index;
+
+		const NetEntity* base = nullptr;
+		if (baseline) {
+			while (b < baseline->entities.size() && baseline->entities[b].index < entity.index) b++;
+			if (b < baseline->entities.size() && baseline->entities[b].index == entity.index
+				&& baseline->entities[b].generation == entity.generation) base = &baseline->entities[b];
+		}
+
+		writer.writeBool(base != nullptr);
+		if (base) writeChanges(entity, *base, writer);
+		else writeFull(entity, writer);
+	}
+	return true;
+}
+
+bool SnapshotCodec::decode(BitReader& reader, uint32_t tick, const Snapshot* baseline, Snapshot& out) {
+	out.tick = tick;
+	uint32_t count = reader.read(COUNT_BITS);
+	if (count > MAX_ENTITIES) return false;
+	out.entities.resize(count);
+
+	size_t b = 0;
+	uint32_t previous = 0xFFFFFFFFu;
+	for (NetEntity& entity : out.entities) {
+		entity.index = readIndex(reader, previous);
+		previous = entity.index;
+
+		if (reader.readBool()) {
+			if (!baseline) return false;
+			while (b < baseline->entities.size() && baseline->entities[b].index < entity.index) b++;
+			if (b >= baseline->entities.size() || baseline->entities[b].index != entity.index) return false;
+			readChanges(reader, baseline->entities[b], entity);
+		}
+		else {
+			readFull(reader, entity);
+		}
+		if (reader.isOverflowed()) return false;
+	}
+	return !reader.isOverflowed();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class CharacterStore;
+class BitWriter;
+class BitReader;
+
+// One character as replicated, already quantized so both ends compare exact integers
+struct NetEntity {
+	uint32_t index;        // Handle slot
+	uint32_t generation;   // Low bits of the handle generation
+	int32_t position[3];   // Feet, in 1/64 units
+	uint16_t yaw;          // Full turn in 1024 steps
+	uint8_t team;
+	uint8_t weapon;
+};
+
+// Every replicated character on one server tick, sorted by index
+struct Snapshot {
+	uint32_t tick;
+	std::vector<NetEntity> entities;
+
+	Snapshot() : tick(0), entities() {}
+};
+
+// Bit-packed snapshots, delta encoded against one the receiver already has. Entities are
+// written in index order so a run of consecutive indices costs a bit each; an entity that
+// was in the baseline sends only the fields that changed, as small deltas when it has not
+// gone far from the baseline and in full otherwise. Entities missing from the new snapshot
+// are simply not written, so the receiver drops them.
+namespace SnapshotCodec {
+	// A snapshot holds at most this many entities, so even a full one with every entity at
+	// its widest takes no more than MAX_ENCODED_BITS and fits a single datagram
+	const size_t MAX_ENTITIES = 100;
+	const size_t MAX_ENCODED_BITS = 10 + MAX_ENTITIES * 90;
+
+	// weapons is per store index and may be null, in which case every weapon is 0
+	void capture(const CharacterStore& characters, const uint8_t* weapons, uint32_t tick, Snapshot& out);
+
+	glm::vec3 getPosition(const NetEntity& entity);
+	float getYaw(const NetEntity& entity);  // Degrees, -180 to 180
+
+	// Baseline may be null for a full snapshot; false if there are more than MAX_ENTITIES
+	bool encode(const Snapshot& snapshot, const Snapshot* baseline, BitWriter& writer);
+	// Baseline must be the snapshot the sender encoded against; false if the data is malformed
+	bool decode(BitReader& reader, uint32_t tick, const Snapshot* baseline, Snapshot& out);
+}
@@ -0,0 +1,85 @@
+#include "SnapshotInterpolator.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Further off the target than this and the clock jumps instead of drifting back
+	const double RESYNC_SECONDS = 0.25;
+	// Share of the drift taken out each frame
+	const double CLOCK_CORRECTION = 0.05;
+	const size_t MAX_BUFFERED = 64;
+
+	float lerpYaw(float from, float to, float t) {
+		float delta = std::fmod(to - from + 540.0f, 360.0f) - 180.0f;
+		return from + delta * t;
+	}
+
+	RemoteCharacter toRemote(const NetEntity& entity) {
+		RemoteCharacter character = { entity.index, SnapshotCodec::getPosition(entity), SnapshotCodec::getYaw(entity), entity.team, entity.weapon };
+		return character;
+	}
+}
+
+SnapshotInterpolator::SnapshotInterpolator(float tickRate, float delaySeconds)
+	: tickRate(tickRate), delayTicks(delaySeconds * tickRate), buffer(), renderTick(0.0), started(false), underruns(0) {}
+
+void SnapshotInterpolator::push(const Snapshot& snapshot) {
+	if (!buffer.empty() && snapshot.tick <= buffer.back().tick) return;
+	buffer.push_back(snapshot);
+	if (buffer.size() > MAX_BUFFERED) buffer.pop_front();
+}
+
+void SnapshotInterpolator::advance(float dt) {
+	if (buffer.empty()) return;
+	double target = buffer.back().tick - delayTicks;
+	if (!started) {
+		renderTick = target;
+		started = true;
+		return;
+	}
+
+	renderTick += dt * tickRate;
+	double drift = target - renderTick;
+	if (std::abs(drift) > RESYNC_SECONDS * tickRate) renderTick = target;
+	else renderTick += drift * CLOCK_CORRECTION;
+	if (renderTick > buffer.back().tick) underruns++;
+
+	// Keep one snapshot at or before the render time to blend from
+	while (buffer.size() > 2 && buffer[1].tick <= renderTick) buffer.pop_front();
+}
+
+bool SnapshotInterpolator::sample(uint32_t skipIndex, std::vector<RemoteCharacter>& out) const {
+	out.clear();
+	if (buffer.empty()) return false;
+
+	// The pair around the render time; before the first or after the last, hold that one
+	size_t next = 0;
+	while (next < buffer.size() && buffer[next].tick <= renderTick) next++;
+	if (next == 0 || next == buffer.size()) {
+		const Snapshot& held = buffer[next == 0 ? 0 : buffer.size() - 1];
+		for (const NetEntity& entity : held.entities) {
+			if (entity.index != skipIndex) out.push_back(toRemote(entity));
+		}
+		return true;
+	}
+
+	const Snapshot& from = buffer[next - 1];
+	const Snapshot& to = buffer[next];
+	float t = static_cast<float>((renderTick - from.tick) / (to.tick - from.tick));
+
+	// Both sorted by index; characters only in the newer snapshot pop in, ones only in the
+	// older are already gone
+	size_t f = 0;
+	for (const NetEntity& entity : to.entities) {
+		if (entity.index == skipIndex) continue;
+		RemoteCharacter character = toRemote(entity);
+		while (f < from.entities.size() && from.entities[f].index < entity.index) f++;
+		if (f < from.entities.size() && from.entities[f].index == entity.index && from.entities[f].generation == entity.generation) {
+			const NetEntity& previous = from.entities[f];
+			character.position = glm::mix(SnapshotCodec::getPosition(previous), character.position, t);
+			character.yaw = lerpYaw(SnapshotCodec::getYaw(previous), character.yaw, t);
+		}
+		out.push_back(character);
+	}
+	return true;
+}
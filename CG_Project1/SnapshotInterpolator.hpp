@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Snapshot.hpp"
+
+// A replicated character as drawn this frame
+struct RemoteCharacter {
+	uint32_t index;
+	glm::vec3 position;  // Feet
+	float yaw;           // Degrees
+	uint8_t team;
+	uint8_t weapon;
+};
+
+// Jitter buffer for remote characters. Snapshots are kept by server tick and the client
+// draws them a fixed delay behind the newest one, blending the two around its render time,
+// so a late or lost snapshot leaves a gap to bridge instead of a stall. The render clock
+// runs at the local frame rate and is nudged towards the target delay rather than set, so
+// arrival jitter does not turn into motion jitter.
+class SnapshotInterpolator {
+public:
+	SnapshotInterpolator(float tickRate, float delaySeconds);
+
+	// Snapshots older than the newest are ignored
+	void push(const Snapshot& snapshot);
+
+	// Moves the render clock on by one frame
+	void advance(float dt);
+
+	// Every character except skipIndex (the local player) at the render time; false until
+	// a snapshot has arrived
+	bool sample(uint32_t skipIndex, std::vector<RemoteCharacter>& out) const;
+
+	double getRenderTick() const { return renderTick; }
+	size_t getBufferedCount() const { return buffer.size(); }
+	// Frames that ran past the newest snapshot and had to hold it
+	size_t getUnderruns() const { return underruns; }
+
+private:
+	float tickRate;
+	float delayTicks;
+	std::deque<Snapshot> buffer;  // Oldest first
+	double renderTick;
+	bool started;
+	size_t underruns;
+};
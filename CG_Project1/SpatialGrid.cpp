@@ -0,0 +1,187 @@
+#include "SpatialGrid.hpp"
+#include "CpuProfiler.hpp"
+#include "MemoryUsage.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Keeps the grid from growing without bound for tiny cell sizes
+	const int MAX_CELLS_PER_AXIS = 4096;
+}
+
+SpatialGrid::SpatialGrid()
+	: cells(), records(), origin(0.0f), cellSize(1.0f), inverseCellSize(1.0f), width(1), depth(1)
+	, entityCount(0), lastUpdated(0) {
+	cells.resize(1);
+}
+
+void SpatialGrid::initialize(const glm::vec3& boundsMin, const glm::vec3& boundsMax, float size) {
+	cellSize = std::max(size, 0.001f);
+	inverseCellSize = 1.0f / cellSize;
+	origin = glm::vec2(boundsMin.x, boundsMin.z);
+
+	float extentX = std::max(boundsMax.x - boundsMin.x, 0.0f);
+	float extentZ = std::max(boundsMax.z - boundsMin.z, 0.0f);
+	width = std::min(std::max(static_cast<int>(std::ceil(extentX * inverseCellSize)), 1), MAX_CELLS_PER_AXIS);
+	depth = std::min(std::max(static_cast<int>(std::ceil(extentZ * inverseCellSize)), 1), MAX_CELLS_PER_AXIS);
+
+	cells.clear();
+	cells.resize(static_cast<size_t>(width) * depth);
+	records.clear();
+	entityCount = 0;
+	lastUpdated = 0;
+}
+
+int SpatialGrid::cellX(float x) const {
+	int cell = static_cast<int>(std::floor((x - origin.x) * inverseCellSize));
+	return std::min(std::max(cell, 0), width - 1);
+}
+
+int SpatialGrid::cellZ(float z) const {
+	int cell = static_cast<int>(std::floor((z - origin.y) * inverseCellSize));
+	return std::min(std::max(cell, 0), depth - 1);
+}
+
+void SpatialGrid::unlink(const Record& record) {
+	// Swap the last entry of the cell into the hole and point its record at the new spot
+	std::vector<Entry>& entries = cells[record.cell];
+	if (record.offset + 1 != entries.size()) {
+		entries[record.offset] = entries.back();
+		records[entries[record.offset].handle.index].offset = record.offset;
+	}
+	entries.pop_back();
+}
+
+void SpatialGrid::update(EntityHandle handle, const glm::vec3& position) {
+	if (handle.isNull()) return;
+	if (handle.index >= records.size()) {
+		Record empty = { 0, NO_CELL, 0 };
+		records.resize(handle.index + 1, empty);
+	}
+
+	Record& record = records[handle.index];
+	uint32_t cell = cellOf(position);
+
+	if (record.cell != NO_CELL && record.generation == handle.generation) {
+		if (record.cell == cell) {
+			// Same cell: only the stored position changes
+			cells[cell][record.offset].position = position;
+			return;
+		}
+		unlink(record);
+	}
+	else if (record.cell != NO_CELL) {
+		// The slot was reused by a newer entity
+		unlink(record);
+	}
+	else {
+		entityCount++;
+	}
+
+	Entry entry = { position, handle };
+	record.generation = handle.generation;
+	record.cell = cell;
+	record.offset = static_cast<uint32_t>(cells[cell].size());
+	cells[cell].push_back(entry);
+}
+
+bool SpatialGrid::remove(EntityHandle handle) {
+	if (handle.isNull() || handle.index >= records.size()) return false;
+	Record& record = records[handle.index];
+	if (record.cell == NO_CELL || record.generation != handle.generation) return false;
+
+	unlink(record);
+	record.cell = NO_CELL;
+	entityCount--;
+	return true;
+}
+
+void SpatialGrid::clear() {
+	for (std::vector<Entry>& entries : cells) {
+		entries.clear();
+	}
+	records.clear();
+	entityCount = 0;
+	lastUpdated = 0;
+}
+
+void SpatialGrid::sync(const CharacterStore& characters) {
+	PROFILE_SCOPE("SpatialGrid::sync");
+	lastUpdated = 0;
+
+	const glm::vec3* positions = characters.getPositions();
+	size_t count = characters.size();
+	for (size_t i = 0; i < count; i++) {
+		EntityHandle handle = characters.handleAt(i);
+		if (handle.index < records.size()) {
+			const Record& record = records[handle.index];
+			if (record.cell != NO_CELL && record.generation == handle.generation && cells[record.cell][record.offset].position == positions[i]) continue;
+		}
+		update(handle, positions[i]);
+		lastUpdated++;
+	}
+
+	// Everything in the store is in the grid now, so any surplus was destroyed
+	if (entityCount > count) {
+		for (uint32_t slot = 0; slot < records.size(); slot++) {
+			Record& record = records[slot];
+			if (record.cell == NO_CELL) continue;
+			if (!characters.isAlive(EntityHandle(slot, record.generation))) {
+				unlink(record);
+				record.cell = NO_CELL;
+				entityCount--;
+			}
+		}
+	}
+}
+
+size_t SpatialGrid::queryRadius(const glm::vec3& center, float radius, std::vector<EntityHandle>& out) const {
+	if (entityCount == 0 || radius < 0.0f) return 0;
+
+	size_t before = out.size();
+	float radiusSquared = radius * radius;
+	int minX = cellX(center.x - radius);
+	int maxX = cellX(center.x + radius);
+	int minZ = cellZ(center.z - radius);
+	int maxZ = cellZ(center.z + radius);
+
+	for (int z = minZ; z <= maxZ; z++) {
+		for (int x = minX; x <= maxX; x++) {
+			for (const Entry& entry : cells[z * width + x]) {
+				glm::vec3 offset = entry.position - center;
+				if (glm::dot(offset, offset) <= radiusSquared) {
+					out.push_back(entry.handle);
+				}
+			}
+		}
+	}
+	return out.size() - before;
+}
+
+size_t SpatialGrid::queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<EntityHandle>& out) const {
+	if (entityCount == 0) return 0;
+
+	size_t before = out.size();
+	int minX = cellX(boxMin.x);
+	int maxX = cellX(boxMax.x);
+	int minZ = cellZ(boxMin.z);
+	int maxZ = cellZ(boxMax.z);
+
+	for (int z = minZ; z <= maxZ; z++) {
+		for (int x = minX; x <= maxX; x++) {
+			for (const Entry& entry : cells[z * width + x]) {
+				const glm::vec3& p = entry.position;
+				if (p.x >= boxMin.x && p.x <= boxMax.x && p.y >= boxMin.y && p.y <= boxMax.y && p.z >= boxMin.z && p.z <= boxMax.z) {
+					out.push_back(entry.handle);
+				}
+			}
+		}
+	}
+	return out.size() - before;
+}
+
+size_t SpatialGrid::getMemoryUsage() const {
+	size_t bytes = vectorBytes(cells) + vectorBytes(records);
+	for (const std::vector<Entry>& cell : cells) bytes += vectorBytes(cell);
+	return bytes;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CharacterStore.hpp"
+
+// Uniform grid over the map's XZ extent for "who is within r of me". Every cell keeps its
+// entities' positions and handles packed together, so a query streams through a handful of
+// short arrays. Entities are tracked by handle, so moving one only touches the two cells it
+// leaves and enters, and positions outside the bounds fall into the border cells.
+class SpatialGrid {
+public:
+	SpatialGrid();
+
+	// Covers the XZ extent of the box with square cells; forgets every entity
+	void initialize(const glm::vec3& boundsMin, const glm::vec3& boundsMax, float cellSize);
+
+	// Insert, move and remove are constant time. Update inserts handles it has not seen
+	// and replaces an older generation of the same slot.
+	void update(EntityHandle handle, const glm::vec3& position);
+	bool remove(EntityHandle handle);
+	void clear();
+
+	// Follows the store: updates entities whose position changed, drops destroyed ones.
+	// One comparison per entity; only movers are relinked.
+	void sync(const CharacterStore& characters);
+
+	// Append the handles inside the sphere or box; the vector is not cleared, so callers
+	// can keep one around and avoid allocating per query
+	size_t queryRadius(const glm::vec3& center, float radius, std::vector<EntityHandle>& out) const;
+	size_t queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<EntityHandle>& out) const;
+
+	size_t size() const { return entityCount; }
+	size_t getMemoryUsage() const;  // Heap bytes held
+	size_t getCellCount() const { return cells.size(); }
+	float getCellSize() const { return cellSize; }
+
+	// Entities the last sync inserted or moved
+	size_t getLastUpdated() const { return lastUpdated; }
+
+private:
+	static const uint32_t NO_CELL = 0xFFFFFFFFu;
+
+	struct Entry {
+		glm::vec3 position;
+		EntityHandle handle;
+	};
+
+	// Indexed by handle slot: where that slot's entity currently sits
+	struct Record {
+		uint32_t generation;
+		uint32_t cell;    // NO_CELL while the slot is not in the grid
+		uint32_t offset;  // Index into the cell's entries
+	};
+
+	std::vector<std::vector<Entry>> cells;
+	std::vector<Record> records;
+	glm::vec2 origin;
+	float cellSize;
+	float inverseCellSize;
+	int width;
+	int depth;
+	size_t entityCount;
+	size_t lastUpdated;
+
+	int cellX(float x) const;
+	int cellZ(float z) const;
+	uint32_t cellOf(const glm::vec3& position) const { return static_cast<uint32_t>(cellZ(position.z) * width + cellX(position.x)); }
+	void unlink(const Record& record);
+};
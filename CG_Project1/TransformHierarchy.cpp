@@ -0,0 +1,50 @@
+#include "TransformHierarchy.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+
+const TransformId TransformHierarchy::ROOT;
+const TransformId TransformHierarchy::INVALID;
+
+TransformHierarchy::TransformHierarchy()
+	: parents(1, ROOT), locals(1, glm::mat4(1.0f)), worlds(1, glm::mat4(1.0f)), states(1, CLEAN)
+	, firstDirty(1), version(0), lastUpdateCount(0) {}
+
+TransformId TransformHierarchy::create(TransformId parent, const glm::mat4& local) {
+	TransformId id = static_cast<TransformId>(parents.size());
+	if (parent >= id) parent = ROOT;
+
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	states.push_back(DIRTY);
+	firstDirty = std::min(firstDirty, static_cast<size_t>(id));
+	return id;
+}
+
+void TransformHierarchy::setLocal(TransformId id, const glm::mat4& local) {
+	if (id == ROOT || id >= parents.size()) return;
+
+	locals[id] = local;
+	states[id] = DIRTY;
+	firstDirty = std::min(firstDirty, static_cast<size_t>(id));
+}
+
+void TransformHierarchy::update() {
+	lastUpdateCount = 0;
+	if (firstDirty >= parents.size()) return;
+
+	PROFILE_SCOPE("TransformHierarchy::update");
+	size_t count = parents.size();
+
+	// A node is recomputed if it changed or its parent was recomputed earlier in this sweep
+	for (size_t i = firstDirty; i < count; i++) {
+		if (states[i] == CLEAN && states[parents[i]] == CLEAN) continue;
+		worlds[i] = worlds[parents[i]] * locals[i];
+		states[i] = DIRTY;
+		lastUpdateCount++;
+	}
+	std::fill(states.begin() + firstDirty, states.end(), static_cast<uint8_t>(CLEAN));
+
+	firstDirty = count;
+	version++;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+typedef uint32_t TransformId;
+
+// Parent/child transforms with cached local and world matrices. Nodes are stored parent
+// before child, so update() is one forward sweep: a node's world matrix is recomputed only
+// if it or an ancestor was changed since the last update. Nothing dirty means update()
+// returns immediately, so static nodes cost nothing per frame.
+class TransformHierarchy {
+public:
+	// The world; identity and never dirty
+	static const TransformId ROOT = 0;
+	static const TransformId INVALID = 0xFFFFFFFFu;
+
+	TransformHierarchy();
+
+	// The parent must already exist, which is what keeps the arrays in update order
+	TransformId create(TransformId parent = ROOT, const glm::mat4& local = glm::mat4(1.0f));
+
+	void setLocal(TransformId id, const glm::mat4& local);
+	const glm::mat4& getLocal(TransformId id) const { return locals[id]; }
+	TransformId getParent(TransformId id) const { return parents[id]; }
+
+	// Up to date after update()
+	const glm::mat4& getWorld(TransformId id) const { return worlds[id]; }
+
+	void update();
+
+	size_t size() const { return parents.size(); }
+
+	// Bumped by every update() that changed at least one world matrix
+	unsigned long long getVersion() const { return version; }
+
+	// Nodes recomputed by the last update()
+	size_t getLastUpdateCount() const { return lastUpdateCount; }
+
+private:
+	enum : uint8_t { CLEAN = 0, DIRTY = 1 };
+
+	std::vector<TransformId> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<uint8_t> states;
+
+	size_t firstDirty;  // Lowest dirty index; the sweep starts here, size() when clean
+	unsigned long long version;
+	size_t lastUpdateCount;
+};
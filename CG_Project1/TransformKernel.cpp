@@ -0,0 +1,342 @@
+#include "TransformKernel.hpp"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define TRANSFORM_KERNEL_SSE 1
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRANSFORM_KERNEL_AVX2_TARGET
+#define TRANSFORM_KERNEL_AVX2 1
+#elif defined(__GNUC__)
+#define TRANSFORM_KERNEL_AVX2_TARGET __attribute__((target("avx2,fma")))
+#define TRANSFORM_KERNEL_AVX2 1
+#endif
+#endif
+
+namespace {
+	const float DEGREES_TO_RADIANS = 3.14159265358979f / 180.0f;
+
+	float scaleAt(const TransformBatch& batch, size_t i) {
+		return batch.scales ? batch.scales[i] : batch.uniformScale;
+	}
+
+	void writeMatrix(float* out, float c, float s, float scale, const glm::vec3& position) {
+		out[0] = c;     out[1] = 0.0f;  out[2] = -s;    out[3] = 0.0f;
+		out[4] = 0.0f;  out[5] = scale; out[6] = 0.0f;  out[7] = 0.0f;
+		out[8] = s;     out[9] = 0.0f;  out[10] = c;    out[11] = 0.0f;
+		out[12] = position.x; out[13] = position.y; out[14] = position.z; out[15] = 1.0f;
+	}
+
+	void buildScalar(const TransformBatch& batch, size_t begin, float* out) {
+		for (size_t i = begin; i < batch.count; i++) {
+			float radians = batch.yawsDegrees[i] * DEGREES_TO_RADIANS;
+			float scale = scaleAt(batch, i);
+			writeMatrix(out + i * 16, std::cos(radians) * scale, std::sin(radians) * scale, scale, batch.positions[i]);
+		}
+	}
+
+#ifdef TRANSFORM_KERNEL_SSE
+	// Cephes single precision sin/cos: reduce to [-pi/4, pi/4] by octant, then pick the sine
+	// or cosine minimax polynomial per lane. Max error is a few ulp for |x| < 8192.
+	const float FOUR_OVER_PI = 1.27323954473516f;
+	const float DP1 = -0.78515625f;
+	const float DP2 = -2.4187564849853515625e-4f;
+	const float DP3 = -3.77489497744594108e-8f;
+	const float SIN_P0 = -1.9515295891e-4f;
+	const float SIN_P1 = 8.3321608736e-3f;
+	const float SIN_P2 = -1.6666654611e-1f;
+	const float COS_P0 = 2.443315711809948e-5f;
+	const float COS_P1 = -1.388731625493765e-3f;
+	const float COS_P2 = 4.166664568298827e-2f;
+
+	void sinCos4(__m128 x, __m128& sines, __m128& cosines) {
+		const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+		__m128 signSin = _mm_and_ps(x, signMask);
+		x = _mm_andnot_ps(signMask, x);
+
+		// Octant, rounded up to even
+		__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+		octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+		__m128 y = _mm_cvtepi32_ps(octant);
+
+		__m128 flipSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29));
+		__m128 flipCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+		__m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+		signSin = _mm_xor_ps(signSin, flipSin);
+
+		// Extended precision x - y * pi/4
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP1)));
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP2)));
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP3)));
+		__m128 z = _mm_mul_ps(x, x);
+
+		__m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_P0), z), _mm_set1_ps(COS_P1));
+		cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(COS_P2));
+		cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+		cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+		__m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_P0), z), _mm_set1_ps(SIN_P1));
+		sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(SIN_P2));
+		sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+		__m128 sinResult = _mm_or_ps(_mm_and_ps(polyMask, sinPoly), _mm_andnot_ps(polyMask, cosPoly));
+		__m128 cosResult = _mm_or_ps(_mm_and_ps(polyMask, cosPoly), _mm_andnot_ps(polyMask, sinPoly));
+		sines = _mm_xor_ps(sinResult, signSin);
+		cosines = _mm_xor_ps(cosResult, flipCos);
+	}
+
+	// Turns four lanes of c, s, scale and position into four packed matrices
+	void storeMatrices4(float* out, __m128 c, __m128 s, __m128 scale, __m128 px, __m128 py, __m128 pz) {
+		const __m128 zero = _mm_setzero_ps();
+		__m128 column0[4] = { c, zero, _mm_sub_ps(zero, s), zero };
+		__m128 column1[4] = { zero, scale, zero, zero };
+		__m128 column2[4] = { s, zero, c, zero };
+		__m128 column3[4] = { px, py, pz, _mm_set1_ps(1.0f) };
+		_MM_TRANSPOSE4_PS(column0[0], column0[1], column0[2], column0[3]);
+		_MM_TRANSPOSE4_PS(column1[0], column1[1], column1[2], column1[3]);
+		_MM_TRANSPOSE4_PS(column2[0], column2[1], column2[2], column2[3]);
+		_MM_TRANSPOSE4_PS(column3[0], column3[1], column3[2], column3[3]);
+
+		for (int lane = 0; lane < 4; lane++) {
+			float* matrix = out + lane * 16;
+			_mm_storeu_ps(matrix, column0[lane]);
+			_mm_storeu_ps(matrix + 4, column1[lane]);
+			_mm_storeu_ps(matrix + 8, column2[lane]);
+			_mm_storeu_ps(matrix + 12, column3[lane]);
+		}
+	}
+
+	void loadPositions4(const glm::vec3* positions, __m128& px, __m128& py, __m128& pz) {
+		px = _mm_setr_ps(positions[0].x, positions[1].x, positions[2].x, positions[3].x);
+		py = _mm_setr_ps(positions[0].y, positions[1].y, positions[2].y, positions[3].y);
+		pz = _mm_setr_ps(positions[0].z, positions[1].z, positions[2].z, positions[3].z);
+	}
+
+	__m128 loadScales4(const TransformBatch& batch, size_t i) {
+		return batch.scales ? _mm_loadu_ps(batch.scales + i) : _mm_set1_ps(batch.uniformScale);
+	}
+
+	size_t buildSse2(const TransformBatch& batch, float* out) {
+		size_t i = 0;
+		for (; i + 4 <= batch.count; i += 4) {
+			__m128 radians = _mm_mul_ps(_mm_loadu_ps(batch.yawsDegrees + i), _mm_set1_ps(DEGREES_TO_RADIANS));
+			__m128 s, c;
+			sinCos4(radians, s, c);
+			__m128 scale = loadScales4(batch, i);
+			__m128 px, py, pz;
+			loadPositions4(batch.positions + i, px, py, pz);
+			storeMatrices4(out + i * 16, _mm_mul_ps(c, scale), _mm_mul_ps(s, scale), scale, px, py, pz);
+		}
+		return i;
+	}
+
+#ifdef TRANSFORM_KERNEL_AVX2
+	TRANSFORM_KERNEL_AVX2_TARGET
+	void sinCos8(__m256 x, __m256& sines, __m256& cosines) {
+		const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000u)));
+		__m256 signSin = _mm256_and_ps(x, signMask);
+		x = _mm256_andnot_ps(signMask, x);
+
+		__m256i octant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOUR_OVER_PI)));
+		octant = _mm256_and_si256(_mm256_add_epi32(octant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+		__m256 y = _mm256_cvtepi32_ps(octant);
+
+		__m256 flipSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(4)), 29));
+		__m256 flipCos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+		__m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+		signSin = _mm256_xor_ps(signSin, flipSin);
+
+		x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP1), x);
+		x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP2), x);
+		x = _mm256_fmadd_ps(y, _mm256_set1_ps(DP3), x);
+		__m256 z = _mm256_mul_ps(x, x);
+
+		__m256 cosPoly = _mm256_fmadd_ps(_mm256_set1_ps(COS_P0), z, _mm256_set1_ps(COS_P1));
+		cosPoly = _mm256_fmadd_ps(cosPoly, z, _mm256_set1_ps(COS_P2));
+		cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+		cosPoly = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), cosPoly), _mm256_set1_ps(1.0f));
+
+		__m256 sinPoly = _mm256_fmadd_ps(_mm256_set1_ps(SIN_P0), z, _mm256_set1_ps(SIN_P1));
+		sinPoly = _mm256_fmadd_ps(sinPoly, z, _mm256_set1_ps(SIN_P2));
+		sinPoly = _mm256_fmadd_ps(_mm256_mul_ps(sinPoly, z), x, x);
+
+		sines = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, polyMask), signSin);
+		cosines = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, polyMask), flipCos);
+	}
+
+	// In-lane 4x4 transpose: each 128-bit half is transposed on its own
+	TRANSFORM_KERNEL_AVX2_TARGET
+	void transposeHalves(__m256& r0, __m256& r1, __m256& r2, __m256& r3) {
+		__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+		__m256 t1 = _mm256_unpacklo_ps(r2, r3);
+		__m256 t2 = _mm256_unpackhi_ps(r0, r1);
+		__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+		r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// Eight-lane version of storeMatrices4, kept in 256-bit registers throughout so the
+	// AVX2 path never mixes in legacy SSE encodings
+	TRANSFORM_KERNEL_AVX2_TARGET
+	void storeMatrices8(float* out, __m256 c, __m256 s, __m256 scale, __m256 px, __m256 py, __m256 pz) {
+		const __m256 zero = _mm256_setzero_ps();
+		__m256 column0[4] = { c, zero, _mm256_sub_ps(zero, s), zero };
+		__m256 column1[4] = { zero, scale, zero, zero };
+		__m256 column2[4] = { s, zero, c, zero };
+		__m256 column3[4] = { px, py, pz, _mm256_set1_ps(1.0f) };
+		transposeHalves(column0[0], column0[1], column0[2], column0[3]);
+		transposeHalves(column1[0], column1[1], column1[2], column1[3]);
+		transposeHalves(column2[0], column2[1], column2[2], column2[3]);
+		transposeHalves(column3[0], column3[1], column3[2], column3[3]);
+
+		// Lane j sits in the low halves, lane j + 4 in the high halves
+		for (int lane = 0; lane < 4; lane++) {
+			float* low = out + lane * 16;
+			float* high = out + (lane + 4) * 16;
+			_mm256_storeu_ps(low, _mm256_permute2f128_ps(column0[lane], column1[lane], 0x20));
+			_mm256_storeu_ps(low + 8, _mm256_permute2f128_ps(column2[lane], column3[lane], 0x20));
+			_mm256_storeu_ps(high, _mm256_permute2f128_ps(column0[lane], column1[lane], 0x31));
+			_mm256_storeu_ps(high + 8, _mm256_permute2f128_ps(column2[lane], column3[lane], 0x31));
+		}
+	}
+
+	TRANSFORM_KERNEL_AVX2_TARGET
+	size_t buildAvx2(const TransformBatch& batch, float* out) {
+		size_t i = 0;
+		for (; i + 8 <= batch.count; i += 8) {
+			__m256 radians = _mm256_mul_ps(_mm256_loadu_ps(batch.yawsDegrees + i), _mm256_set1_ps(DEGREES_TO_RADIANS));
+			__m256 s, c;
+			sinCos8(radians, s, c);
+			__m256 scale = batch.scales ? _mm256_loadu_ps(batch.scales + i) : _mm256_set1_ps(batch.uniformScale);
+			c = _mm256_mul_ps(c, scale);
+			s = _mm256_mul_ps(s, scale);
+
+			__m256 px = _mm256_setr_ps(batch.positions[i].x, batch.positions[i + 1].x, batch.positions[i + 2].x, batch.positions[i + 3].x,
+				batch.positions[i + 4].x, batch.positions[i + 5].x, batch.positions[i + 6].x, batch.positions[i + 7].x);
+			__m256 py = _mm256_setr_ps(batch.positions[i].y, batch.positions[i + 1].y, batch.positions[i + 2].y, batch.positions[i + 3].y,
+				batch.positions[i + 4].y, batch.positions[i + 5].y, batch.positions[i + 6].y, batch.positions[i + 7].y);
+			__m256 pz = _mm256_setr_ps(batch.positions[i].z, batch.positions[i + 1].z, batch.positions[i + 2].z, batch.positions[i + 3].z,
+				batch.positions[i + 4].z, batch.positions[i + 5].z, batch.positions[i + 6].z, batch.positions[i + 7].z);
+			storeMatrices8(out + i * 16, c, s, scale, px, py, pz);
+		}
+		_mm256_zeroupper();
+		return i;
+	}
+
+	TRANSFORM_KERNEL_AVX2_TARGET
+	size_t sinCosAvx2(const float* radians, float* sines, float* cosines, size_t count) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 s, c;
+			sinCos8(_mm256_loadu_ps(radians + i), s, c);
+			_mm256_storeu_ps(sines + i, s);
+			_mm256_storeu_ps(cosines + i, c);
+		}
+		_mm256_zeroupper();
+		return i;
+	}
+
+	bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && fma && (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+#endif
+#endif
+}
+
+bool TransformKernel::isSupported(Path path) {
+	switch (path) {
+		case Path::SCALAR:
+			return true;
+#ifdef TRANSFORM_KERNEL_SSE
+		case Path::SSE2:
+			return true;
+#endif
+#ifdef TRANSFORM_KERNEL_AVX2
+		case Path::AVX2: {
+			static const bool supported = cpuHasAvx2();
+			return supported;
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+TransformKernel::Path TransformKernel::bestPath() {
+	if (isSupported(Path::AVX2)) return Path::AVX2;
+	if (isSupported(Path::SSE2)) return Path::SSE2;
+	return Path::SCALAR;
+}
+
+const char* TransformKernel::pathName(Path path) {
+	switch (path) {
+		case Path::AVX2: return "AVX2";
+		case Path::SSE2: return "SSE2";
+		default: return "scalar";
+	}
+}
+
+void TransformKernel::build(const TransformBatch& batch, float* out) {
+	static const Path path = bestPath();
+	build(batch, out, path);
+}
+
+void TransformKernel::build(const TransformBatch& batch, float* out, Path path) {
+	if (!isSupported(path)) path = Path::SCALAR;
+
+	size_t done = 0;
+#ifdef TRANSFORM_KERNEL_AVX2
+	if (path == Path::AVX2) done = buildAvx2(batch, out);
+#endif
+#ifdef TRANSFORM_KERNEL_SSE
+	// Also picks up a 4-wide remainder after the 8-wide loop
+	if (path != Path::SCALAR) {
+		TransformBatch rest = batch;
+		rest.positions += done;
+		rest.yawsDegrees += done;
+		if (rest.scales) rest.scales += done;
+		rest.count -= done;
+		done += buildSse2(rest, out + done * 16);
+	}
+#endif
+	buildScalar(batch, done, out);
+}
+
+void TransformKernel::sinCos(const float* radians, float* sines, float* cosines, size_t count, Path path) {
+	if (!isSupported(path)) path = Path::SCALAR;
+
+	size_t i = 0;
+#ifdef TRANSFORM_KERNEL_AVX2
+	if (path == Path::AVX2) i = sinCosAvx2(radians, sines, cosines, count);
+#endif
+#ifdef TRANSFORM_KERNEL_SSE
+	if (path != Path::SCALAR) {
+		for (; i + 4 <= count; i += 4) {
+			__m128 s, c;
+			sinCos4(_mm_loadu_ps(radians + i), s, c);
+			_mm_storeu_ps(sines + i, s);
+			_mm_storeu_ps(cosines + i, c);
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		sines[i] = std::sin(radians[i]);
+		cosines[i] = std::cos(radians[i]);
+	}
+}
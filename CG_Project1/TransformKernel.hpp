@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Input for a batch of yaw-only transforms, laid out as separate arrays (struct of arrays)
+struct TransformBatch {
+	const glm::vec3* positions;
+	const float* yawsDegrees;
+	const float* scales;  // Per-entity uniform scale, or nullptr to use uniformScale for all
+	float uniformScale;
+	size_t count;
+};
+
+// Builds translate(position) * rotateY(yaw) * scale(s) for many entities at once, the same
+// matrices glm::translate/rotate/scale produce. Output is packed column-major 4x4 floats,
+// 16 per entity, written front to back with unaligned stores so it can target mapped GL
+// instance buffers directly. The SIMD paths evaluate sin/cos 4 or 8 lanes at a time.
+namespace TransformKernel {
+	enum class Path { SCALAR, SSE2, AVX2 };
+
+	// Widest path supported by the compiler and the running CPU
+	Path bestPath();
+	bool isSupported(Path path);
+	const char* pathName(Path path);
+
+	void build(const TransformBatch& batch, float* out);
+	void build(const TransformBatch& batch, float* out, Path path);
+
+	// Vectorized sine and cosine of count angles in radians, for testing and reuse
+	void sinCos(const float* radians, float* sines, float* cosines, size_t count, Path path);
+}
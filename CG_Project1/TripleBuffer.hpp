@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free single-producer/single-consumer triple buffer. The writer fills writeBuffer()
+// and publishes it; the reader picks up the newest published slot whenever it is ready.
+// Neither side ever waits, and the reader never sees a half-written slot. Slots are
+// recycled, so the writer must overwrite everything it relies on before publishing.
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : state(1), writeIndex(0), readIndex(2) {}
+
+	// Writer side
+	T& writeBuffer() { return slots[writeIndex]; }
+
+	void publish() {
+		unsigned int previous = state.exchange(writeIndex | DIRTY_BIT, std::memory_order_acq_rel);
+		writeIndex = previous & INDEX_MASK;
+	}
+
+	// True while the last published slot has not been picked up by the reader
+	bool hasUnread() const { return (state.load(std::memory_order_acquire) & DIRTY_BIT) != 0; }
+
+	// Reader side; returns false if nothing new was published since the last acquire
+	bool acquire() {
+		if (!hasUnread()) return false;
+		unsigned int previous = state.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & INDEX_MASK;
+		return true;
+	}
+
+	const T& readBuffer() const { return slots[readIndex]; }
+
+private:
+	static const unsigned int INDEX_MASK = 3u;
+	static const unsigned int DIRTY_BIT = 4u;
+
+	T slots[3];
+	std::atomic<unsigned int> state;  // Index of the shared middle slot plus the dirty bit
+	unsigned int writeIndex;          // Only touched by the writer
+	unsigned int readIndex;           // Only touched by the reader
+};
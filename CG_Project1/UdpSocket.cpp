@@ -0,0 +1,233 @@
+#include "UdpSocket.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mstcpip.h>
+typedef int socklen_t;
+typedef SOCKET NativeSocket;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int NativeSocket;
+#endif
+
+#if defined(__linux__)
+#define UDP_SOCKET_MMSG 1
+#endif
+
+const size_t Datagram::MAX_SIZE;
+
+namespace {
+	const intptr_t NO_SOCKET = -1;
+
+	// Largest batch handed to one sendmmsg or recvmmsg call
+	const size_t MMSG_BATCH = 64;
+
+	// Room for bursts between ticks; the default is small on some systems
+	const int BUFFER_BYTES = 1 << 20;
+
+	sockaddr_in toNative(const SocketAddress& address) {
+		sockaddr_in native;
+		std::memset(&native, 0, sizeof(native));
+		native.sin_family = AF_INET;
+		native.sin_addr.s_addr = htonl(address.ip);
+		native.sin_port = htons(address.port);
+		return native;
+	}
+
+	SocketAddress fromNative(const sockaddr_in& native) {
+		return SocketAddress(ntohl(native.sin_addr.s_addr), ntohs(native.sin_port));
+	}
+
+#if defined(_WIN32)
+	// Winsock has to be started once per process before any socket exists
+	int winsockUsers = 0;
+
+	bool startNetworking() {
+		if (winsockUsers++ > 0) return true;
+		WSADATA data;
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+			winsockUsers--;
+			return false;
+		}
+		return true;
+	}
+
+	void stopNetworking() {
+		if (--winsockUsers == 0) WSACleanup();
+	}
+#else
+	bool startNetworking() { return true; }
+	void stopNetworking() {}
+#endif
+
+	void closeNative(intptr_t handle) {
+#if defined(_WIN32)
+		closesocket(static_cast<NativeSocket>(handle));
+#else
+		::close(static_cast<NativeSocket>(handle));
+#endif
+	}
+}
+
+bool SocketAddress::parse(const std::string& text, uint16_t port, SocketAddress& out) {
+	in_addr address;
+	if (inet_pton(AF_INET, text.c_str(), &address) != 1) return false;
+	out = SocketAddress(ntohl(address.s_addr), port);
+	return true;
+}
+
+UdpSocket::UdpSocket() : handle(NO_SOCKET), port(0) {}
+
+UdpSocket::~UdpSocket() {
+	close();
+}
+
+bool UdpSocket::open(uint16_t requestedPort) {
+	close();
+	if (!startNetworking()) {
+		std::cerr << "Failed to start networking" << std::endl;
+		return false;
+	}
+
+#if defined(_WIN32)
+	SOCKET native = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (native == INVALID_SOCKET) {
+		stopNetworking();
+		std::cerr << "Failed to create UDP socket" << std::endl;
+		return false;
+	}
+	handle = static_cast<intptr_t>(native);
+	u_long nonBlocking = 1;
+	bool configured = ioctlsocket(native, FIONBIO, &nonBlocking) == 0;
+
+	// Otherwise an ICMP port unreachable from a client that went away fails a later receive
+	BOOL reportReset = FALSE;
+	DWORD returned = 0;
+	WSAIoctl(native, SIO_UDP_CONNRESET, &reportReset, sizeof(reportReset), nullptr, 0, &returned, nullptr, nullptr);
+#else
+	int native = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (native < 0) {
+		std::cerr << "Failed to create UDP socket" << std::endl;
+		return false;
+	}
+	handle = native;
+	bool configured = fcntl(native, F_SETFL, fcntl(native, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+
+	setsockopt(native, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&BUFFER_BYTES), sizeof(BUFFER_BYTES));
+	setsockopt(native, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&BUFFER_BYTES), sizeof(BUFFER_BYTES));
+
+	sockaddr_in address = toNative(SocketAddress(INADDR_ANY, requestedPort));
+	if (!configured || bind(native, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		std::cerr << "Failed to bind UDP socket to port " << requestedPort << std::endl;
+		close();
+		return false;
+	}
+
+	sockaddr_in bound;
+	socklen_t length = sizeof(bound);
+	getsockname(native, reinterpret_cast<sockaddr*>(&bound), &length);
+	port = ntohs(bound.sin_port);
+	return true;
+}
+
+void UdpSocket::close() {
+	if (handle == NO_SOCKET) return;
+	closeNative(handle);
+	stopNetworking();
+	handle = NO_SOCKET;
+	port = 0;
+}
+
+bool UdpSocket::isOpen() const {
+	return handle != NO_SOCKET;
+}
+
+size_t UdpSocket::send(const Datagram* datagrams, size_t count) {
+	if (handle == NO_SOCKET) return 0;
+	size_t sent = 0;
+
+#if defined(UDP_SOCKET_MMSG)
+	mmsghdr messages[MMSG_BATCH];
+	iovec buffers[MMSG_BATCH];
+	sockaddr_in addresses[MMSG_BATCH];
+	while (sent < count) {
+		size_t batch = std::min(count - sent, MMSG_BATCH);
+		for (size_t i = 0; i < batch; i++) {
+			const Datagram& datagram = datagrams[sent + i];
+			addresses[i] = toNative(datagram.address);
+			buffers[i].iov_base = const_cast<uint8_t*>(datagram.data);
+			buffers[i].iov_len = datagram.size;
+			std::memset(&messages[i], 0, sizeof(mmsghdr));
+			messages[i].msg_hdr.msg_name = &addresses[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			messages[i].msg_hdr.msg_iov = &buffers[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+		int result = sendmmsg(static_cast<NativeSocket>(handle), messages, static_cast<unsigned int>(batch), 0);
+		if (result <= 0) break;
+		sent += result;
+		if (static_cast<size_t>(result) < batch) break;
+	}
+#else
+	for (; sent < count; sent++) {
+		const Datagram& datagram = datagrams[sent];
+		sockaddr_in address = toNative(datagram.address);
+		int result = sendto(static_cast<NativeSocket>(handle), reinterpret_cast<const char*>(datagram.data), datagram.size, 0,
+			reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+		if (result < 0) break;
+	}
+#endif
+	return sent;
+}
+
+size_t UdpSocket::receive(Datagram* datagrams, size_t maxCount) {
+	if (handle == NO_SOCKET) return 0;
+	size_t received = 0;
+
+#if defined(UDP_SOCKET_MMSG)
+	mmsghdr messages[MMSG_BATCH];
+	iovec buffers[MMSG_BATCH];
+	sockaddr_in addresses[MMSG_BATCH];
+	while (received < maxCount) {
+		size_t batch = std::min(maxCount - received, MMSG_BATCH);
+		for (size_t i = 0; i < batch; i++) {
+			buffers[i].iov_base = datagrams[received + i].data;
+			buffers[i].iov_len = Datagram::MAX_SIZE;
+			std::memset(&messages[i], 0, sizeof(mmsghdr));
+			messages[i].msg_hdr.msg_name = &addresses[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			messages[i].msg_hdr.msg_iov = &buffers[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+		int result = recvmmsg(static_cast<NativeSocket>(handle), messages, static_cast<unsigned int>(batch), MSG_DONTWAIT, nullptr);
+		if (result <= 0) break;
+		for (int i = 0; i < result; i++) {
+			datagrams[received + i].address = fromNative(addresses[i]);
+			datagrams[received + i].size = static_cast<uint16_t>(messages[i].msg_len);
+		}
+		received += result;
+		if (static_cast<size_t>(result) < batch) break;
+	}
+#else
+	for (; received < maxCount; received++) {
+		Datagram& datagram = datagrams[received];
+		sockaddr_in address;
+		socklen_t length = sizeof(address);
+		int result = recvfrom(static_cast<NativeSocket>(handle), reinterpret_cast<char*>(datagram.data), static_cast<int>(Datagram::MAX_SIZE), 0,
+			reinterpret_cast<sockaddr*>(&address), &length);
+		if (result < 0) break;
+		datagram.address = fromNative(address);
+		datagram.size = static_cast<uint16_t>(result);
+	}
+#endif
+	return received;
+}
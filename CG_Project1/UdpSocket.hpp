@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// IPv4 address and port, both in host byte order
+struct SocketAddress {
+	uint32_t ip;
+	uint16_t port;
+
+	SocketAddress() : ip(0), port(0) {}
+	SocketAddress(uint32_t ip, uint16_t port) : ip(ip), port(port) {}
+
+	bool operator==(const SocketAddress& other) const { return ip == other.ip && port == other.port; }
+	bool operator!=(const SocketAddress& other) const { return !(*this == other); }
+
+	// Dotted quad only, e.g. "127.0.0.1"
+	static bool parse(const std::string& text, uint16_t port, SocketAddress& out);
+};
+
+// Fixed-size so batches need no allocation; kept under a typical MTU
+struct Datagram {
+	static const size_t MAX_SIZE = 1200;
+
+	SocketAddress address;
+	uint16_t size;
+	uint8_t data[MAX_SIZE];
+};
+
+// Non-blocking UDP socket that sends and receives in batches. On Linux a batch is a single
+// sendmmsg or recvmmsg call, so a server ticking many clients pays one system call per
+// direction per tick; elsewhere it loops over sendto and recvfrom.
+class UdpSocket {
+public:
+	UdpSocket();
+	~UdpSocket();
+
+	UdpSocket(const UdpSocket&) = delete;
+	UdpSocket& operator=(const UdpSocket&) = delete;
+
+	// Port 0 lets the system pick one
+	bool open(uint16_t port = 0);
+	void close();
+	bool isOpen() const;
+	uint16_t getPort() const { return port; }
+
+	// Returns how many were handed to the system; the rest would have blocked or failed
+	size_t send(const Datagram* datagrams, size_t count);
+	// Fills up to maxCount datagrams with whatever has arrived, without waiting
+	size_t receive(Datagram* datagrams, size_t maxCount);
+
+private:
+	intptr_t handle;
+	uint16_t port;
+};
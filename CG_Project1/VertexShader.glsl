@@ -1,14 +1,39 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+#ifdef INSTANCED
+layout (location = 3) in mat4 aModel;  // Occupies locations 3-6
+#endif
 
 out vec2 TexCoord;
+#ifdef LIT
+out vec3 ViewPos;
+out vec3 ViewNormal;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
 uniform mat4 projection;
+#ifndef CROSSHAIR
+uniform mat4 view;
+#ifndef INSTANCED
+uniform mat4 model;
+#endif
+#endif
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef CROSSHAIR
+    gl_Position = projection * vec4(aPos, 1.0);
+#else
+#ifdef INSTANCED
+    mat4 model = aModel;
+#endif
+    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    gl_Position = projection * viewPos;
+#ifdef LIT
+    // Models only use uniform scale, so the upper 3x3 is enough for normals
+    ViewPos = viewPos.xyz;
+    ViewNormal = mat3(view * model) * aNormal;
+#endif
+#endif
     TexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y);  // Flip the Y coordinate here
-}
\ No newline at end of file
+}
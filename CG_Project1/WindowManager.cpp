@@ -1,5 +1,6 @@
 #include "WindowManager.hpp"
 #include <iostream>
+#include "CpuProfiler.hpp"
 
 WindowManager::WindowManager(const std::string& title, int width, int height)
 	: title(title), width(width), height(height), window(nullptr), glContext(nullptr) {}
@@ -10,7 +11,11 @@ WindowManager::~WindowManager() {
 	SDL_Quit();
 }
 
-bool WindowManager::initialize() {
+bool WindowManager::initialize(bool headless) {
+	if (headless) {
+		SDL_SetHint(SDL_HINT_VIDEODRIVER, "offscreen");
+	}
+
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 		std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
 		return false;
@@ -21,7 +26,7 @@ bool WindowManager::initialize() {
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 
 	window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-		width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+		width, height, SDL_WINDOW_OPENGL | (headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN));
 	if (!window) {
 		std::cerr << "Failed to create window: " << SDL_GetError() << std::endl;
 		return false;
@@ -38,7 +43,7 @@ bool WindowManager::initialize() {
 		return false;
 	}
 
-	SDL_GL_SetSwapInterval(1); // Enable V-Sync
+	SDL_GL_SetSwapInterval(headless ? 0 : 1); // Enable V-Sync, except when measuring headless
 	return true;
 }
 
@@ -54,6 +59,27 @@ void WindowManager::handleEvents(bool& running) {
 	}
 }
 
+bool WindowManager::makeCurrent() const {
+	if (SDL_GL_MakeCurrent(window, glContext) != 0) {
+		std::cerr << "Failed to make OpenGL context current: " << SDL_GetError() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void WindowManager::releaseCurrent() const {
+	SDL_GL_MakeCurrent(window, nullptr);
+}
+
+int WindowManager::setSwapInterval(int interval) {
+	if (SDL_GL_SetSwapInterval(interval) == 0) return interval;
+
+	std::cerr << "Swap interval " << interval << " not supported: " << SDL_GetError() << std::endl;
+	if (interval == -1 && SDL_GL_SetSwapInterval(1) == 0) return 1;
+	return SDL_GL_GetSwapInterval();
+}
+
 void WindowManager::swapBuffers() const {
+	PROFILE_SCOPE("swapBuffers");
 	SDL_GL_SwapWindow(window);
 }
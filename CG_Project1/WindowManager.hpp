@@ -9,11 +9,22 @@ public:
 	WindowManager(const std::string& title, int width, int height);
 	~WindowManager();
 
-	bool initialize();
+	// Headless mode renders through SDL's offscreen (EGL) video driver without a visible window,
+	// which also works on software rasterizers like llvmpipe
+	bool initialize(bool headless = false);
 	void handleEvents(bool& running);
 	void swapBuffers() const;
 
+	// Moves the GL context between threads; it can only be current on one at a time
+	bool makeCurrent() const;
+	void releaseCurrent() const;
+
+	// 1 = vsync, 0 = off, -1 = adaptive (falls back to vsync if unsupported)
+	int setSwapInterval(int interval);
+
 	SDL_Window* getWindow() const { return window; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
 
 private:
 	std::string title;